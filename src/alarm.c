@@ -53,7 +53,9 @@ void alarm_context_init(alarm_context_t *context, const char *name)
     context->alarms = NULL;
 
     context->num_pending_alarms = 0;
+    context->pending_alarms[0].clk = (CLOCK) ~0L;
     context->next_pending_alarm_clk = (CLOCK) ~0L;
+    context->next_pending_alarm_idx = -1;
 }
 
 void alarm_context_destroy(alarm_context_t *context)
@@ -85,6 +87,8 @@ void alarm_context_time_warp(alarm_context_t *context, CLOCK warp_amount,
         return;
     }
 
+    /* All alarms are shifted by the same amount, so the heap order is
+       preserved.  */
     for (i = 0; i < context->num_pending_alarms; i++) {
         if (warp_direction > 0) {
             context->pending_alarms[i].clk += warp_amount;
@@ -182,23 +186,30 @@ void alarm_unset(alarm_t *alarm)
         last = --context->num_pending_alarms;
 
         if (last != idx) {
-            /* Let's copy the struct by hand to make sure stupid compilers
-               don't do stupid things.  */
+            CLOCK old_clk = context->pending_alarms[idx].clk;
+
+            /* Move the last heap entry into the hole and restore the heap
+               order.  Let's copy the struct by hand to make sure stupid
+               compilers don't do stupid things.  */
             context->pending_alarms[idx].alarm
                 = context->pending_alarms[last].alarm;
             context->pending_alarms[idx].clk
                 = context->pending_alarms[last].clk;
+            context->pending_alarms[last].clk = (CLOCK) ~0L;
 
-            context->pending_alarms[idx].alarm->pending_idx = idx;
+            if (context->pending_alarms[idx].clk < old_clk) {
+                alarm_context_sift_up(context, (unsigned int)idx);
+            } else {
+                alarm_context_sift_down(context, (unsigned int)idx);
+            }
+        } else {
+            context->pending_alarms[last].clk = (CLOCK) ~0L;
         }
 
-        if (context->next_pending_alarm_idx == idx) {
-            alarm_context_update_next_pending(context);
-        } else if (context->next_pending_alarm_idx == last) {
-            context->next_pending_alarm_idx = idx;
-        }
+        alarm_context_update_next_pending(context);
     } else {
         context->num_pending_alarms = 0;
+        context->pending_alarms[0].clk = (CLOCK) ~0L;
         context->next_pending_alarm_clk = (CLOCK) ~0L;
         context->next_pending_alarm_idx = -1;
     }
@@ -45,7 +45,7 @@ struct alarm_s {
     /* Callback to be called when the alarm is dispatched.  */
     alarm_callback_t callback;
 
-    /* Index into the pending alarm list.  If < 0, the alarm is not
+    /* Index into the pending alarm heap.  If < 0, the alarm is not
        pending.  */
     int pending_idx;
 
@@ -74,15 +74,18 @@ struct alarm_context_s {
     /* Alarm list.  */
     struct alarm_s *alarms;
 
-    /* Pending alarm array.  Statically allocated because it's slightly
-       faster this way.  */
-    pending_alarms_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
+    /* Pending alarm array, kept as a binary min-heap ordered by `clk', so
+       the next alarm to dispatch is always at index 0.  The entry after
+       the last pending alarm is a sentinel with `clk' = ~0, which saves a
+       bounds check when sifting down.  Statically allocated because it's
+       slightly faster this way.  */
+    pending_alarms_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS + 1];
     unsigned int num_pending_alarms;
 
     /* Clock tick for the next pending alarm.  */
     CLOCK next_pending_alarm_clk;
 
-    /* Pending alarm number.  */
+    /* Pending alarm number (0 if any alarm is pending, -1 otherwise).  */
     int next_pending_alarm_idx;
 };
 typedef struct alarm_context_s alarm_context_t;
@@ -111,23 +114,71 @@ inline static CLOCK alarm_context_next_pending_clk(alarm_context_t *context)
 
 inline static void alarm_context_update_next_pending(alarm_context_t *context)
 {
-    CLOCK next_pending_alarm_clk = (CLOCK)~0L;
-    int next_pending_alarm_idx;
-    unsigned int i;
+    if (context->num_pending_alarms > 0) {
+        context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+        context->next_pending_alarm_idx = 0;
+    } else {
+        context->next_pending_alarm_clk = (CLOCK)~0L;
+        context->next_pending_alarm_idx = -1;
+    }
+}
+
+/* Move the pending alarm at `idx' towards the root of the heap until its
+   parent is not later than it.  */
+inline static void alarm_context_sift_up(alarm_context_t *context,
+                                         unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
+
+    while (idx > 0) {
+        unsigned int parent = (idx - 1) >> 1;
+
+        if (heap[parent].clk <= clk) {
+            break;
+        }
+        heap[idx].alarm = heap[parent].alarm;
+        heap[idx].clk = heap[parent].clk;
+        heap[idx].alarm->pending_idx = (int)idx;
+        idx = parent;
+    }
 
-    next_pending_alarm_idx = context->next_pending_alarm_idx;
+    heap[idx].alarm = alarm;
+    heap[idx].clk = clk;
+    alarm->pending_idx = (int)idx;
+}
 
-    for (i = 0; i < context->num_pending_alarms; i++) {
-        CLOCK pending_clk = context->pending_alarms[i].clk;
+/* Move the pending alarm at `idx' towards the leaves of the heap until
+   none of its children is earlier than it.  */
+inline static void alarm_context_sift_down(alarm_context_t *context,
+                                           unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    unsigned int num = context->num_pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
 
-        if (pending_clk <= next_pending_alarm_clk) {
-            next_pending_alarm_clk = pending_clk;
-            next_pending_alarm_idx = (int)i;
+    for (;;) {
+        unsigned int child = (idx << 1) + 1;
+
+        if (child >= num) {
+            break;
+        }
+        /* heap[num] is the sentinel, so the right child always exists.  */
+        child += (heap[child + 1].clk < heap[child].clk);
+        if (clk <= heap[child].clk) {
+            break;
         }
+        heap[idx].alarm = heap[child].alarm;
+        heap[idx].clk = heap[child].clk;
+        heap[idx].alarm->pending_idx = (int)idx;
+        idx = child;
     }
 
-    context->next_pending_alarm_clk = next_pending_alarm_clk;
-    context->next_pending_alarm_idx = next_pending_alarm_idx;
+    heap[idx].alarm = alarm;
+    heap[idx].clk = clk;
+    alarm->pending_idx = (int)idx;
 }
 
 inline static void alarm_context_dispatch(alarm_context_t *context,
@@ -168,22 +219,23 @@ inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
         context->pending_alarms[new_idx].clk = cpu_clk;
 
         context->num_pending_alarms++;
+        context->pending_alarms[new_idx + 1].clk = (CLOCK)~0L;
 
-        if (cpu_clk < context->next_pending_alarm_clk) {
-            context->next_pending_alarm_clk = cpu_clk;
-            context->next_pending_alarm_idx = new_idx;
-        }
-
-        alarm->pending_idx = new_idx;
+        alarm_context_sift_up(context, (unsigned int)new_idx);
     } else {
         /* Already pending: modify.  */
 
+        CLOCK old_clk = context->pending_alarms[idx].clk;
+
         context->pending_alarms[idx].clk = cpu_clk;
-        if (context->next_pending_alarm_clk > cpu_clk
-            || idx == context->next_pending_alarm_idx) {
-            alarm_context_update_next_pending(context);
+        if (cpu_clk < old_clk) {
+            alarm_context_sift_up(context, (unsigned int)idx);
+        } else {
+            alarm_context_sift_down(context, (unsigned int)idx);
         }
     }
+
+    alarm_context_update_next_pending(context);
 }
 
 #endif
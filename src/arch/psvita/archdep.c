@@ -39,14 +39,17 @@
 #include "debug_psv.h"
 
 #include <ctype.h>
+#include <stddef.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <signal.h>
+#ifdef PSVITA
 #include <psp2/kernel/threadmgr.h> 
 #include <psp2/io/fcntl.h> 
+#endif
 
 
 #ifdef HAVE_VFORK_H
@@ -325,7 +328,11 @@ int archdep_path_is_relative(const char *path)
         return 0;
     }
 
+#ifdef PSVITA
 	return strchr(path, ':') == NULL;
+#else
+    return *path != '/';
+#endif
 }
 
 int archdep_spawn(const char *name, char **argv,
@@ -797,6 +804,7 @@ void archdep_signals_pipe_unset(void)
 
 /* Missing functions in Vita SDK */
 
+#ifdef PSVITA
 char* getwd(char *buffer)
 {
 	// Not implemented. Return fixed path for now.
@@ -852,3 +860,4 @@ int usleep(useconds_t usec)
     sceKernelDelayThread(usec);
     return 0;
 }
+#endif
@@ -160,10 +160,12 @@ extern int			archdep_default_logger(const char *level_string, const char *txt);
 extern void			archdep_shutdown(void);
 
 /* Missing functions in Vita SDK */
+#ifdef PSVITA
 extern char*		getwd(char *buffer);
 extern int			chdir(const char *path);
 extern int			mkdir(const char* path, mode_t mode);
 extern int			rmdir(const char *path);
 extern int			usleep(useconds_t usec);
+#endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,466 @@
+/*
+ * bench.c - Headless benchmark runner for the host.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The runner replaces the View and the Controller of the Vita app.  It
+   implements the PSV_* functions without drawing anything, so that the Vita
+   arch layer and the machine core run unchanged on the host.
+
+   Usage: vicebench [-frames <n>] [-crt pal|scanlines] [VICE options] [image]
+          vicebench -test <name>
+
+   The image (PRG, D64, T64, snapshot...) is autostarted as usual.  The
+   runner starts in warp mode with the dummy sound device and per-frame
+   profiling enabled; any of these can be overridden on the command line
+   (e.g. `+warp').  After <n> frames the speed and the time spent in each
+   section of the frame are printed and the program exits.
+
+   With -crt, each frame is also run through the CRT emulation of the
+   View, into a 16 bit image.
+
+   `vicebench -test <name>' runs one of the self tests of bench.h instead
+   of the emulator and exits with a non-zero status if it fails.  The tests
+   that need the machine start it with bench_run_machine().  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "app_defs.h"
+#include "archdep.h"
+#include "frameprof.h"
+#include "lib.h"
+#include "machine.h"
+#include "main.h"
+#include "maincpu.h"
+#include "resources.h"
+#include "rewind.h"
+#include "types.h"
+#include "videoarch.h"
+#include "vsync.h"
+#include "vsyncapi.h"
+
+#include "bench.h"
+#include "controller.h"
+
+#define BENCH_DEFAULT_FRAMES 1000
+
+/* Seed of the random numbers at the start of each self test.  */
+#define BENCH_DEFAULT_SEED 1
+
+/* Options put in front of the user's, so that they can be overridden.  */
+static const char * const default_args[] = {
+    "-sounddev", "dummy",
+    "-warp",
+    "-frameprofile"
+};
+
+#define NUM_DEFAULT_ARGS (int)(sizeof(default_args) / sizeof(default_args[0]))
+
+static unsigned long bench_frames = BENCH_DEFAULT_FRAMES;
+static unsigned long frames_done = 0;
+static unsigned long view_updates = 0;
+
+static unsigned long start_time;
+static CLOCK start_clk;
+
+/* Sum of the profiled frames.  */
+static unsigned long long section_usec[FRAMEPROF_NUM];
+static unsigned long long profiled_usec = 0;
+static unsigned long profiled_frames = 0;
+static long last_profiled_frame = -1;
+
+static uint8_t *view_pixels = NULL;
+static int view_width = 0;
+static int view_height = 0;
+static int viewport_x = 0;
+static int viewport_y = 0;
+static int viewport_width = 0;
+static int viewport_height = 0;
+
+/* CRT emulation mode and its frame, at double height for the scanlines.  */
+static int bench_crt = PSV_CRT_OFF;
+static uint8_t *crt_pixels = NULL;
+
+static unsigned int random_seed = BENCH_DEFAULT_SEED;
+
+/* Frame function of a self test that runs the machine.  */
+static int (*test_frame)(unsigned long frame) = NULL;
+
+/* Self tests, by name.  */
+static const struct {
+    const char *name;
+    int (*run)(void);
+} bench_tests[] = {
+    { "sid", bench_test_sid },
+    { "alarm", bench_test_alarm },
+    { "cpu", bench_test_cpu },
+    { "vicii", bench_test_vicii },
+    { "sprites", bench_test_sprites },
+    { "tap", bench_test_tap },
+    { "render", bench_test_render },
+    { "mem", bench_test_mem },
+    { "zfile", bench_test_zfile },
+    { "drive", bench_test_drive }
+};
+
+#define NUM_BENCH_TESTS (int)(sizeof(bench_tests) / sizeof(bench_tests[0]))
+
+/* ------------------------------------------------------------------------- */
+
+void bench_seed(unsigned int seed)
+{
+    random_seed = seed;
+}
+
+/* A number below `n', from the upper bits of a linear congruential
+   generator.  */
+unsigned int bench_random(unsigned int n)
+{
+    random_seed = random_seed * 1103515245 + 12345;
+    return (random_seed >> 8) % n;
+}
+
+uint32_t bench_random32(void)
+{
+    return (bench_random(0x10000) << 16) | bench_random(0x10000);
+}
+
+/* Start the machine with the default options and `args', and call
+   `frame' at the end of each frame until it returns non-zero.  The runner
+   then exits, with a failure if it returned a negative value.  */
+int bench_run_machine(const char * const *args, int num_args,
+                      int (*frame)(unsigned long frame))
+{
+    char **argv;
+    int i, n = 0;
+
+    argv = lib_malloc((num_args + NUM_DEFAULT_ARGS + 2) * sizeof(char *));
+    argv[n++] = "vicebench";
+    for (i = 0; i < NUM_DEFAULT_ARGS; i++) {
+        argv[n++] = (char *)default_args[i];
+    }
+    for (i = 0; i < num_args; i++) {
+        argv[n++] = (char *)args[i];
+    }
+    argv[n] = NULL;
+
+    archdep_mkdir(APP_DATA_DIR, 0755);
+    archdep_mkdir(VICE_DIR, 0755);
+
+    test_frame = frame;
+    frames_done = 0;
+    main_program(n, argv);
+
+    /* Not reached, the frame function ends the run.  */
+    return 1;
+}
+
+static int bench_run_test(const char *name)
+{
+    int i;
+
+    for (i = 0; i < NUM_BENCH_TESTS; i++) {
+        if (strcmp(name, bench_tests[i].name) == 0) {
+            bench_seed(BENCH_DEFAULT_SEED);
+            return bench_tests[i].run() ? EXIT_FAILURE : EXIT_SUCCESS;
+        }
+    }
+
+    fprintf(stderr, "Unknown test `%s'.\n", name);
+    return EXIT_FAILURE;
+}
+
+static void bench_report(void)
+{
+    unsigned long end_time = vsyncarch_gettime();
+    double secs = (double)(end_time - start_time) / vsyncarch_frequency();
+    double fps = secs > 0 ? frames_done / secs : 0;
+    double refresh = vsync_get_refresh_frequency();
+    rewind_info_t rewind;
+    int i;
+
+    printf("frames:       %lu\n", frames_done);
+    printf("time:         %.3f s\n", secs);
+    printf("frames/sec:   %.2f\n", fps);
+    if (refresh > 0) {
+        printf("speed:        %.1f%%\n", fps * 100.0 / refresh);
+    }
+    printf("cycles/sec:   %.0f\n", secs > 0 ? (double)(maincpu_clk - start_clk) / secs : 0);
+    printf("view updates: %lu\n", view_updates);
+
+    rewind_get_info(&rewind);
+    if (rewind.captures > 0) {
+        printf("rewind:       %lu captures, %.1f usec each, %d states, %.1f s in %lu KB\n",
+               rewind.captures,
+               (double)rewind.capture_usec / rewind.captures,
+               rewind.states,
+               rewind.seconds,
+               (unsigned long)(rewind.bytes / 1024));
+    }
+
+    if (profiled_frames == 0) {
+        return;
+    }
+
+    printf("\n%-8s %12s %12s %8s\n", "section", "total ms", "usec/frame", "share");
+    for (i = 0; i < FRAMEPROF_NUM; i++) {
+        printf("%-8s %12.1f %12.1f %7.1f%%\n",
+               frameprof_section_name(i),
+               section_usec[i] / 1000.0,
+               (double)section_usec[i] / profiled_frames,
+               profiled_usec ? section_usec[i] * 100.0 / profiled_usec : 0);
+    }
+    printf("%-8s %12.1f %12.1f\n", "total",
+           profiled_usec / 1000.0,
+           (double)profiled_usec / profiled_frames);
+}
+
+/* Add the last finished frame to the totals.  Each frame is counted once,
+   even though the profiler finishes frames after the scan.  */
+static void bench_profile_frame(void)
+{
+    const frameprof_frame_t *frame = frameprof_get_last_frame();
+    int i;
+
+    if (frame == NULL || (long)frame->frame == last_profiled_frame) {
+        return;
+    }
+
+    for (i = 0; i < FRAMEPROF_NUM; i++) {
+        section_usec[i] += frame->usec[i];
+    }
+    profiled_usec += frame->total;
+    profiled_frames++;
+    last_profiled_frame = (long)frame->frame;
+}
+
+/* ------------------------------------------------------------------------- */
+
+void PSV_CreateView(int width, int height, int depth)
+{
+    lib_free(view_pixels);
+    lib_free(crt_pixels);
+
+    view_width = width;
+    view_height = height;
+    view_pixels = lib_calloc(1, (size_t)width * height);
+    crt_pixels = lib_calloc(1, (size_t)width * height * 2 * 2);
+}
+
+static void bench_render_crt(void)
+{
+    if (bench_crt != PSV_CRT_OFF && viewport_width > 0) {
+        video_psv_render_frame(crt_pixels, view_width * 2, viewport_x, viewport_y,
+                               viewport_width, viewport_height);
+    }
+}
+
+void PSV_UpdateView()
+{
+    view_updates++;
+    bench_render_crt();
+}
+
+void PSV_UpdateViewLines(const uint32_t* dirty_lines, unsigned int num_lines)
+{
+    view_updates++;
+    bench_render_crt();
+}
+
+void PSV_SetViewport(int x, int y, int width, int height)
+{
+    viewport_x = x;
+    viewport_y = y;
+    viewport_width = width;
+    viewport_height = height;
+}
+
+void PSV_GetViewInfo(int* width, int* height, unsigned char** ppixels, int* pitch, int* bpp)
+{
+    if (width) {
+        *width = view_width;
+    }
+    if (height) {
+        *height = view_height;
+    }
+    if (ppixels) {
+        *ppixels = view_pixels;
+    }
+    if (pitch) {
+        *pitch = view_width;
+    }
+    if (bpp) {
+        *bpp = 8;
+    }
+}
+
+/* Called once per frame before the frame is synchronized.  */
+void PSV_ScanControls()
+{
+    int ret;
+
+    if (test_frame != NULL) {
+        ret = test_frame(frames_done++);
+        if (ret != 0) {
+            archdep_vice_exit(ret < 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+        }
+        return;
+    }
+
+    if (frames_done == 0) {
+        start_time = vsyncarch_gettime();
+        start_clk = maincpu_clk;
+    } else {
+        bench_profile_frame();
+    }
+
+    if (++frames_done > bench_frames) {
+        frames_done = bench_frames;
+        bench_report();
+        archdep_vice_exit(0);
+    }
+}
+
+void PSV_ApplySettings()
+{
+    /* Same as the Vita app, so that the numbers are comparable.  */
+    resources_set_int(VICE_RES_VICII_FILTER, 0);
+    resources_set_int(VICE_RES_VIRTUAL_DEVICES, 1);
+    resources_set_int(VICE_RES_SID_RESID_SAMPLING, 0);
+    resources_set_int("Drive8Type", 1542);
+
+    if (bench_crt != PSV_CRT_OFF) {
+        resources_set_int(VICE_RES_VICII_FILTER, 1);
+        video_psv_set_crt_emulation(bench_crt);
+    }
+}
+
+void PSV_ActivateMenu()
+{
+}
+
+int PSV_RGBToPixel(uint8_t r, uint8_t g, uint8_t b)
+{
+    return 0;
+}
+
+void PSV_NotifyPalette(unsigned char* palette, int size)
+{
+}
+
+void PSV_NotifyFPS(int fps, float percent, int warp_flag)
+{
+}
+
+void PSV_NotifySoundXruns(unsigned int underruns, unsigned int overruns)
+{
+}
+
+void PSV_NotifyTapeCounter(int count)
+{
+}
+
+void PSV_NotifyTapeControl(int control)
+{
+}
+
+void PSV_NotifyDriveStatus(int drive, int led)
+{
+}
+
+void PSV_NotifyDriveContent(int drive, const char* image)
+{
+}
+
+void PSV_NotifyTapeMotorStatus(int motor)
+{
+}
+
+void PSV_NotifyDriveTrack(unsigned int drive, unsigned int track)
+{
+}
+
+void PSV_NotifyReset()
+{
+}
+
+int PSV_ShowMessage(const char* msg, int msg_type)
+{
+    fprintf(stderr, "%s\n", msg);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+int main(int argc, char *argv[])
+{
+    char **args;
+    int i, n;
+
+    args = lib_malloc((argc + NUM_DEFAULT_ARGS + 1) * sizeof(char *));
+    args[0] = argv[0];
+    for (n = 1; n <= NUM_DEFAULT_ARGS; n++) {
+        args[n] = (char *)default_args[n - 1];
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-test") == 0 && i + 1 < argc) {
+            lib_free(args);
+            return bench_run_test(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            bench_frames = strtoul(argv[++i], NULL, 10);
+            continue;
+        }
+        if (strcmp(argv[i], "-crt") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "pal") == 0) {
+                bench_crt = PSV_CRT_PAL;
+            } else if (strcmp(argv[i], "scanlines") == 0) {
+                bench_crt = PSV_CRT_SCANLINES;
+            }
+            continue;
+        }
+        args[n++] = argv[i];
+    }
+    args[n] = NULL;
+
+    if (bench_frames == 0) {
+        bench_frames = BENCH_DEFAULT_FRAMES;
+    }
+
+    /* Home of the autostart disk image and the log.  */
+    archdep_mkdir(APP_DATA_DIR, 0755);
+    archdep_mkdir(VICE_DIR, 0755);
+
+    main_program(n, args);
+
+    return 0;
+}
+
+void main_exit(void)
+{
+    machine_shutdown();
+}
@@ -0,0 +1,83 @@
+/*
+ * bench.h - Self tests of the headless benchmark runner.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_BENCH_H
+#define VICE_BENCH_H
+
+#include "types.h"
+
+/* Tests run by `vicebench -test <name>' instead of the emulator.  They
+   return 0 if the optimized code matches its reference.  Most of them run
+   without the machine; the others start it with bench_run_machine().  */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pseudo random numbers for the tests, the same on every host.  The runner
+   seeds them before each test; bench_seed() starts another sequence.  */
+extern void bench_seed(unsigned int seed);
+extern unsigned int bench_random(unsigned int n);
+extern uint32_t bench_random32(void);
+
+/* Run the machine with `args' after the default options, and call `frame'
+   at the end of each frame from 0 on.  The runner exits once it returns
+   non-zero: successfully if positive, with a failure if negative.  */
+extern int bench_run_machine(const char * const *args, int num_args,
+                             int (*frame)(unsigned long frame));
+
+/* reSID resampling with and without the vectorized FIR convolution.  */
+extern int bench_test_sid(void);
+
+/* Alarm dispatch time with 4, 16 and 64 pending alarms.  */
+extern int bench_test_alarm(void);
+
+/* 6502 core with and without the threaded opcode dispatch.  */
+extern int bench_test_cpu(void);
+
+/* VIC-II text and bitmap modes with and without SIMD.  */
+extern int bench_test_vicii(void);
+
+/* VIC-II sprites drawn with bit planes and with the per-pixel code.  */
+extern int bench_test_sprites(void);
+
+/* TAP pulse index and datasette gaps against a plain decode.  */
+extern int bench_test_tap(void);
+
+/* Render modes drawn in bands on the render threads and in one pass.  */
+extern int bench_test_render(void);
+
+/* C64 direct RAM page tables against the memory function tables.  */
+extern int bench_test_mem(void);
+
+/* Images in memory read, written back and grown through zfile.  */
+extern int bench_test_zfile(void);
+
+/* A fastloader run with and without the drive thread.  */
+extern int bench_test_drive(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+/*
+ * bench_alarm.c - Alarm dispatch micro-benchmark.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* An alarm context with 4, 16 and 64 active alarms is run the way the CPU
+   runs it: the clock jumps to the next pending alarm and dispatches it.
+   Each callback sets its own alarm again, 1 to 1024 cycles later, and every
+   eighth one also moves another pending alarm, as a timer write does.  The
+   time per dispatch is printed.
+
+   Each alarm remembers when it is due, so the run also checks that the
+   alarms are dispatched in order and on time.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+
+#include "alarm.h"
+#include "lib.h"
+#include "types.h"
+#include "vsyncapi.h"
+
+#include "bench.h"
+
+#define ALARM_BENCH_MAX 64
+#define ALARM_BENCH_DISPATCHES 4000000
+
+typedef struct alarm_bench_s {
+    alarm_t *alarm;
+    CLOCK due;
+} alarm_bench_t;
+
+static alarm_context_t *bench_context;
+static alarm_bench_t bench_alarms[ALARM_BENCH_MAX];
+static int num_bench_alarms;
+
+static CLOCK bench_clk;
+static unsigned long dispatches;
+static unsigned long errors;
+
+static void bench_alarm_set(alarm_bench_t *a)
+{
+    a->due = bench_clk + 1 + bench_random(1024);
+    alarm_set(a->alarm, a->due);
+}
+
+static void bench_alarm_callback(CLOCK offset, void *data)
+{
+    alarm_bench_t *a = (alarm_bench_t *)data;
+
+    if (offset != 0 || a->due != bench_clk) {
+        errors++;
+    }
+
+    bench_alarm_set(a);
+    if ((++dispatches & 7) == 0) {
+        bench_alarm_set(&bench_alarms[bench_random(num_bench_alarms)]);
+    }
+}
+
+/* Run `num' alarms and return the time per dispatch in nanoseconds.  */
+static double bench_alarm_run(int num)
+{
+    unsigned long start, end;
+    int i;
+
+    bench_context = alarm_context_new("Bench");
+    num_bench_alarms = num;
+    bench_clk = 0;
+    bench_seed(1);
+    dispatches = 0;
+
+    for (i = 0; i < num; i++) {
+        bench_alarms[i].alarm = alarm_new(bench_context, "Bench",
+                                          bench_alarm_callback,
+                                          &bench_alarms[i]);
+        bench_alarm_set(&bench_alarms[i]);
+    }
+
+    start = vsyncarch_gettime();
+    while (dispatches < ALARM_BENCH_DISPATCHES) {
+        CLOCK next = alarm_context_next_pending_clk(bench_context);
+
+        if (next < bench_clk) {
+            errors++;
+            break;
+        }
+        bench_clk = next;
+        alarm_context_dispatch(bench_context, bench_clk);
+    }
+    end = vsyncarch_gettime();
+
+    alarm_context_destroy(bench_context);
+
+    return (double)(end - start) * 1.0e9 / vsyncarch_frequency() / dispatches;
+}
+
+int bench_test_alarm(void)
+{
+    static const int nums[] = { 4, 16, 64 };
+    unsigned int i;
+
+    errors = 0;
+
+    for (i = 0; i < sizeof(nums) / sizeof(nums[0]); i++) {
+        double ns = bench_alarm_run(nums[i]);
+
+        printf("alarm: %2d alarms: %6.1f ns/dispatch\n", nums[i], ns);
+    }
+
+    if (errors) {
+        printf("alarm: FAILED, %lu alarms dispatched out of order\n", errors);
+    }
+
+    return errors != 0;
+}
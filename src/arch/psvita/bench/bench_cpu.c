@@ -0,0 +1,455 @@
+/*
+ * bench_cpu.c - 6502 core dispatch test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Test programs are generated from a seed and run by the 6502 core built
+   with and without CPU_THREADED_DISPATCH (bench_cpu_core.c).  The clock,
+   the registers and a hash of the memory writes must be the same before
+   every instruction, and the memory must be the same at the end.
+
+   The programs run almost every documented and undocumented opcode with
+   harmless operands, and mix in what makes the dispatch leave the threaded
+   path: interrupts from alarms and from BRK, SEI/CLI and PLP, code in the
+   I/O area, timer writes that move an alarm to the next few cycles, and
+   reads of the clock.  The runs differ in how often the alarms fire.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lib.h"
+#include "types.h"
+
+#include "bench.h"
+#include "bench_cpu.h"
+
+#define CPU_TEST_CYCLES 1000000
+#define CPU_TEST_MAX_STEPS (CPU_TEST_CYCLES / 2 + 1)
+
+#define CODE_START 0x0810
+#define CODE_END 0x3e00
+#define SUB_RAM 0x3f00
+#define SUB_IO 0xde00
+#define NMI_HANDLER 0xf000
+#define IRQ_HANDLER 0xf100
+#define DATA 0x4000
+#define CHECKSUM 0x4300
+#define JMP_VECTOR 0x4480
+
+/* Addressing modes of the opcodes the programs are made of.  */
+enum {
+    AM_NONE,    /* Not generated: stack, jumps, JAM, TXS, TAS, LAS, SHA... */
+    AM_IMP,
+    AM_IMM,
+    AM_ZP,
+    AM_ZPX,
+    AM_IZX,
+    AM_IZY,
+    AM_ABS,
+    AM_ABX,
+    AM_REL
+};
+
+static const uint8_t cpu_modes[0x100] = {
+    /*       0       1       2        3       4       5       6       7       8       9       a       b       c       d       e       f */
+    /* 0 */ AM_NONE, AM_IZX, AM_NONE, AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_NONE, AM_IMM, AM_IMP, AM_IMM, AM_ABS, AM_ABS, AM_ABS, AM_ABS,
+    /* 1 */ AM_REL,  AM_IZY, AM_NONE, AM_IZY, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_IMP, AM_ABX, AM_ABX, AM_ABX, AM_ABX, AM_ABX,
+    /* 2 */ AM_NONE, AM_IZX, AM_NONE, AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_NONE, AM_IMM, AM_IMP, AM_IMM, AM_ABS, AM_ABS, AM_ABS, AM_ABS,
+    /* 3 */ AM_REL,  AM_IZY, AM_NONE, AM_IZY, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_IMP, AM_ABX, AM_ABX, AM_ABX, AM_ABX, AM_ABX,
+    /* 4 */ AM_NONE, AM_IZX, AM_NONE, AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_NONE, AM_IMM, AM_IMP, AM_IMM, AM_NONE, AM_ABS, AM_ABS, AM_ABS,
+    /* 5 */ AM_REL,  AM_IZY, AM_NONE, AM_IZY, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_IMP, AM_ABX, AM_ABX, AM_ABX, AM_ABX, AM_ABX,
+    /* 6 */ AM_NONE, AM_IZX, AM_NONE, AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_NONE, AM_IMM, AM_IMP, AM_IMM, AM_NONE, AM_ABS, AM_ABS, AM_ABS,
+    /* 7 */ AM_REL,  AM_IZY, AM_NONE, AM_IZY, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_IMP, AM_ABX, AM_ABX, AM_ABX, AM_ABX, AM_ABX,
+    /* 8 */ AM_IMM,  AM_IZX, AM_IMM,  AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_IMP, AM_IMM, AM_IMP, AM_IMM, AM_ABS, AM_ABS, AM_ABS, AM_ABS,
+    /* 9 */ AM_REL,  AM_IZY, AM_NONE, AM_NONE, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_NONE, AM_NONE, AM_NONE, AM_ABX, AM_NONE, AM_NONE,
+    /* a */ AM_IMM,  AM_IZX, AM_IMM,  AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_IMP, AM_IMM, AM_IMP, AM_IMM, AM_ABS, AM_ABS, AM_ABS, AM_ABS,
+    /* b */ AM_REL,  AM_IZY, AM_NONE, AM_IZY, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_IMP, AM_NONE, AM_ABX, AM_ABX, AM_ABX, AM_ABX,
+    /* c */ AM_IMM,  AM_IZX, AM_IMM,  AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_IMP, AM_IMM, AM_IMP, AM_IMM, AM_ABS, AM_ABS, AM_ABS, AM_ABS,
+    /* d */ AM_REL,  AM_IZY, AM_NONE, AM_IZY, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_IMP, AM_ABX, AM_ABX, AM_ABX, AM_ABX, AM_ABX,
+    /* e */ AM_IMM,  AM_IZX, AM_IMM,  AM_IZX, AM_ZP,  AM_ZP,  AM_ZP,  AM_ZP,  AM_IMP, AM_IMM, AM_IMP, AM_IMM, AM_ABS, AM_ABS, AM_ABS, AM_ABS,
+    /* f */ AM_REL,  AM_IZY, AM_NONE, AM_IZY, AM_ZPX, AM_ZPX, AM_ZPX, AM_ZPX, AM_IMP, AM_ABX, AM_IMP, AM_ABX, AM_ABX, AM_ABX, AM_ABX, AM_ABX
+};
+
+/* Only these absolute loads may read the I/O area, the rest of the
+   absolute opcodes write or modify the data page.  */
+static int cpu_reads_only(uint8_t op)
+{
+    switch (op & 0x1f) {
+        case 0x0c:
+        case 0x0d:
+        case 0x19:
+        case 0x1c:
+        case 0x1d:
+            return (op & 0xe0) != 0x80;
+        case 0x0e:
+        case 0x0f:
+        case 0x1e:
+        case 0x1f:
+            return (op & 0xe0) == 0xa0;
+    }
+    return 0;
+}
+
+typedef struct cpu_gen_s {
+    uint8_t *mem;
+    unsigned int pc;
+} cpu_gen_t;
+
+static void gen_byte(cpu_gen_t *gen, unsigned int value)
+{
+    gen->mem[gen->pc++ & 0xffff] = (uint8_t)value;
+}
+
+static void gen_op(cpu_gen_t *gen, unsigned int op, unsigned int addr)
+{
+    gen_byte(gen, op);
+    gen_byte(gen, addr & 0xff);
+    gen_byte(gen, addr >> 8);
+}
+
+/* One opcode with harmless operands, then the flags go to the checksum.  */
+static void gen_random_opcode(cpu_gen_t *gen)
+{
+    static const unsigned int io[] = {
+        0xd012, 0xd011, 0xdc04, 0xdc05, 0xdc06, 0xdd04, 0xd019, 0xd41b
+    };
+    unsigned int op;
+
+    do {
+        op = bench_random(0x100);
+    } while (cpu_modes[op] == AM_NONE);
+
+    /* Keep the interrupts on and the decimal mode rare.  */
+    if (op == 0x78) {
+        op = 0x58;
+    }
+    if (op == 0xf8 && bench_random(10) < 7) {
+        op = 0xea;
+    }
+
+    gen_byte(gen, 0xd8);                            /* CLD */
+    gen_byte(gen, 0xa2);                            /* LDX #n */
+    gen_byte(gen, bench_random(8));
+    gen_byte(gen, 0xa0);                            /* LDY #n */
+    gen_byte(gen, bench_random(8));
+    gen_byte(gen, 0xa9);                            /* LDA #n */
+    gen_byte(gen, bench_random(0x100));
+    if (bench_random(2)) {
+        gen_byte(gen, bench_random(2) ? 0x18 : 0x38);   /* CLC/SEC */
+    }
+
+    switch (cpu_modes[op]) {
+        case AM_IMP:
+            gen_byte(gen, op);
+            break;
+        case AM_IMM:
+            gen_byte(gen, op);
+            gen_byte(gen, bench_random(0x100));
+            break;
+        case AM_ZP:
+        case AM_ZPX:
+            gen_byte(gen, op);
+            gen_byte(gen, 0xe0 + bench_random(8));
+            break;
+        case AM_IZX:
+            gen_byte(gen, op);
+            gen_byte(gen, 0xf0 + bench_random(8));
+            break;
+        case AM_IZY:
+            gen_byte(gen, op);
+            gen_byte(gen, 0xf0 + 2 * bench_random(8));
+            break;
+        case AM_REL:
+            gen_byte(gen, op);
+            gen_byte(gen, 0);
+            break;
+        default:
+            if (cpu_reads_only((uint8_t)op) && bench_random(10) < 3) {
+                gen_op(gen, op, io[bench_random(8)]);
+            } else {
+                gen_op(gen, op, DATA + bench_random(0x100));
+            }
+            break;
+    }
+
+    gen_byte(gen, 0x08);                            /* PHP */
+    gen_byte(gen, 0x68);                            /* PLA */
+    gen_op(gen, 0x4d, CHECKSUM);                    /* EOR CHECKSUM */
+    gen_op(gen, 0x8d, CHECKSUM);                    /* STA CHECKSUM */
+}
+
+static void gen_block(cpu_gen_t *gen)
+{
+    unsigned int target = gen->pc + 13;
+    unsigned int n;
+
+    switch (bench_random(16)) {
+        case 0:
+            /* A few opcodes with the interrupts off.  */
+            gen_byte(gen, 0x78);                    /* SEI */
+            for (n = bench_random(4); n > 0; n--) {
+                gen_op(gen, 0xad, 0xdc04);          /* LDA $DC04 */
+                gen_op(gen, 0x8d, DATA + 0x402);    /* STA DATA+$402 */
+            }
+            gen_byte(gen, 0x58);                    /* CLI */
+            break;
+        case 1:
+            /* Random flags, with the I flag.  */
+            gen_byte(gen, 0xa9);                    /* LDA #n */
+            gen_byte(gen, bench_random(0x100) & 0xc7);
+            gen_byte(gen, 0x48);                    /* PHA */
+            gen_byte(gen, 0x28);                    /* PLP */
+            gen_byte(gen, 0xea);                    /* NOP */
+            gen_byte(gen, 0x58);                    /* CLI */
+            break;
+        case 2:
+            gen_byte(gen, 0x00);                    /* BRK */
+            gen_byte(gen, 0xea);
+            break;
+        case 3:
+            gen_op(gen, 0x20, bench_random(2) ? SUB_RAM : SUB_IO);   /* JSR */
+            break;
+        case 4:
+            /* JMP (JMP_VECTOR) to the next opcode.  */
+            gen_byte(gen, 0xa9);                    /* LDA #<target */
+            gen_byte(gen, target & 0xff);
+            gen_op(gen, 0x8d, JMP_VECTOR);          /* STA JMP_VECTOR */
+            gen_byte(gen, 0xa9);                    /* LDA #>target */
+            gen_byte(gen, target >> 8);
+            gen_op(gen, 0x8d, JMP_VECTOR + 1);      /* STA JMP_VECTOR+1 */
+            gen_op(gen, 0x6c, JMP_VECTOR);          /* JMP (JMP_VECTOR) */
+            break;
+        case 5:
+            /* A short loop.  */
+            gen_byte(gen, 0xa2);                    /* LDX #n */
+            gen_byte(gen, 1 + bench_random(16));
+            gen_byte(gen, 0xca);                    /* DEX */
+            gen_byte(gen, 0xd0);                    /* BNE *-1 */
+            gen_byte(gen, 0xfd);
+            break;
+        case 6:
+            /* Move the IRQ or NMI to the next few cycles.  */
+            gen_byte(gen, 0xa9);                    /* LDA #n */
+            gen_byte(gen, bench_random(16));
+            gen_op(gen, 0x8d, bench_random(2) ? 0xdc04 : 0xdd04);
+            break;
+        case 7:
+            gen_op(gen, 0xad, 0xd012);              /* LDA $D012 */
+            gen_op(gen, 0x4d, 0xdc04);              /* EOR $DC04 */
+            gen_op(gen, 0x4d, CHECKSUM + 2);        /* EOR CHECKSUM+2 */
+            gen_op(gen, 0x8d, CHECKSUM + 2);        /* STA CHECKSUM+2 */
+            break;
+        default:
+            gen_random_opcode(gen);
+            break;
+    }
+}
+
+static void gen_program(uint8_t *mem, unsigned int seed)
+{
+    cpu_gen_t gen;
+    unsigned int loop, i;
+
+    gen.mem = mem;
+    bench_seed(seed);
+
+    memset(mem, 0, 0x10000);
+    for (i = 0; i < 0x500; i++) {
+        mem[DATA + i] = (uint8_t)bench_random(0x100);
+    }
+    for (i = 0xe0; i < 0xf0; i++) {
+        mem[i] = (uint8_t)bench_random(0x100);
+    }
+    mem[0xfffa] = NMI_HANDLER & 0xff;
+    mem[0xfffb] = NMI_HANDLER >> 8;
+    mem[0xfffc] = CODE_START & 0xff;
+    mem[0xfffd] = CODE_START >> 8;
+    mem[0xfffe] = IRQ_HANDLER & 0xff;
+    mem[0xffff] = IRQ_HANDLER >> 8;
+
+    /* NMI: PHA TXA PHA LDA $DD0D INC DATA+$400 LDX $DC04 STX DATA+$404
+       PLA TAX PLA RTI */
+    gen.pc = NMI_HANDLER;
+    gen_byte(&gen, 0x48);
+    gen_byte(&gen, 0x8a);
+    gen_byte(&gen, 0x48);
+    gen_op(&gen, 0xad, 0xdd0d);
+    gen_op(&gen, 0xee, DATA + 0x400);
+    gen_op(&gen, 0xae, 0xdc04);
+    gen_op(&gen, 0x8e, DATA + 0x404);
+    gen_byte(&gen, 0x68);
+    gen_byte(&gen, 0xaa);
+    gen_byte(&gen, 0x68);
+    gen_byte(&gen, 0x40);
+
+    /* IRQ and BRK: PHA LDA $DC0D INC DATA+$401 PLA RTI */
+    gen.pc = IRQ_HANDLER;
+    gen_byte(&gen, 0x48);
+    gen_op(&gen, 0xad, 0xdc0d);
+    gen_op(&gen, 0xee, DATA + 0x401);
+    gen_byte(&gen, 0x68);
+    gen_byte(&gen, 0x40);
+
+    /* INC DATA+$402 RTS */
+    gen.pc = SUB_RAM;
+    gen_op(&gen, 0xee, DATA + 0x402);
+    gen_byte(&gen, 0x60);
+
+    /* Run from I/O: LDA $D012 STA DATA+$403 RTS */
+    gen.pc = SUB_IO;
+    gen_op(&gen, 0xad, 0xd012);
+    gen_op(&gen, 0x8d, DATA + 0x403);
+    gen_byte(&gen, 0x60);
+
+    /* CLD, point $F0-$FF at DATA+$40, then the blocks forever.  */
+    gen.pc = CODE_START;
+    gen_byte(&gen, 0xd8);
+    gen_byte(&gen, 0xa9);
+    gen_byte(&gen, 0x40);
+    for (i = 0xf0; i < 0x100; i++) {
+        gen_byte(&gen, 0x85);
+        gen_byte(&gen, i);
+    }
+    gen_byte(&gen, 0x58);
+
+    loop = gen.pc;
+    while (gen.pc < CODE_END) {
+        gen_block(&gen);
+    }
+    gen_op(&gen, 0xee, CHECKSUM + 1);               /* INC CHECKSUM+1 */
+    gen_op(&gen, 0x4c, loop);                       /* JMP loop */
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int cpu_compare(const bench_cpu_run_t *ref, const bench_cpu_run_t *run)
+{
+    unsigned long i, n;
+    unsigned int addr;
+
+    n = ref->num_steps < run->num_steps ? ref->num_steps : run->num_steps;
+    if (n > ref->max_steps) {
+        n = ref->max_steps;
+    }
+
+    for (i = 0; i < n; i++) {
+        const bench_cpu_step_t *a = &ref->steps[i];
+        const bench_cpu_step_t *b = &run->steps[i];
+
+        if (memcmp(a, b, sizeof(*a)) != 0) {
+            printf("FAILED at instruction %lu\n"
+                   "  switch:   CLK %lu PC %04X A %02X X %02X Y %02X SP %02X P %02X bus %08lX\n"
+                   "  threaded: CLK %lu PC %04X A %02X X %02X Y %02X SP %02X P %02X bus %08lX\n",
+                   i,
+                   (unsigned long)a->clk, a->pc, a->a, a->x, a->y, a->sp, a->p,
+                   (unsigned long)a->bus,
+                   (unsigned long)b->clk, b->pc, b->a, b->x, b->y, b->sp, b->p,
+                   (unsigned long)b->bus);
+            return 1;
+        }
+    }
+
+    if (ref->num_steps != run->num_steps || ref->clk != run->clk) {
+        printf("FAILED, %lu instructions in %lu cycles against %lu in %lu\n",
+               run->num_steps, (unsigned long)run->clk,
+               ref->num_steps, (unsigned long)ref->clk);
+        return 1;
+    }
+
+    for (addr = 0; addr < 0x10000; addr++) {
+        if (ref->mem_out[addr] != run->mem_out[addr]) {
+            printf("FAILED, memory differs at $%04X: $%02X against $%02X\n",
+                   addr, run->mem_out[addr], ref->mem_out[addr]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void cpu_run_init(bench_cpu_run_t *run, const uint8_t *mem,
+                         const bench_cpu_timer_t *timers, unsigned int seed)
+{
+    memset(run, 0, sizeof(*run));
+    run->mem = mem;
+    run->cycles = CPU_TEST_CYCLES;
+    run->irq = timers[0];
+    run->nmi = timers[1];
+    run->tick = timers[2];
+    run->seed = seed;
+    run->max_steps = CPU_TEST_MAX_STEPS;
+    run->steps = lib_malloc(run->max_steps * sizeof(bench_cpu_step_t));
+    run->mem_out = lib_malloc(0x10000);
+}
+
+static void cpu_run_free(bench_cpu_run_t *run)
+{
+    lib_free(run->steps);
+    lib_free(run->mem_out);
+}
+
+int bench_test_cpu(void)
+{
+    /* IRQ, NMI and tick intervals in cycles, 0 for none.  */
+    static const struct {
+        const char *name;
+        bench_cpu_timer_t timers[3];
+    } tests[] = {
+        { "no alarms",    { {   0,    0 }, {    0,    0 }, {  0,   0 } } },
+        { "irq",          { {  50,  400 }, {    0,    0 }, {  0,   0 } } },
+        { "irq+nmi",      { { 500, 5000 }, { 1000, 9000 }, { 10,  60 } } },
+        { "dense alarms", { {  20,  100 }, {  300, 2000 }, {  1,   8 } } },
+        { "sparse ticks", { {   0,    0 }, {    0,    0 }, { 40, 200 } } }
+    };
+    uint8_t *mem = lib_malloc(0x10000);
+    int failed = 0;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        bench_cpu_run_t ref, run;
+
+        gen_program(mem, 1 + i);
+
+        cpu_run_init(&ref, mem, tests[i].timers, 100 + i);
+        cpu_run_init(&run, mem, tests[i].timers, 100 + i);
+
+        bench_cpu_run_switch(&ref);
+        bench_cpu_run_threaded(&run);
+
+        printf("cpu: %-12s %7lu instructions, %7lu loops %s, ",
+               tests[i].name, run.num_steps, run.loops,
+               run.threaded ? "threaded" : "(no threaded dispatch)");
+        if (cpu_compare(&ref, &run)) {
+            failed = 1;
+        } else {
+            printf("ok\n");
+        }
+
+        cpu_run_free(&ref);
+        cpu_run_free(&run);
+    }
+
+    lib_free(mem);
+
+    return failed;
+}
@@ -0,0 +1,81 @@
+/*
+ * bench_cpu.h - 6502 core dispatch test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_BENCH_CPU_H
+#define VICE_BENCH_CPU_H
+
+#include "types.h"
+
+/* The state before an instruction.  `bus' is a hash of all the memory
+   writes so far, with the clock at which they were done.  */
+typedef struct bench_cpu_step_s {
+    CLOCK clk;
+    uint32_t bus;
+    uint16_t pc;
+    uint8_t a;
+    uint8_t x;
+    uint8_t y;
+    uint8_t sp;
+    uint8_t p;
+} bench_cpu_step_t;
+
+/* Interrupt sources of a run.  Each one fires again after a random number
+   of cycles in [min, max]; max = 0 disables it, so that it only fires
+   once after a timer write.  */
+typedef struct bench_cpu_timer_s {
+    unsigned int min;
+    unsigned int max;
+} bench_cpu_timer_t;
+
+typedef struct bench_cpu_run_s {
+    /* In: the 64 KB of memory at reset, and the cycles to run.  */
+    const uint8_t *mem;
+    CLOCK cycles;
+
+    /* In: the IRQ and NMI timers, and a timer that only breaks up the
+       runs of opcodes, as VIC-II and CIA alarms do.  */
+    bench_cpu_timer_t irq;
+    bench_cpu_timer_t nmi;
+    bench_cpu_timer_t tick;
+    unsigned int seed;
+
+    /* Out: the steps, up to `max_steps'.  */
+    bench_cpu_step_t *steps;
+    unsigned long max_steps;
+    unsigned long num_steps;
+
+    /* Out: the memory and the clock at the end.  */
+    uint8_t *mem_out;
+    CLOCK clk;
+
+    /* Out: the number of times the main loop of the core was entered, and
+       whether the core was built with the threaded dispatch.  */
+    unsigned long loops;
+    int threaded;
+} bench_cpu_run_t;
+
+/* The core built with and without CPU_THREADED_DISPATCH.  */
+extern void bench_cpu_run_switch(bench_cpu_run_t *run);
+extern void bench_cpu_run_threaded(bench_cpu_run_t *run);
+
+#endif
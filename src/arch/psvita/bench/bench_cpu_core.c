@@ -0,0 +1,388 @@
+/*
+ * bench_cpu_core.c - 6502 core harness of the dispatch test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* This file is included by bench_cpu_switch.c and bench_cpu_threaded.c,
+   which define BENCH_CPU_RUN to the name of the run function and set
+   CPU_THREADED_DISPATCH as they need.  It wraps 6510core.c the way
+   maincpu.c does, around a flat 64 KB memory:
+
+   - $0000-$CFFF and $E000-$FFFF are fetched through `bank_base', as RAM
+     and KERNAL are in the C64.
+
+   - $D000-$DFFF is read with LOAD, as I/O is.  Most of it is plain memory,
+     but $D012 and $DC04/$DC05 return the clock, $DC06 the number of ticks,
+     and reading $DC0D/$DD0D releases the IRQ/NMI line.  Writing $DC04/$DD04
+     moves the IRQ/NMI alarm to that many cycles later.
+
+   The IRQ, NMI and tick alarms fire at random intervals from the seed of
+   the run, so both builds see them at the same cycles as long as they run
+   the same.  */
+
+#include "vice.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "6510core.h"
+#include "alarm.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "maincpu.h"
+#include "monitor.h"
+#include "mos6510.h"
+#include "types.h"
+
+#include "bench.h"
+#include "bench_cpu.h"
+
+/* The fetch reads 4 bytes at a time.  */
+#define BENCH_MEM_SIZE (0x10000 + 4)
+
+static uint8_t *bench_mem;
+
+static CLOCK bench_clk;
+static CLOCK bench_stop_clk;
+static int bench_rmw_flag;
+static unsigned int bench_last_opcode_info;
+static unsigned int bench_last_opcode_addr;
+static mos6510_regs_t bench_regs;
+
+static interrupt_cpu_status_t *bench_int_status;
+static unsigned int bench_irq_num;
+static unsigned int bench_nmi_num;
+
+static alarm_context_t *bench_alarm_context;
+static alarm_t *bench_irq_alarm;
+static alarm_t *bench_nmi_alarm;
+static alarm_t *bench_tick_alarm;
+static unsigned int bench_ticks;
+
+static bench_cpu_run_t *bench_run;
+static uint32_t bench_bus;
+
+static unsigned int bench_timer_random(const bench_cpu_timer_t *timer)
+{
+    return timer->min + bench_random(timer->max - timer->min + 1);
+}
+
+static void bench_timer_set(alarm_t *alarm, const bench_cpu_timer_t *timer,
+                            CLOCK clk)
+{
+    if (timer->max) {
+        alarm_set(alarm, clk + bench_timer_random(timer));
+    } else {
+        alarm_unset(alarm);
+    }
+}
+
+static void bench_irq_alarm_handler(CLOCK offset, void *data)
+{
+    interrupt_set_irq(bench_int_status, bench_irq_num, 1, bench_clk - offset);
+    bench_timer_set(bench_irq_alarm, &bench_run->irq, bench_clk - offset);
+}
+
+static void bench_nmi_alarm_handler(CLOCK offset, void *data)
+{
+    interrupt_set_nmi(bench_int_status, bench_nmi_num, 1, bench_clk - offset);
+    bench_timer_set(bench_nmi_alarm, &bench_run->nmi, bench_clk - offset);
+}
+
+static void bench_tick_alarm_handler(CLOCK offset, void *data)
+{
+    bench_ticks++;
+    bench_timer_set(bench_tick_alarm, &bench_run->tick, bench_clk - offset);
+}
+
+static uint8_t bench_load(uint16_t addr)
+{
+    if (addr < 0xd000 || addr >= 0xe000) {
+        return bench_mem[addr];
+    }
+
+    switch (addr) {
+        case 0xd012:
+            return (uint8_t)(bench_clk / 63);
+        case 0xdc04:
+            return (uint8_t)bench_clk;
+        case 0xdc05:
+            return (uint8_t)(bench_clk >> 8);
+        case 0xdc06:
+            return (uint8_t)bench_ticks;
+        case 0xdc0d:
+            if (bench_int_status->pending_int[bench_irq_num] & IK_IRQ) {
+                interrupt_set_irq(bench_int_status, bench_irq_num, 0, bench_clk);
+                return 0x81;
+            }
+            return 0;
+        case 0xdd0d:
+            if (bench_int_status->pending_int[bench_nmi_num] & IK_NMI) {
+                interrupt_set_nmi(bench_int_status, bench_nmi_num, 0, bench_clk);
+                return 0x81;
+            }
+            return 0;
+    }
+
+    return bench_mem[addr];
+}
+
+static void bench_store(uint16_t addr, uint8_t value)
+{
+    bench_bus = (bench_bus ^ (uint32_t)bench_clk ^ ((uint32_t)addr << 8) ^ value)
+                * 16777619;
+
+    switch (addr) {
+        case 0xdc04:
+            alarm_set(bench_irq_alarm, bench_clk + value + 1);
+            break;
+        case 0xdd04:
+            alarm_set(bench_nmi_alarm, bench_clk + value + 1);
+            break;
+        default:
+            bench_mem[addr] = value;
+            break;
+    }
+}
+
+static void bench_mem_translate(unsigned int addr, uint8_t **base, int *start,
+                                int *limit)
+{
+    *base = bench_mem;
+    if (addr < 0xd000) {
+        *start = 0;
+        *limit = 0xcffd;
+    } else if (addr >= 0xe000) {
+        *start = 0xe000;
+        *limit = 0xfffd;
+    } else {
+        *start = 0;
+        *limit = 0;
+    }
+}
+
+static void bench_step(unsigned int pc, uint8_t a, uint8_t x, uint8_t y,
+                       uint8_t sp, uint8_t p)
+{
+    bench_cpu_run_t *run = bench_run;
+
+    if (run->num_steps < run->max_steps) {
+        bench_cpu_step_t *step = &run->steps[run->num_steps];
+
+        step->clk = bench_clk;
+        step->bus = bench_bus;
+        step->pc = (uint16_t)pc;
+        step->a = a;
+        step->x = x;
+        step->y = y;
+        step->sp = sp;
+        step->p = p;
+    }
+    run->num_steps++;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* As in maincpu.c.  */
+inline static int interrupt_check_nmi_delay(interrupt_cpu_status_t *cs,
+                                            CLOCK cpu_clk)
+{
+    CLOCK nmi_clk = cs->nmi_clk + INTERRUPT_DELAY;
+
+    /* BRK (0x00) delays the NMI by one opcode.  */
+    if (OPINFO_NUMBER(*cs->last_opcode_info_ptr) == 0x00) {
+        return 0;
+    }
+
+    /* Branch instructions delay IRQs and NMI by one cycle if branch
+       is taken with no page boundary crossing.  */
+    if (OPINFO_DELAYS_INTERRUPT(*cs->last_opcode_info_ptr)) {
+        nmi_clk++;
+    }
+
+    if (cpu_clk >= nmi_clk) {
+        return 1;
+    }
+
+    return 0;
+}
+
+inline static int interrupt_check_irq_delay(interrupt_cpu_status_t *cs,
+                                            CLOCK cpu_clk)
+{
+    CLOCK irq_clk = cs->irq_clk + INTERRUPT_DELAY;
+
+    /* Branch instructions delay IRQs and NMI by one cycle if branch
+       is taken with no page boundary crossing.  */
+    if (OPINFO_DELAYS_INTERRUPT(*cs->last_opcode_info_ptr)) {
+        irq_clk++;
+    }
+
+    /* If an opcode changes the I flag from 1 to 0, the 6510 needs
+       one more opcode before it triggers the IRQ routine.  */
+    if (cpu_clk >= irq_clk) {
+        if (!OPINFO_ENABLES_IRQ(*cs->last_opcode_info_ptr)) {
+            return 1;
+        } else {
+            cs->global_pending_int |= IK_IRQPEND;
+        }
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void bench_cpu_setup(bench_cpu_run_t *run)
+{
+    bench_run = run;
+    bench_seed(run->seed);
+    bench_bus = 0;
+    bench_ticks = 0;
+    bench_clk = 0;
+    bench_stop_clk = run->cycles;
+    bench_rmw_flag = 0;
+    bench_last_opcode_info = 0;
+    bench_last_opcode_addr = 0;
+    memset(&bench_regs, 0, sizeof(bench_regs));
+
+    bench_mem = lib_calloc(1, BENCH_MEM_SIZE);
+    memcpy(bench_mem, run->mem, 0x10000);
+
+    bench_int_status = interrupt_cpu_status_new();
+    interrupt_cpu_status_init(bench_int_status, &bench_last_opcode_info);
+    bench_irq_num = interrupt_cpu_status_int_new(bench_int_status, "BenchIRQ");
+    bench_nmi_num = interrupt_cpu_status_int_new(bench_int_status, "BenchNMI");
+    interrupt_cpu_status_reset(bench_int_status);
+
+    bench_alarm_context = alarm_context_new("Bench");
+    bench_irq_alarm = alarm_new(bench_alarm_context, "BenchIRQ",
+                                bench_irq_alarm_handler, NULL);
+    bench_nmi_alarm = alarm_new(bench_alarm_context, "BenchNMI",
+                                bench_nmi_alarm_handler, NULL);
+    bench_tick_alarm = alarm_new(bench_alarm_context, "BenchTick",
+                                 bench_tick_alarm_handler, NULL);
+    bench_timer_set(bench_irq_alarm, &run->irq, 0);
+    bench_timer_set(bench_nmi_alarm, &run->nmi, 0);
+    bench_timer_set(bench_tick_alarm, &run->tick, 0);
+
+    run->num_steps = 0;
+    run->loops = 0;
+}
+
+static void bench_cpu_shutdown(bench_cpu_run_t *run)
+{
+    memcpy(run->mem_out, bench_mem, 0x10000);
+    run->clk = bench_clk;
+
+    alarm_context_destroy(bench_alarm_context);
+    interrupt_cpu_status_destroy(bench_int_status);
+    lib_free(bench_mem);
+}
+
+void BENCH_CPU_RUN(bench_cpu_run_t *run)
+{
+    uint8_t reg_a = 0;
+    uint8_t reg_x = 0;
+    uint8_t reg_y = 0;
+    uint8_t reg_p = P_INTERRUPT;
+    uint8_t reg_sp = 0xff;
+    uint8_t flag_n = 0;
+    uint8_t flag_z = 1;
+    unsigned int reg_pc;
+    uint8_t *bank_base = NULL;
+    int bank_start = 0;
+    int bank_limit = 0;
+
+    bench_cpu_setup(run);
+
+#define CLK bench_clk
+#define RMW_FLAG bench_rmw_flag
+#define LAST_OPCODE_INFO bench_last_opcode_info
+#define LAST_OPCODE_ADDR bench_last_opcode_addr
+#define TRACEFLG 0
+
+#define CPU_INT_STATUS bench_int_status
+
+#define ALARM_CONTEXT bench_alarm_context
+
+#define JAM() CLK++
+
+#define ROM_TRAP_ALLOWED() 0
+
+#define ROM_TRAP_HANDLER() ((uint32_t)-1)
+
+#define CPU_CAN_DISPATCH() (CLK < bench_stop_clk)
+
+#define CALLER e_comp_space
+
+#define GLOBAL_REGS bench_regs
+
+#define DMA_FUNC
+
+#define DMA_ON_RESET
+
+#define cpu_reset()
+
+#define JUMP(addr)                                                                     \
+    do {                                                                               \
+        reg_pc = (unsigned int)(addr);                                                 \
+        if (reg_pc >= (unsigned int)bank_limit || reg_pc < (unsigned int)bank_start) { \
+            bench_mem_translate(reg_pc, &bank_base, &bank_start, &bank_limit);         \
+        }                                                                              \
+    } while (0)
+
+#define LOAD(addr) bench_load((uint16_t)(addr))
+#define STORE(addr, value) bench_store((uint16_t)(addr), (uint8_t)(value))
+#define LOAD_ZERO(addr) bench_mem[(addr) & 0xff]
+#define STORE_ZERO(addr, value) bench_store((uint16_t)((addr) & 0xff), (uint8_t)(value))
+
+#define LOAD_ADDR(addr) \
+    ((LOAD((addr) + 1) << 8) | LOAD(addr))
+
+#define LOAD_ZERO_ADDR(addr) \
+    ((LOAD_ZERO((addr) + 1) << 8) | LOAD_ZERO(addr))
+
+#define PAGE_ZERO bench_mem
+#define PAGE_ONE (bench_mem + 0x100)
+
+/* Record the state before every opcode.  */
+#define SET_LAST_ADDR(x)                                                          \
+    do {                                                                          \
+        LAST_OPCODE_ADDR = (x);                                                   \
+        bench_step((x), reg_a, reg_x, reg_y, reg_sp, (uint8_t)LOCAL_STATUS()); \
+    } while (0)
+
+    JUMP(LOAD_ADDR(0xfffc));
+
+    while (CLK < bench_stop_clk) {
+        run->loops++;
+
+#include "6510core.c"
+    }
+
+#ifdef CPU_THREADED_DISPATCH
+    run->threaded = 1;
+#else
+    run->threaded = 0;
+#endif
+
+    bench_cpu_shutdown(run);
+}
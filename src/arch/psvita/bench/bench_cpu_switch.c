@@ -0,0 +1,30 @@
+/*
+ * bench_cpu_switch.c - 6502 core with the opcode switch only.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The reference: every opcode goes back to the main loop, as with
+   cmake -DCPU_THREADED_DISPATCH=OFF.  */
+#undef CPU_THREADED_DISPATCH
+
+#define BENCH_CPU_RUN bench_cpu_run_switch
+
+#include "bench_cpu_core.c"
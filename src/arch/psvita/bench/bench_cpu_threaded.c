@@ -0,0 +1,33 @@
+/*
+ * bench_cpu_threaded.c - 6502 core with the threaded opcode dispatch.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Built with the threaded dispatch even with
+   cmake -DCPU_THREADED_DISPATCH=OFF, so that the test always compares the
+   two.  6510core.c still turns it off where it is not supported.  */
+#ifndef CPU_THREADED_DISPATCH
+#define CPU_THREADED_DISPATCH
+#endif
+
+#define BENCH_CPU_RUN bench_cpu_run_threaded
+
+#include "bench_cpu_core.c"
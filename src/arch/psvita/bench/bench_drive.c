@@ -0,0 +1,888 @@
+/*
+ * bench_drive.c - Drive thread test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* A D64 is made with a small fastloader and a file of random data, and
+   autostarted twice: in a child process with the drive thread, and in
+   this process without it.  The fastloader uploads its drive code with
+   M-W and starts it with M-E.  The drive reads the sectors of the file
+   through the job queue and sends each byte as four bit pairs on CLK and
+   DATA, timed from a start signal of the C64 on DATA.  The C64 polls
+   $dd00 while it waits for the drive, as the usual loaders do.
+
+   At the end of every frame the child sends the state of the machine to
+   this process: the clocks, the drive CPU registers, the drive RAM, both
+   VIAs, the head and the C64 RAM.  Each must be the same as here.  Once
+   the file has been loaded, it must be in the C64 RAM.  The share of the
+   drive cycles run by the worker is printed for the boot and the KERNAL
+   load of the fastloader, for the fastload, and for the idle frames
+   after it.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "archdep.h"
+#include "drive.h"
+#include "drivethread.h"
+#include "drivetypes.h"
+#include "maincpu.h"
+#include "mem.h"
+#include "mos6510.h"
+#include "types.h"
+#include "via.h"
+
+#include "bench.h"
+
+#define DRIVE_TEST_IMAGE APP_DATA_DIR "bench-drive.d64"
+
+/* Blocks of the file loaded by the fastloader, at $2000 on.  */
+#define DRIVE_TEST_BLOCKS       48
+#define DRIVE_TEST_LOAD_PAGE    0x20
+
+/* Frames to wait for the fastloader, and to run after it.  */
+#define DRIVE_TEST_MAX_FRAMES   3000
+#define DRIVE_TEST_IDLE_FRAMES  100
+
+#define D64_SIZE        174848
+#define D64_TRACKS      35
+#define DIR_TRACK       18
+
+/* Set by the fastloader in $02: running, and done.  $03 holds
+   DRIVE_TEST_MAGIC once the fastloader has been started.  */
+#define DRIVE_TEST_RUNNING      1
+#define DRIVE_TEST_DONE         2
+#define DRIVE_TEST_MAGIC        0x5a
+
+/* Drive code and C64 code.  */
+#define DRIVE_CODE      0x0500
+#define DRIVE_PAIRS     0x0600
+#define C64_BASIC       0x0801
+#define C64_CODE        0x080d
+
+/* Bytes per M-W command.  */
+#define MW_CHUNK        32
+
+typedef struct drive_test_via_s {
+    uint8_t via[16];
+    int ifr;
+    int ier;
+    unsigned int tal;
+    uint8_t t2cl;
+    uint8_t t2ch;
+    CLOCK tau;
+    CLOCK tbu;
+    CLOCK tai;
+    CLOCK tbi;
+    int pb7;
+    int pb7x;
+    int pb7o;
+    int pb7xx;
+    int pb7sx;
+    uint8_t oldpa;
+    uint8_t oldpb;
+    uint8_t ila;
+    uint8_t ilb;
+    int ca2_state;
+    int cb2_state;
+    uint8_t shift_state;
+    int irq_line;
+} drive_test_via_t;
+
+typedef struct drive_test_state_s {
+    unsigned long frame;
+    CLOCK maincpu_clk;
+    CLOCK drive_clk;
+    mos6510_regs_t regs;
+    int half_track;
+    unsigned int head_offset;
+    drive_test_via_t via1;
+    drive_test_via_t via2;
+    uint8_t drive_ram[0x800];
+    uint8_t ram[0x10000];
+    drive_thread_info_t info;
+} drive_test_state_t;
+
+/* Totals of one phase of the run.  */
+typedef struct drive_test_phase_s {
+    const char *name;
+    unsigned long frames;
+    CLOCK maincpu_cycles;
+    CLOCK drive_cycles;
+    unsigned long long slice_cycles;
+    unsigned long long worker_cycles;
+} drive_test_phase_t;
+
+typedef struct drive_gen_s {
+    uint8_t *mem;
+    unsigned int org;
+    unsigned int pc;
+    int failed;
+} drive_gen_t;
+
+static uint8_t d64[D64_SIZE];
+
+/* Tracks and sectors of the file, in order.  */
+static uint8_t data_track[DRIVE_TEST_BLOCKS];
+static uint8_t data_sector[DRIVE_TEST_BLOCKS];
+
+static int state_fd = -1;
+static pid_t child = -1;
+static drive_test_state_t state;
+static drive_test_state_t child_state;
+
+static drive_test_phase_t phases[3] = {
+    { "boot and KERNAL load" },
+    { "fastload" },
+    { "idle" }
+};
+static int phase = 0;
+static drive_test_state_t phase_start;
+static unsigned long done_frame = 0;
+
+/* ------------------------------------------------------------------------- */
+
+static void gen_byte(drive_gen_t *gen, unsigned int value)
+{
+    gen->mem[gen->pc++ - gen->org] = (uint8_t)value;
+}
+
+static void gen_op1(drive_gen_t *gen, unsigned int op, unsigned int value)
+{
+    gen_byte(gen, op);
+    gen_byte(gen, value);
+}
+
+static void gen_op(drive_gen_t *gen, unsigned int op, unsigned int addr)
+{
+    gen_byte(gen, op);
+    gen_byte(gen, addr & 0xff);
+    gen_byte(gen, addr >> 8);
+}
+
+/* A branch back to `target'.  */
+static void gen_branch(drive_gen_t *gen, unsigned int op, unsigned int target)
+{
+    int offset = (int)target - (int)(gen->pc + 2);
+
+    if (offset < -128) {
+        gen->failed = 1;
+    }
+    gen_op1(gen, op, (unsigned int)offset & 0xff);
+}
+
+static void gen_nops(drive_gen_t *gen, int n)
+{
+    while (n-- > 0) {
+        gen_byte(gen, 0xea);                        /* NOP */
+    }
+}
+
+/* Patch the address of the JMP or absolute operand at `at'.  */
+static void gen_patch(drive_gen_t *gen, unsigned int at, unsigned int addr)
+{
+    gen->mem[at + 1 - gen->org] = addr & 0xff;
+    gen->mem[at + 2 - gen->org] = addr >> 8;
+}
+
+/* The drive code at DRIVE_CODE, started with M-E.  Each byte of a sector
+   goes out as four bit pairs, high bits first, on DATA and CLK, 16 cycles
+   apart.  The pairs are encoded in DRIVE_PAIRS beforehand: DATA OUT and
+   CLK OUT are set for the bits that are 0, as the C64 reads the lines
+   inverted.  CLK held low means busy.  */
+static int drive_gen_drive(uint8_t *code, unsigned int track, unsigned int sector)
+{
+    drive_gen_t gen = { code, DRIVE_CODE, DRIVE_CODE, 0 };
+    unsigned int sector_loop, wait, byte, go, enc_operand[4];
+    int i, shift;
+
+    gen_op1(&gen, 0xa9, 0x08);                      /* LDA #$08 */
+    gen_op(&gen, 0x8d, 0x1800);                     /* STA $1800 */
+    gen_op1(&gen, 0xa9, track);                     /* LDA #track */
+    gen_op1(&gen, 0xa2, sector);                    /* LDX #sector */
+
+    sector_loop = gen.pc;
+    gen_op1(&gen, 0x85, 0x06);                      /* STA $06 */
+    gen_op1(&gen, 0x86, 0x07);                      /* STX $07 */
+    gen_byte(&gen, 0x58);                           /* CLI */
+    gen_op1(&gen, 0xa9, 0x80);                      /* LDA #$80 */
+    gen_op1(&gen, 0x85, 0x00);                      /* STA $00 */
+    wait = gen.pc;
+    gen_op1(&gen, 0xa5, 0x00);                      /* LDA $00 */
+    gen_branch(&gen, 0x30, wait);                   /* BMI wait */
+    gen_byte(&gen, 0x78);                           /* SEI */
+    gen_op1(&gen, 0xa0, 0x00);                      /* LDY #0 */
+
+    byte = gen.pc;
+    for (i = 3; i >= 0; i--) {
+        gen_op(&gen, 0xb9, 0x0300);                 /* LDA $0300,Y */
+        for (shift = 0; shift < 6 - 2 * i; shift++) {
+            gen_byte(&gen, 0x4a);                   /* LSR */
+        }
+        if (i > 0) {
+            gen_op1(&gen, 0x29, 0x03);              /* AND #$03 */
+        }
+        gen_byte(&gen, 0xaa);                       /* TAX */
+        enc_operand[i] = gen.pc;
+        gen_op(&gen, 0xbd, 0);                      /* LDA enc,X */
+        gen_op(&gen, 0x8d, DRIVE_PAIRS + i);        /* STA pair */
+    }
+
+    gen_op1(&gen, 0xa9, 0x00);                      /* LDA #$00 */
+    gen_op(&gen, 0x8d, 0x1800);                     /* STA $1800 */
+    go = gen.pc;
+    gen_op(&gen, 0xad, 0x1800);                     /* LDA $1800 */
+    gen_byte(&gen, 0x4a);                           /* LSR */
+    gen_branch(&gen, 0x90, go);                     /* BCC go */
+    gen_nops(&gen, 1);
+    for (i = 0; i < 4; i++) {
+        gen_op(&gen, 0xad, DRIVE_PAIRS + i);        /* LDA pair */
+        gen_op(&gen, 0x8d, 0x1800);                 /* STA $1800 */
+        gen_nops(&gen, i < 3 ? 4 : 5);
+    }
+    gen_op1(&gen, 0xa9, 0x08);                      /* LDA #$08 */
+    gen_op(&gen, 0x8d, 0x1800);                     /* STA $1800 */
+    gen_byte(&gen, 0xc8);                           /* INY */
+    gen_branch(&gen, 0xd0, byte);                   /* BNE byte */
+
+    gen_op(&gen, 0xae, 0x0301);                     /* LDX $0301 */
+    gen_op(&gen, 0xad, 0x0300);                     /* LDA $0300 */
+    gen_op1(&gen, 0xf0, 3);                         /* BEQ done */
+    gen_op(&gen, 0x4c, sector_loop);                /* JMP sector */
+    gen_op1(&gen, 0xa9, 0x00);                      /* done: LDA #$00 */
+    gen_op(&gen, 0x8d, 0x1800);                     /* STA $1800 */
+    gen_byte(&gen, 0x58);                           /* CLI */
+    gen_byte(&gen, 0x60);                           /* RTS */
+
+    for (i = 0; i < 4; i++) {
+        gen_patch(&gen, enc_operand[i], gen.pc);
+    }
+    gen_byte(&gen, 0x0a);                           /* enc: 00 01 10 11 */
+    gen_byte(&gen, 0x02);
+    gen_byte(&gen, 0x08);
+    gen_byte(&gen, 0x00);
+
+    return gen.failed ? -1 : (int)(gen.pc - gen.org);
+}
+
+/* The C64 program, with a BASIC line to start it.  The M-W and M-E
+   commands follow the code, each after its length.  The C64 reads the
+   four pairs 26, 42, 58 and 74 cycles after it has pulled DATA, in the
+   middle of the time each is on the bus whatever the delay of the drive
+   loop; the screen is off, so no bad line gets in the way.  Returns the
+   length of the program.  */
+static int drive_gen_c64(uint8_t *prg, const uint8_t *drive_code, int drive_size)
+{
+    drive_gen_t gen = { prg, C64_BASIC, C64_BASIC, 0 };
+    unsigned int cmd, out, cmds_at[2], beq_uploaded, uploaded, wait_busy;
+    unsigned int sector, byte, wait_ready, i, n;
+    int pos;
+
+    /* 10 SYS2061 */
+    gen_op(&gen, 0x0b, 0x0a08);
+    gen_byte(&gen, 0x00);
+    gen_byte(&gen, 0x9e);
+    gen_byte(&gen, '2');
+    gen_byte(&gen, '0');
+    gen_byte(&gen, '6');
+    gen_byte(&gen, '1');
+    gen_byte(&gen, 0x00);
+    gen_byte(&gen, 0x00);
+    gen_byte(&gen, 0x00);
+
+    gen_op1(&gen, 0xa9, 0x00);                      /* LDA #0 */
+    gen_op1(&gen, 0x85, 0x02);                      /* STA $02 */
+    gen_op1(&gen, 0xa9, DRIVE_TEST_MAGIC);          /* LDA #magic */
+    gen_op1(&gen, 0x85, 0x03);                      /* STA $03 */
+    gen_op1(&gen, 0xa9, 0x0b);                      /* LDA #$0b */
+    gen_op(&gen, 0x8d, 0xd011);                     /* STA $d011 */
+    gen_op1(&gen, 0xa9, 0x00);                      /* LDA #0 */
+    gen_op1(&gen, 0x85, 0xfd);                      /* STA $fd */
+
+    cmd = gen.pc;
+    gen_op1(&gen, 0xa6, 0xfd);                      /* LDX $fd */
+    cmds_at[0] = gen.pc;
+    gen_op(&gen, 0xbd, 0);                          /* LDA cmds,X */
+    beq_uploaded = gen.pc;
+    gen_op1(&gen, 0xf0, 0);                         /* BEQ uploaded */
+    gen_op1(&gen, 0x85, 0xfe);                      /* STA $fe */
+    gen_op1(&gen, 0xe6, 0xfd);                      /* INC $fd */
+    gen_op1(&gen, 0xa9, 0x08);                      /* LDA #8 */
+    gen_op(&gen, 0x20, 0xffb1);                     /* JSR LISTEN */
+    gen_op1(&gen, 0xa9, 0x6f);                      /* LDA #$6f */
+    gen_op(&gen, 0x20, 0xff93);                     /* JSR SECOND */
+    out = gen.pc;
+    gen_op1(&gen, 0xa6, 0xfd);                      /* LDX $fd */
+    cmds_at[1] = gen.pc;
+    gen_op(&gen, 0xbd, 0);                          /* LDA cmds,X */
+    gen_op(&gen, 0x20, 0xffa8);                     /* JSR CIOUT */
+    gen_op1(&gen, 0xe6, 0xfd);                      /* INC $fd */
+    gen_op1(&gen, 0xc6, 0xfe);                      /* DEC $fe */
+    gen_branch(&gen, 0xd0, out);                    /* BNE out */
+    gen_op(&gen, 0x20, 0xffae);                     /* JSR UNLSN */
+    gen_op(&gen, 0x4c, cmd);                        /* JMP cmd */
+
+    /* The drive runs the loader from the last command on.  */
+    uploaded = gen.pc;
+    prg[beq_uploaded + 1 - gen.org] = (uint8_t)(uploaded - (beq_uploaded + 2));
+    gen_byte(&gen, 0x78);                           /* SEI */
+    gen_op1(&gen, 0xa9, DRIVE_TEST_RUNNING);        /* LDA #running */
+    gen_op1(&gen, 0x85, 0x02);                      /* STA $02 */
+    gen_op1(&gen, 0xa9, 0x00);                      /* LDA #0 */
+    gen_op1(&gen, 0x85, 0xfb);                      /* STA $fb */
+    gen_op1(&gen, 0xa9, DRIVE_TEST_LOAD_PAGE);      /* LDA #page */
+    gen_op1(&gen, 0x85, 0xfc);                      /* STA $fc */
+    gen_op1(&gen, 0xa2, 0x23);                      /* LDX #$23 */
+    wait_busy = gen.pc;
+    gen_op(&gen, 0x2c, 0xdd00);                     /* BIT $dd00 */
+    gen_branch(&gen, 0x70, wait_busy);              /* BVS wait_busy */
+
+    sector = gen.pc;
+    gen_op1(&gen, 0xa0, 0x00);                      /* LDY #0 */
+    byte = gen.pc;
+    wait_ready = gen.pc;
+    gen_op(&gen, 0x2c, 0xdd00);                     /* BIT $dd00 */
+    gen_branch(&gen, 0x50, wait_ready);             /* BVC wait_ready */
+    gen_op(&gen, 0x8e, 0xdd00);                     /* STX $dd00: pull DATA */
+    gen_nops(&gen, 3);
+    gen_op1(&gen, 0xa9, 0x03);                      /* LDA #$03 */
+    gen_op(&gen, 0x8d, 0xdd00);                     /* STA $dd00: release */
+    gen_nops(&gen, 5);
+    for (i = 0; i < 4; i++) {
+        gen_op(&gen, 0xad, 0xdd00);                 /* LDA $dd00 */
+        gen_op1(&gen, 0x85, 0xf0 + i);              /* STA $f0+i */
+        if (i < 3) {
+            gen_nops(&gen, 3);
+            gen_op1(&gen, 0x24, 0xf0);              /* BIT $f0 */
+        }
+    }
+    for (i = 0; i < 4; i++) {
+        gen_op1(&gen, 0xa5, 0xf0 + i);              /* LDA $f0+i */
+        gen_op1(&gen, 0x29, 0xc0);                  /* AND #$c0 */
+        for (n = 0; n < 2 * i; n++) {
+            gen_byte(&gen, 0x4a);                   /* LSR */
+        }
+        if (i > 0) {
+            gen_op1(&gen, 0x05, 0xf4);              /* ORA $f4 */
+        }
+        gen_op1(&gen, 0x85, 0xf4);                  /* STA $f4 */
+    }
+    gen_op1(&gen, 0x91, 0xfb);                      /* STA ($fb),Y */
+    gen_byte(&gen, 0xc8);                           /* INY */
+    gen_branch(&gen, 0xd0, byte);                   /* BNE byte */
+    gen_op1(&gen, 0xb1, 0xfb);                      /* LDA ($fb),Y */
+    gen_op1(&gen, 0xe6, 0xfc);                      /* INC $fc */
+    gen_op1(&gen, 0xc9, 0x00);                      /* CMP #0 */
+    gen_op1(&gen, 0xf0, 3);                         /* BEQ done */
+    gen_op(&gen, 0x4c, sector);                     /* JMP sector */
+    gen_op1(&gen, 0xa9, 0x1b);                      /* done: LDA #$1b */
+    gen_op(&gen, 0x8d, 0xd011);                     /* STA $d011 */
+    gen_op1(&gen, 0xa9, DRIVE_TEST_DONE);           /* LDA #done */
+    gen_op1(&gen, 0x85, 0x02);                      /* STA $02 */
+    gen_byte(&gen, 0x58);                           /* CLI */
+    gen_byte(&gen, 0x60);                           /* RTS */
+
+    /* M-W the drive code, then M-E it.  */
+    gen_patch(&gen, cmds_at[0], gen.pc);
+    gen_patch(&gen, cmds_at[1], gen.pc);
+    for (pos = 0; pos < drive_size; pos += MW_CHUNK) {
+        n = (unsigned int)(drive_size - pos < MW_CHUNK ? drive_size - pos : MW_CHUNK);
+        gen_byte(&gen, 6 + n);
+        gen_byte(&gen, 'M');
+        gen_byte(&gen, '-');
+        gen_byte(&gen, 'W');
+        gen_byte(&gen, (DRIVE_CODE + pos) & 0xff);
+        gen_byte(&gen, (DRIVE_CODE + pos) >> 8);
+        gen_byte(&gen, n);
+        for (i = 0; i < n; i++) {
+            gen_byte(&gen, drive_code[pos + i]);
+        }
+    }
+    gen_byte(&gen, 5);
+    gen_byte(&gen, 'M');
+    gen_byte(&gen, '-');
+    gen_byte(&gen, 'E');
+    gen_byte(&gen, DRIVE_CODE & 0xff);
+    gen_byte(&gen, DRIVE_CODE >> 8);
+    gen_byte(&gen, 0);
+
+    return gen.failed ? -1 : (int)(gen.pc - gen.org);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int d64_sectors(int track)
+{
+    if (track <= 17) {
+        return 21;
+    }
+    if (track <= 24) {
+        return 19;
+    }
+    if (track <= 30) {
+        return 18;
+    }
+    return 17;
+}
+
+static uint8_t *d64_sector(int track, int sector)
+{
+    int t, n = sector;
+
+    for (t = 1; t < track; t++) {
+        n += d64_sectors(t);
+    }
+    return d64 + n * 256;
+}
+
+/* Store `size' bytes of `data' from `track' on, every tenth sector as the
+   DOS does, and return the number of blocks.  The tracks and sectors go
+   to `tracks' and `sectors' if not NULL.  */
+static int d64_write_file(int track, const uint8_t *data, int size,
+                          uint8_t *tracks, uint8_t *sectors)
+{
+    uint8_t used[D64_TRACKS + 1][21];
+    int blocks = (size + 253) / 254;
+    int b, s = 0, next_t, next_s, n;
+    uint8_t *p;
+
+    memset(used, 0, sizeof(used));
+
+    for (b = 0; b < blocks; b++) {
+        used[track][s] = 1;
+        if (tracks != NULL) {
+            tracks[b] = (uint8_t)track;
+            sectors[b] = (uint8_t)s;
+        }
+        p = d64_sector(track, s);
+        n = size - b * 254 < 254 ? size - b * 254 : 254;
+        memcpy(p + 2, data + b * 254, (size_t)n);
+
+        next_t = track;
+        next_s = (s + 10) % d64_sectors(track);
+        while (used[next_t][next_s]) {
+            next_s = (next_s + 1) % d64_sectors(next_t);
+            if (next_s == s) {
+                next_t = next_t + 1 == DIR_TRACK ? next_t + 2 : next_t + 1;
+                next_s = 0;
+                break;
+            }
+        }
+
+        if (b + 1 < blocks) {
+            p[0] = (uint8_t)next_t;
+            p[1] = (uint8_t)next_s;
+        } else {
+            p[0] = 0;
+            p[1] = (uint8_t)(n + 1);
+        }
+        track = next_t;
+        s = next_s;
+    }
+
+    return blocks;
+}
+
+static void d64_dir_entry(int n, uint8_t type, int track, int sector,
+                          const char *name, int blocks)
+{
+    uint8_t *p = d64_sector(DIR_TRACK, 1) + n * 32;
+
+    p[2] = type;
+    p[3] = (uint8_t)track;
+    p[4] = (uint8_t)sector;
+    memset(p + 5, 0xa0, 16);
+    memcpy(p + 5, name, strlen(name));
+    p[30] = (uint8_t)(blocks & 0xff);
+    p[31] = (uint8_t)(blocks >> 8);
+}
+
+static int drive_make_image(void)
+{
+    static uint8_t prg[0x1000];
+    static uint8_t data[DRIVE_TEST_BLOCKS * 254];
+    uint8_t drive_code[0x100];
+    uint8_t *bam;
+    int drive_size, prg_size, blocks, i;
+    FILE *fd;
+
+    memset(d64, 0, sizeof(d64));
+    for (i = 0; i < (int)sizeof(data); i++) {
+        data[i] = (uint8_t)bench_random(256);
+    }
+    d64_write_file(19, data, (int)sizeof(data), data_track, data_sector);
+
+    drive_size = drive_gen_drive(drive_code, data_track[0], data_sector[0]);
+    prg[0] = C64_BASIC & 0xff;
+    prg[1] = C64_BASIC >> 8;
+    prg_size = drive_size < 0 ? -1 : drive_gen_c64(prg + 2, drive_code, drive_size);
+    if (prg_size < 0) {
+        printf("FAILED, the fastloader does not fit its branches\n");
+        return 1;
+    }
+    blocks = d64_write_file(17, prg, prg_size + 2, NULL, NULL);
+
+    /* The BAM, with every sector in use.  */
+    bam = d64_sector(DIR_TRACK, 0);
+    bam[0] = DIR_TRACK;
+    bam[1] = 1;
+    bam[2] = 'A';
+    memset(bam + 0x90, 0xa0, 0x1b);
+    memcpy(bam + 0x90, "BENCH", 5);
+    bam[0xa2] = 'B';
+    bam[0xa3] = 'D';
+    bam[0xa5] = '2';
+    bam[0xa6] = 'A';
+
+    d64_sector(DIR_TRACK, 1)[1] = 0xff;
+    d64_dir_entry(0, 0x82, 17, 0, "FASTLOADER", blocks);
+    d64_dir_entry(1, 0x81, data_track[0], data_sector[0], "DATA",
+                  DRIVE_TEST_BLOCKS);
+
+    fd = fopen(DRIVE_TEST_IMAGE, MODE_WRITE);
+    if (fd == NULL || fwrite(d64, sizeof(d64), 1, fd) != 1) {
+        printf("FAILED, cannot write `%s'\n", DRIVE_TEST_IMAGE);
+        if (fd != NULL) {
+            fclose(fd);
+        }
+        return 1;
+    }
+    fclose(fd);
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void drive_get_via(drive_test_via_t *v, const via_context_t *via)
+{
+    memcpy(v->via, via->via, sizeof(v->via));
+    v->ifr = via->ifr;
+    v->ier = via->ier;
+    v->tal = via->tal;
+    v->t2cl = via->t2cl;
+    v->t2ch = via->t2ch;
+    v->tau = via->tau;
+    v->tbu = via->tbu;
+    v->tai = via->tai;
+    v->tbi = via->tbi;
+    v->pb7 = via->pb7;
+    v->pb7x = via->pb7x;
+    v->pb7o = via->pb7o;
+    v->pb7xx = via->pb7xx;
+    v->pb7sx = via->pb7sx;
+    v->oldpa = via->oldpa;
+    v->oldpb = via->oldpb;
+    v->ila = via->ila;
+    v->ilb = via->ilb;
+    v->ca2_state = via->ca2_state;
+    v->cb2_state = via->cb2_state;
+    v->shift_state = via->shift_state;
+    v->irq_line = via->irq_line;
+}
+
+/* The drives are run up to the main CPU first, as drive_vsync_hook()
+   does right after this.  */
+static void drive_get_state(drive_test_state_t *s, unsigned long frame)
+{
+    drive_context_t *drv = drive_context[0];
+
+    drive_cpu_execute_all(maincpu_clk);
+
+    memset(s, 0, sizeof(drive_test_state_t));
+    s->frame = frame;
+    s->maincpu_clk = maincpu_clk;
+    s->drive_clk = *(drv->clk_ptr);
+    s->regs = drv->cpu->cpu_regs;
+    s->half_track = drv->drive->current_half_track;
+    s->head_offset = drv->drive->GCR_head_offset;
+    drive_get_via(&s->via1, drv->via1d1541);
+    drive_get_via(&s->via2, drv->via2);
+    memcpy(s->drive_ram, drv->drive->drive_ram, sizeof(s->drive_ram));
+    memcpy(s->ram, mem_ram, sizeof(s->ram));
+    drive_thread_get_info(&s->info);
+}
+
+static int drive_read_state(drive_test_state_t *s)
+{
+    uint8_t *p = (uint8_t *)s;
+    size_t left = sizeof(drive_test_state_t);
+    ssize_t n;
+
+    while (left > 0) {
+        n = read(state_fd, p, left);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+    return 0;
+}
+
+static int drive_write_state(const drive_test_state_t *s)
+{
+    const uint8_t *p = (const uint8_t *)s;
+    size_t left = sizeof(drive_test_state_t);
+    ssize_t n;
+
+    while (left > 0) {
+        n = write(state_fd, p, left);
+        if (n <= 0) {
+            return -1;
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+    return 0;
+}
+
+/* First differing byte of `a' and `b', or -1.  */
+static long drive_diff(const void *a, const void *b, size_t size)
+{
+    const uint8_t *pa = a, *pb = b;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        if (pa[i] != pb[i]) {
+            return (long)i;
+        }
+    }
+    return -1;
+}
+
+static int drive_compare(const drive_test_state_t *t, const drive_test_state_t *s)
+{
+    long at;
+
+    if (t->maincpu_clk != s->maincpu_clk || t->drive_clk != s->drive_clk) {
+        printf("FAILED, frame %lu: main CPU clock %lu, drive clock %lu with "
+               "the thread, %lu, %lu without\n", s->frame,
+               (unsigned long)t->maincpu_clk, (unsigned long)t->drive_clk,
+               (unsigned long)s->maincpu_clk, (unsigned long)s->drive_clk);
+        return 1;
+    }
+    if (t->regs.pc != s->regs.pc || t->regs.a != s->regs.a
+        || t->regs.x != s->regs.x || t->regs.y != s->regs.y
+        || t->regs.sp != s->regs.sp
+        || MOS6510_REGS_GET_STATUS(&t->regs) != MOS6510_REGS_GET_STATUS(&s->regs)) {
+        printf("FAILED, frame %lu: drive PC $%04x with the thread, $%04x "
+               "without, or other registers differ\n", s->frame,
+               t->regs.pc, s->regs.pc);
+        return 1;
+    }
+    if (t->half_track != s->half_track || t->head_offset != s->head_offset) {
+        printf("FAILED, frame %lu: head on half track %d at %u with the "
+               "thread, %d at %u without\n", s->frame, t->half_track,
+               t->head_offset, s->half_track, s->head_offset);
+        return 1;
+    }
+    if (memcmp(&t->via1, &s->via1, sizeof(drive_test_via_t)) != 0) {
+        printf("FAILED, frame %lu: VIA 1 differs\n", s->frame);
+        return 1;
+    }
+    if (memcmp(&t->via2, &s->via2, sizeof(drive_test_via_t)) != 0) {
+        printf("FAILED, frame %lu: VIA 2 differs\n", s->frame);
+        return 1;
+    }
+    at = drive_diff(t->drive_ram, s->drive_ram, sizeof(s->drive_ram));
+    if (at >= 0) {
+        printf("FAILED, frame %lu: drive RAM $%04lx is $%02x with the "
+               "thread, $%02x without\n", s->frame, at, t->drive_ram[at],
+               s->drive_ram[at]);
+        return 1;
+    }
+    at = drive_diff(t->ram, s->ram, sizeof(s->ram));
+    if (at >= 0) {
+        printf("FAILED, frame %lu: C64 RAM $%04lx is $%02x with the "
+               "thread, $%02x without\n", s->frame, at, t->ram[at],
+               s->ram[at]);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Add the frames since the start of the phase, from the threaded run.  */
+static void drive_end_phase(const drive_test_state_t *t)
+{
+    drive_test_phase_t *p = &phases[phase];
+
+    p->frames = t->frame - phase_start.frame;
+    p->maincpu_cycles = t->maincpu_clk - phase_start.maincpu_clk;
+    p->drive_cycles = t->drive_clk - phase_start.drive_clk;
+    p->slice_cycles = t->info.slice_cycles - phase_start.info.slice_cycles;
+    p->worker_cycles = t->info.worker_cycles - phase_start.info.worker_cycles;
+
+    phase_start = *t;
+    phase++;
+}
+
+/* The file must have been loaded at DRIVE_TEST_LOAD_PAGE.  */
+static int drive_check_load(const drive_test_state_t *s)
+{
+    int b;
+
+    for (b = 0; b < DRIVE_TEST_BLOCKS; b++) {
+        if (memcmp(s->ram + (DRIVE_TEST_LOAD_PAGE + b) * 256,
+                   d64_sector(data_track[b], data_sector[b]), 256) != 0) {
+            printf("FAILED, block %d (track %d, sector %d) was not loaded "
+                   "at $%04x\n", b, data_track[b], data_sector[b],
+                   (DRIVE_TEST_LOAD_PAGE + b) * 256);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int drive_report(void)
+{
+    int status, i;
+
+    close(state_fd);
+    if (waitpid(child, &status, 0) != child
+        || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("FAILED, the run with the drive thread failed\n");
+        return -1;
+    }
+
+    if (phases[0].slice_cycles == 0 && phases[2].slice_cycles == 0) {
+        printf("drive: built without the drive thread, %lu frames compared\n",
+               state.frame + 1);
+        return 1;
+    }
+
+    for (i = 0; i < 3; i++) {
+        drive_test_phase_t *p = &phases[i];
+
+        printf("drive: %-20s %5lu frames, %5.1f%% of the main CPU cycles "
+               "posted, %5.1f%% of the drive cycles run by the worker\n",
+               p->name, p->frames,
+               p->maincpu_cycles ? p->slice_cycles * 100.0 / p->maincpu_cycles : 0.0,
+               p->drive_cycles ? p->worker_cycles * 100.0 / p->drive_cycles : 0.0);
+    }
+    printf("drive: %lu frames compared, ok\n", state.frame + 1);
+    return 1;
+}
+
+static int drive_child_frame(unsigned long frame)
+{
+    drive_get_state(&state, frame);
+    if (drive_write_state(&state) < 0) {
+        return -1;
+    }
+
+    /* Stop with this process.  */
+    if (done_frame == 0 && state.ram[3] == DRIVE_TEST_MAGIC
+        && state.ram[2] == DRIVE_TEST_DONE) {
+        done_frame = frame;
+    }
+    if (done_frame > 0 && frame >= done_frame + DRIVE_TEST_IDLE_FRAMES) {
+        return 1;
+    }
+    return frame >= DRIVE_TEST_MAX_FRAMES ? -1 : 0;
+}
+
+static int drive_test_frame(unsigned long frame)
+{
+    drive_get_state(&state, frame);
+    if (drive_read_state(&child_state) < 0) {
+        printf("FAILED, frame %lu: the run with the drive thread stopped\n", frame);
+        return -1;
+    }
+    if (drive_compare(&child_state, &state)) {
+        return -1;
+    }
+
+    if (frame == 0) {
+        phase_start = child_state;
+    }
+    if (state.ram[3] == DRIVE_TEST_MAGIC) {
+        if (phase == 0 && state.ram[2] == DRIVE_TEST_RUNNING) {
+            drive_end_phase(&child_state);
+        }
+        if (phase == 1 && state.ram[2] == DRIVE_TEST_DONE) {
+            if (drive_check_load(&state)) {
+                return -1;
+            }
+            drive_end_phase(&child_state);
+            done_frame = frame;
+        }
+    }
+
+    if (phase == 2 && frame >= done_frame + DRIVE_TEST_IDLE_FRAMES) {
+        drive_end_phase(&child_state);
+        return drive_report();
+    }
+    if (frame >= DRIVE_TEST_MAX_FRAMES) {
+        printf("FAILED, the fastloader did not finish in %d frames\n",
+               DRIVE_TEST_MAX_FRAMES);
+        return -1;
+    }
+    return 0;
+}
+
+/* The same options for both runs, but the drive thread.  The autostart
+   delay would be random otherwise.  */
+static const char *drive_args[] = {
+    "-truedrive", "-drive8idle", "0", "+drivesound",
+    "+drivethread", "+autostart-delay-random", "-autostart", DRIVE_TEST_IMAGE
+};
+
+#define NUM_DRIVE_ARGS (int)(sizeof(drive_args) / sizeof(drive_args[0]))
+#define DRIVE_THREAD_ARG 4
+
+int bench_test_drive(void)
+{
+    int fds[2];
+
+    archdep_mkdir(APP_DATA_DIR, 0755);
+    if (drive_make_image()) {
+        return 1;
+    }
+
+    fflush(stdout);
+    if (pipe(fds) != 0) {
+        printf("FAILED, cannot make a pipe\n");
+        return 1;
+    }
+    child = fork();
+    if (child < 0) {
+        printf("FAILED, cannot start the run with the drive thread\n");
+        return 1;
+    }
+
+    if (child == 0) {
+        close(fds[0]);
+        state_fd = fds[1];
+        drive_args[DRIVE_THREAD_ARG] = "-drivethread";
+        return bench_run_machine(drive_args, NUM_DRIVE_ARGS, drive_child_frame);
+    }
+
+    close(fds[1]);
+    state_fd = fds[0];
+    return bench_run_machine(drive_args, NUM_DRIVE_ARGS, drive_test_frame);
+}
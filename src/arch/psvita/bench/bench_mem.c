@@ -0,0 +1,186 @@
+/*
+ * bench_mem.c - C64 direct RAM page test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The C64 is started, and once the KERNAL runs the memory configuration is
+   walked through every $00/$01 setting with EXROM and GAME, every video
+   bank, and with watchpoints on and off, switched in either order.  The
+   memory tables are also set up again from another configuration.  Each
+   time, a page of `_mem_read_ram_tab_ptr' and `_mem_write_ram_tab_ptr' must
+   be NULL, or point to `mem_ram' with `ram_read()' or `ram_store()' in the
+   function tables; reading and writing random addresses of the page
+   through the pointer and through the function must give the same bytes.
+   The wrap-around page $100 must never be accessed directly.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+
+#include "c64cart.h"
+#include "c64mem.h"
+#include "c64pla.h"
+#include "mem.h"
+#include "types.h"
+
+#include "bench.h"
+
+/* Frame at which the KERNAL has set up the machine.  */
+#define MEM_TEST_FRAME      10
+
+/* Addresses tried in each page.  */
+#define MEM_TEST_ADDRESSES  4
+
+static unsigned long checks;
+static unsigned long direct_pages;
+
+static int mem_check_tables(const char *what)
+{
+    unsigned int page, i, addr;
+    uint8_t *p, value;
+
+    if (_mem_read_ram_tab_ptr[0x100] != NULL || _mem_write_ram_tab_ptr[0x100] != NULL) {
+        printf("FAILED, %s: page $100 is accessed directly\n", what);
+        return 1;
+    }
+
+    for (page = 0; page < 0x100; page++) {
+        p = _mem_read_ram_tab_ptr[page];
+        if (p != NULL) {
+            if (p != mem_ram || _mem_read_tab_ptr[page] != ram_read) {
+                printf("FAILED, %s: page $%02x is read directly, "
+                       "but not from RAM by its function\n", what, page);
+                return 1;
+            }
+            for (i = 0; i < MEM_TEST_ADDRESSES; i++) {
+                addr = (page << 8) | bench_random(0x100);
+                mem_ram[addr] = (uint8_t)bench_random(0x100);
+                if (p[addr] != _mem_read_tab_ptr[page]((uint16_t)addr)) {
+                    printf("FAILED, %s: $%04x reads $%02x directly, "
+                           "$%02x by its function\n", what, addr, p[addr],
+                           _mem_read_tab_ptr[page]((uint16_t)addr));
+                    return 1;
+                }
+            }
+            direct_pages++;
+        }
+
+        p = _mem_write_ram_tab_ptr[page];
+        if (p != NULL) {
+            if (p != mem_ram || _mem_write_tab_ptr[page] != ram_store) {
+                printf("FAILED, %s: page $%02x is written directly, "
+                       "but not to RAM by its function\n", what, page);
+                return 1;
+            }
+            for (i = 0; i < MEM_TEST_ADDRESSES; i++) {
+                addr = (page << 8) | bench_random(0x100);
+                value = (uint8_t)bench_random(0x100);
+                _mem_write_tab_ptr[page]((uint16_t)addr, value);
+                if (p[addr] != value) {
+                    printf("FAILED, %s: $%02x written to $%04x by its function, "
+                           "$%02x there directly\n", what, value, addr, p[addr]);
+                    return 1;
+                }
+            }
+            direct_pages++;
+        }
+    }
+
+    checks++;
+    return 0;
+}
+
+/* Every video bank, and watchpoints switched on before and after it.  */
+static int mem_check_config(const char *what)
+{
+    int vbank;
+
+    for (vbank = 0; vbank < 4; vbank++) {
+        mem_set_vbank(vbank);
+        if (mem_check_tables(what)) {
+            return 1;
+        }
+        mem_toggle_watchpoints(1, NULL);
+        if (mem_check_tables(what)) {
+            return 1;
+        }
+        mem_set_vbank(3 - vbank);
+        if (mem_check_tables(what)) {
+            return 1;
+        }
+        mem_toggle_watchpoints(0, NULL);
+        if (mem_check_tables(what)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int mem_test_frame(unsigned long frame)
+{
+    static const uint8_t dirs[] = { 0x2f, 0x00, 0x07, 0x05 };
+    char what[64];
+    unsigned int exrom, game, data, dir;
+
+    if (frame < MEM_TEST_FRAME) {
+        return 0;
+    }
+
+    for (game = 0; game < 2; game++) {
+        for (exrom = 0; exrom < 2; exrom++) {
+            for (dir = 0; dir < sizeof(dirs); dir++) {
+                for (data = 0; data < 8; data++) {
+                    pport.dir = dirs[dir];
+                    pport.data = (uint8_t)(data | (bench_random(0x20) << 3));
+                    export.exrom = (uint8_t)exrom;
+                    export.game = (uint8_t)game;
+                    mem_pla_config_changed();
+                    sprintf(what, "$00 $%02x $01 $%02x EXROM %u GAME %u",
+                            pport.dir, pport.data, exrom, game);
+                    if (mem_check_config(what)) {
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+
+    /* The tables set up again from another configuration and video bank.  */
+    pport.dir = 0x2f;
+    pport.data = 0x36;
+    export.exrom = 0;
+    export.game = 0;
+    mem_pla_config_changed();
+    mem_set_vbank(2);
+    mem_initialize_memory();
+    if (mem_check_tables("tables set up again")) {
+        return -1;
+    }
+
+    printf("mem: %lu table states, %lu direct pages, ok\n", checks, direct_pages);
+    return 1;
+}
+
+int bench_test_mem(void)
+{
+    return bench_run_machine(NULL, 0, mem_test_frame);
+}
@@ -0,0 +1,276 @@
+/*
+ * bench_render.c - Banded render test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Every render mode that video-render-threads.c splits in bands is rendered
+   from a random draw buffer in one pass with video_render_main(), and in
+   bands with video_render_threads_main() on 1-3 render threads, at 16 and
+   32 bpp, with and without the PAL/CRT filter, doublescan and scale2x, for
+   PAL and NTSC.  The areas include the whole viewport, the line after it,
+   a band that would start on that line, and random areas.  The targets
+   must be the same, including the pixels outside the area.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "video-color.h"
+#include "video-render.h"
+#include "video.h"
+#include "viewport.h"
+
+#include "bench.h"
+
+/* The draw buffer, with the viewport and a margin around it.  */
+#define RENDER_TEST_WIDTH       400
+#define RENDER_TEST_HEIGHT      312
+#define RENDER_TEST_FIRST_LINE  16
+#define RENDER_TEST_LAST_LINE   215
+
+/* The target: double size, and a line more for the scanlines.  */
+#define RENDER_TEST_TRG_WIDTH   (RENDER_TEST_WIDTH * 2 + 16)
+#define RENDER_TEST_TRG_HEIGHT  (RENDER_TEST_HEIGHT * 2 + 4)
+#define RENDER_TEST_TRG_PITCH   (RENDER_TEST_TRG_WIDTH * 4)
+#define RENDER_TEST_TRG_SIZE    (RENDER_TEST_TRG_PITCH * RENDER_TEST_TRG_HEIGHT)
+
+#define RENDER_TEST_AREAS       6
+
+static uint8_t draw_buffer[RENDER_TEST_WIDTH * RENDER_TEST_HEIGHT];
+static uint8_t trg_ref[RENDER_TEST_TRG_SIZE];
+static uint8_t trg[RENDER_TEST_TRG_SIZE];
+
+static video_render_config_t config;
+static viewport_t viewport;
+
+static const struct {
+    int rendermode;
+    const char *name;
+    int scalex;
+} render_modes[] = {
+    { VIDEO_RENDER_PAL_1X1, "PAL 1x1", 1 },
+    { VIDEO_RENDER_PAL_2X2, "PAL 2x2", 2 },
+    { VIDEO_RENDER_RGB_1X1, "RGB 1x1", 1 },
+    { VIDEO_RENDER_RGB_1X2, "RGB 1x2", 1 },
+    { VIDEO_RENDER_RGB_2X2, "RGB 2x2", 2 },
+    { VIDEO_RENDER_CRT_1X1, "CRT 1x1", 1 },
+    { VIDEO_RENDER_CRT_1X2, "CRT 1x2", 1 },
+    { VIDEO_RENDER_CRT_2X2, "CRT 2x2", 2 }
+};
+
+#define NUM_RENDER_MODES (int)(sizeof(render_modes) / sizeof(render_modes[0]))
+
+/* Random colour tables in the ranges of video-color.c, so that the PAL and
+   CRT renderers stay inside their gamma tables.  */
+static void render_colors(int depth, int video)
+{
+    video_render_color_tables_t *colortab = &config.color_tables;
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        int32_t val = (int32_t)bench_random(256) * (video ? 256 : 128);
+
+        video_render_setphysicalcolor(&config, i, bench_random32(), depth);
+        colortab->ytablel[i] = val * 32;
+        colortab->ytableh[i] = val * 191;
+        colortab->cbtable[i] = (int32_t)bench_random(0x2000) - 0x1000;
+        colortab->crtable[i] = (int32_t)bench_random(0x2000) - 0x1000;
+        colortab->cbtable_odd[i] = -colortab->cbtable[i];
+        colortab->crtable_odd[i] = (int32_t)bench_random(0x2000) - 0x1000;
+        colortab->cutable[i] = (int32_t)bench_random(0x2000) - 0x1000;
+        colortab->cvtable[i] = (int32_t)bench_random(0x2000) - 0x1000;
+        colortab->cutable_odd[i] = -colortab->cutable[i];
+        colortab->cvtable_odd[i] = (int32_t)bench_random(0x2000) - 0x1000;
+    }
+
+    for (i = 0; i < 256 * 3; i++) {
+        gamma_red[i] = bench_random32();
+        gamma_grn[i] = bench_random32();
+        gamma_blu[i] = bench_random32();
+    }
+    for (i = 0; i < 256 * 3 * 2; i++) {
+        gamma_red_fac[i] = bench_random32();
+        gamma_grn_fac[i] = bench_random32();
+        gamma_blu_fac[i] = bench_random32();
+    }
+    alpha = 0xff000000;
+}
+
+/* Source lines of area `n': the viewport, the viewport and the line after
+   it, a band that would start on that line, and random areas.  */
+static void render_area(int n, int threads, int *ys, int *lines)
+{
+    int band;
+
+    switch (n) {
+        case 0:
+            *ys = RENDER_TEST_FIRST_LINE;
+            *lines = RENDER_TEST_LAST_LINE - RENDER_TEST_FIRST_LINE + 1;
+            break;
+        case 1:
+            *ys = RENDER_TEST_FIRST_LINE;
+            *lines = RENDER_TEST_LAST_LINE - RENDER_TEST_FIRST_LINE + 2;
+            break;
+        case 2:
+            band = 16 + (int)bench_random(8);
+            *ys = RENDER_TEST_LAST_LINE + 1 - band;
+            *lines = band * (threads + 1) + (int)bench_random((unsigned int)threads + 1);
+            break;
+        default:
+            *ys = 1 + (int)bench_random(RENDER_TEST_LAST_LINE);
+            *lines = 1 + (int)bench_random((unsigned int)(RENDER_TEST_LAST_LINE + 2 - *ys));
+            break;
+    }
+}
+
+static int render_test_area(int index, int depth, int threads, int area)
+{
+    int scale, xs, ys, width, lines, pitcht;
+
+    scale = video_render_threads_test_scale(render_modes[index].rendermode);
+    render_area(area, threads, &ys, &lines);
+    xs = 8 + (int)bench_random(16);
+    width = 1 + (int)bench_random(RENDER_TEST_WIDTH - 16 - (unsigned int)xs);
+    pitcht = RENDER_TEST_TRG_WIDTH * (depth / 8);
+
+    memset(trg_ref, (int)bench_random(256), sizeof(trg_ref));
+    memcpy(trg, trg_ref, sizeof(trg));
+
+    video_render_main(&config, draw_buffer, trg_ref,
+                      width * render_modes[index].scalex, lines * scale,
+                      xs, ys, xs * render_modes[index].scalex, ys * scale,
+                      RENDER_TEST_WIDTH, pitcht, depth, &viewport);
+    video_render_threads_main(&config, draw_buffer, trg,
+                              width * render_modes[index].scalex, lines * scale,
+                              xs, ys, xs * render_modes[index].scalex, ys * scale,
+                              RENDER_TEST_WIDTH, pitcht, depth, &viewport);
+
+    if (memcmp(trg_ref, trg, sizeof(trg)) != 0) {
+        printf("FAILED, %s %d bpp, filter %d, doublescan %d, scale2x %d, "
+               "readable %d, %s, %d threads: source lines %d-%d, "
+               "x %d-%d differ\n",
+               render_modes[index].name, depth, config.filter,
+               config.doublescan, config.scale2x, config.readable,
+               viewport.crt_type ? "PAL" : "NTSC", threads,
+               ys, ys + lines - 1, xs, xs + width - 1);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int render_test_mode(int index, int threads, unsigned long *renders)
+{
+    static const int depths[] = { 16, 32 };
+    int d, filter, doublescan, scale2x, readable, video, area;
+
+    config.rendermode = render_modes[index].rendermode;
+    config.scalex = render_modes[index].scalex;
+
+    for (d = 0; d < 2; d++) {
+        for (video = 0; video < 2; video++) {
+            viewport.crt_type = video;
+            render_colors(depths[d], video);
+            for (filter = VIDEO_FILTER_NONE; filter <= VIDEO_FILTER_CRT; filter++) {
+                for (doublescan = 0; doublescan < 2; doublescan++) {
+                    for (scale2x = 0; scale2x < 2; scale2x++) {
+                        for (readable = 0; readable < 2; readable++) {
+                            config.filter = filter;
+                            config.doublescan = doublescan;
+                            config.scale2x = scale2x;
+                            config.readable = readable;
+                            for (area = 0; area < RENDER_TEST_AREAS; area++) {
+                                if (render_test_area(index, depths[d], threads, area)) {
+                                    return 1;
+                                }
+                                (*renders)++;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+int bench_test_render(void)
+{
+    unsigned long renders[NUM_RENDER_MODES];
+    int i, threads, split = 0;
+
+    for (i = 0; i < NUM_RENDER_MODES; i++) {
+        if (video_render_threads_test_scale(render_modes[i].rendermode) > 0) {
+            split++;
+        }
+        renders[i] = 0;
+    }
+    if (split == 0) {
+        printf("render: built without render threads, nothing to compare\n");
+        return 0;
+    }
+
+    video_render_1x2_init();
+    video_render_2x2_init();
+    video_render_pal_init();
+    video_render_crt_init();
+
+    video_render_initconfig(&config);
+    config.chip_name = "VICII";
+    config.video_resources.pal_scanlineshade = 667;
+    config.video_resources.pal_blur = 500;
+    config.video_resources.pal_oddlines_phase = 1250;
+    config.video_resources.pal_oddlines_offset = 750;
+    config.video_resources.audioleak = 0;
+
+    viewport.first_line = RENDER_TEST_FIRST_LINE;
+    viewport.last_line = RENDER_TEST_LAST_LINE;
+
+    for (i = 0; i < (int)sizeof(draw_buffer); i++) {
+        draw_buffer[i] = (uint8_t)bench_random(256);
+    }
+
+    for (threads = 1; threads <= 3; threads++) {
+        video_render_threads_set(threads);
+        for (i = 0; i < NUM_RENDER_MODES; i++) {
+            if (video_render_threads_test_scale(render_modes[i].rendermode) == 0) {
+                continue;
+            }
+            if (render_test_mode(i, threads, &renders[i])) {
+                video_render_threads_shutdown();
+                return 1;
+            }
+        }
+    }
+    video_render_threads_shutdown();
+
+    for (i = 0; i < NUM_RENDER_MODES; i++) {
+        if (renders[i] > 0) {
+            printf("render: %-8s %lu areas on 1-3 threads, ok\n",
+                   render_modes[i].name, renders[i]);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * bench_sid.cpp - reSID FIR convolution test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Two reSID instances get the same stream of register writes, one with the
+   vectorized FIR convolution (SID::enable_fir_simd(true)) and one with the
+   original scalar loops.  Then two instances with the FIR convolution get
+   it, one clocking the chip in blocks (SID::enable_clock_block(true)) and
+   one with the original per-cycle loop.  Both resampling methods are run
+   for both chip models at the usual sample rates, and the sample buffers
+   must be the same, sample for sample.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "resid/sid.h"
+
+#include "bench.h"
+
+using namespace reSID;
+
+#define SID_CLOCK_PAL 985248
+
+/* Emulated time per run, in cycles.  */
+#define SID_TEST_CYCLES (3 * SID_CLOCK_PAL)
+
+#define SID_BUFFER_SIZE 1024
+
+/* Deterministic register stream: a register write every 1 to 2048 cycles,
+   sometimes up to 20000, with bursts of volume writes such as sample players
+   do.  */
+class sid_stream
+{
+public:
+    sid_stream() : burst(0) {}
+
+    /* Next write and the number of cycles until it.  */
+    cycle_count next(reg8 &reg, reg8 &value)
+    {
+        if (burst > 0) {
+            burst--;
+            reg = 0x18;
+            value = (reg8)(0x10 | bench_random(16));
+            return 60 + bench_random(8);
+        }
+        if (bench_random(64) == 0) {
+            burst = 200 + bench_random(400);
+        }
+
+        reg = (reg8)bench_random(0x19);
+        switch (reg) {
+            case 0x04:
+            case 0x0b:
+            case 0x12:
+                /* Any waveform combination, with sync, ring and test.  */
+                value = (reg8)((bench_random(16) << 4) | bench_random(16));
+                break;
+            case 0x17:
+                value = (reg8)((bench_random(16) << 4) | bench_random(8));
+                break;
+            case 0x18:
+                value = (reg8)((bench_random(8) << 4) | 0x0f);
+                break;
+            default:
+                value = (reg8)bench_random(256);
+                break;
+        }
+        /* Now and then a pause long enough for the bus value to fade.  */
+        if (bench_random(32) == 0) {
+            return 1 + bench_random(20000);
+        }
+        return 1 + bench_random(2048);
+    }
+
+private:
+    int burst;
+};
+
+static void sid_setup(SID &sid, chip_model model, sampling_method method,
+                      int rate, bool simd, bool blocks)
+{
+    sid.set_chip_model(model);
+    sid.enable_filter(true);
+    /* The default SidResidFilterBias and SidResid8580FilterBias, as in
+       resid_init().  Without it, the 8580 filter of all but the first SID
+       is left with an unset gate voltage.  */
+    sid.adjust_filter_bias(model == MOS6581 ? 0.5 : -3.0);
+    sid.enable_external_filter(true);
+    sid.enable_fir_simd(simd);
+    sid.enable_clock_block(blocks);
+    /* The passband of the SidResidPassband default of 90%.  */
+    sid.set_sampling_parameters(SID_CLOCK_PAL, method, rate, rate * 90 / 200);
+    sid.reset();
+}
+
+/* Run both SIDs for `cycles' and compare what they produce.  Return the
+   number of samples that differ.  */
+static long sid_clock_both(SID &sid, SID &ref, cycle_count cycles,
+                           long *samples)
+{
+    static short buf[SID_BUFFER_SIZE];
+    static short buf_ref[SID_BUFFER_SIZE];
+    cycle_count left = cycles;
+    cycle_count left_ref = cycles;
+    long diffs = 0;
+
+    while (left > 0 || left_ref > 0) {
+        int n = sid.clock(left, buf, SID_BUFFER_SIZE);
+        int n_ref = ref.clock(left_ref, buf_ref, SID_BUFFER_SIZE);
+        int i;
+
+        if (n != n_ref || left != left_ref) {
+            return diffs + 1 + (n > n_ref ? n : n_ref);
+        }
+        for (i = 0; i < n; i++) {
+            if (buf[i] != buf_ref[i]) {
+                diffs++;
+            }
+        }
+        *samples += n;
+    }
+
+    return diffs;
+}
+
+/* Compare the SIMD convolution with the scalar one, or the block clocking
+   with the per-cycle loop.  */
+static long sid_test_run(chip_model model, sampling_method method, int rate,
+                         bool blocks, long *samples)
+{
+    SID *sid = new SID;
+    SID *ref = new SID;
+    sid_stream stream;
+    cycle_count done = 0;
+    long diffs = 0;
+
+    /* The same register stream for every run.  */
+    bench_seed(1);
+    sid_setup(*sid, model, method, rate, true, true);
+    sid_setup(*ref, model, method, rate, blocks, !blocks);
+
+    *samples = 0;
+    while (done < SID_TEST_CYCLES && diffs == 0) {
+        reg8 reg, value;
+        cycle_count delta = stream.next(reg, value);
+
+        diffs += sid_clock_both(*sid, *ref, delta, samples);
+
+        /* Reads see the bus value, and the oscillator and envelope of
+           voice 3.  */
+        reg8 addr = (reg8)bench_random(0x20);
+        if (sid->read(addr) != ref->read(addr)) {
+            diffs++;
+        }
+
+        sid->write(reg, value);
+        ref->write(reg, value);
+        done += delta;
+    }
+
+    delete sid;
+    delete ref;
+
+    return diffs;
+}
+
+int bench_test_sid(void)
+{
+    static const chip_model models[] = { MOS6581, MOS8580 };
+    static const sampling_method methods[] = { SAMPLE_RESAMPLE, SAMPLE_RESAMPLE_FASTMEM };
+    static const int rates[] = { 22050, 44100, 48000 };
+    int failed = 0;
+    unsigned int b, m, s, r;
+
+    for (b = 0; b < 2; b++) {
+        for (m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+            for (s = 0; s < sizeof(methods) / sizeof(methods[0]); s++) {
+                for (r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+                    long samples;
+                    long diffs = sid_test_run(models[m], methods[s], rates[r],
+                                              b != 0, &samples);
+
+                    printf("sid: %s %s %-16s %5d Hz: %7ld samples, ",
+                           b ? "blocks" : "FIR   ",
+                           models[m] == MOS6581 ? "6581" : "8580",
+                           methods[s] == SAMPLE_RESAMPLE ? "resample" : "resample-fastmem",
+                           rates[r], samples);
+                    if (diffs) {
+                        printf("FAILED (%ld differ)\n", diffs);
+                        failed = 1;
+                    } else {
+                        printf("ok\n");
+                    }
+                }
+            }
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,335 @@
+/*
+ * bench_sprites.c - VIC-II sprite pixel test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Random sprite lines are drawn with the bit plane functions of
+   vicii-sprites.c and with the per-pixel macros they replaced, which keep
+   one byte per pixel for the sprites drawn so far.  Each line is a few
+   hires, multicolor and expanded multicolor sprites, and the repeated
+   pixels drawn after them, at random positions over the whole line and
+   past its ends, with random data, priority and trim masks.  The sprites
+   each draw collides with, and the pixels of the line, must be the same;
+   the collision registers are made from these.  The trim masks are checked
+   against the old loop for every display interval.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "types.h"
+#include "vicii-sprites.h"
+#include "viciitypes.h"
+
+#include "bench.h"
+
+#define SPRITES_TEST_LINES 1000000
+#define SPRITES_TEST_DRAWS 12
+
+/* The sprite line of NTSC, the longest.  */
+#define SPRITES_TEST_WRAP_X 520
+
+/* Room for the line and for sprites partially outside it.  */
+#define SPRITES_TEST_GUARD 64
+#define SPRITES_TEST_LINE (SPRITES_TEST_GUARD + SPRITES_TEST_WRAP_X + SPRITES_TEST_GUARD)
+
+static uint8_t line_ref[SPRITES_TEST_LINE], line[SPRITES_TEST_LINE];
+
+/* The sprites drawn so far, one byte per pixel.  */
+static uint8_t sprline_ref[SPRITES_TEST_LINE];
+
+static uint32_t sprites_random_msk(void)
+{
+    uint32_t msk = bench_random32();
+
+    /* Sparse, dense, empty and full masks too.  */
+    switch (bench_random(6)) {
+        case 0:
+            return msk & bench_random32();
+        case 1:
+            return msk | bench_random32();
+        case 2:
+            return 0;
+        case 3:
+            return ~0U;
+        default:
+            return msk;
+    }
+}
+
+/* The per-pixel drawing of vicii-sprites.c before the bit planes.  */
+#define SPRITE_PIXEL(do_draw, sprite_bit, imgptr, collmskptr, \
+                     pos, color, collmsk_return)              \
+    do {                                                      \
+        if ((do_draw) && (collmskptr)[(pos)] == 0) {          \
+            (imgptr)[(pos)] = (uint8_t)(color); }             \
+        (collmsk_return) |= (collmskptr)[(pos)];              \
+        (collmskptr)[(pos)] |= (sprite_bit);                  \
+    } while (0)
+
+static uint8_t sprite_mask_ref(uint32_t msk, uint32_t gfxmsk, int size, int n,
+                               uint8_t *ptr, int pos, uint32_t color)
+{
+    uint8_t *sptr = sprline_ref + SPRITES_TEST_GUARD + pos;
+    uint8_t cmsk = 0;
+    uint32_t m;
+    int p;
+
+    for (m = 1U << (size - 1), p = 0; p < size; p++, m >>= 1) {
+        if (msk & m) {
+            if (gfxmsk & m) {
+                SPRITE_PIXEL(0, 1 << n, ptr, sptr, p, color, cmsk);
+            } else {
+                SPRITE_PIXEL(1, 1 << n, ptr, sptr, p, color, cmsk);
+            }
+        }
+    }
+
+    return cmsk;
+}
+
+/* As the macro, this shifts `mcmsk' past the pixels drawn.  */
+static uint8_t mcsprite_mask_ref(uint32_t *mcmsk, uint32_t gfxmsk,
+                                 uint32_t trmsk, int size, int n,
+                                 uint8_t *ptr, int pos,
+                                 const uint32_t *pixel_table)
+{
+    uint8_t *sptr = sprline_ref + SPRITES_TEST_GUARD + pos;
+    uint8_t cmsk = 0;
+    uint32_t m;
+    int p;
+
+    for (m = 1U << (size - 1), p = 0; p < size;
+         p += 2, m >>= 2, *mcmsk <<= 2, trmsk <<= 2) {
+        uint8_t c, t;
+
+        c = (uint8_t)((*mcmsk >> 22) & 0x3);
+        t = (uint8_t)((trmsk >> 22) & 0x3);
+
+        if (c) {
+            if (t & 2) {
+                SPRITE_PIXEL(!(gfxmsk & m), 1 << n, ptr, sptr, p,
+                             pixel_table[c], cmsk);
+            }
+            if (t & 1) {
+                SPRITE_PIXEL(!(gfxmsk & (m >> 1)), 1 << n, ptr, sptr, p + 1,
+                             pixel_table[c], cmsk);
+            }
+        }
+    }
+
+    return cmsk;
+}
+
+static uint8_t mcsprite_double_mask_ref(uint32_t *mcmsk, uint32_t gfxmsk,
+                                        uint32_t trmsk, int size, int n,
+                                        uint8_t *ptr, int pos,
+                                        const uint32_t *pixel_table)
+{
+    uint8_t *sptr = sprline_ref + SPRITES_TEST_GUARD + pos;
+    uint8_t cmsk = 0;
+    uint32_t m;
+    int p, i;
+
+    for (m = 1U << (size - 1), p = 0; p < size;
+         p += 4, *mcmsk <<= 2, trmsk <<= 4) {
+        uint8_t c, t;
+
+        c = (uint8_t)((*mcmsk >> 22) & 0x3);
+        t = (uint8_t)((trmsk >> (size - 4)) & 0xf);
+
+        for (i = 0; i < 4; i++, m >>= 1, t <<= 1) {
+            if (c && (t & 0x8)) {
+                SPRITE_PIXEL(!(gfxmsk & m), 1 << n, ptr, sptr, p + i,
+                             pixel_table[c], cmsk);
+            }
+        }
+    }
+
+    return cmsk;
+}
+
+static uint32_t trim_msk_ref(int size, int sprite_xs, int sprite_xe)
+{
+    int display_width = ((sprite_xe + 1 < size ? sprite_xe + 1 : size)
+                         - (sprite_xs > 0 ? sprite_xs : 0));
+    uint32_t msk = 0;
+    int i;
+
+    if (display_width > 0) {
+        for (i = 0; i < display_width; i++) {
+            msk = (msk << 1) | 1;
+        }
+        for (i = 0; i < size - sprite_xe - 1; i++) {
+            msk <<= 1;
+        }
+    }
+
+    return msk;
+}
+
+/* A mask as TRIM_MSK makes it, or a random one.  */
+static uint32_t sprites_random_trim(int size)
+{
+    if (bench_random(2)) {
+        return sprites_random_msk();
+    }
+    return vicii_sprites_test_trim(size, (int)bench_random(size + 8) - 4,
+                                   (int)bench_random(size + 8) - 4);
+}
+
+static int sprites_test_trim(void)
+{
+    static const int sizes[] = { 1, 2, 3, 4, 5, 6, 7, 16, 18, 24, 25, 32, 34 };
+    int i, xs, xe;
+
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+        for (xs = -64; xs < 64; xs++) {
+            for (xe = -64; xe < 64; xe++) {
+                if (vicii_sprites_test_trim(sizes[i], xs, xe)
+                    != trim_msk_ref(sizes[i], xs, xe)) {
+                    printf("FAILED, trim mask of size %d differs for %d-%d\n",
+                           sizes[i], xs, xe);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+/* Draw one random sprite both ways.  */
+static int sprites_test_draw(const char **what)
+{
+    uint32_t c[4];
+    uint32_t msk, gfxmsk, trmsk, mcmsk_ref;
+    uint8_t cmsk, cmsk_ref;
+    int n, pos, size, i;
+
+    n = (int)bench_random(8);
+    pos = (int)bench_random(vicii.sprite_wrap_x + SPRITES_TEST_GUARD / 2)
+          - SPRITES_TEST_GUARD / 2;
+    for (i = 0; i < 4; i++) {
+        c[i] = bench_random(16);
+    }
+    msk = sprites_random_msk();
+    gfxmsk = bench_random(2) ? sprites_random_msk() : 0;
+
+    switch (bench_random(4)) {
+        case 0:
+            /* Hires, normal or expanded, cut off or repeated pixels.  */
+            *what = "hires";
+            size = 1 + (int)bench_random(32);
+            cmsk_ref = sprite_mask_ref(msk, gfxmsk, size, n,
+                                       line_ref + SPRITES_TEST_GUARD + pos,
+                                       pos, c[0]);
+            cmsk = vicii_sprites_test_mask(msk, gfxmsk, size, n,
+                                           line + SPRITES_TEST_GUARD + pos,
+                                           pos, c[0]);
+            break;
+        case 1:
+            /* Multicolor; the MC bug shifts the data up by one.  */
+            *what = "multicolor";
+            trmsk = sprites_random_trim(24 + (int)bench_random(2));
+            mcmsk_ref = msk;
+            cmsk_ref = mcsprite_mask_ref(&mcmsk_ref, gfxmsk, trmsk, 24, n,
+                                         line_ref + SPRITES_TEST_GUARD + pos,
+                                         pos, c);
+            cmsk = vicii_sprites_test_mcmask(msk, gfxmsk, trmsk, 24, 0, n,
+                                             line + SPRITES_TEST_GUARD + pos,
+                                             pos, c);
+            break;
+        default:
+            /* Expanded multicolor, in two parts as drawn by
+               draw_mc_sprite_expanded().  */
+            *what = "expanded multicolor";
+            trmsk = sprites_random_trim(32 + 2 * (int)bench_random(2));
+            mcmsk_ref = msk;
+            cmsk_ref = mcsprite_double_mask_ref(&mcmsk_ref, gfxmsk, trmsk, 32, n,
+                                                line_ref + SPRITES_TEST_GUARD + pos,
+                                                pos, c);
+            cmsk = vicii_sprites_test_mcmask(msk, gfxmsk, trmsk, 32, 1, n,
+                                             line + SPRITES_TEST_GUARD + pos,
+                                             pos, c);
+            if (cmsk != cmsk_ref) {
+                break;
+            }
+            msk <<= 16;
+            gfxmsk = bench_random(2) ? sprites_random_msk() : 0;
+            trmsk = sprites_random_trim(16 + 2 * (int)bench_random(2));
+            cmsk_ref = mcsprite_double_mask_ref(&mcmsk_ref, gfxmsk, trmsk, 16, n,
+                                                line_ref + SPRITES_TEST_GUARD + pos + 32,
+                                                pos + 32, c);
+            cmsk = vicii_sprites_test_mcmask(msk, gfxmsk, trmsk, 16, 1, n,
+                                             line + SPRITES_TEST_GUARD + pos + 32,
+                                             pos + 32, c);
+            break;
+    }
+
+    return cmsk != cmsk_ref;
+}
+
+int bench_test_sprites(void)
+{
+    const char *what = NULL;
+    unsigned long draws = 0;
+    int i, j, num;
+
+    vicii.sprite_wrap_x = SPRITES_TEST_WRAP_X;
+    vicii_sprites_test_init();
+
+    if (sprites_test_trim()) {
+        vicii_sprites_shutdown();
+        return 1;
+    }
+    printf("sprites: trim masks ok\n");
+
+    for (i = 0; i < SPRITES_TEST_LINES; i++) {
+        memset(line_ref, (int)bench_random(0x100), sizeof(line_ref));
+        memcpy(line, line_ref, sizeof(line));
+        memset(sprline_ref, 0, sizeof(sprline_ref));
+        vicii_sprites_reset_sprline();
+
+        num = 1 + (int)bench_random(SPRITES_TEST_DRAWS);
+        for (j = 0; j < num; j++) {
+            if (sprites_test_draw(&what)) {
+                printf("FAILED, line %d: collisions of %s sprite %d differ\n",
+                       i, what, j);
+                vicii_sprites_shutdown();
+                return 1;
+            }
+            if (memcmp(line_ref, line, sizeof(line)) != 0) {
+                printf("FAILED, line %d: pixels of %s sprite %d differ\n",
+                       i, what, j);
+                vicii_sprites_shutdown();
+                return 1;
+            }
+            draws++;
+        }
+    }
+
+    vicii_sprites_shutdown();
+
+    printf("sprites: %d lines, %lu sprites, ok\n", SPRITES_TEST_LINES, draws);
+    return 0;
+}
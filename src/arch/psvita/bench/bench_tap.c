@@ -0,0 +1,511 @@
+/*
+ * bench_tap.c - TAP pulse index test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Random version 0, 1 and 2 images are opened with tap_open() and played by
+   the datasette, as the C64 and as the C16 reads them.  The images mix
+   short pulses, zeroes and long pulses, and some end with a long pulse cut
+   off.  The entries of the pulse index, the offset of each pulse and the
+   pulses found by offset, the gaps read forward and backward and the tape
+   positions after each of them, and the positions found by counter must
+   match a plain decode of the image from its start.  Then pulses are recorded over the image somewhere with
+   tap_write_data(); the index updated from there must match the one of the
+   image opened afresh.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "datasette.h"
+#include "tap.h"
+#include "types.h"
+
+#include "bench.h"
+
+#define TAP_TEST_IMAGES     100
+#define TAP_TEST_MAX_SIZE   4096
+#define TAP_TEST_MAX_WRITE  (20 * 4)
+
+/* DatasetteZeroGapDelay, as set by datasette_test_set_image().  */
+#define TAP_TEST_ZERO_GAP   20000
+
+#define TAP_TEST_FILE APP_DATA_DIR "bench-test.tap"
+
+/* An image decoded from its start.  */
+typedef struct tap_test_decode_s {
+    int num_pulses;
+    uint32_t offset[TAP_TEST_MAX_SIZE + TAP_TEST_MAX_WRITE + 1];
+    uint32_t counter[TAP_TEST_MAX_SIZE + TAP_TEST_MAX_WRITE + 1];
+    CLOCK gap[TAP_TEST_MAX_SIZE + TAP_TEST_MAX_WRITE];
+} tap_test_decode_t;
+
+/* A gap as the datasette reads it, and the tape position after it.  */
+typedef struct tap_test_read_s {
+    CLOCK gap;
+    uint32_t pos;
+} tap_test_read_t;
+
+static uint8_t image[TAP_TEST_MAX_SIZE + TAP_TEST_MAX_WRITE];
+static tap_test_decode_t decode;
+static tap_test_read_t reads[2 * (TAP_TEST_MAX_SIZE + TAP_TEST_MAX_WRITE)];
+static uint32_t saved_offset[(TAP_TEST_MAX_SIZE + TAP_TEST_MAX_WRITE) / TAP_INDEX_STEP + 1];
+static uint32_t saved_counter[(TAP_TEST_MAX_SIZE + TAP_TEST_MAX_WRITE) / TAP_INDEX_STEP + 1];
+
+/* A pulse as the datasette records it.  */
+static int tap_random_pulse(uint8_t *p, int version)
+{
+    int i;
+
+    if (bench_random(8) != 0) {
+        p[0] = (uint8_t)(1 + bench_random(255));
+        return 1;
+    }
+
+    p[0] = 0;
+    if (version == 0) {
+        return 1;
+    }
+
+    /* Random lengths, zero, shorter than a count, and non-zero bytes
+       that look like short pulses when read backward.  */
+    for (i = 1; i < 4; i++) {
+        switch (bench_random(4)) {
+            case 0:
+                p[i] = 0;
+                break;
+            case 1:
+                p[i] = (uint8_t)(i == 1 ? bench_random(8) : 0);
+                break;
+            default:
+                p[i] = (uint8_t)(1 + bench_random(255));
+                break;
+        }
+    }
+    return 4;
+}
+
+static int tap_random_image(int version)
+{
+    int size = 0, end = 3 + (int)bench_random(TAP_TEST_MAX_SIZE - 16);
+
+    while (size < end) {
+        size += tap_random_pulse(image + size, version);
+    }
+
+    /* A long pulse cut off by the end of the image.  */
+    if (version > 0 && bench_random(2)) {
+        int cut = 1 + (int)bench_random(3);
+
+        image[size] = 0;
+        if (cut > 1) {
+            image[size + 1] = (uint8_t)(1 + bench_random(255));
+        }
+        if (cut > 2) {
+            image[size + 2] = (uint8_t)bench_random(256);
+        }
+        size += cut;
+    }
+
+    return size;
+}
+
+static int tap_write_image(int size, int version, int c16)
+{
+    uint8_t header[TAP_HDR_SIZE];
+    FILE *fd;
+    int ok;
+
+    memset(header, 0, sizeof(header));
+    memcpy(header + TAP_HDR_MAGIC_OFFSET, c16 ? "C16-TAPE-RAW" : "C64-TAPE-RAW", 12);
+    header[TAP_HDR_VERSION] = (uint8_t)version;
+    header[TAP_HDR_SYSTEM] = (uint8_t)(c16 ? 2 : 0);
+    header[TAP_HDR_LEN] = (uint8_t)size;
+    header[TAP_HDR_LEN + 1] = (uint8_t)(size >> 8);
+
+    fd = fopen(TAP_TEST_FILE, MODE_WRITE);
+    if (fd == NULL) {
+        printf("FAILED, cannot write `%s'\n", TAP_TEST_FILE);
+        return 1;
+    }
+    ok = (fwrite(header, sizeof(header), 1, fd) == 1
+          && fwrite(image, (size_t)size, 1, fd) == 1);
+    if (fclose(fd) != 0 || !ok) {
+        printf("FAILED, cannot write `%s'\n", TAP_TEST_FILE);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Decode the image pulse by pulse from its start, and count the tape as
+   the machine plays it.  */
+static void tap_decode(int size, int version, int c16)
+{
+    int pos = 0, num = 0, len;
+    CLOCK gap, count;
+
+    decode.offset[0] = 0;
+    decode.counter[0] = 0;
+
+    while (pos < size) {
+        if (image[pos] != 0) {
+            gap = image[pos] * 8;
+            len = 1;
+        } else if (version == 0) {
+            gap = TAP_TEST_ZERO_GAP;
+            len = 1;
+        } else {
+            if (pos + 4 > size) {
+                break;
+            }
+            gap = image[pos + 1] | (image[pos + 2] << 8) | (image[pos + 3] << 16);
+            if (gap == 0) {
+                gap = TAP_TEST_ZERO_GAP;
+            }
+            len = 4;
+        }
+
+        count = gap / 8;
+        if (c16) {
+            if (version == 1) {
+                count = (gap / 8) * 2;
+            } else if (version == 2) {
+                count = gap * 2 / 8;
+            } else {
+                count = 0;
+            }
+        }
+
+        decode.gap[num] = gap;
+        pos += len;
+        num++;
+        decode.offset[num] = (uint32_t)pos;
+        decode.counter[num] = decode.counter[num - 1] + (uint32_t)count;
+    }
+
+    decode.num_pulses = num;
+}
+
+/* The gaps the machine reads from the decoded image, in the direction
+   given, and the tape positions after each of them.  The C16 reads both
+   half waves of a pulse of version 1, and a doubled pulse of version 2.  */
+static int tap_expected_reads(int version, int c16, int direction)
+{
+    int i, k, num = 0;
+
+    if (c16 && version == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < decode.num_pulses; i++) {
+        k = (direction > 0) ? i : decode.num_pulses - 1 - i;
+
+        reads[num].gap = decode.gap[k] * ((c16 && version == 2) ? 2 : 1);
+        reads[num].pos = decode.offset[(direction > 0) ? k + 1 : k];
+        num++;
+        if (c16 && version == 1) {
+            reads[num] = reads[num - 1];
+            num++;
+        }
+    }
+
+    return num;
+}
+
+static int tap_check_index(tap_t *tap, const char *what)
+{
+    int i, k, pulse;
+    uint32_t pos, offset;
+
+    if (tap->num_pulses != decode.num_pulses) {
+        printf("FAILED, %s: %d pulses indexed, %d decoded\n",
+               what, tap->num_pulses, decode.num_pulses);
+        return 1;
+    }
+    for (i = 0; i <= decode.num_pulses; i += TAP_INDEX_STEP) {
+        k = i / TAP_INDEX_STEP;
+        if (tap->index_offset[k] != decode.offset[i]
+            || tap->index_counter[k] != decode.counter[i]) {
+            printf("FAILED, %s: index entry %d at offset %u counter %u, "
+                   "decoded at %u counter %u\n", what, k, tap->index_offset[k],
+                   tap->index_counter[k], decode.offset[i], decode.counter[i]);
+            return 1;
+        }
+    }
+    for (i = 0; i <= decode.num_pulses; i++) {
+        if (tap_pulse_offset(tap, i) != decode.offset[i]) {
+            printf("FAILED, %s: pulse %d at offset %u, decoded at %u\n",
+                   what, i, tap_pulse_offset(tap, i), decode.offset[i]);
+            return 1;
+        }
+    }
+
+    /* The first pulse at or after an offset, in or between pulses.  */
+    for (i = 0; i < 256; i++) {
+        pos = bench_random(decode.offset[decode.num_pulses] + 2);
+        k = 0;
+        while (k < decode.num_pulses && decode.offset[k] < pos) {
+            k++;
+        }
+        pulse = tap_find_pulse(tap, (int)pos, &offset);
+        if (pulse != k || offset != decode.offset[k]) {
+            printf("FAILED, %s: pulse %d at offset %u found for offset %u, "
+                   "decoded %d at %u\n", what, pulse, offset, pos, k, decode.offset[k]);
+            return 1;
+        }
+    }
+    if (tap->cycle_counter_total != (int)decode.counter[decode.num_pulses]) {
+        printf("FAILED, %s: tape length %d, decoded %u\n",
+               what, tap->cycle_counter_total, decode.counter[decode.num_pulses]);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Play the whole tape in `direction' from where it is.  */
+static int tap_check_reads(tap_t *tap, int version, int c16, int direction)
+{
+    const char *name = (direction > 0) ? "forward" : "backward";
+    int num, i;
+    uint32_t end;
+    CLOCK gap;
+
+    num = tap_expected_reads(version, c16, direction);
+    for (i = 0; i < num; i++) {
+        gap = datasette_test_read_gap(direction);
+        if (gap != reads[i].gap) {
+            printf("FAILED, %s read %d: gap %lu, decoded %lu\n",
+                   name, i, (unsigned long)gap, (unsigned long)reads[i].gap);
+            return 1;
+        }
+        if ((uint32_t)tap->current_file_seek_position != reads[i].pos) {
+            printf("FAILED, %s read %d: at offset %d, decoded %u\n",
+                   name, i, tap->current_file_seek_position, reads[i].pos);
+            return 1;
+        }
+    }
+
+    /* Nothing more at the end.  */
+    end = (uint32_t)tap->current_file_seek_position;
+    gap = datasette_test_read_gap(direction);
+    if (gap != 0 || (uint32_t)tap->current_file_seek_position != end) {
+        printf("FAILED, %s read past the end: gap %lu at offset %d\n",
+               name, (unsigned long)gap, tap->current_file_seek_position);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Position the tape at `counter' and read the gap found there.  */
+static int tap_check_seek(tap_t *tap, int version, int c16, uint32_t counter)
+{
+    int k = 0;
+    CLOCK gap, expected;
+
+    while (k < decode.num_pulses && decode.counter[k + 1] <= counter) {
+        k++;
+    }
+
+    datasette_test_seek_counter((int)counter);
+    if ((uint32_t)tap->current_file_seek_position != decode.offset[k]
+        || (uint32_t)tap->cycle_counter != decode.counter[k]) {
+        printf("FAILED, seek to counter %u: offset %d counter %d, "
+               "decoded pulse %d at offset %u counter %u\n",
+               counter, tap->current_file_seek_position, tap->cycle_counter,
+               k, decode.offset[k], decode.counter[k]);
+        return 1;
+    }
+
+    expected = 0;
+    if (k < decode.num_pulses && !(c16 && version == 0)) {
+        expected = decode.gap[k] * ((c16 && version == 2) ? 2 : 1);
+    }
+    gap = datasette_test_read_gap(1);
+    if (gap != expected) {
+        printf("FAILED, read after seek to counter %u: gap %lu, decoded %lu\n",
+               counter, (unsigned long)gap, (unsigned long)expected);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int tap_check_play(tap_t *tap, int version, int c16)
+{
+    uint32_t total = decode.counter[decode.num_pulses];
+    int i;
+
+    if (tap_check_reads(tap, version, c16, 1)
+        || tap_check_reads(tap, version, c16, -1)) {
+        return 1;
+    }
+
+    for (i = 0; i <= decode.num_pulses; i++) {
+        if (tap_check_seek(tap, version, c16, decode.counter[i])) {
+            return 1;
+        }
+    }
+    for (i = 0; i < 64; i++) {
+        if (tap_check_seek(tap, version, c16, bench_random(total + 16))) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Record pulses from a pulse somewhere on the tape, as the datasette does,
+   or from within a pulse, and index them.  */
+static int tap_record(tap_t *tap, int *size, int version)
+{
+    uint8_t pulse[4];
+    int pos, num, len, i;
+
+    switch (bench_random(4)) {
+        case 0:
+            pos = (int)bench_random(tap->size + 1);
+            break;
+        case 1:
+            /* Into the last bytes before an entry of the index.  */
+            i = (int)bench_random(tap->num_pulses / TAP_INDEX_STEP + 1);
+            pos = (int)tap->index_offset[i] - 1 - (int)bench_random(4);
+            if (pos < 0) {
+                pos = 0;
+            }
+            break;
+        default:
+            pos = (int)tap_pulse_offset(tap, (int)bench_random(tap->num_pulses + 1));
+            break;
+    }
+    num = 1 + (int)bench_random(TAP_TEST_MAX_WRITE / 4);
+
+    for (i = 0; i < num; i++) {
+        len = tap_random_pulse(pulse, version);
+        if (tap_write_data(tap, pos, pulse, len) < 0) {
+            printf("FAILED, cannot record to `%s'\n", TAP_TEST_FILE);
+            return 1;
+        }
+        memcpy(image + pos, pulse, len);
+        pos += len;
+        if (tap->size < pos) {
+            tap->size = pos;
+        }
+    }
+    *size = tap->size;
+
+    datasette_test_update_index();
+    return 0;
+}
+
+static int tap_test_image(int version, int c16, unsigned long *pulses)
+{
+    unsigned int read_only = 0;
+    tap_t *tap;
+    int size, num, entries, failed;
+
+    size = tap_random_image(version);
+    if (tap_write_image(size, version, c16)) {
+        return 1;
+    }
+
+    tap = tap_open(TAP_TEST_FILE, &read_only);
+    if (tap == NULL || read_only) {
+        printf("FAILED, cannot open `%s'\n", TAP_TEST_FILE);
+        return 1;
+    }
+
+    datasette_test_set_image(tap, c16);
+    tap_decode(size, version, c16);
+    failed = tap_check_index(tap, "open") || tap_check_play(tap, version, c16);
+    *pulses += (unsigned long)decode.num_pulses;
+
+    if (!failed) {
+        failed = tap_record(tap, &size, version);
+    }
+    if (!failed) {
+        tap_decode(size, version, c16);
+        failed = tap_check_index(tap, "record");
+    }
+    num = tap->num_pulses;
+    entries = num / TAP_INDEX_STEP + 1;
+    memcpy(saved_offset, tap->index_offset, entries * sizeof(uint32_t));
+    memcpy(saved_counter, tap->index_counter, entries * sizeof(uint32_t));
+
+    datasette_test_set_image(NULL, -1);
+    tap_close(tap);
+    if (failed) {
+        return 1;
+    }
+
+    /* The recorded image opened afresh.  */
+    tap = tap_open(TAP_TEST_FILE, &read_only);
+    if (tap == NULL) {
+        printf("FAILED, cannot open `%s' again\n", TAP_TEST_FILE);
+        return 1;
+    }
+    datasette_test_set_image(tap, c16);
+    if (tap->num_pulses != num
+        || memcmp(tap->index_offset, saved_offset, entries * sizeof(uint32_t)) != 0
+        || memcmp(tap->index_counter, saved_counter, entries * sizeof(uint32_t)) != 0) {
+        printf("FAILED, index after recording differs from a fresh open\n");
+        failed = 1;
+    }
+    if (!failed) {
+        failed = tap_check_play(tap, version, c16);
+    }
+    datasette_test_set_image(NULL, -1);
+    tap_close(tap);
+
+    return failed;
+}
+
+int bench_test_tap(void)
+{
+    int version, c16, i;
+
+    archdep_mkdir(APP_DATA_DIR, 0755);
+
+    for (version = 0; version <= 2; version++) {
+        for (c16 = 0; c16 <= 1; c16++) {
+            unsigned long pulses = 0;
+
+            for (i = 0; i < TAP_TEST_IMAGES; i++) {
+                if (tap_test_image(version, c16, &pulses)) {
+                    printf("FAILED, version %d image %d as %s\n",
+                           version, i, c16 ? "C16" : "C64");
+                    remove(TAP_TEST_FILE);
+                    return 1;
+                }
+            }
+
+            printf("tap: v%d as %s, %d images, %lu pulses, ok\n",
+                   version, c16 ? "C16" : "C64", TAP_TEST_IMAGES, pulses);
+        }
+    }
+
+    remove(TAP_TEST_FILE);
+    return 0;
+}
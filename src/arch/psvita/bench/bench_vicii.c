@@ -0,0 +1,198 @@
+/*
+ * bench_vicii.c - VIC-II line renderer test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The text and bitmap modes of vicii-draw.c are drawn from random line
+   data with the plain loops and with SIMD, over every range of characters,
+   from the VIC-II state and from the raster cache.  The pixels and the
+   graphics mask must be the same, including the bytes outside the range,
+   which must be left alone.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "raster-cache.h"
+#include "types.h"
+#include "vicii-draw.h"
+#include "viciitypes.h"
+
+#include "bench.h"
+
+#define VICII_TEST_ROUNDS 40
+
+/* Room for a line of pixels, and a guard on each side.  */
+#define VICII_TEST_GUARD 32
+#define VICII_TEST_LINE (VICII_TEST_GUARD + VICII_SCREEN_XPIX + VICII_TEST_GUARD)
+
+static uint8_t chargen[0x800];
+static uint8_t bitmap_low[0x1000];
+static uint8_t bitmap_high[0x1000];
+
+static void vicii_fill(uint8_t *p, size_t size, unsigned int n)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        p[i] = (uint8_t)bench_random(n);
+    }
+}
+
+/* Random line data, as it is in the VIC-II state and in the cache: colours
+   are 4 bit values, the extended colour index of the cache is 2 bits.  */
+static void vicii_random_line(raster_cache_t *cache)
+{
+    int i;
+
+    vicii_fill(chargen, sizeof(chargen), 0x100);
+    vicii_fill(bitmap_low, sizeof(bitmap_low), 0x100);
+    vicii_fill(bitmap_high, sizeof(bitmap_high), 0x100);
+
+    vicii.chargen_ptr = chargen;
+    vicii.bitmap_low_ptr = bitmap_low;
+    vicii.bitmap_high_ptr = bitmap_high;
+    vicii.memptr = (int)bench_random(0x400);
+    vicii.raster.ycounter = bench_random(8);
+    vicii.raster.background_color = (uint8_t)bench_random(16);
+    for (i = 0; i < 3; i++) {
+        vicii.ext_background_color[i] = (int)bench_random(16);
+    }
+    vicii_fill(vicii.vbuf, VICII_SCREEN_TEXTCOLS, 0x100);
+    vicii_fill(vicii.cbuf, VICII_SCREEN_TEXTCOLS, 16);
+
+    vicii_fill(cache->foreground_data, RASTER_CACHE_MAX_TEXTCOLS, 0x100);
+    vicii_fill(cache->background_data, RASTER_CACHE_MAX_TEXTCOLS, 0x100);
+    cache->background_data[0] &= 0x0f;
+    vicii_fill(cache->color_data_1, RASTER_CACHE_MAX_TEXTCOLS, 0x100);
+    cache->color_data_1[0] &= 0x0f;
+    cache->color_data_1[1] &= 0x0f;
+    vicii_fill(cache->color_data_2, RASTER_CACHE_MAX_TEXTCOLS, 16);
+    vicii_fill(cache->color_data_3, RASTER_CACHE_MAX_TEXTCOLS, 16);
+}
+
+/* The colours of the text modes are 4 bit values.  */
+static void vicii_text_colors(const char *name, raster_cache_t *cache)
+{
+    int i;
+
+    if (strstr(name, "text") == NULL) {
+        return;
+    }
+
+    for (i = 0; i < RASTER_CACHE_MAX_TEXTCOLS; i++) {
+        cache->color_data_1[i] &= 0x0f;
+        if (strcmp(name, "ext text") == 0) {
+            cache->color_data_3[i] &= 0x03;
+        }
+    }
+}
+
+static int vicii_check(const char *name, const char *what, unsigned int xs,
+                       unsigned int xe, const uint8_t *line_ref,
+                       const uint8_t *line, const uint8_t *msk_ref,
+                       const uint8_t *msk)
+{
+    if (memcmp(line_ref, line, VICII_TEST_LINE) != 0) {
+        printf("FAILED, %s %s: pixels differ for characters %u-%u\n",
+               name, what, xs, xe);
+        return 1;
+    }
+    if (memcmp(msk_ref, msk, RASTER_CACHE_GFX_MSK_SIZE) != 0) {
+        printf("FAILED, %s %s: mask differs for characters %u-%u\n",
+               name, what, xs, xe);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int vicii_test_mode(const vicii_draw_test_t *test, unsigned long *ranges)
+{
+    static uint8_t line_ref[VICII_TEST_LINE], line[VICII_TEST_LINE];
+    static uint8_t msk_ref[RASTER_CACHE_GFX_MSK_SIZE], msk[RASTER_CACHE_GFX_MSK_SIZE];
+    static raster_cache_t cache_ref, cache;
+    unsigned int xs, xe;
+
+    vicii_random_line(&cache_ref);
+    vicii_text_colors(test->name, &cache_ref);
+
+    for (xs = 0; xs < VICII_SCREEN_TEXTCOLS; xs++) {
+        for (xe = xs; xe < VICII_SCREEN_TEXTCOLS; xe++) {
+            vicii_fill(line_ref, sizeof(line_ref), 0x100);
+            memcpy(line, line_ref, sizeof(line));
+            vicii_fill(msk_ref, sizeof(msk_ref), 0x100);
+            memcpy(msk, msk_ref, sizeof(msk));
+
+            test->draw(line_ref + VICII_TEST_GUARD, xs, xe, msk_ref);
+            test->draw_simd(line + VICII_TEST_GUARD, xs, xe, msk);
+            if (vicii_check(test->name, "line", xs, xe, line_ref, line, msk_ref, msk)) {
+                return 1;
+            }
+
+            vicii_fill(line_ref, sizeof(line_ref), 0x100);
+            memcpy(line, line_ref, sizeof(line));
+            vicii_fill(msk_ref, sizeof(msk_ref), 0x100);
+            memcpy(msk, msk_ref, sizeof(msk));
+            memcpy(&cache, &cache_ref, sizeof(cache));
+            cache_ref.gfx_msk = msk_ref;
+            cache.gfx_msk = msk;
+
+            test->draw_cached(line_ref + VICII_TEST_GUARD, xs, xe, &cache_ref);
+            test->draw_cached_simd(line + VICII_TEST_GUARD, xs, xe, &cache);
+            if (vicii_check(test->name, "cached line", xs, xe, line_ref, line, msk_ref, msk)) {
+                return 1;
+            }
+
+            (*ranges)++;
+        }
+    }
+
+    return 0;
+}
+
+int bench_test_vicii(void)
+{
+    const vicii_draw_test_t *tests;
+    int num_tests, i, round;
+
+    num_tests = vicii_draw_get_tests(&tests);
+    if (num_tests == 0) {
+        printf("vicii: built without SIMD, nothing to compare\n");
+        return 0;
+    }
+
+    for (i = 0; i < num_tests; i++) {
+        unsigned long ranges = 0;
+
+        for (round = 0; round < VICII_TEST_ROUNDS; round++) {
+            if (vicii_test_mode(&tests[i], &ranges)) {
+                return 1;
+            }
+        }
+
+        printf("vicii: %-12s %lu ranges, cached and uncached, ok\n",
+               tests[i].name, ranges);
+    }
+
+    return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * bench_zfile.c - Files in memory test.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* A random image is put in memory with zfile_memory_add(), in place of a
+   stand-in file, as the Vita app does with the images it unzips.  Then it
+   is opened with zfile_fopen() and closed again many times: read only,
+   for writing without a write, with writes into the image, past its end
+   with a gap, and in append mode.  What is read must match the image; a
+   stream that wrote must leave the image written to the file when it is
+   closed, grown where it was written past the end, and a stream that did
+   not write must leave the stand-in file alone.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "lib.h"
+#include "types.h"
+#include "zfile.h"
+
+#include "bench.h"
+
+#define ZFILE_TEST_ROUNDS       200
+#define ZFILE_TEST_SIZE         174848  /* A D64 of 35 tracks.  */
+#define ZFILE_TEST_MAX_WRITE    4096
+#define ZFILE_TEST_MAX_SIZE     (ZFILE_TEST_SIZE + ZFILE_TEST_ROUNDS * 2 * ZFILE_TEST_MAX_WRITE)
+
+#define ZFILE_TEST_FILE APP_DATA_DIR "bench-test.d64"
+
+/* The stand-in file, put back before each round.  */
+static const char stand_in[] = "stand-in";
+
+static uint8_t image[ZFILE_TEST_MAX_SIZE];
+static uint8_t buffer[ZFILE_TEST_MAX_SIZE];
+static size_t image_size;
+
+static int zfile_put_stand_in(void)
+{
+    FILE *fd = fopen(ZFILE_TEST_FILE, MODE_WRITE);
+    int ok;
+
+    if (fd == NULL) {
+        printf("FAILED, cannot write `%s'\n", ZFILE_TEST_FILE);
+        return 1;
+    }
+    ok = (fwrite(stand_in, sizeof(stand_in), 1, fd) == 1);
+    if (fclose(fd) != 0 || !ok) {
+        printf("FAILED, cannot write `%s'\n", ZFILE_TEST_FILE);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* The file must hold `size' bytes of `data'.  */
+static int zfile_check_file(const char *what, const void *data, size_t size)
+{
+    FILE *fd = fopen(ZFILE_TEST_FILE, MODE_READ);
+    size_t n;
+
+    if (fd == NULL) {
+        printf("FAILED, %s: cannot read `%s'\n", what, ZFILE_TEST_FILE);
+        return 1;
+    }
+    n = fread(buffer, 1, sizeof(buffer), fd);
+    fclose(fd);
+
+    if (n != size || memcmp(buffer, data, size) != 0) {
+        printf("FAILED, %s: the file holds %lu bytes, %lu expected%s\n",
+               what, (unsigned long)n, (unsigned long)size,
+               n == size ? ", which differ" : "");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Read the whole image through `stream'.  */
+static int zfile_check_read(const char *what, FILE *stream)
+{
+    size_t n;
+
+    if (fseek(stream, 0, SEEK_END) != 0 || ftell(stream) != (long)image_size) {
+        printf("FAILED, %s: stream size %ld, %lu expected\n",
+               what, ftell(stream), (unsigned long)image_size);
+        return 1;
+    }
+    rewind(stream);
+    n = fread(buffer, 1, sizeof(buffer), stream);
+    if (n != image_size || memcmp(buffer, image, image_size) != 0) {
+        printf("FAILED, %s: %lu bytes read, %lu expected%s\n",
+               what, (unsigned long)n, (unsigned long)image_size,
+               n == image_size ? ", which differ" : "");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Write random bytes at `pos' of the stream and of the image.  */
+static int zfile_write(const char *what, FILE *stream, size_t pos, int append)
+{
+    size_t size = 1 + bench_random(ZFILE_TEST_MAX_WRITE);
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        buffer[i] = (uint8_t)bench_random(256);
+    }
+
+    if (fseek(stream, (long)pos, SEEK_SET) != 0) {
+        printf("FAILED, %s: cannot seek to %lu\n", what, (unsigned long)pos);
+        return 1;
+    }
+    /* Append mode writes at the end wherever the stream was.  */
+    if (append) {
+        pos = image_size;
+    }
+    if (fwrite(buffer, 1, size, stream) != size) {
+        printf("FAILED, %s: cannot write %lu bytes at %lu\n",
+               what, (unsigned long)size, (unsigned long)pos);
+        return 1;
+    }
+
+    if (pos > image_size) {
+        memset(image + image_size, 0, pos - image_size);
+    }
+    memcpy(image + pos, buffer, size);
+    if (image_size < pos + size) {
+        image_size = pos + size;
+    }
+
+    return 0;
+}
+
+static int zfile_round(unsigned long *written)
+{
+    static const char * const names[] = {
+        "read only", "no write", "write", "write past the end", "append"
+    };
+    unsigned int op = bench_random(5);
+    const char *what = names[op];
+    FILE *stream;
+    int failed;
+
+    if (zfile_put_stand_in()) {
+        return 1;
+    }
+
+    stream = zfile_fopen(ZFILE_TEST_FILE, op == 0 ? MODE_READ
+                         : op == 4 ? MODE_APPEND_READ_WRITE : MODE_READ_WRITE);
+    if (stream == NULL) {
+        printf("FAILED, %s: cannot open `%s'\n", what, ZFILE_TEST_FILE);
+        return 1;
+    }
+
+    failed = zfile_check_read(what, stream);
+    if (!failed) {
+        switch (op) {
+            case 2:
+                failed = zfile_write(what, stream, bench_random((unsigned int)image_size), 0);
+                break;
+            case 3:
+                failed = zfile_write(what, stream, image_size + bench_random(ZFILE_TEST_MAX_WRITE), 0);
+                break;
+            case 4:
+                failed = zfile_write(what, stream, bench_random((unsigned int)image_size), 1);
+                break;
+        }
+    }
+    if (!failed && op >= 2) {
+        failed = zfile_check_read(what, stream);
+    }
+
+    if (zfile_fclose(stream) != 0) {
+        printf("FAILED, %s: cannot close `%s'\n", what, ZFILE_TEST_FILE);
+        return 1;
+    }
+    if (failed) {
+        return 1;
+    }
+
+    if (op >= 2) {
+        (*written)++;
+        return zfile_check_file(what, image, image_size);
+    }
+    return zfile_check_file(what, stand_in, sizeof(stand_in));
+}
+
+int bench_test_zfile(void)
+{
+    unsigned long written = 0;
+    uint8_t *data;
+    int i, failed = 0;
+
+    archdep_mkdir(APP_DATA_DIR, 0755);
+
+    image_size = ZFILE_TEST_SIZE;
+    for (i = 0; i < (int)image_size; i++) {
+        image[i] = (uint8_t)bench_random(256);
+    }
+
+    if (zfile_put_stand_in()) {
+        return 1;
+    }
+    data = lib_malloc(image_size);
+    memcpy(data, image, image_size);
+    if (zfile_memory_add(ZFILE_TEST_FILE, data, image_size) < 0) {
+        lib_free(data);
+        printf("zfile: built without memory streams, nothing to compare\n");
+        return 0;
+    }
+
+    for (i = 0; i < ZFILE_TEST_ROUNDS && !failed; i++) {
+        failed = zfile_round(&written);
+    }
+    zfile_memory_remove(ZFILE_TEST_FILE);
+
+    if (!failed) {
+        printf("zfile: %d opens, %lu written back, image grown to %lu bytes, ok\n",
+               ZFILE_TEST_ROUNDS, written, (unsigned long)image_size);
+    }
+    return failed;
+}
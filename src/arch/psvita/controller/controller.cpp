@@ -65,6 +65,8 @@ extern "C" {
 #include "kbdbuf.h"
 #include "maincpu.h"
 #include "t64.h"
+#include "frameprof.h"
+#include "rewind.h"
 }
 
 #include <cstring>
@@ -87,6 +89,17 @@ extern "C" void PSV_UpdateView()
 	gs_frameDrawn = true;
 }
 
+extern "C" void PSV_UpdateViewLines(const uint32_t* dirty_lines, unsigned int num_lines)
+{
+	// Nothing visible changed. Leave gs_frameDrawn alone so that pending
+	// statusbar/keyboard changes still get drawn after the scan.
+	if (!gs_view->isViewDirty(dirty_lines, num_lines))
+		return;
+
+	gs_view->updateView();
+	gs_frameDrawn = true;
+}
+
 extern "C" void PSV_SetViewport(int x, int y, int width, int height)
 {
 	// Make sure we stay borderless when e.g. changing video standard.
@@ -121,6 +134,11 @@ extern "C" void PSV_ScanControls()
 
 	gs_view->scanControls(maps, &size, gs_scanMouse);
 
+	// Feed the profiler graph. The frame number tells repeated scans apart.
+	const frameprof_frame_t* frame = frameprof_get_last_frame();
+	if (frame)
+		gs_view->setFrameProfile(frame);
+
 	for (int i=0; i<size; ++i){
 		ControlPadMap* map = maps[i];
 		
@@ -140,8 +158,8 @@ extern "C" void PSV_ScanControls()
 			continue;
 		}
 
-		// Button releases can be ignored for all special commands except autofire.
-		if (!map->ispress && map->mid != 136) 
+		// Button releases can be ignored for all special commands except autofire and rewind.
+		if (!map->ispress && map->mid != 136 && map->mid != 139) 
 			continue;
 
 		// Special commands
@@ -150,6 +168,7 @@ extern "C" void PSV_ScanControls()
 			if (ui_emulation_is_paused()){
 				// We can show menu right away. No need to trigger trap if in pause state
 				// and the sound buffer is already silenced.
+				gs_rewindHeld = false;
 				gs_view->activateMenu();
 				setSoundVolume(100); 
 				break;
@@ -195,6 +214,9 @@ extern "C" void PSV_ScanControls()
 		case 138: // Show/hide status bar
 			gs_view->toggleStatusbarOnView();
 			break;
+		case 139: // Rewind while held
+			setPendingAction(map->ispress? CTRL_ACTION_REWIND_START: CTRL_ACTION_REWIND_STOP);
+			break;
 		default:
 			break;
 		}
@@ -224,7 +246,7 @@ extern "C" void PSV_ScanControls()
 
 extern "C" void PSV_ApplySettings()
 {
-	// Disable CRT emulation.
+	// Disable CRT emulation. The CRT emulation setting turns it on again.
 	resources_set_int(VICE_RES_VICII_FILTER, 0); 
 
 	// Enable general mechanisms for fast disk/tape emulation.
@@ -234,6 +256,10 @@ extern "C" void PSV_ApplySettings()
 	// Any other value brings the emulation to almost complete standstill.
 	resources_set_int(VICE_RES_SID_RESID_SAMPLING, 0);
 
+	// Let the sound buffer pace the emulation. sceKernelDelayThread oversleeps,
+	// which makes timer based pacing stutter and underrun the sound.
+	resources_set_int(VICE_RES_VSYNC_PACING, VSYNC_PACING_AUDIO);
+
 	// Activate/deactivate drives. Every drive eats resources so its better to start with only one active.
 	// 1542 = CBM 1541-II
 	resources_set_int("Drive8Type", 1542);
@@ -272,6 +298,11 @@ extern "C" void PSV_NotifyFPS(int fps, float percent, int warp_flag)
 	gs_view->setFPSCount(fps, (int)percent, warp_flag);
 }
 
+extern "C" void PSV_NotifySoundXruns(unsigned int underruns, unsigned int overruns)
+{
+	gs_view->setSoundXruns(underruns, overruns);
+}
+
 extern "C" void	PSV_NotifyTapeCounter(int counter)
 {
 	gs_view->setTapeCounter(counter);
@@ -279,6 +310,12 @@ extern "C" void	PSV_NotifyTapeCounter(int counter)
 
 extern "C" void	PSV_NotifyTapeControl(int control)
 {	
+	// Warp for fast forward and rewind ends when the tape stops winding.
+	if (gs_tapeWarp && control != DATASETTE_CONTROL_FORWARD && control != DATASETTE_CONTROL_REWIND){
+		gs_tapeWarp = false;
+		resources_set_int(VICE_RES_WARP_MODE, 0);
+	}
+
 	// We can ignore T64 files here. Tape control status only works correctly with TAP files.
 	if (isTapOnTape()){
 		gs_view->setTapeControl(control);
@@ -387,6 +424,9 @@ int Controller::loadFile(int load_type, const char* file, int index)
 				resources_set_int(VICE_RES_CARTRIDGE_RESET, 1);
 		}
 	
+		// Don't rewind back into the previous game.
+		rewind_reset();
+
 		ret = autostart_autodetect(image_file, NULL, index, AUTOSTART_MODE_RUN);
 
 		// Restore old value.
@@ -537,6 +577,8 @@ int Controller::loadState(const char* file)
 	if (file_name)
 		cartridge = file_name;
 
+	rewind_reset();
+
 	int ret = machine_read_snapshot((char*)file, 0);
 	
 	if (!cartridge.empty()){
@@ -554,7 +596,7 @@ int Controller::loadState(const char* file)
 	return ret;
 }
 
-int Controller::saveState(const char* file_name)
+int Controller::saveState(const char* file_name, patch_data_s* patches, int num_patches)
 {
 	// Saving a state when a tap file is attached to the datasette can be problematic.
 	// The snapshot sometimes "remembers" the tape and won't start without it.
@@ -582,70 +624,57 @@ int Controller::saveState(const char* file_name)
 		goto case_exception; // Disk or cartridge
 
 case_normal:
-	return machine_write_snapshot(file_name, 0, 0, 0);
+	return writeSnapshot(file_name, patches, num_patches);
 
 case_exception:
 	tape_image_detach(1);
-	int ret = machine_write_snapshot(file_name, 0, 0, 0);
+	int ret = writeSnapshot(file_name, patches, num_patches);
 	tape_image_attach(1, attached_image_file.c_str());
 	return ret;
 }
 
-int Controller::patchSaveState(patch_data_s* patch)
+int Controller::writeSnapshot(const char* file_name, patch_data_s* patches, int num_patches)
 {
-	if (!patch || !patch->snapshot_file || !patch->data)
-		return -1;
-	
-	FILE *fp;
+	// The snapshot is built in memory and written to the file in one go when closed.
+	// Our own modules (thumbnail, settings) are added to the same snapshot as a dword
+	// data size followed by the data, so the file is not opened again to append them.
+
+	snapshot_t* snapshot = machine_snapshot_create(file_name, NULL);
 
-	if (!(fp = fopen(patch->snapshot_file, "a+"))){
+	if (!snapshot)
 		return -1;
+
+	if (machine_write_snapshot_modules(snapshot, 0, 0, 0) < 0)
+		goto fail;
+
+	for (int i = 0; i < num_patches; ++i){
+		snapshot_module_t* module = snapshot_module_create(snapshot, 
+														   patches[i].module_name, 
+														   patches[i].major, 
+														   patches[i].minor);
+		if (!module)
+			goto fail;
+
+		if (snapshot_module_write_dword(module, patches[i].data_size) < 0
+			|| snapshot_module_write_byte_array(module, (const uint8_t*)patches[i].data, patches[i].data_size) < 0){
+			snapshot_module_close(module);
+			goto fail;
+		}
+
+		snapshot_module_close(module);
 	}
 
-	// We can't add a module to a snapshot without changing code in Vice.
-	// Workaround is to append a byte chunk to the snapshot file that is in right format.
-	// Vice will happily accept it.
-	
-	// Vice snapshot module format:
-	// Header:                 
-	// Name (16 bytes)        
-	// Major version (1 byte) 
-	// Minor version (1 byte1)	  
-	// Size of module (4 bytes)   
-	// Data: (Any number of fields. We use two, dword and byte array)
-	// Data size (4 bytes)		 
-	// Data  (n bytes)           
-
-	int module_size = 16 + 1 + 1 + 4 + 4 + patch->data_size;
-	char* buf = new char[module_size];
-
-	char name[16] = {0};
-
-	if (patch->module_name)
-		strncpy(name, patch->module_name, 16);
-
-	// Header
-	memcpy(buf, name, 16);
-	buf[16] = patch->major;
-	buf[17] = patch->minor;
-	buf[18] = module_size;
-	buf[19] = module_size >> 8;
-	buf[20] = module_size >> 16;
-	buf[21] = module_size >> 24;
-	// Data
-	buf[22] = patch->data_size;
-	buf[23] = patch->data_size >> 8;
-	buf[24] = patch->data_size >> 16;
-	buf[25] = patch->data_size >> 24;
-	memcpy(&buf[26], patch->data, patch->data_size);
-	
-	if (fwrite(buf, 1, module_size, fp) < 1) {
-		fclose(fp);
-        return -1;
-    }
+	if (snapshot_close(snapshot) < 0){
+		FileExplorer::getInst()->deleteFile(file_name);
+		return -1;
+	}
 
-	fclose(fp);
 	return 0;
+
+fail:
+	snapshot_close(snapshot);
+	FileExplorer::getInst()->deleteFile(file_name);
+	return -1;
 }
 
 int	Controller::getSaveStatePatch(patch_data_s* pinfo)
@@ -658,8 +687,8 @@ int	Controller::getSaveStatePatch(patch_data_s* pinfo)
 	// Reading our patch module is best done by using the snapshot api.
 	// This way we don't have to remember the file offset to our data.
 
-	// First we need to open the snapshot.
-	snapshot = snapshot_open(pinfo->snapshot_file, &major_version, &minor_version, machine_get_name());
+	// First we need to open the snapshot. Only the table of contents and our module are read from the file.
+	snapshot = snapshot_open_lazy(pinfo->snapshot_file, &major_version, &minor_version, machine_get_name());
 	
 	if (!snapshot){
 		return -1;
@@ -683,6 +712,13 @@ int	Controller::getSaveStatePatch(patch_data_s* pinfo)
 		return -1;
 	}
 
+	// Allocate the data if the caller didn't. One more byte for null character. Remember to deallocate.
+	if (!pinfo->data){
+		char* data = new char[pinfo->data_size + 1];
+		data[pinfo->data_size] = '\0';
+		pinfo->data = data;
+	}
+
 	// Read the byte array.
 	snapshot_module_read_byte_array(patch_module,
                                     (uint8_t*)pinfo->data, 
@@ -702,7 +738,7 @@ int	Controller::getSaveStatePatchInfo(patch_data_s* pinfo)
 	snapshot_t* snapshot;
 	snapshot_module_t* patch_module;
 
-	snapshot = snapshot_open(pinfo->snapshot_file, &major_version, &minor_version, machine_get_name());
+	snapshot = snapshot_open_lazy(pinfo->snapshot_file, &major_version, &minor_version, machine_get_name());
 	
 	if (!snapshot){
 		return -1;
@@ -956,6 +992,42 @@ Commented out because lack of testing.
 //	}	
 //}
 
+void Controller::setFrameProfiler(const char* val)
+{
+	// "Graph" only shows the profiler graph. "Graph + CSV" also writes every frame to a file.
+
+	int enable = strcmp(val, "Off")? 1: 0;
+	int csv = strcmp(val, "Graph + CSV")? 0: 1;
+
+	resources_set_string(VICE_RES_FRAME_PROFILE_FILE, csv? FRAME_PROFILE_FILE_PATH: "");
+	resources_set_int(VICE_RES_FRAME_PROFILE, enable);
+}
+
+void Controller::setRewind(const char* val)
+{
+	// While enabled, a snapshot of the machine is kept every few frames. Holding the
+	// mapped "Rewind" button steps back through them.
+
+	resources_set_int(VICE_RES_REWIND, strcmp(val, "Off")? 1: 0);
+}
+
+void Controller::setRunAhead(const char* val)
+{
+	// Every displayed frame is emulated this many frames ahead and then rolled back,
+	// so that the game reacts to input earlier. Costs one extra frame of emulation per
+	// frame ahead.
+
+	resources_set_int(VICE_RES_RUNAHEAD, atoi(val));
+}
+
+void Controller::setDriveThread(const char* val)
+{
+	// Runs the 1541 on another core. Only used while no drive idles and drive sound
+	// is off, otherwise the drive keeps running on the emulation thread.
+
+	resources_set_int(VICE_RES_DRIVE_THREAD, strcmp(val, "Off")? 1: 0);
+}
+
 void Controller::setJoystickAutofireSpeed(const char* val)
 {
 	// We toggle joystick fire by using modulo function: frame counter % divider.
@@ -985,12 +1057,26 @@ void Controller::setViciiModel(const char* val)
 	resources_set_int(VICE_RES_MACHINE_VIDEO_STANDARD, value); 
 }
 
-void Controller::setCrtEmulation()
+void Controller::setCrtEmulation(const char* val)
+{
+	// The VICE PAL/CRT renderers draw the frames of the View from the indexed draw 
+	// buffer. The VIC-II keeps drawing at single size, so no double scan/size.
+
+	int mode = PSV_CRT_OFF;
+
+	if (!strcmp(val, "PAL"))
+		mode = PSV_CRT_PAL;
+	else if (!strcmp(val, "Scanlines"))
+		mode = PSV_CRT_SCANLINES;
+
+	// Crt emulation 0=off, 1=on. The renderers only blur with it on.
+	resources_set_int(VICE_RES_VICII_FILTER, (mode != PSV_CRT_OFF)? 1: 0); 
+	video_psv_set_crt_emulation(mode);
+}
+
+void Controller::renderCrtFrame(unsigned char* pixels, int pitch, int x, int y, int width, int height)
 {
-	resources_set_int(VICE_RES_VICII_DOUBLE_SCAN, 1);
-	resources_set_int(VICE_RES_VICII_DOUBLE_SIZE, 1);
-	// Crt emulation (scan lines) 0=off, 1=on
-	resources_set_int(VICE_RES_VICII_FILTER, 1); 
+	video_psv_render_frame(pixels, pitch, x, y, width, height);
 }
 
 void Controller::setColorPalette(const char* val)
@@ -1570,10 +1656,15 @@ int Controller::getImageType(const char* image)
 void Controller::setTapeControl(int action)
 {
 	switch (action){
-	case DATASETTE_CONTROL_STOP:
-	case DATASETTE_CONTROL_START:
+	// Winding the tape in real time takes up to a few minutes. Wind it at warp speed
+	// until it stops, so that it can still be stopped anywhere on the way.
 	case DATASETTE_CONTROL_FORWARD:
 	case DATASETTE_CONTROL_REWIND:
+		datasette_control(action);
+		startTapeWarp();
+		break;
+	case DATASETTE_CONTROL_STOP:
+	case DATASETTE_CONTROL_START:
 	case DATASETTE_CONTROL_RECORD:
 	case DATASETTE_CONTROL_RESET:
 	case DATASETTE_CONTROL_RESET_COUNTER:
@@ -1722,6 +1813,18 @@ static void toggleWarpMode()
 
 	value = value? 0:1;
 	resources_set_int(VICE_RES_WARP_MODE, value);
+	gs_tapeWarp = false; // The user's choice stays after the tape stops winding.
+}
+
+static void startTapeWarp()
+{
+	int value;
+	// Only a TAP image winds. Warp that is already on is left to the user.
+	if (!isTapOnTape() || resources_get_int(VICE_RES_WARP_MODE, &value) < 0 || value)
+		return;
+
+	resources_set_int(VICE_RES_WARP_MODE, 1);
+	gs_tapeWarp = true;
 }
 
 static void	checkPendingActions()
@@ -1729,9 +1832,18 @@ static void	checkPendingActions()
 	// Check for pending actions. This function is called at the end of each screen frame. 
 	// That's every 20ms in PAL standard and every 16ms in NTSC standard.
 	
+	// Rewind follows the button, but stops for the menu and the pause. This goes first
+	// because the timers below return early.
+	bool rewind = gs_rewindHeld && !gs_showMenuTimer && !gs_pauseTimer && !ui_emulation_is_paused();
+	if (rewind != (rewind_is_active() != 0))
+		rewind_set_active(rewind);
+
 	if (gs_showMenuTimer > 0){
-		if (--gs_showMenuTimer == 0)
+		if (--gs_showMenuTimer == 0){
+			// The button release is not seen while the menu is up.
+			gs_rewindHeld = false;
 			video_psv_menu_show();
+		}
 	}
 	if (gs_pauseTimer > 0){
 		if (--gs_pauseTimer != 0) return;
@@ -1876,6 +1988,11 @@ static void setPendingAction(ctrl_pending_action_e action)
 	// location after the Autoload-operation. This way we will have a new location only when loading a new game.
 	// To achieve this we will have to know what's going on the screen. If we can identify a "READY." text
 	// followed by a blinking cursor we know that we have loaded a program to the computer.
+	//
+	// Rewind:
+	// The button only sets the wanted state, checkPendingActions() starts and stops rewinding at
+	// the end of the frame. Rewinding is held back while the menu or the pause is pending, and
+	// the hold is dropped when the menu opens because the release is not seen there.
 	
 	switch (action){
 
@@ -1937,6 +2054,12 @@ static void setPendingAction(ctrl_pending_action_e action)
 			gs_scanScreenReadyTimer = 50;
 		}
 		break;
+	case CTRL_ACTION_REWIND_START:
+		gs_rewindHeld = true;
+		break;
+	case CTRL_ACTION_REWIND_STOP:
+		gs_rewindHeld = false;
+		break;
 	}
 }
 
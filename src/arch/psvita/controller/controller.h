@@ -28,6 +28,7 @@
 // for gcc
 void		PSV_CreateView(int width, int height, int depth);
 void		PSV_UpdateView();
+void		PSV_UpdateViewLines(const uint32_t* dirty_lines, unsigned int num_lines);
 void		PSV_SetViewport(int x, int y, int width, int height);
 void		PSV_GetViewInfo(int* width, int* height, unsigned char** ppixels, int* pitch, int* bpp);
 void		PSV_ScanControls();
@@ -36,6 +37,7 @@ void		PSV_ActivateMenu();
 int			PSV_RGBToPixel(uint8_t r, uint8_t g, uint8_t b);
 void		PSV_NotifyPalette(unsigned char* palette, int size);
 void		PSV_NotifyFPS(int fps, float percent, int warp_flag);
+void		PSV_NotifySoundXruns(unsigned int underruns, unsigned int overruns);
 void		PSV_NotifyTapeCounter(int count);
 void		PSV_NotifyTapeControl(int control);
 void		PSV_NotifyDriveStatus(int drive, int led);
@@ -103,7 +105,6 @@ private:
 	void			setSidEngine(const char* val);
 	void			setSidModel(const char* val);
 	void			setViciiModel(const char* val);
-	void			setCrtEmulation();
 	void			setColorPalette(const char* val);
 	void			setJoystickPort(const char* val);
 	void			setDriveStatus(const char* val);
@@ -123,6 +124,7 @@ private:
 	void			detachDriveImage(int drive);
 	int				detachTapeImage();
 	void			detachCartridgeImage();
+	int				writeSnapshot(const char* file_name, patch_data_s* patches, int num_patches);
 
 public:
 					Controller();
@@ -132,8 +134,7 @@ public:
 	void			resetComputer();
 	int				loadFile(int load_type, const char* file_path, int index = 0);
 	int				loadState(const char* file);
-	int				saveState(const char* file_name);
-	int				patchSaveState(patch_data_s* patch);
+	int				saveState(const char* file_name, patch_data_s* patches = NULL, int num_patches = 0);
 	int				getSaveStatePatch(patch_data_s* patch_info);
 	int				getSaveStatePatchInfo(patch_data_s* patch_info);
 	int				getViewport(ViewPort* vp, bool borders);
@@ -147,6 +148,12 @@ public:
 	void			setCartControl(int action);
 	void			setBorderVisibility(const char* val);
 	void			setJoystickAutofireSpeed(const char* val);
+	void			setFrameProfiler(const char* val);
+	void			setRewind(const char* val);
+	void			setRunAhead(const char* val);
+	void			setDriveThread(const char* val);
+	void			setCrtEmulation(const char* val);
+	void			renderCrtFrame(unsigned char* pixels, int pitch, int x, int y, int width, int height);
 };
 
 
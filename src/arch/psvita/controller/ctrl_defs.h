@@ -12,7 +12,9 @@ enum ctrl_pending_action_e{
 	CTRL_ACTION_KBDCMD_RUN,
 	CTRL_ACTION_SCANSCR_PRESSPLAYONTAPE,
 	CTRL_ACTION_SCANSCR_LOADING,
-	CTRL_ACTION_SCANSCR_LOADING_READY
+	CTRL_ACTION_SCANSCR_LOADING_READY,
+	CTRL_ACTION_REWIND_START,
+	CTRL_ACTION_REWIND_STOP
 
 };
 
@@ -38,6 +40,8 @@ static int	  gs_deactivateDriveTimer = 0;
 static int    gs_scanScreenPressPlayTimer = 0;
 static int    gs_scanScreenLoadingTimer = 0;
 static int	  gs_scanScreenReadyTimer = 0;
+static bool	  gs_rewindHeld = false;
+static bool	  gs_tapeWarp = false;
 static bool   gs_scanMouse = false;
 static int	  gs_machineResetMode = 1;
 static string gs_loadProgramName;
@@ -45,6 +49,7 @@ int			  g_joystickPort = 2;
 
 static void	 toggleJoystickPorts();
 static void	 toggleWarpMode();
+static void	 startTapeWarp();
 static void	 setPendingAction(ctrl_pending_action_e);
 static void	 checkPendingActions();
 static void	 setSoundVolume(int);
@@ -40,8 +40,12 @@
 #include "resources.h"
 #include "controller.h"
 #include "debug_psv.h"
+#include "video-render.h"
 #include <string.h>
 
+// Worker threads that run the CRT/PAL filters besides the emulation thread.
+#define CRT_RENDER_THREADS		2
+
 
 static struct video_canvas_s*	activeCanvas = NULL;
 static float					last_framerate = 0;
@@ -49,6 +53,9 @@ static float					last_percent = 0;
 static int						last_warp_flag = 0;
 static int						drive_led_on = 0, tape_led_on = 0;
 static video_canvas_t*			active_canvas = NULL;
+static const uint32_t*			dirty_lines = NULL;
+static unsigned int				dirty_num_lines = 0;
+static int						crt_emulation = PSV_CRT_OFF;
 static void						pause_trap(uint16_t unused_addr, void *data); 
 static void						load_snapshot_trap(uint16_t addr, void *data);
 void							video_psv_menu_show();
@@ -198,16 +205,36 @@ void video_canvas_refresh(struct video_canvas_s *canvas,
                           unsigned int xi, unsigned int yi,
                           unsigned int w, unsigned int h)
 {
-	PSV_UpdateView();
+	// Without a dirty line bitmap (e.g. refresh_all) the whole view is redrawn.
+	if (dirty_lines)
+		PSV_UpdateViewLines(dirty_lines, dirty_num_lines);
+	else
+		PSV_UpdateView();
+
+	dirty_lines = NULL;
+}
+
+void video_arch_canvas_dirty_lines(struct video_canvas_s *canvas, const uint32_t *lines, unsigned int num_lines)
+{
+	// Only valid until the following video_canvas_refresh call.
+	dirty_lines = lines;
+	dirty_num_lines = num_lines;
 }
 
 int video_init()
 {
+	// The CRT/PAL renderers write RGB565 pixels.
+	unsigned int i;
+
+	for (i = 0; i < 256; i++)
+		video_render_setrawrgb(i, (i >> 3) << 11, (i >> 2) << 5, i >> 3);
+
 	return 0;
 }
 
 void video_shutdown()
 {
+	video_render_threads_shutdown();
 }
 
 int video_arch_cmdline_options_init(void)
@@ -232,6 +259,11 @@ void ui_display_speed(float percent, float framerate, int warp_flag)
 	last_framerate = framerate;
 	last_percent = percent;
 	last_warp_flag = warp_flag;
+
+	// Piggyback on the speed update to report sound buffer problems.
+	unsigned int underruns, overruns;
+	if (sound_get_xruns(&underruns, &overruns) == 0)
+		PSV_NotifySoundXruns(underruns, overruns);
 }
 
 void ui_display_drive_led(int drive_number, unsigned int led_pwm1, unsigned int led_pwm2)
@@ -302,3 +334,45 @@ void video_psv_get_canvas(struct video_canvas_s** canvas)
 {
 	*canvas = activeCanvas;
 }
+
+void video_psv_set_crt_emulation(int mode)
+{
+	// The filters are not applied to the draw buffer but to the frames the View presents
+	// (see video_psv_render_frame), so the VIC-II keeps drawing at single size.
+
+	crt_emulation = mode;
+	resources_set_int("RenderThreads", (mode != PSV_CRT_OFF)? CRT_RENDER_THREADS: 0);
+}
+
+void video_psv_render_frame(uint8_t* trg, int pitch, int x, int y, int width, int height)
+{
+	// Runs the VICE PAL renderer, or the CRT renderer with scanlines at double height, 
+	// over the viewport of the draw buffer. The target is a RGB565 frame that has the 
+	// viewport at the same position, with y doubled for scanlines.
+
+	video_render_config_t* config;
+	int scale_y;
+
+	if (!activeCanvas || crt_emulation == PSV_CRT_OFF)
+		return;
+
+	config = activeCanvas->videoconfig;
+
+	if (!config->color_tables.updated)
+		video_color_update_palette(activeCanvas);
+
+	// Our own render mode, not the one VICE picked for the VIC-II size.
+	if (crt_emulation == PSV_CRT_SCANLINES){
+		config->rendermode = VIDEO_RENDER_CRT_1X2;
+		scale_y = 2;
+	}
+	else{
+		config->rendermode = VIDEO_RENDER_PAL_1X1;
+		scale_y = 1;
+	}
+
+	video_render_threads_main(config, activeCanvas->draw_buffer->draw_buffer, trg, 
+							  width, height * scale_y, x, y, x, y * scale_y,
+							  activeCanvas->draw_buffer->draw_buffer_width, pitch, 16,
+							  activeCanvas->viewport);
+}
@@ -36,9 +36,26 @@ struct video_canvas_s {
 typedef struct video_canvas_s video_canvas_t;
 
 
+/* The raster code reports the changed frame buffer lines before each
+   refresh through video_arch_canvas_dirty_lines().  */
+#define VIDEO_ARCH_DIRTY_LINES
+
+extern void video_arch_canvas_dirty_lines(struct video_canvas_s *canvas,
+                                          const uint32_t *lines,
+                                          unsigned int num_lines);
+
 extern void video_psv_ui_init_finalize(void);
 extern void video_psv_menu_show(void);
 extern void video_psv_update_palette(void);
 extern void video_psv_get_canvas(struct video_canvas_s** canvas);
 
+/* CRT emulation modes.  The filters are run on the RGB565 frames of the
+   View, the draw buffer stays 8 bit indexed.  */
+#define PSV_CRT_OFF         0
+#define PSV_CRT_PAL         1   /* PAL blur and delay line */
+#define PSV_CRT_SCANLINES   2   /* blur and scanlines, double height */
+
+extern void video_psv_set_crt_emulation(int mode);
+extern void video_psv_render_frame(uint8_t *trg, int pitch, int x, int y, int width, int height);
+
 #endif
@@ -3,7 +3,10 @@
 #define APP_DEFS_H
 
 #define APP_NAME							"VICEVita"
+// The host benchmark build points these to its own directories.
+#ifndef APP_DATA_DIR
 #define	APP_DATA_DIR						"ux0:data/vicevita/" 
+#endif
 #define GAME_DIR APP_DATA_DIR				"games/"
 #define SAVE_DIR APP_DATA_DIR				"saves/"
 #define VICE_DIR APP_DATA_DIR				"vice/"
@@ -15,12 +18,15 @@
 
 // ux0:app is not accessible by regular apps but they can access their own resources through app0:
 // which is mounted to point to their own directory and is also mounted as read only.
+#ifndef APP_RESOURCES
 #define APP_RESOURCES						"app0:/resources"
+#endif
 
 #define CONF_FILE_NAME						"config.ini"
 
 // Default configuration file
 #define DEF_CONF_FILE_PATH APP_DATA_DIR CONF_FILE_NAME
+#define FRAME_PROFILE_FILE_PATH APP_DATA_DIR "frameprof.csv"
 
 // Ini file strings
 #define INI_FILE_SEC_CONTROLS				"Controls"
@@ -49,11 +55,15 @@
 #define VICE_RES_SOUND_VOLUME				"SoundVolume"
 #define VICE_RES_CPU_SPEED					"Speed"
 #define VICE_RES_VICII_FILTER				"VICIIfilter"
-#define VICE_RES_VICII_DOUBLE_SCAN			"VICIIDoubleScan"
-#define VICE_RES_VICII_DOUBLE_SIZE			"VICIIDoubleSize"
 #define VICE_RES_VICII_EXTERNAL_PALETTE		"VICIIExternalPalette"
 #define VICE_RES_VIRTUAL_DEVICES			"VirtualDevices"
+#define VICE_RES_VSYNC_PACING				"VsyncPacing"
+#define VICE_RES_FRAME_PROFILE				"FrameProfile"
+#define VICE_RES_FRAME_PROFILE_FILE			"FrameProfileFile"
 #define VICE_RES_WARP_MODE					"WarpMode"
+#define VICE_RES_REWIND						"Rewind"
+#define VICE_RES_RUNAHEAD					"RunAhead"
+#define VICE_RES_DRIVE_THREAD				"DriveThread"
 
 // Settings/Peripherals entry id's
 #define KEYMAPS								1
@@ -89,6 +99,11 @@
 #define SETTINGS_VIEW						31
 #define SETTINGS_MODEL						32
 #define SETTINGS_MODEL_NOT_IN_SNAP			33
+#define FRAME_PROFILER						34
+#define REWIND								35
+#define RUNAHEAD							36
+#define DRIVE_THREAD						37
+#define CRT_EMULATION						38
 
 // Setting types
 #define ST_MODEL							1 
@@ -178,6 +178,7 @@ KeyIndex     | 0 | 1 | 2 | 3 | 4 | 5 | 6 | ... | 20 |
 			137	  = Reset
 			129   = Swap joysticks
 			130   = Warp mode
+			139   = Rewind (hold)
 			131   = Joystick up
 			132   = Joystick down
 			133   = Joystick left
@@ -25,6 +25,12 @@
 #include "debug_psv.h"
 #include "unzip.h"
 
+// C interface files. Tell g++ not to mangle symbols.
+extern "C" {
+#include "lib.h"
+#include "zfile.h"
+}
+
 #include <cstring>
 #include <algorithm> // std::find
 
@@ -94,10 +100,10 @@ const char* Extractor::extract(const char* archive_file, int drive)
 			int file_size = fi.uncompressed_size;
 		
 			if (file_size > 0 && 
-				image_type == IMAGE_DISK || 
+				(image_type == IMAGE_DISK || 
 				image_type == IMAGE_TAPE || 
 				image_type == IMAGE_CARTRIDGE || 
-				image_type == IMAGE_PROGRAM){
+				image_type == IMAGE_PROGRAM)){
 
 				// Supported file found. 
 				
@@ -106,7 +112,7 @@ const char* Extractor::extract(const char* archive_file, int drive)
 					goto error;
 				}
 
-				file_buffer = new char[file_size];
+				file_buffer = (char*)lib_malloc(file_size);
 				
 				// We read the file in one go.
 				// Perhaps this should be read in a loop with smaller buffer size.
@@ -122,13 +128,25 @@ const char* Extractor::extract(const char* archive_file, int drive)
 
 				tmp_files.push_back(image_save_path);
 
+				// Disk and tape images are attached straight from the buffer. Only an empty
+				// file is created, so that the image can still be selected when changing disks.
+				// The core writes the image to it if it is changed.
+				bool in_memory = false;
+				if (image_type == IMAGE_DISK || image_type == IMAGE_TAPE){
+					if (zfile_memory_add(image_save_path.c_str(), (uint8_t*)file_buffer, file_size) == 0){
+						// The buffer belongs to the core now.
+						file_buffer = NULL;
+						in_memory = true;
+					}
+				}
+
 				// Create image file from the buffer data.
 				FILE* fd = fopen(image_save_path.c_str(), "w");
 				if (!fd){
 					goto error;
 				}
 				
-				if (fwrite(file_buffer, 1, file_size, fd) < file_size){
+				if (!in_memory && fwrite(file_buffer, 1, file_size, fd) < file_size){
 					fclose(fd);
 					goto error;
 				}
@@ -140,7 +158,7 @@ const char* Extractor::extract(const char* archive_file, int drive)
 					goto error;
 				}
 
-				delete[] file_buffer;
+				lib_free(file_buffer);
 				file_buffer = NULL;
 			}
 	
@@ -190,7 +208,7 @@ error:
 		unzClose(zipfile);
 
 	if (file_buffer)
-		delete[] file_buffer;
+		lib_free(file_buffer);
 
 	// All or nothing approach used here. Function fails on single error.
 	// Delete the files that succeeded to extract.
@@ -314,6 +332,7 @@ void Extractor::deleteTrackedFiles(vector<string>& old_files, vector<string>* ne
 				continue;
 		}
 
+		zfile_memory_remove((*it).c_str());
 		FileExplorer::getInst()->deleteFile((*it).c_str());
 	}
 }
\ No newline at end of file
@@ -115,6 +115,8 @@ void Navigator::scanCyclic()
 		} 
 
 		m_prevJoystickBits = curr_joystick_bits;
+
+		scanUpdate();
 	}
 }
 
@@ -52,6 +52,7 @@ private:
 	virtual void    buttonPressed(int button){};
 	virtual void    buttonReleased(int button){};
 	virtual bool	isExit(int buttons){return false;};
+	virtual void	scanUpdate(){}; // Called once per scan (frame) for work not driven by input.
 	
 
 protected:
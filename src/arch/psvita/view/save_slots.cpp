@@ -36,11 +36,52 @@
 #include <png.h>
 #include <psp2/rtc.h> 
 #include <psp2/ctrl.h>
+#include <psp2/io/stat.h>
 #include <psp2/kernel/threadmgr.h> 
 
 
 #define THUMBNAIL_WIDTH 320
 #define THUMBNAIL_HEIGHT 200
+// Save the thumbnail as a paletted png (1) or as a RGB png (0).
+#define THUMBNAIL_PALETTED 1
+// Decoded thumbnails kept in memory. At least the six slots of the grid.
+#define THUMB_CACHE_SIZE 12
+
+// Memory buffer the png thumbnail is encoded to. The thumbnail module stores the png size
+// in front of the png, and a snapshot module can only be appended to, so the png can't be
+// streamed into the module. It is encoded here and copied into the module once.
+struct PngBuffer
+{
+	char* data;
+	size_t size;
+	size_t capacity;
+};
+
+static void pngWrite(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	// libpng write callback. Appends the data to the memory buffer.
+
+	PngBuffer* buf = (PngBuffer*)png_get_io_ptr(png_ptr);
+
+	if (buf->size + length > buf->capacity){
+		size_t capacity = buf->capacity * 2;
+		while (buf->size + length > capacity)
+			capacity *= 2;
+
+		char* data_new = new char[capacity];
+		memcpy(data_new, buf->data, buf->size);
+		delete[] buf->data;
+		buf->data = data_new;
+		buf->capacity = capacity;
+	}
+
+	memcpy(buf->data + buf->size, data, length);
+	buf->size += length;
+}
+
+static void pngFlush(png_structp png_ptr)
+{
+}
 
 
 SaveSlots::SaveSlots()
@@ -53,19 +94,26 @@ SaveSlots::SaveSlots()
 			slot->width = 0;
 			slot->height = 0;
 			slot->thumb_img = 0;
+			slot->thumb_loading = false;
 		}
 	}
+
+	m_thumbCacheClock = 0;
+	m_thumbLoaderRunning = false;
+	m_thumbLoaderCancel = false;
+	pthread_mutex_init(&m_thumbMutex, NULL);
 }
 
 SaveSlots::~SaveSlots()
 {
-	for (int i=0; i<2; i++){
-		for (int j=0; j<3; j++){
-			GridEntry* slot = &m_grid[i][j];
-			if (slot && slot->thumb_img)
-				vita2d_free_texture(slot->thumb_img);
-		}
+	stopThumbLoader();
+
+	for (vector<ThumbCacheEntry>::iterator it = m_thumbCache.begin(); it != m_thumbCache.end(); ++it){
+		if ((*it).texture)
+			vita2d_free_texture((*it).texture);
 	}
+
+	pthread_mutex_destroy(&m_thumbMutex);
 }
 
 void SaveSlots::init(View* view, 
@@ -102,6 +150,7 @@ RetCode SaveSlots::doModal(const char* save_path, const char* file_name)
 	m_exitCode = EXIT;
 	show();
 	scanCyclic();
+	stopThumbLoader();
 	cleanUp();
 
 	return m_exitCode;
@@ -143,6 +192,12 @@ void SaveSlots::render()
 	drawInstructions();
 }
 
+void SaveSlots::scanUpdate()
+{
+	if (m_thumbLoaderRunning)
+		collectThumbnails();
+}
+
 void SaveSlots::buttonReleased(int button)
 {
 	switch (button){
@@ -150,7 +205,9 @@ void SaveSlots::buttonReleased(int button)
 			if (!isSlotOccupied(m_highlightSlot))
 				break;
 			if (confirmUser("Delete save state?")){
+				stopThumbLoader();
 				emptySaveSlot(m_highlightSlot);
+				populateGrid(); // Resume loading the other thumbnails.
 				setState();
 			}
 			show(); 
@@ -159,12 +216,14 @@ void SaveSlots::buttonReleased(int button)
 			break;
 		case SCE_CTRL_CROSS: // Load
 			if (isSlotOccupied(m_highlightSlot)){
+				stopThumbLoader(); // The loader uses the snapshot api too.
 				gtShowMsgBoxNoBtn("Loading...", this);
 				sceKernelDelayThread(350000); // Just for the looks
 				string snapshot = getfilePath(m_highlightSlot);
 				
 				if (m_controller->loadState(snapshot.c_str()) < 0){
 					gtShowMsgBoxOk("Load failed", this);
+					populateGrid();
 					show();
 					return;
 				}
@@ -182,9 +241,12 @@ void SaveSlots::buttonReleased(int button)
 			if (g_game_file.empty())
 				return;
 
+			stopThumbLoader(); // The loader uses the snapshot api too.
+
 			// Ask user confirmation if this is overwrite
 			if (isSlotOccupied(m_highlightSlot)){
 				if (!confirmUser("Overwrite existing save?")){
+					populateGrid();
 					show();
 					return;
 				}
@@ -210,14 +272,41 @@ void SaveSlots::buttonReleased(int button)
 
 			gtShowMsgBoxNoBtn("Saving...", this);
 			
-			// Save snaphot and patch it with thumbnail and settings.
-			if (m_controller->saveState(snap_file.c_str()) < 0){
+			// Save snaphot together with the thumbnail and settings modules.
+			long thumb_size = 0;
+			char* thumb = createThumbnail(&thumb_size);
+			string settings = getSettingsString();
+			patch_data_s patches[2];
+			int num_patches = 0;
+
+			if (thumb){
+				patches[num_patches].module_name = SNAP_MOD_THUMB;
+				patches[num_patches].major = 1;
+				patches[num_patches].minor = 1;
+				patches[num_patches].data = thumb;
+				patches[num_patches].data_size = thumb_size;
+				num_patches++;
+			}
+
+			patches[num_patches].module_name = SNAP_MOD_SETTINGS;
+			patches[num_patches].major = 1;
+			patches[num_patches].minor = 1;
+			patches[num_patches].data = settings.c_str();
+			patches[num_patches].data_size = settings.size();
+			num_patches++;
+
+			int ret = m_controller->saveState(snap_file.c_str(), patches, num_patches);
+
+			if (thumb)
+				delete[] thumb;
+
+			if (ret < 0){
 				gtShowMsgBoxOk("Save failed", this);
+				populateGrid(); // Resume loading the other thumbnails.
+				setState();
 				show();
 				break;
 			}
-			addThumbToSnap(snap_file.c_str());
-			addSettingsToSnap(snap_file.c_str());
 			populateGrid();
 			setState();
 			show();
@@ -277,58 +366,38 @@ string SaveSlots::getSnapshotFromDirContent(vector<DirEntry> &dir, int save_slot
 	return ret;
 }
 
-int SaveSlots::addThumbToSnap(const char* snap_file)
+char* SaveSlots::createThumbnail(long* size)
 {
-	// Creates a png thumbnail image and patches it to the snapshot file.
-	
-	// TODO: Find a way how to create the png image straight to memory buffer.
-	// Currently the png is written to a file and then read to buffer.
-
-	if (!snap_file)
-		return -1;
-		
-	int ret = 0;
-	string thumb_file = m_path + "tmp_thumb";
-
-	if (saveViewToThumbnail(thumb_file.c_str()) < 0){
-		return -1;
-	}
+	// Creates a png thumbnail image of the view straight to memory. Returns the png data, 
+	// remember to deallocate.
 
-	long file_size = 0;
-	char* file_buf = readFileToBuf(thumb_file.c_str(), &file_size);
+	uint32_t palette[256];
+	uint32_t* thumb_palette = THUMBNAIL_PALETTED? palette: NULL;
 
-	if (file_buf && file_size > 0){
-		patch_data_s patch;
-		patch.snapshot_file = snap_file;
-		patch.module_name = SNAP_MOD_THUMB;
-		patch.major = 1;
-		patch.minor = 1;
-		patch.data = file_buf;
-		patch.data_size = file_size;
-		if (m_controller->patchSaveState(&patch) < 0)
-			ret = -1;
-	}
-	
-	if (file_buf)
-		delete[] file_buf;
+	unsigned char* thumb = m_view->getThumbnail(THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, thumb_palette);
+	if (!thumb)
+		return NULL;
 
-	FileExplorer::getInst()->deleteFile(thumb_file.c_str());
+	char* png = encodePng(thumb, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT, thumb_palette, size);
 
-	return ret;
+	delete[] thumb;
+	return png;
 }
 
-const char* SaveSlots::getThumbFromSnap(const char* file)
+const char* SaveSlots::getThumbFromSnap(const char* file, long* size)
 {
 	patch_data_s patch;
 	patch.snapshot_file = file;
 	patch.module_name = SNAP_MOD_THUMB;
+	patch.data = NULL; // Allocated by the controller. Remember to deallocate.
 	
-	// Get the bitmap size. Not the fastest way but easy.
-	if (m_controller->getSaveStatePatchInfo(&patch) < 0)
+	if (m_controller->getSaveStatePatch(&patch) < 0){
+		if (patch.data)
+			delete[] patch.data;
 		return NULL;
+	}
 
-	patch.data = new char[patch.data_size]; // Remember to deallocate.
-	m_controller->getSaveStatePatch(&patch);
+	*size = patch.data_size;
 	return patch.data;
 }
 
@@ -337,32 +406,24 @@ int	SaveSlots::getSettingsFromSnap(const char* file, char** data)
 	patch_data_s patch;
 	patch.snapshot_file = file;
 	patch.module_name = SNAP_MOD_SETTINGS;
-	
-	if (m_controller->getSaveStatePatchInfo(&patch) < 0)
-		return -1;
-
-	patch.data = new char[patch.data_size + 1]; // One more for null character.
+	patch.data = NULL; // Allocated and null terminated by the controller.
 	
 	if (m_controller->getSaveStatePatch(&patch) < 0){
-		delete[] patch.data;
+		if (patch.data)
+			delete[] patch.data;
 		return -1;
 	}
 
-	((char*)patch.data)[patch.data_size] = '\0';
 	*data = (char*)patch.data;
 
 	return 0;
 }
 
-int	SaveSlots::addSettingsToSnap(const char* snap_file)
+string SaveSlots::getSettingsString()
 {
-	// Combine control keymaps and view settings into a patch module and patch the snap.
+	// Combine control keymaps and view settings into a string that is saved as a snapshot module.
 	// Format: keymaps^value|setting1^value|...|settingn^value
 
-	if (!snap_file)
-		return -1;
-		
-	int ret = 0;
 	string settings = m_controls->toString();
 	settings.append(SNAP_MOD_DELIM_ENTRY);
 	settings.append(m_settings->toString(SETTINGS_VIEW).c_str());
@@ -370,18 +431,7 @@ int	SaveSlots::addSettingsToSnap(const char* snap_file)
 	settings.append(SNAP_MOD_DELIM_ENTRY);
 	settings.append(m_settings->toString(SETTINGS_MODEL_NOT_IN_SNAP).c_str());
 
-	patch_data_s patch;
-	patch.snapshot_file = snap_file;
-	patch.module_name = SNAP_MOD_SETTINGS;
-	patch.major = 1;
-	patch.minor = 1;
-	patch.data = settings.c_str();
-	patch.data_size = settings.size();
-	
-	if (m_controller->patchSaveState(&patch) < 0)
-		ret = -1;
-	
-	return ret;
+	return settings;
 }
 
 string SaveSlots::getTimeStampFromDirContent(vector<DirEntry> &dir, int save_slot)
@@ -439,14 +489,12 @@ void SaveSlots::emptySaveSlot(int slot)
 			GridEntry* grid_entry = &m_grid[i][j];
 			if (grid_number == slot-1 && !grid_entry->file_path.empty()){
 				fileExp.deleteFile(grid_entry->file_path.c_str());
-				grid_entry->file_path.clear();
 				grid_entry->time_stamp.clear();
 				grid_entry->text = "Empty";
-				
-				if (grid_entry->thumb_img){
-					vita2d_free_texture(grid_entry->thumb_img);
-					grid_entry->thumb_img = NULL;
-				}
+				grid_entry->thumb_img = NULL;
+				grid_entry->thumb_loading = false;
+				removeCachedThumbnail(grid_entry->file_path);
+				grid_entry->file_path.clear();
 			}
 		}
 	}
@@ -462,10 +510,8 @@ void SaveSlots::resetGrid()
 			slot->file_path.clear();
 			slot->time_stamp.clear();
 			slot->text = "Empty";
-			if (slot->thumb_img){
-				vita2d_free_texture(slot->thumb_img);
-				slot->thumb_img = NULL;
-			}
+			slot->thumb_img = NULL;
+			slot->thumb_loading = false;
 		}
 	}
 }
@@ -499,23 +545,262 @@ void SaveSlots::populateGrid()
 			int slot_number = (j+i*3);
 			GridEntry* slot = &m_grid[i][j];
 			
-			if (!slot->file_path.empty())
+			if (!slot->file_path.empty()){
+				// Loading was stopped before the thumbnail was ready.
+				if (slot->thumb_loading)
+					requestThumbnail(slot);
 				continue;
+			}
 		
 			slot->file_path = getSnapshotFromDirContent(dir_content, slot_number+1);
 			if (slot->file_path.empty())
 				continue;
 
 			slot->time_stamp = getTimeStampFromDirContent(dir_content, slot_number+1);
-			const char* buf = getThumbFromSnap(slot->file_path.c_str());
-			
-			if (buf){
-				slot->thumb_img = vita2d_load_PNG_buffer(buf);
-				delete[] buf;
-				continue;
+			requestThumbnail(slot);
+		}
+	}
+
+	startThumbLoader();
+}
+
+void SaveSlots::requestThumbnail(GridEntry* slot)
+{
+	// Takes the thumbnail from the cache, or queues it for the loader thread.
+	// The slot shows a placeholder text until the thumbnail is ready.
+
+	SceIoStat info;
+	memset(&info, 0, sizeof(info));
+	sceIoGetstat(slot->file_path.c_str(), &info);
+
+	ThumbCacheEntry* entry = findCachedThumbnail(slot->file_path, info.st_mtime);
+
+	if (entry){
+		slot->thumb_img = entry->texture;
+		slot->text = entry->texture? "": "No thumb";
+		slot->thumb_loading = false;
+		return;
+	}
+
+	ThumbJob job;
+	job.file_path = slot->file_path;
+	job.mtime = info.st_mtime;
+	job.state = THUMB_JOB_PENDING;
+	job.pixels = NULL;
+	job.width = 0;
+	job.height = 0;
+	m_thumbJobs.push_back(job);
+
+	slot->thumb_img = NULL;
+	slot->text = "Loading...";
+	slot->thumb_loading = true;
+}
+
+void SaveSlots::startThumbLoader()
+{
+	// The jobs are only added while the loader is not running, so the thread can walk them
+	// without holding the lock.
+
+	if (m_thumbLoaderRunning || m_thumbJobs.empty())
+		return;
+
+	m_thumbLoaderCancel = false;
+
+	if (pthread_create(&m_thumbLoader, NULL, thumbLoaderThread, this) == 0){
+		m_thumbLoaderRunning = true;
+		return;
+	}
+
+	// No thread, load them here.
+	thumbLoaderThread(this);
+	collectThumbnails();
+}
+
+void SaveSlots::stopThumbLoader()
+{
+	// Waits for the thumbnail being decoded and drops the rest. The loader reads the snapshots 
+	// with the snapshot api, which isn't thread safe, so this must be called before the ui 
+	// loads, saves or deletes a snapshot.
+
+	if (!m_thumbLoaderRunning)
+		return;
+
+	pthread_mutex_lock(&m_thumbMutex);
+	m_thumbLoaderCancel = true;
+	pthread_mutex_unlock(&m_thumbMutex);
+
+	pthread_join(m_thumbLoader, NULL);
+	m_thumbLoaderRunning = false;
+
+	collectThumbnails();
+}
+
+void* SaveSlots::thumbLoaderThread(void* arg)
+{
+	SaveSlots* slots = (SaveSlots*)arg;
+
+	for (size_t i = 0; i < slots->m_thumbJobs.size(); ++i){
+		pthread_mutex_lock(&slots->m_thumbMutex);
+		bool cancel = slots->m_thumbLoaderCancel;
+		pthread_mutex_unlock(&slots->m_thumbMutex);
+
+		if (cancel)
+			break;
+
+		ThumbJob* job = &slots->m_thumbJobs[i];
+		long size = 0;
+		const char* png = slots->getThumbFromSnap(job->file_path.c_str(), &size);
+		unsigned char* pixels = NULL;
+		png_image image;
+
+		memset(&image, 0, sizeof(image));
+		image.version = PNG_IMAGE_VERSION;
+
+		if (png && png_image_begin_read_from_memory(&image, png, size)){
+			image.format = PNG_FORMAT_RGBA; // Same byte order as the vita2d textures.
+			pixels = new unsigned char[PNG_IMAGE_SIZE(image)];
+
+			if (!png_image_finish_read(&image, NULL, pixels, 0, NULL)){
+				delete[] pixels;
+				pixels = NULL;
 			}
-		
-			slot->text = "No thumb";	
+		}
+
+		png_image_free(&image);
+
+		if (png)
+			delete[] png;
+
+		pthread_mutex_lock(&slots->m_thumbMutex);
+		job->pixels = pixels;
+		job->width = image.width;
+		job->height = image.height;
+		job->state = THUMB_JOB_READY;
+		pthread_mutex_unlock(&slots->m_thumbMutex);
+	}
+
+	return NULL;
+}
+
+void SaveSlots::collectThumbnails()
+{
+	// Moves the decoded thumbnails to textures and the cache, and shows them in the grid.
+	// The textures are created here as the gpu memory belongs to the ui thread.
+
+	bool pending = false;
+	bool updated = false;
+
+	pthread_mutex_lock(&m_thumbMutex);
+
+	for (vector<ThumbJob>::iterator it = m_thumbJobs.begin(); it != m_thumbJobs.end(); ++it){
+		ThumbJob* job = &(*it);
+
+		if (job->state == THUMB_JOB_PENDING)
+			pending = true;
+		if (job->state != THUMB_JOB_READY)
+			continue;
+
+		vita2d_texture* texture = NULL;
+
+		if (job->pixels){
+			texture = vita2d_create_empty_texture(job->width, job->height);
+			if (texture){
+				unsigned char* dst = (unsigned char*)vita2d_texture_get_datap(texture);
+				unsigned int stride = vita2d_texture_get_stride(texture);
+				for (int y = 0; y < job->height; y++)
+					memcpy(dst + y * stride, job->pixels + y * job->width * 4, job->width * 4);
+			}
+			delete[] job->pixels;
+			job->pixels = NULL;
+		}
+
+		job->state = THUMB_JOB_COLLECTED;
+		addCachedThumbnail(job->file_path, job->mtime, texture);
+
+		for (int i=0; i<2; i++){
+			for (int j=0; j<3; j++){
+				GridEntry* slot = &m_grid[i][j];
+				if (slot->thumb_loading && slot->file_path == job->file_path){
+					slot->thumb_img = texture;
+					slot->text = texture? "": "No thumb";
+					slot->thumb_loading = false;
+				}
+			}
+		}
+
+		updated = true;
+	}
+
+	pthread_mutex_unlock(&m_thumbMutex);
+
+	// All done, or the rest were dropped.
+	if (!pending || !m_thumbLoaderRunning){
+		if (m_thumbLoaderRunning){
+			pthread_join(m_thumbLoader, NULL);
+			m_thumbLoaderRunning = false;
+		}
+		m_thumbJobs.clear();
+	}
+
+	if (updated)
+		show();
+}
+
+ThumbCacheEntry* SaveSlots::findCachedThumbnail(const string& file_path, const SceDateTime& mtime)
+{
+	for (vector<ThumbCacheEntry>::iterator it = m_thumbCache.begin(); it != m_thumbCache.end(); ++it){
+		if ((*it).file_path == file_path && !memcmp(&(*it).mtime, &mtime, sizeof(SceDateTime))){
+			(*it).last_used = ++m_thumbCacheClock;
+			return &(*it);
+		}
+	}
+
+	return NULL;
+}
+
+void SaveSlots::addCachedThumbnail(const string& file_path, const SceDateTime& mtime, vita2d_texture* texture)
+{
+	// An older thumbnail of the same file is replaced. When the cache is full, the least recently 
+	// used thumbnail that isn't shown in the grid goes.
+
+	removeCachedThumbnail(file_path);
+
+	if (m_thumbCache.size() >= THUMB_CACHE_SIZE){
+		vector<ThumbCacheEntry>::iterator lru = m_thumbCache.end();
+		for (vector<ThumbCacheEntry>::iterator it = m_thumbCache.begin(); it != m_thumbCache.end(); ++it){
+			bool shown = false;
+			for (int i=0; i<2; i++){
+				for (int j=0; j<3; j++){
+					if (m_grid[i][j].file_path == (*it).file_path)
+						shown = true;
+				}
+			}
+			if (!shown && (lru == m_thumbCache.end() || (*it).last_used < lru->last_used))
+				lru = it;
+		}
+		if (lru != m_thumbCache.end()){
+			if (lru->texture)
+				vita2d_free_texture(lru->texture);
+			m_thumbCache.erase(lru);
+		}
+	}
+
+	ThumbCacheEntry entry;
+	entry.file_path = file_path;
+	entry.mtime = mtime;
+	entry.texture = texture;
+	entry.last_used = ++m_thumbCacheClock;
+	m_thumbCache.push_back(entry);
+}
+
+void SaveSlots::removeCachedThumbnail(const string& file_path)
+{
+	for (vector<ThumbCacheEntry>::iterator it = m_thumbCache.begin(); it != m_thumbCache.end(); ++it){
+		if ((*it).file_path == file_path){
+			if ((*it).texture)
+				vita2d_free_texture((*it).texture);
+			m_thumbCache.erase(it);
+			return;
 		}
 	}
 }
@@ -795,66 +1080,79 @@ void SaveSlots::waitTillButtonsReleased()
 	}
 }
 
-int SaveSlots::saveViewToThumbnail(const char* fname)
-{
-	if (!fname)
-		return -1;
-
-	unsigned char* thumb = m_view->getThumbnail();
-	if (!thumb){
-		return -1;
-	}
-
-	saveAsPng(thumb, fname, THUMBNAIL_WIDTH, THUMBNAIL_HEIGHT);
-
-	delete[] thumb;
-	return 0;
-}
-
-int SaveSlots::saveAsPng(unsigned char *img, const char *filename, int width, int height)
+char* SaveSlots::encodePng(unsigned char* img, int width, int height, uint32_t* palette, long* size)
 {
-	// Saves the thumbnail as a png file.
+	// Encodes the thumbnail as a png image to a memory buffer. The image is RGB, or palette
+	// indices if the palette is given. Returns the png data, remember to deallocate.
 
-	FILE* fp = fopen(filename, "wb");
-	if (fp == NULL) {
-		return -1;
-	}
-	
 	png_structp pngStruct = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (pngStruct == NULL) {
-		return -1;
+		return NULL;
 	}
 	
 	png_infop pngInfo = png_create_info_struct(pngStruct);
 	if (pngInfo == NULL) {
 		png_destroy_write_struct(&pngStruct, NULL);
-		return -1;
+		return NULL;
 	}
-	
+
+	int bytesPerPixel = palette? 1: 3;
+	png_bytep* rows = (png_bytep*)new char[height * sizeof(png_bytep)];
+
+	// Deflate doesn't grow the image much, so the buffer is rarely reallocated.
+	PngBuffer buf;
+	buf.capacity = width * height * bytesPerPixel / 2 + 1024;
+	buf.size = 0;
+	buf.data = new char[buf.capacity];
+
 	if (setjmp(png_jmpbuf(pngStruct))) {    
 		png_destroy_write_struct(&pngStruct, &pngInfo);
-		fclose(fp);
-		return -1;
+		delete[] rows;
+		delete[] buf.data;
+		return NULL;
 	}
 	
-	png_init_io(pngStruct, fp);
-	png_set_IHDR(pngStruct, pngInfo, width, height, 8, 
-					PNG_COLOR_TYPE_RGB,
-					PNG_INTERLACE_NONE, 
-					PNG_COMPRESSION_TYPE_DEFAULT, 
-					PNG_FILTER_TYPE_DEFAULT);
-
-	png_write_info(pngStruct, pngInfo);
-	png_write_flush(pngStruct);
-	
-	png_uint_32 bytesInRow = width * 3;
-	png_bytep* rows = (png_bytep*)new char[height * sizeof(png_bytep)];
+	png_set_write_fn(pngStruct, &buf, pngWrite, pngFlush);
+
+	if (palette){
+		// Only the colours used are saved, packed in as few bits as possible.
+		int numColors = 1;
+		for (int i = 0; i < width * height; i++){
+			if (img[i] >= numColors)
+				numColors = img[i] + 1;
+		}
 
-	if (rows == NULL) {
-		fclose(fp);
-		png_destroy_write_struct(&pngStruct, &pngInfo);
-		return -1;
+		int bitDepth = numColors <= 2? 1: numColors <= 4? 2: numColors <= 16? 4: 8;
+
+		png_color plte[256];
+		for (int i = 0; i < numColors; i++){
+			//palette table value: r | (g << 8) | (b << 16) | (0xFF << 24);
+			plte[i].red = palette[i];
+			plte[i].green = palette[i] >> 8;
+			plte[i].blue = palette[i] >> 16;
+		}
+
+		png_set_IHDR(pngStruct, pngInfo, width, height, bitDepth, 
+						PNG_COLOR_TYPE_PALETTE,
+						PNG_INTERLACE_NONE, 
+						PNG_COMPRESSION_TYPE_DEFAULT, 
+						PNG_FILTER_TYPE_DEFAULT);
+		png_set_PLTE(pngStruct, pngInfo, plte, numColors);
+		// Filters don't help with palette indices.
+		png_set_filter(pngStruct, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+		png_write_info(pngStruct, pngInfo);
+		png_set_packing(pngStruct); // One index per byte in the image.
+	}
+	else{
+		png_set_IHDR(pngStruct, pngInfo, width, height, 8, 
+						PNG_COLOR_TYPE_RGB,
+						PNG_INTERLACE_NONE, 
+						PNG_COMPRESSION_TYPE_DEFAULT, 
+						PNG_FILTER_TYPE_DEFAULT);
+		png_write_info(pngStruct, pngInfo);
 	}
+	
+	png_uint_32 bytesInRow = width * bytesPerPixel;
 
 	for (int i = 0; i < height; i++) {
 		rows[i] = img;
@@ -865,9 +1163,10 @@ int SaveSlots::saveAsPng(unsigned char *img, const char *filename, int width, in
 	png_write_end(pngStruct, NULL);
 	png_destroy_write_struct(&pngStruct, &pngInfo);
 
-	fclose(fp);
 	delete[] rows;
-	return 0;
+
+	*size = buf.size;
+	return buf.data;
 }
 
 string SaveSlots::getDisplayFitString(const char* str, int limit, float font_size)
@@ -906,31 +1205,6 @@ void SaveSlots::cleanUp()
 	}
 }
 
-char* SaveSlots::readFileToBuf(const char* file, long* file_size)
-{
-	// Important: This function allocates memory from heap. Caller must deallocate (delete[]) after use.
-	FILE *fp = fopen(file, "r");
-	
-	if (fp == NULL)
-		return NULL;
-
-	// Get the file size in bytes
-	fseek(fp, 0L, SEEK_END);
-	long numbytes = ftell(fp);
- 
-	char* buffer = new char[numbytes];
-	memset(buffer, 0, numbytes);
-	// Reset the file position indicator to the beginning of the file
-	fseek(fp, 0L, SEEK_SET);	
-	// Copy all the text into the buffer
-	fread(buffer, sizeof(char), numbytes, fp);
-	fclose(fp);
-
-	*file_size = numbytes;
-
-	return buffer;
-}
-
 int SaveSlots::applyPatchModuleSettings(const char* snapshot)
 {
 	char* settings; 
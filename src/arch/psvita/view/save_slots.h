@@ -29,6 +29,8 @@
 #include "iRenderable.h"
 #include <vector>
 #include <string>
+#include <pthread.h>
+#include <psp2/rtc.h>
 
 using std::string;
 using std::vector;
@@ -49,14 +51,40 @@ struct GridEntry
 	string text;
 	string file_path;
 	string time_stamp;
-	vita2d_texture* thumb_img;
+	vita2d_texture* thumb_img; // Owned by the thumbnail cache.
+	bool thumb_loading;
+};
+
+// Decoded thumbnail of a snapshot file. The modification time tells if the file has changed.
+struct ThumbCacheEntry
+{
+	string file_path;
+	SceDateTime mtime;
+	vita2d_texture* texture; // NULL if the snapshot has no thumbnail.
+	unsigned int last_used;
+};
+
+enum ThumbJobState {
+	THUMB_JOB_PENDING = 0,
+	THUMB_JOB_READY,
+	THUMB_JOB_COLLECTED
+};
+
+// Thumbnail decoded by the loader thread. The texture is created by the ui thread.
+struct ThumbJob
+{
+	string file_path;
+	SceDateTime mtime;
+	ThumbJobState state;
+	unsigned char* pixels; // RGBA, NULL if the snapshot has no thumbnail.
+	int width;
+	int height;
 };
 
 class View;
 class Controller;
 class Controls;
 class Settings;
-class SceDateTime;
 class SaveSlots : public Navigator, IRenderable
 {
 
@@ -77,6 +105,13 @@ private:
 	SaveSlotsState		m_state;
 	string				m_displayfileName;
 	RetCode				m_exitCode;
+	vector<ThumbCacheEntry>	m_thumbCache;
+	unsigned int		m_thumbCacheClock;
+	vector<ThumbJob>	m_thumbJobs;
+	pthread_t			m_thumbLoader;
+	pthread_mutex_t		m_thumbMutex;
+	bool				m_thumbLoaderRunning;
+	bool				m_thumbLoaderCancel;
 
 	
 	void				show();
@@ -91,26 +126,32 @@ private:
 	void				drawInstructions();
 	void				waitTillButtonsReleased();
 	void				setState();
-	int					saveViewToThumbnail(const char* fname);
-	int					saveAsPng(unsigned char* image, const char* filename, int width, int height);
+	char*				encodePng(unsigned char* image, int width, int height, uint32_t* palette, long* size);
 	int					touchCoordinatesToSaveSlot(int x, int y);
 	bool				isSlotOccupied(int slot);
 	bool				isGridEmpty();
 	bool				confirmUser(const char* msg);
 	void				emptySaveSlot(int slot);
 	void				addTimeStamp(int slot, char* time_stamp);
-	int					addThumbToSnap(const char* snap_file);
-	int					addSettingsToSnap(const char* snap_file);
+	char*				createThumbnail(long* size);
+	string				getSettingsString();
 	void				changeHighlightSquare(int button);
 	string				getfilePath(int slot);
 	string				formatTimeStamp(string seconds);
 	string				getSnapshotFromDirContent(vector<DirEntry> &dir, int save_slot);
-	const char*			getThumbFromSnap(const char* file);
+	const char*			getThumbFromSnap(const char* file, long* size);
+	void				requestThumbnail(GridEntry* slot);
+	void				startThumbLoader();
+	void				stopThumbLoader();
+	void				collectThumbnails();
+	ThumbCacheEntry*	findCachedThumbnail(const string& file_path, const SceDateTime& mtime);
+	void				addCachedThumbnail(const string& file_path, const SceDateTime& mtime, vita2d_texture* texture);
+	void				removeCachedThumbnail(const string& file_path);
+	static void*		thumbLoaderThread(void* arg);
 	int					getSettingsFromSnap(const char* file, char** data);
 	string				getTimeStampFromDirContent(vector<DirEntry> &dir, int save_slot);
 	string				getDisplayFitString(const char* str, int limit, float font_size = 1);
 	void				cleanUp();
-	char*				readFileToBuf(const char* file, long* file_size);
 	int					applyPatchModuleSettings(const char* snapshot);
 
 	// Navigator interface implementations
@@ -120,6 +161,7 @@ private:
 	void				navigateLeft(); 
 	void				navigateRight(); 
 	void				buttonReleased(int button);
+	void				scanUpdate();
 
 public:
 						SaveSlots();
@@ -76,10 +76,15 @@ static const char* gs_keyboardModeValues[]		= {"Full screen","Split screen","Sli
 static const char* gs_autofireSpeedValues[]		= {"Slow","Medium","Fast"};
 static const char* gs_cpuSpeedValues[]			= {"100%","125%","150%","175%","200%"};
 static const char* gs_hostCpuSpeedValues[]		= {"333 MHz","444 MHz"};
+static const char* gs_profilerValues[]			= {"Off","Graph","Graph + CSV"};
+static const char* gs_rewindValues[]			= {"Off","On"};
+static const char* gs_runAheadValues[]			= {"Off","1 frame","2 frames"};
+static const char* gs_driveThreadValues[]		= {"Off","On"};
+static const char* gs_crtEmulationValues[]		= {"Off","PAL","Scanlines"};
 static const char* gs_audioPlaybackValues[]		= {"Enabled","Disabled"};
 static const char* gs_machineResetValues[]		= {"Hard","Soft"};
 
-static int gs_settingsEntriesSize = 21;
+static int gs_settingsEntriesSize = 26;
 static SettingsEntry gs_list[] = 
 {
 	{"Machine","","",0,0,"",1}, /* Header line */
@@ -89,6 +94,7 @@ static SettingsEntry gs_list[] =
 	{"Video","","",0,0,"",1},
 	{"Aspect ratio",  "AspectRatio",  "16:9",gs_aspectRatioValues,3,"",0,ST_VIEW,ASPECT_RATIO,0},
 	{"Texture filter","TextureFilter","Linear",gs_textureFilterValues,2,"",0,ST_VIEW,TEXTURE_FILTER,0},
+	{"CRT emulation", "CRTEmulation", "Off",gs_crtEmulationValues,3,"",0,ST_VIEW,CRT_EMULATION,0},
 	{"Color palette", "ColorPalette", "Colodore",gs_colorPaletteValues,6,"",0,ST_MODEL,COLOR_PALETTE,0},
 	{"Borders",       "Borders",      "Hide",gs_borderVisibilityValues,2,"",0,ST_VIEW,BORDERS,0},
 	{"Input","","",0,0,"",1},
@@ -99,6 +105,10 @@ static SettingsEntry gs_list[] =
 	{"Performance","","",0,0,"",1},
 	{"CPU speed",     "CPUSpeed",    "100%",gs_cpuSpeedValues,5,"",0,ST_MODEL,CPU_SPEED,0},
 	{"Host CPU speed","HostCPUSpeed","333 MHz",gs_hostCpuSpeedValues,2,"",0,ST_VIEW,HOST_CPU_SPEED,0},
+	{"Profiler",      "Profiler",    "Off",gs_profilerValues,3,"",0,ST_VIEW,FRAME_PROFILER,0},
+	{"Rewind",        "Rewind",      "Off",gs_rewindValues,2,"",0,ST_VIEW,REWIND,0},
+	{"Run-ahead",     "RunAhead",    "Off",gs_runAheadValues,3,"",0,ST_VIEW,RUNAHEAD,0},
+	{"Drive thread",  "DriveThread", "Off",gs_driveThreadValues,2,"",0,ST_VIEW,DRIVE_THREAD,0},
 	{"Audio","","",0,0,"",1},
 	{"Playback","Sound","Enabled",gs_audioPlaybackValues,2,"",0,ST_MODEL,SOUND,0},
 	{"Other","","",0,0,"",1},
@@ -725,6 +735,7 @@ string Settings::toString(int setting)
 			switch (gs_list[i].id){
 			case ASPECT_RATIO:
 			case TEXTURE_FILTER:
+			case CRT_EMULATION:
 			case BORDERS:
 			case JOYSTICK_SIDE:
 			case JOYSTICK_AUTOFIRE_SPEED:
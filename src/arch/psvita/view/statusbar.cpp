@@ -44,6 +44,12 @@ Statusbar::Statusbar()
 	m_tapeControl = 0;
 	m_tapeControlTex = NULL;
 	m_lastActiveDrive = 0;
+	m_underruns = 0;
+	m_overruns = 0;
+	m_xruns[0] = 0;
+	m_profileNext = 0;
+	m_profileCount = 0;
+	m_profileLastFrame = (unsigned long)-1;
 }
 
 Statusbar::~Statusbar()
@@ -151,6 +157,10 @@ int Statusbar::render()
 	if (m_warpFlag)
 		vita2d_draw_texture(m_bitmaps[IMG_SB_LED_ON_GREEN], 811, 522);
 
+	// Sound buffer underruns/overruns. Only shown once there has been any.
+	if (m_xruns[0])
+		txtr_draw_text(850, 534, YELLOW, m_xruns, 0.8);
+
 	m_updated = false;
 	return 1;
 }
@@ -173,6 +183,93 @@ void Statusbar::setSpeedData(int fps, int cpu, int warp_flag)
 	m_updated = true;
 }
 
+void Statusbar::setSoundXruns(unsigned int underruns, unsigned int overruns)
+{
+	if (underruns == m_underruns && overruns == m_overruns)
+		return;
+
+	m_underruns = underruns;
+	m_overruns = overruns;
+	// The counts start again from zero when the sound device is reopened.
+	if (underruns || overruns)
+		snprintf(m_xruns, sizeof(m_xruns), "U%u O%u", underruns, overruns);
+	else
+		m_xruns[0] = 0;
+
+	m_updated = true;
+}
+
+void Statusbar::addFrameProfile(const frameprof_frame_t* frame)
+{
+	if (frame->frame == m_profileLastFrame)
+		return;
+
+	// Profiling was restarted.
+	if (frame->frame < m_profileLastFrame || m_profileLastFrame == (unsigned long)-1)
+		m_profileCount = 0;
+
+	m_profileLastFrame = frame->frame;
+	m_profile[m_profileNext] = *frame;
+	m_profileNext = (m_profileNext + 1) % FRAMEPROF_HISTORY;
+	if (m_profileCount < FRAMEPROF_HISTORY)
+		m_profileCount++;
+}
+
+void Statusbar::renderFrameProfile()
+{
+	// Stacked bar graph of the last frames, newest on the right, with the average 
+	// time per section in milliseconds on the left. Full height is 40 ms.
+
+	static const int colors[FRAMEPROF_NUM] = {
+		ROYAL_BLUE,					// cpu
+		GREEN,						// video
+		RGBA8(192, 0, 192, 255),	// sid
+		RGBA8(255, 128, 0, 255),	// drive
+		CYAN,						// sound
+		YELLOW,						// view
+		RGBA8(255, 64, 64, 255),	// snap
+		DARK_GREY					// sleep
+	};
+	const int bar_width = 2;
+	const int height = 80;
+	const float usec_per_pixel = 40000.0f / height;
+	const int x0 = 960 - FRAMEPROF_HISTORY * bar_width - 8;
+	const int y0 = 8;
+	unsigned long sum[FRAMEPROF_NUM] = {0};
+	char text[32];
+
+	vita2d_draw_rectangle(x0 - 84, y0, FRAMEPROF_HISTORY * bar_width + 84, height, RGBA8(0, 0, 0, 160));
+
+	int pos = (m_profileNext - m_profileCount + FRAMEPROF_HISTORY) % FRAMEPROF_HISTORY;
+	int x = x0 + (FRAMEPROF_HISTORY - m_profileCount) * bar_width;
+
+	for (int i=0; i<m_profileCount; ++i){
+		const frameprof_frame_t* f = &m_profile[pos];
+		float y = y0 + height;
+
+		for (int s=0; s<FRAMEPROF_NUM && y > y0; ++s){
+			float h = f->usec[s] / usec_per_pixel;
+			if (h > y - y0)
+				h = y - y0;
+			y -= h;
+			vita2d_draw_rectangle(x, y, bar_width, h, colors[s]);
+			sum[s] += f->usec[s];
+		}
+
+		pos = (pos + 1) % FRAMEPROF_HISTORY;
+		x += bar_width;
+	}
+
+	// 20 ms, a PAL frame.
+	vita2d_draw_line(x0, y0 + height/2, x0 + FRAMEPROF_HISTORY * bar_width, y0 + height/2, WHITE);
+
+	for (int s=0; s<FRAMEPROF_NUM; ++s){
+		float avg = m_profileCount? (float)sum[s] / m_profileCount / 1000: 0;
+		snprintf(text, sizeof(text), "%-5s %4.1f", frameprof_section_name(s), avg);
+		txtr_draw_text(x0 - 80, y0 + 10 + s * 9, colors[s], text, 0.6);
+	}
+}
+
 void Statusbar::setDriveLed(int drive, int led)
 {
 	if (drive > 3)
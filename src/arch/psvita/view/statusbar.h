@@ -25,6 +25,10 @@
 
 #include <string>
 
+extern "C" {
+#include "frameprof.h"
+}
+
 #define IMG_SB_STATUSBAR               0
 #define IMG_SB_LED_ON_GREEN            1
 #define IMG_SB_LED_ON_RED              2
@@ -65,6 +69,13 @@ private:
 	char			m_fps[8];
 	char			m_cpu[8];
 	char			m_counter[8];
+	char			m_xruns[24];
+	unsigned int	m_underruns;
+	unsigned int	m_overruns;
+	frameprof_frame_t m_profile[FRAMEPROF_HISTORY];
+	int				m_profileNext;
+	int				m_profileCount;
+	unsigned long	m_profileLastFrame;
 	int				m_warpFlag;
 	int				m_tapeControl;
 	int				m_tapeMotor;
@@ -84,6 +95,9 @@ public:
 	void			show();
 	int				render();
 	void			setSpeedData(int fps, int percent, int warp_flag);
+	void			setSoundXruns(unsigned int underruns, unsigned int overruns);
+	void			addFrameProfile(const frameprof_frame_t* frame);
+	void			renderFrameProfile();
 	void			setTapeCounter(int counter);
 	void			setTapeControl(int control);
 	void			setDriveLed(int drive, int led);
@@ -48,6 +48,12 @@
 #include <psp2/kernel/threadmgr.h> 
 #include <psp2/io/dirent.h> 
 
+// The thumbnail colours are looked up 16 pixels at a time with NEON.
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define THUMBNAIL_NEON
+#endif
+
 // Globals (Static keyword makes the variable global only inside the file).
 string				g_game_file;
 vita2d_texture**	g_instructionBitmaps;
@@ -82,21 +88,47 @@ View::View()
 	m_about				= NULL;
 	m_statusbar			= NULL;
 	m_keyboard			= NULL;
-	m_view_tex			= NULL;
+	m_view_tex_data		= NULL;
 	m_fileExp			= NULL;
 	m_posX				= 0;
 	m_posY				= 0;
 	m_scaleX			= 1;
 	m_scaleY			= 1;
+	m_width				= 0;
+	m_height			= 0;
+	m_viewBitDepth		= 8;
+	m_frameScale		= 0;
+	m_paletteSize		= 0;
 	m_statusbarMask		= 0;
 	m_showStatusbar		= false;
 	m_inGame			= false;
 	m_pendingDraw		= false;
 	m_displayPause		= false;
+	m_showProfile		= false;
+	m_readyFrame		= -1;
+	m_drawingFrame		= -1;
+	m_renderQuit		= false;
+	m_renderThreadRunning = false;
+
+	for (int i=0; i<VIEW_FRAME_COUNT; ++i)
+		m_frames[i].tex = NULL;
+
+	pthread_mutex_init(&m_frameMutex, NULL);
+	pthread_cond_init(&m_frameCond, NULL);
+	pthread_cond_init(&m_idleCond, NULL);
+
+	// Recursive because the keyboard scan may draw the view.
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&m_renderMutex, &attr);
+	pthread_mutexattr_destroy(&attr);
 }
 
 View::~View()
 {
+	stopRenderThread();
+
 	if (m_controlPad)
 		delete m_controlPad;
 	if (m_mainMenu)
@@ -117,14 +149,18 @@ View::~View()
 		delete m_keyboard;
 	if (m_fileExp)
 		delete m_fileExp;
-	if (m_view_tex)
-		vita2d_free_texture(m_view_tex);
+	freeViewTextures();
 
 	for (int i=0; i<gs_instructionBitmapsSize; ++i){
 		vita2d_free_texture(g_instructionBitmaps[i]);
 	}
 
 	txtr_free();
+
+	pthread_mutex_destroy(&m_frameMutex);
+	pthread_cond_destroy(&m_frameCond);
+	pthread_cond_destroy(&m_idleCond);
+	pthread_mutex_destroy(&m_renderMutex);
 }
 
 void View::init(Controller* controller)
@@ -161,6 +197,10 @@ void View::init(Controller* controller)
 
 	loadResources();
 
+	// Game frames are composited and presented on their own thread.
+	if (pthread_create(&m_renderThread, NULL, renderThread, this) == 0)
+		m_renderThreadRunning = true;
+
 	string last_dir = getLastBrowserDir();
 	m_fileExp->init(last_dir.c_str(),0,0,0,gs_browserFilter);
 
@@ -230,67 +270,284 @@ int	View::createView(int width, int height, int bpp)
 {
 	// Creates the view texture.
 
+	// VICE draws into a buffer of its own. Each finished frame is copied to one of 
+	// the frame textures, so VICE can start the next frame while the render thread
+	// still presents the previous one.
+
+	waitRenderIdle();
+
 	m_width = width;
 	m_height = height;
+	m_viewBitDepth = (bpp == 16)? 16: 8;
 	
-	if (m_view_tex)
-		vita2d_free_texture(m_view_tex);
+	freeViewTextures();
+	createFrameTextures();
 
+	m_view_tex_data = new unsigned char[m_width * m_height * (m_viewBitDepth/8)];
+	memset(m_view_tex_data, 0, m_width * m_height * (m_viewBitDepth/8));
+	
+	return 1;
+}
 
-	switch (bpp){
-	case 8:
-		// format: 8 bit indexed
-		m_view_tex = vita2d_create_empty_texture_format(m_width, m_height, (SceGxmTextureFormat)SCE_GXM_TEXTURE_BASE_FORMAT_P8);
-		m_viewBitDepth = 8;
-		break;
-	case 16:
-		// format: 16 bit 5-6-5
-		m_view_tex = vita2d_create_empty_texture_format(m_width, m_height, SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB);
-		m_viewBitDepth = 16;
-		break;
+void View::createFrameTextures()
+{
+	// The frames are copies of the draw buffer, or with CRT emulation 16 bit 5-6-5 
+	// images rendered from it with m_frameScale lines per draw buffer line.
+
+	freeFrameTextures();
+
+	if (!m_width)
+		return;
+
+	for (int i=0; i<VIEW_FRAME_COUNT; ++i){
+		if (m_frameScale)
+			m_frames[i].tex = vita2d_create_empty_texture_format(m_width, m_height * m_frameScale, SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB);
+		else if (m_viewBitDepth == 8)
+			// format: 8 bit indexed
+			m_frames[i].tex = vita2d_create_empty_texture_format(m_width, m_height, (SceGxmTextureFormat)SCE_GXM_TEXTURE_BASE_FORMAT_P8);
+		else
+			// format: 16 bit 5-6-5
+			m_frames[i].tex = vita2d_create_empty_texture_format(m_width, m_height, SCE_GXM_TEXTURE_FORMAT_U5U6U5_RGB);
+
+		uint32_t* palette_tbl = (uint32_t*)vita2d_texture_get_palette(m_frames[i].tex);
+
+		if (palette_tbl)
+			memcpy(palette_tbl, m_palette, m_paletteSize * sizeof(uint32_t));
 	}
 
 	m_settings->applySetting(TEXTURE_FILTER);
-    m_view_tex_data = (unsigned char*) vita2d_texture_get_datap(m_view_tex);
-	
-	return 1;
 }
 
 void View::updateView()
 {
-	if (!m_inGame)
+	// Hands the finished frame over to the render thread.
+
+	if (!m_inGame || !m_view_tex_data)
+		return;
+
+	if (!m_renderThreadRunning){
+		renderFrame(prepareFrame(0));
 		return;
+	}
+
+	// There is always a frame that is neither waiting nor being drawn.
+	// Only this thread marks frames ready so it stays free while we copy.
+	int free_frame = 0;
+
+	pthread_mutex_lock(&m_frameMutex);
+	while (free_frame == m_readyFrame || free_frame == m_drawingFrame)
+		free_frame++;
+	pthread_mutex_unlock(&m_frameMutex);
+
+	prepareFrame(free_frame);
+
+	// A frame that the render thread did not pick up yet is dropped.
+	pthread_mutex_lock(&m_frameMutex);
+	m_readyFrame = free_frame;
+	pthread_cond_signal(&m_frameCond);
+	pthread_mutex_unlock(&m_frameMutex);
+}
+
+ViewFrame* View::prepareFrame(int index)
+{
+	// Copies the visible part of the draw buffer and the current layout to a frame.
+
+	ViewFrame* frame = &m_frames[index];
+	int stride = vita2d_texture_get_stride(frame->tex);
+
+	frame->viewport	= m_viewport;
+	frame->posX		= m_posX;
+	frame->posY		= m_posY;
+	frame->scaleX	= m_scaleX;
+	frame->scaleY	= m_scaleY;
+
+	if (m_frameScale){
+		// The CRT emulation renders the viewport in place of the copy.
+		m_controller->renderCrtFrame((unsigned char*)vita2d_texture_get_datap(frame->tex), stride, 
+			m_viewport.x, m_viewport.y, m_viewport.width, m_viewport.height);
+
+		frame->viewport.y		*= m_frameScale;
+		frame->viewport.height	*= m_frameScale;
+		frame->scaleY			/= m_frameScale;
+	}
+	else{
+		int bytes_pp = m_viewBitDepth/8;
+		int pitch = m_width * bytes_pp;
+		int row_size = m_viewport.width * bytes_pp;
+		unsigned char* src = m_view_tex_data + m_viewport.y * pitch + m_viewport.x * bytes_pp;
+		unsigned char* dst = (unsigned char*)vita2d_texture_get_datap(frame->tex) + m_viewport.y * stride + m_viewport.x * bytes_pp;
+
+		for (int y=0; y<m_viewport.height; ++y){
+			memcpy(dst, src, row_size);
+			src += pitch;
+			dst += stride;
+		}
+	}
+
+	frame->clear	= !viewCoversScreen();
+	frame->keyboard	= (g_keyboardStatus & KEYBOARD_VISIBLE)? true: false;
+	frame->statusbar = m_showStatusbar? true: false;
+	frame->paused	= m_displayPause;
+	frame->profile	= m_showProfile;
 
+	return frame;
+}
+
+void View::renderFrame(ViewFrame* frame)
+{
 	vita2d_start_drawing();
-	vita2d_clear_screen();
-
-	// Don't draw view if keyboard is in fullscreen.
-	//if (!(g_keyboardStatus == KEYBOARD_UP && m_keyboard->getMode() == KEYBOARD_FULL_SCREEN)){
-		vita2d_draw_texture_part_scale(
-			m_view_tex, 
-			m_posX, 
-			m_posY, 
-			m_viewport.x, 
-			m_viewport.y, 
-			m_viewport.width, 
-			m_viewport.height, 
-			m_scaleX, 
-			m_scaleY);
-	//}
-
-	if (g_keyboardStatus & KEYBOARD_VISIBLE)
+
+	// The emulator image overwrites every pixel when it fills the screen.
+	if (frame->clear)
+		vita2d_clear_screen();
+
+	vita2d_draw_texture_part_scale(
+		frame->tex, 
+		frame->posX, 
+		frame->posY, 
+		frame->viewport.x, 
+		frame->viewport.y, 
+		frame->viewport.width, 
+		frame->viewport.height, 
+		frame->scaleX, 
+		frame->scaleY);
+
+	// Keyboard and statusbar state is changed by the emulation thread.
+	pthread_mutex_lock(&m_renderMutex);
+
+	if (frame->keyboard)
 		m_keyboard->render();
 
-	if (m_showStatusbar)
+	if (frame->statusbar)
 		m_statusbar->render();
 
-	if (m_displayPause)
+	if (frame->profile)
+		m_statusbar->renderFrameProfile();
+
+	pthread_mutex_unlock(&m_renderMutex);
+
+	if (frame->paused)
 		txtr_draw_text(870, 534, YELLOW, "Paused");
 	
     vita2d_end_drawing();
+	// The frame texture may be reused as soon as we return.
+	vita2d_wait_rendering_done();
     vita2d_swap_buffers();
 }
 
+void* View::renderThread(void* arg)
+{
+	View* view = (View*)arg;
+	ViewFrame* frame;
+
+	for (;;){
+		pthread_mutex_lock(&view->m_frameMutex);
+		while (!view->m_renderQuit && view->m_readyFrame < 0)
+			pthread_cond_wait(&view->m_frameCond, &view->m_frameMutex);
+
+		if (view->m_renderQuit){
+			pthread_mutex_unlock(&view->m_frameMutex);
+			break;
+		}
+
+		view->m_drawingFrame = view->m_readyFrame;
+		view->m_readyFrame = -1;
+		frame = &view->m_frames[view->m_drawingFrame];
+		pthread_mutex_unlock(&view->m_frameMutex);
+
+		view->renderFrame(frame);
+
+		pthread_mutex_lock(&view->m_frameMutex);
+		view->m_drawingFrame = -1;
+		pthread_cond_broadcast(&view->m_idleCond);
+		pthread_mutex_unlock(&view->m_frameMutex);
+	}
+
+	return NULL;
+}
+
+void View::waitRenderIdle()
+{
+	// Waits until all handed over frames are presented. Must be called before 
+	// drawing on the calling thread or touching the frame textures.
+
+	pthread_mutex_lock(&m_frameMutex);
+	while (m_readyFrame >= 0 || m_drawingFrame >= 0)
+		pthread_cond_wait(&m_idleCond, &m_frameMutex);
+	pthread_mutex_unlock(&m_frameMutex);
+}
+
+void View::stopRenderThread()
+{
+	if (!m_renderThreadRunning)
+		return;
+
+	waitRenderIdle();
+
+	pthread_mutex_lock(&m_frameMutex);
+	m_renderQuit = true;
+	pthread_cond_signal(&m_frameCond);
+	pthread_mutex_unlock(&m_frameMutex);
+
+	pthread_join(m_renderThread, NULL);
+	m_renderThreadRunning = false;
+}
+
+void View::freeViewTextures()
+{
+	freeFrameTextures();
+
+	if (m_view_tex_data)
+		delete [] m_view_tex_data;
+	m_view_tex_data = NULL;
+}
+
+void View::freeFrameTextures()
+{
+	for (int i=0; i<VIEW_FRAME_COUNT; ++i){
+		if (m_frames[i].tex)
+			vita2d_free_texture(m_frames[i].tex);
+		m_frames[i].tex = NULL;
+	}
+}
+
+bool View::isViewDirty(const uint32_t* dirty_lines, unsigned int num_lines)
+{
+	// Returns true if any of the texture lines inside the viewport changed.
+	// The dirty lines are frame buffer lines, which are also the texture rows.
+
+	unsigned int first = m_viewport.y;
+	unsigned int last = m_viewport.y + m_viewport.height;
+
+	if (last > num_lines)
+		last = num_lines;
+
+	for (unsigned int y = first; y < last; ){
+		uint32_t word = dirty_lines[y >> 5] >> (y & 31);
+
+		if (word){
+			// Bits beyond the viewport in the same word don't count.
+			if (y + __builtin_ctz(word) < last)
+				return true;
+			return false;
+		}
+
+		y = (y | 31) + 1;
+	}
+
+	return false;
+}
+
+bool View::viewCoversScreen()
+{
+	if ((g_keyboardStatus & KEYBOARD_VISIBLE) || m_showStatusbar)
+		return false;
+
+	return m_posX <= 0 && m_posY <= 0 
+		&& m_posX + m_viewport.width * m_scaleX >= 960 
+		&& m_posY + m_viewport.height * m_scaleY >= 544;
+}
+
 void View::updateViewPos()
 {
 	//PSV_DEBUG("View::updateViewPos()");
@@ -373,70 +630,114 @@ void View::getViewportInfo(int* x, int* y, int* width, int* height)
 
 void View::setPalette(unsigned char* palette, int size)
 {
-	// Fills the color palette table of the indexed texture
+	// Fills the color palette tables of the indexed frame textures. The palette is also 
+	// kept for the thumbnails and for frame textures created later.
 
-	if (!m_view_tex)
-		return;
-
-	uint32_t* palette_tbl = (uint32_t*)vita2d_texture_get_palette(m_view_tex);
+	waitRenderIdle();
 
-	if (!palette_tbl)
-		return;
+	if (size > 256)
+		size = 256;
 
+	unsigned char* color = palette;
 	unsigned char r, g, b;
-	
+
 	for(int i=0; i<size; i++){
-		r = palette[0];
-		g = palette[1];
-		b = palette[2];
-		palette_tbl[i] = r | (g << 8) | (b << 16) | (0xFF << 24);
-		palette += 3;
+		r = color[0];
+		g = color[1];
+		b = color[2];
+		m_palette[i] = r | (g << 8) | (b << 16) | (0xFF << 24);
+		color += 3;
+	}
+	m_paletteSize = size;
+
+	for (int f=0; f<VIEW_FRAME_COUNT; ++f){
+		if (!m_frames[f].tex)
+			return;
+
+		uint32_t* palette_tbl = (uint32_t*)vita2d_texture_get_palette(m_frames[f].tex);
+
+		if (!palette_tbl)
+			return;
+
+		memcpy(palette_tbl, m_palette, size * sizeof(uint32_t));
 	}
 }
 
 void View::setFPSCount(int fps, int percent, int warp_flag)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setSpeedData(fps, percent, warp_flag);
+	pthread_mutex_unlock(&m_renderMutex);
+}
+
+void View::setSoundXruns(unsigned int underruns, unsigned int overruns)
+{
+	pthread_mutex_lock(&m_renderMutex);
+	m_statusbar->setSoundXruns(underruns, overruns);
+	pthread_mutex_unlock(&m_renderMutex);
+}
+
+void View::setFrameProfile(const frameprof_frame_t* frame)
+{
+	pthread_mutex_lock(&m_renderMutex);
+	m_statusbar->addFrameProfile(frame);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 void View::setTapeCounter(int counter)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setTapeCounter(counter);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 void View::setTapeControl(int control)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setTapeControl(control);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 void View::setDriveLed(int drive, int led)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setDriveLed(drive, led);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 void View::setTapeMotorStatus(int motor)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setTapeMotor(motor);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 void View::setDriveTrack(unsigned int drive, unsigned int track)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setDriveTrack(drive, track);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 void View::setDriveDiskPresence(int drive, int disk_in)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setDriveDiskPresence(drive, disk_in);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 void View::setDriveStatus(int drive, int active)
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->setDriveStatus(drive, active);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 int View::showMessage(const char* msg, int msg_type)
 {
 	int ret = 0;
+
+	waitRenderIdle();
 	if (msg_type == 0)
 		gtShowMsgBoxOk(msg);
 	else
@@ -461,8 +762,10 @@ void View::toggleStatusbarOnView()
 
 void View::toggleKeyboardOnView()
 {
+	pthread_mutex_lock(&m_renderMutex);
 	m_keyboard->toggleVisibility();
 	m_keyboard->clear();
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 string	View::getGameSaveDirPath()
@@ -521,7 +824,10 @@ bool View::isBorderlessView()
 
 void View::scanControls(ControlPadMap** maps, int* size, bool scan_mouse)
 {
+	// The keyboard is also read by the render thread.
+	pthread_mutex_lock(&m_renderMutex);
 	m_controlPad->scan(maps, size, g_keyboardStatus == KEYBOARD_UP, scan_mouse);
+	pthread_mutex_unlock(&m_renderMutex);
 }
 
 string View::showMainMenu()
@@ -701,10 +1007,47 @@ void View::changeKeyboardMode(const char* value)
 
 void View::changeTextureFilter(const char* value)
 {
+	SceGxmTextureFilter filter;
+
 	if (!strcmp(value, "Linear"))
-		vita2d_texture_set_filters(m_view_tex, (SceGxmTextureFilter)SCE_GXM_TEXTURE_FILTER_LINEAR, (SceGxmTextureFilter)SCE_GXM_TEXTURE_FILTER_LINEAR);
+		filter = (SceGxmTextureFilter)SCE_GXM_TEXTURE_FILTER_LINEAR;
 	else if (!strcmp(value, "Point"))
-		vita2d_texture_set_filters(m_view_tex, (SceGxmTextureFilter)SCE_GXM_TEXTURE_FILTER_POINT, (SceGxmTextureFilter)SCE_GXM_TEXTURE_FILTER_POINT);
+		filter = (SceGxmTextureFilter)SCE_GXM_TEXTURE_FILTER_POINT;
+	else
+		return;
+
+	waitRenderIdle();
+
+	for (int i=0; i<VIEW_FRAME_COUNT; ++i){
+		if (m_frames[i].tex)
+			vita2d_texture_set_filters(m_frames[i].tex, filter, filter);
+	}
+}
+
+void View::changeCrtEmulation(const char* value)
+{
+	// The PAL filter renders the frames at the size of the view, the scanlines at
+	// double height.
+
+	int scale = 0;
+
+	if (!strcmp(value, "PAL"))
+		scale = 1;
+	else if (!strcmp(value, "Scanlines"))
+		scale = 2;
+
+	// Needs an indexed draw buffer.
+	if (m_viewBitDepth != 8)
+		scale = 0;
+
+	waitRenderIdle();
+
+	m_controller->setCrtEmulation(scale? value: "Off");
+
+	if (scale != m_frameScale){
+		m_frameScale = scale;
+		createFrameTextures();
+	}
 }
 
 void View::setHostCpuFrequency(const char* freq)
@@ -777,6 +1120,9 @@ void View::setProperty(int key, const char* value)
 	case TEXTURE_FILTER:
 		changeTextureFilter(value);
 		break;
+	case CRT_EMULATION:
+		changeCrtEmulation(value);
+		break;
 	case BORDERS:
 		m_controller->setBorderVisibility(value);
 		break;
@@ -792,6 +1138,19 @@ void View::setProperty(int key, const char* value)
 	case HOST_CPU_SPEED:
 		setHostCpuFrequency(value);
 		break;
+	case FRAME_PROFILER:
+		m_showProfile = strcmp(value, "Off")? true: false;
+		m_controller->setFrameProfiler(value);
+		break;
+	case REWIND:
+		m_controller->setRewind(value);
+		break;
+	case RUNAHEAD:
+		m_controller->setRunAhead(value);
+		break;
+	case DRIVE_THREAD:
+		m_controller->setDriveThread(value);
+		break;
 	}
 }
 
@@ -815,6 +1174,8 @@ void View::getSettingValues(int key, const char** value, const char** src, const
 
 void View::activateMenu()
 {
+	// The menus draw on this thread.
+	waitRenderIdle();
 	doModal();
 }
 
@@ -833,46 +1194,128 @@ bool View::pendingRedraw()
 		return true;
 	}
 
-	if (m_keyboard->isUpdated())
-		return true;
-	
-	if (m_showStatusbar && m_statusbar->isUpdated())
-		return true;
+	bool updated;
 
-	return false;
+	pthread_mutex_lock(&m_renderMutex);
+	updated = m_keyboard->isUpdated() || (m_showStatusbar && m_statusbar->isUpdated());
+	pthread_mutex_unlock(&m_renderMutex);
+
+	return updated;
 }
 
-unsigned char* View::getThumbnail()
+unsigned char* View::getThumbnail(int width, int height, uint32_t* palette)
 {
-	uint32_t* palette_tbl = (uint32_t*)vita2d_texture_get_palette(m_view_tex);
-	
-	if (!palette_tbl)
+	// Returns the view without the borders scaled to width x height. The pixels are RGB 
+	// (3 bytes), or palette indices (1 byte) if the palette is given, in which case the 
+	// 256 entry palette is copied to it. Remember to deallocate.
+
+	if (!m_view_tex_data || m_viewBitDepth != 8 || !m_paletteSize || width <= 0 || height <= 0)
 		return NULL;
 
-	static ViewPort vp;
+	const uint32_t* palette_tbl = m_palette;
+
+	ViewPort vp;
 
 	// Remove the borders
 	if (m_controller->getViewport(&vp, false) < 0)
 		return NULL;
-	
-	unsigned char* bitmap = new unsigned char[vp.width * vp.height * 3];
+
+	// Nearest source column of each thumbnail column.
+	int* src_x = new int[width];
+	for (int j = 0; j < width; j++)
+		src_x[j] = vp.x + j * vp.width / width;
+
+	unsigned char* bitmap = new unsigned char[width * height * (palette? 1: 3)];
 	unsigned char* p = bitmap;
-	unsigned char* pixel = m_view_tex_data + (vp.y * m_width + vp.x);
 
-	for (int i = 0; i < vp.height; i++)
-    {
-		for (int j = 0; j < vp.width; j++, pixel++)
+	// The columns are usually taken 1:1, only the lines are sampled.
+	bool columns_1to1 = (width == vp.width);
+
+#ifdef THUMBNAIL_NEON
+	// The red, green and blue bytes of the first 16 palette entries, as vtbl tables.
+	uint8x8x2_t tbl_r, tbl_g, tbl_b;
+	if (!palette && columns_1to1){
+		uint8_t r[16], g[16], b[16];
+		for (int k = 0; k < 16; k++){
+			r[k] = palette_tbl[k];
+			g[k] = palette_tbl[k] >> 8;
+			b[k] = palette_tbl[k] >> 16;
+		}
+		tbl_r.val[0] = vld1_u8(r); tbl_r.val[1] = vld1_u8(r + 8);
+		tbl_g.val[0] = vld1_u8(g); tbl_g.val[1] = vld1_u8(g + 8);
+		tbl_b.val[0] = vld1_u8(b); tbl_b.val[1] = vld1_u8(b + 8);
+	}
+#endif
+
+	for (int i = 0; i < height; i++)
+	{
+		const unsigned char* line = m_view_tex_data + (vp.y + i * vp.height / height) * m_width;
+		int j = 0;
+
+		if (palette){
+			if (columns_1to1){
+				memcpy(p, line + vp.x, width);
+				p += width;
+				continue;
+			}
+			for (; j < width; j++)
+				*p++ = line[src_x[j]];
+			continue;
+		}
+
+#ifdef THUMBNAIL_NEON
+		// Sixteen pixels at a time: each of the colour bytes is looked up from its
+		// table and vst3 interleaves them to RGB. A block with a colour past the
+		// tables is left to the loops below, together with the rest of the line.
+		if (columns_1to1){
+			for (; j + 16 <= width; j += 16, p += 48)
+			{
+				uint8x16_t idx = vld1q_u8(line + vp.x + j);
+				uint8x8_t lo = vget_low_u8(idx);
+				uint8x8_t hi = vget_high_u8(idx);
+
+				if (vget_lane_u64(vreinterpret_u64_u8(vorr_u8(lo, hi)), 0) & 0xf0f0f0f0f0f0f0f0ULL)
+					break;
+
+				uint8x16x3_t rgb;
+				rgb.val[0] = vcombine_u8(vtbl2_u8(tbl_r, lo), vtbl2_u8(tbl_r, hi));
+				rgb.val[1] = vcombine_u8(vtbl2_u8(tbl_g, lo), vtbl2_u8(tbl_g, hi));
+				rgb.val[2] = vcombine_u8(vtbl2_u8(tbl_b, lo), vtbl2_u8(tbl_b, hi));
+				vst3q_u8(p, rgb);
+			}
+		}
+#endif
+
+		// Four pixels at a time. The palette entries are little endian r,g,b,a bytes, 
+		// so the alpha bytes are shifted out and the colours packed to three words.
+		for (; j + 4 <= width; j += 4, p += 12)
+		{
+			uint32_t c0 = palette_tbl[line[src_x[j]]];
+			uint32_t c1 = palette_tbl[line[src_x[j+1]]];
+			uint32_t c2 = palette_tbl[line[src_x[j+2]]];
+			uint32_t c3 = palette_tbl[line[src_x[j+3]]];
+			uint32_t rgb[3];
+
+			rgb[0] = (c0 & 0x00ffffff) | (c1 << 24);
+			rgb[1] = ((c1 >> 8) & 0x0000ffff) | (c2 << 16);
+			rgb[2] = ((c2 >> 16) & 0x000000ff) | (c3 << 8);
+			memcpy(p, rgb, 12);
+		}
+
+		for (; j < width; j++, p += 3)
 		{
 			//palette table value: r | (g << 8) | (b << 16) | (0xFF << 24);
-			p[0] = palette_tbl[*pixel]; // red
-			p[1] = (palette_tbl[*pixel] >> 8); // green
-			p[2] = (palette_tbl[*pixel] >> 16); // blue
-			p += 3;
+			uint32_t c = palette_tbl[line[src_x[j]]];
+			p[0] = c; // red
+			p[1] = c >> 8; // green
+			p[2] = c >> 16; // blue
 		}
+	}
 
-		pixel += (m_width - vp.width);
-    } 
+	if (palette)
+		memcpy(palette, palette_tbl, 256 * sizeof(uint32_t));
 
+	delete[] src_x;
 	return bitmap;
 }
 
@@ -881,7 +1324,9 @@ void View::notifyReset()
 	// Notification that Model is about to reset.
 
 	//m_peripherals->notifyReset();
+	pthread_mutex_lock(&m_renderMutex);
 	m_statusbar->notifyReset();
+	pthread_mutex_unlock(&m_renderMutex);
 	updateControls();
 	updateSettings();
 }
@@ -26,6 +26,7 @@
 #include "vkeyboard.h"
 #include <string>
 #include <psp2/types.h>
+#include <pthread.h>
 
 
 using std::string;
@@ -39,6 +40,24 @@ typedef struct{
 	int height;
 } ViewPort;
 
+// Number of frames in the render pipeline: one waiting, one being drawn 
+// and one being filled.
+#define VIEW_FRAME_COUNT 3
+
+typedef struct{
+	vita2d_texture*	tex;
+	ViewPort		viewport;
+	float			posX;
+	float			posY;
+	float			scaleX;
+	float			scaleY;
+	bool			clear;
+	bool			keyboard;
+	bool			statusbar;
+	bool			paused;
+	bool			profile;
+} ViewFrame;
+
 extern string			g_game_file;
 extern vita2d_texture** g_instructionBitmaps;
 
@@ -56,6 +75,8 @@ class FileExplorer;
 class vita2d_texture;
 class IRenderable;
 struct FileInfo;
+struct frameprof_frame_s;
+typedef struct frameprof_frame_s frameprof_frame_t;
 class View
 {
 
@@ -66,8 +87,20 @@ private:
 	float			m_scaleX;
 	float			m_scaleY;
 	ViewPort		m_viewport;
-	vita2d_texture*	m_view_tex;
+	ViewFrame		m_frames[VIEW_FRAME_COUNT];
 	unsigned char*	m_view_tex_data;
+	int				m_frameScale;		// 0: indexed frames, else CRT lines per view line
+	uint32_t		m_palette[256];
+	int				m_paletteSize;
+	int				m_readyFrame;
+	int				m_drawingFrame;
+	bool			m_renderQuit;
+	bool			m_renderThreadRunning;
+	pthread_t		m_renderThread;
+	pthread_mutex_t	m_frameMutex;
+	pthread_cond_t	m_frameCond;
+	pthread_cond_t	m_idleCond;
+	pthread_mutex_t	m_renderMutex;
 
 	Controller*		m_controller;
 	ControlPad*		m_controlPad;
@@ -91,6 +124,7 @@ private:
 	bool			m_statusbarMask;
 	bool			m_displayPause;
 	bool			m_pendingDraw;
+	bool			m_showProfile;
 	
 	string			showMainMenu();
 	void			showStartGame();
@@ -114,6 +148,7 @@ private:
 	void			changeAspectRatio(const char* value);
 	void			changeKeyboardMode(const char* value);
 	void			changeTextureFilter(const char* value);
+	void			changeCrtEmulation(const char* value);
 	void			changeJoystickScanSide(const char* side);
 	void			waitKeysIdle();
 	string			getFileNameNoExt(const char* fpath);
@@ -123,6 +158,15 @@ private:
 	void			cleanTmpDir();
 	string			getLastBrowserDir();
 	void			printTestRect();
+	bool			viewCoversScreen();
+	ViewFrame*		prepareFrame(int index);
+	void			renderFrame(ViewFrame* frame);
+	static void*	renderThread(void* arg);
+	void			waitRenderIdle();
+	void			stopRenderThread();
+	void			freeViewTextures();
+	void			createFrameTextures();
+	void			freeFrameTextures();
 
 public: 
 					View();
@@ -133,12 +177,15 @@ public:
 	void			scanControls(ControlPadMap** maps, int* size, bool scan_mouse);
 	int				createView(int width, int height, int bpp);
 	void			updateView();
+	bool			isViewDirty(const uint32_t* dirty_lines, unsigned int num_lines);
 	void			updateViewPos();
 	void			updateViewport(int x, int y, int width, int height);
 	void			getViewInfo(int* width, int* height, unsigned char** ppixels, int* pitch, int* bpp);
 	void			getViewportInfo(int* x, int* y, int* width, int* height);
 	void			setPalette(unsigned char* palette, int size);
 	void			setFPSCount(int fps, int percent, int warp_flag);
+	void			setSoundXruns(unsigned int underruns, unsigned int overruns);
+	void			setFrameProfile(const frameprof_frame_t* frame);
 	void			setTapeCounter(int count);
 	void			setTapeControl(int status);
 	void			setDriveLed(int drive, int led);
@@ -155,7 +202,7 @@ public:
 	void			applyAllSettings();
 	void			setProperty(int key, const char* value);
 	void			activateMenu();
-	unsigned char*	getThumbnail();
+	unsigned char*	getThumbnail(int width, int height, uint32_t* palette = NULL);
 	void			notifyReset();
 	void			onSettingChanged(int key, const char* value, const char* src, const char** values, int size, int mask);
 	void			getSettingValues(int key, const char** value, const char** src, const char*** values, int* size);
@@ -28,6 +28,7 @@
  */
 
 #include "vice.h"
+#include "drivethread.h"
 #include "kbdbuf.h"
 #include "ui.h"
 #include "vsyncapi.h"
@@ -36,24 +37,39 @@
 #include "debug_psv.h"
 
 #include <time.h>
+#ifdef PSVITA
 #include <psp2/rtc.h> 
 #include <psp2/kernel/threadmgr.h> 
+#else
+#include <unistd.h>
+#endif
 
 
 /* Number of timer units per second. */
 unsigned long vsyncarch_frequency(void)
 {
     /* Microseconds resolution. */
+#ifdef PSVITA
     return sceRtcGetTickResolution();
+#else
+    return 1000000;
+#endif
 }
 
 /* Get time in timer units. */
 unsigned long vsyncarch_gettime(void)
 {
+#ifdef PSVITA
 	SceRtcTick ticks;
 	sceRtcGetCurrentTick(&ticks);	
 
     return ticks.tick;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (unsigned long)now.tv_sec * 1000000UL + now.tv_nsec / 1000;
+#endif
 }
 
 void vsyncarch_init(void)
@@ -69,11 +85,17 @@ void vsyncarch_display_speed(double speed, double frame_rate, int warp_enabled)
 /* Sleep a number of timer units. */
 void vsyncarch_sleep(unsigned long delay)
 {
+#ifdef PSVITA
 	sceKernelDelayThread(delay);
+#else
+    usleep(delay);
+#endif
 }
 
 void vsyncarch_presync(void)
 {
+	/* The controller may attach images or change the drive settings.  */
+	drive_thread_stop();
 	PSV_ScanControls();
     kbdbuf_flush();
 }
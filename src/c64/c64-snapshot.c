@@ -37,6 +37,7 @@
 #include "cia.h"
 #include "drive-snapshot.h"
 #include "drive.h"
+#include "drivethread.h"
 #include "ioutil.h"
 #include "joyport.h"
 #include "joystick.h"
@@ -56,15 +57,17 @@
 #define SNAP_MAJOR 1
 #define SNAP_MINOR 1
 
-int c64_snapshot_write(const char *name, int save_roms, int save_disks, int event_mode)
+snapshot_t *c64_snapshot_create(const char *name, snapshot_buffer_t *buffer)
 {
-    snapshot_t *s;
-
-    s = snapshot_create(name, ((uint8_t)(SNAP_MAJOR)), ((uint8_t)(SNAP_MINOR)), machine_get_name());
-    if (s == NULL) {
-        return -1;
+    if (name == NULL) {
+        return snapshot_memory_create(((uint8_t)(SNAP_MAJOR)), ((uint8_t)(SNAP_MINOR)), machine_get_name(), buffer);
     }
 
+    return snapshot_create(name, ((uint8_t)(SNAP_MAJOR)), ((uint8_t)(SNAP_MINOR)), machine_get_name());
+}
+
+int c64_snapshot_write_modules(snapshot_t *s, int save_roms, int save_disks, int event_mode)
+{
     sound_snapshot_prepare();
 
     /* Execute drive CPUs to get in sync with the main CPU.  */
@@ -85,31 +88,48 @@ int c64_snapshot_write(const char *name, int save_roms, int save_disks, int even
         || joyport_snapshot_write_module(s, JOYPORT_1) < 0
         || joyport_snapshot_write_module(s, JOYPORT_2) < 0
         || userport_snapshot_write_module(s) < 0) {
-        snapshot_close(s);
-        ioutil_remove(name);
         return -1;
     }
 
-    snapshot_close(s);
     return 0;
 }
 
-int c64_snapshot_read(const char *name, int event_mode)
+int c64_snapshot_write(const char *name, int save_roms, int save_disks, int event_mode)
 {
     snapshot_t *s;
-    uint8_t minor, major;
 
-    s = snapshot_open(name, &major, &minor, machine_get_name());
+    s = c64_snapshot_create(name, NULL);
     if (s == NULL) {
         return -1;
     }
 
+    if (c64_snapshot_write_modules(s, save_roms, save_disks, event_mode) < 0) {
+        snapshot_close(s);
+        ioutil_remove(name);
+        return -1;
+    }
+
+    /* The file is only written here.  */
+    if (snapshot_close(s) < 0) {
+        ioutil_remove(name);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int c64_snapshot_read_modules(snapshot_t *s, uint8_t major, uint8_t minor, int event_mode)
+{
     if (major != SNAP_MAJOR || minor != SNAP_MINOR) {
         log_error(LOG_DEFAULT, "Snapshot version (%d.%d) not valid: expecting %d.%d.", major, minor, SNAP_MAJOR, SNAP_MINOR);
         snapshot_set_error(SNAPSHOT_MODULE_INCOMPATIBLE);
-        goto fail;
+        return -1;
     }
 
+    /* The drives must not run on their thread while the clocks are
+       restored.  */
+    drive_thread_stop();
+
     vicii_snapshot_prepare();
 
     joyport_clear_devices();
@@ -129,7 +149,19 @@ int c64_snapshot_read(const char *name, int event_mode)
         || joyport_snapshot_read_module(s, JOYPORT_1) < 0
         || joyport_snapshot_read_module(s, JOYPORT_2) < 0
         || userport_snapshot_read_module(s) < 0) {
-        goto fail;
+        return -1;
+    }
+
+    return 0;
+}
+
+/* Read the modules of an open snapshot and close it.  */
+static int c64_snapshot_read_and_close(snapshot_t *s, uint8_t major, uint8_t minor, int event_mode)
+{
+    if (c64_snapshot_read_modules(s, major, minor, event_mode) < 0) {
+        snapshot_close(s);
+        machine_trigger_reset(MACHINE_RESET_MODE_SOFT);
+        return -1;
     }
 
     snapshot_close(s);
@@ -137,13 +169,30 @@ int c64_snapshot_read(const char *name, int event_mode)
     sound_snapshot_finish();
 
     return 0;
+}
 
-fail:
-    if (s != NULL) {
-        snapshot_close(s);
+int c64_snapshot_read(const char *name, int event_mode)
+{
+    snapshot_t *s;
+    uint8_t minor, major;
+
+    s = snapshot_open(name, &major, &minor, machine_get_name());
+    if (s == NULL) {
+        return -1;
     }
 
-    machine_trigger_reset(MACHINE_RESET_MODE_SOFT);
+    return c64_snapshot_read_and_close(s, major, minor, event_mode);
+}
+
+int c64_snapshot_read_memory(const uint8_t *data, size_t size, int event_mode)
+{
+    snapshot_t *s;
+    uint8_t minor, major;
+
+    s = snapshot_memory_open(data, size, &major, &minor, machine_get_name());
+    if (s == NULL) {
+        return -1;
+    }
 
-    return -1;
+    return c64_snapshot_read_and_close(s, major, minor, event_mode);
 }
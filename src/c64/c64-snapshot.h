@@ -27,6 +27,14 @@
 #ifndef VICE_C64_SNAPSHOT_H
 #define VICE_C64_SNAPSHOT_H
 
+#include "snapshot.h"
+#include "types.h"
+
 extern int c64_snapshot_write(const char *name, int save_roms, int save_disks, int event_mode);
 extern int c64_snapshot_read(const char *name, int event_mode);
+
+extern snapshot_t *c64_snapshot_create(const char *name, snapshot_buffer_t *buffer);
+extern int c64_snapshot_write_modules(snapshot_t *s, int save_roms, int save_disks, int event_mode);
+extern int c64_snapshot_read_memory(const uint8_t *data, size_t size, int event_mode);
+
 #endif
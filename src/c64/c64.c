@@ -1318,6 +1318,21 @@ int machine_read_snapshot(const char *name, int event_mode)
     return c64_snapshot_read(name, event_mode);
 }
 
+snapshot_t *machine_snapshot_create(const char *name, snapshot_buffer_t *buffer)
+{
+    return c64_snapshot_create(name, buffer);
+}
+
+int machine_write_snapshot_modules(snapshot_t *s, int save_roms, int save_disks, int event_mode)
+{
+    return c64_snapshot_write_modules(s, save_roms, save_disks, event_mode);
+}
+
+int machine_read_snapshot_memory(const uint8_t *data, size_t size, int event_mode)
+{
+    return c64_snapshot_read_memory(data, size, event_mode);
+}
+
 /* ------------------------------------------------------------------------- */
 /* FIXME: those two shouldnt be here anymore */
 int machine_autodetect_psid(const char *name)
@@ -25,6 +25,7 @@
 
 #include "vice.h"
 
+#include "c64mem.h"
 #include "maincpu.h"
 #include "mem.h"
 
@@ -51,6 +52,8 @@
  - DMA_FUNC
  - DMA_ON_RESET
  - CHECK_AND_RUN_ALTERNATE_CPU
+ - ALTERNATE_CPU_STARTED (with CHECK_AND_RUN_ALTERNATE_CPU, for
+   CPU_THREADED_DISPATCH)
 
 */
 
@@ -123,6 +126,35 @@ static void check_and_run_alternate_cpu(void)
 
 #define CHECK_AND_RUN_ALTERNATE_CPU check_and_run_alternate_cpu();
 
+#define ALTERNATE_CPU_STARTED() cpmcart_z80_started
+
+#ifndef FEATURE_CPUMEMHISTORY
+/* Plain RAM pages are accessed directly, the others through the tables.  */
+inline static uint8_t c64cpu_load(unsigned int addr)
+{
+    uint8_t *p = _mem_read_ram_tab_ptr[addr >> 8];
+
+    if (p != NULL) {
+        return p[addr];
+    }
+    return (*_mem_read_tab_ptr[addr >> 8])((uint16_t)addr);
+}
+
+inline static void c64cpu_store(unsigned int addr, uint8_t value)
+{
+    uint8_t *p = _mem_write_ram_tab_ptr[addr >> 8];
+
+    if (p != NULL) {
+        p[addr] = value;
+    } else {
+        (*_mem_write_tab_ptr[addr >> 8])((uint16_t)addr, value);
+    }
+}
+
+#define LOAD(addr) c64cpu_load((unsigned int)(addr))
+#define STORE(addr, value) c64cpu_store((unsigned int)(addr), (uint8_t)(value))
+#endif
+
 #define HAVE_Z80_REGS
 
 #include "../maincpu.c"
@@ -99,6 +99,10 @@ store_func_ptr_t *_mem_write_tab_ptr;
 static uint8_t **_mem_read_base_tab_ptr;
 static uint32_t *mem_read_limit_tab_ptr;
 
+/* Pointers to the currently used tables of plain RAM pages.  */
+uint8_t **_mem_read_ram_tab_ptr;
+uint8_t **_mem_write_ram_tab_ptr;
+
 /* Memory read and write tables.  */
 static store_func_ptr_t mem_write_tab[NUM_VBANKS][NUM_CONFIGS][0x101];
 static read_func_ptr_t mem_read_tab[NUM_CONFIGS][0x101];
@@ -108,6 +112,15 @@ static uint32_t mem_read_limit_tab[NUM_CONFIGS][0x101];
 static store_func_ptr_t mem_write_tab_watch[0x101];
 static read_func_ptr_t mem_read_tab_watch[0x101];
 
+/* Pages that are plain RAM, i.e. read with `ram_read()' or written with
+   `ram_store()', point to `mem_ram' so that the CPU can access them
+   directly.  The other pages are NULL.  */
+static uint8_t *mem_read_ram_tab[NUM_CONFIGS][0x101];
+static uint8_t *mem_write_ram_tab[NUM_VBANKS][NUM_CONFIGS][0x101];
+
+/* No direct access while watchpoints are active.  */
+static uint8_t *mem_ram_tab_watch[0x101];
+
 /* Current video bank (0, 1, 2 or 3).  */
 static int vbank;
 
@@ -156,9 +169,13 @@ void mem_toggle_watchpoints(int flag, void *context)
     if (flag) {
         _mem_read_tab_ptr = mem_read_tab_watch;
         _mem_write_tab_ptr = mem_write_tab_watch;
+        _mem_read_ram_tab_ptr = mem_ram_tab_watch;
+        _mem_write_ram_tab_ptr = mem_ram_tab_watch;
     } else {
         _mem_read_tab_ptr = mem_read_tab[mem_config];
         _mem_write_tab_ptr = mem_write_tab[vbank][mem_config];
+        _mem_read_ram_tab_ptr = mem_read_ram_tab[mem_config];
+        _mem_write_ram_tab_ptr = mem_write_ram_tab[vbank][mem_config];
     }
     watchpoints_active = flag;
 }
@@ -214,9 +231,13 @@ void mem_pla_config_changed(void)
     if (watchpoints_active) {
         _mem_read_tab_ptr = mem_read_tab_watch;
         _mem_write_tab_ptr = mem_write_tab_watch;
+        _mem_read_ram_tab_ptr = mem_ram_tab_watch;
+        _mem_write_ram_tab_ptr = mem_ram_tab_watch;
     } else {
         _mem_read_tab_ptr = mem_read_tab[mem_config];
         _mem_write_tab_ptr = mem_write_tab[vbank][mem_config];
+        _mem_read_ram_tab_ptr = mem_read_ram_tab[mem_config];
+        _mem_write_ram_tab_ptr = mem_write_ram_tab[vbank][mem_config];
     }
 
     _mem_read_base_tab_ptr = mem_read_base_tab[mem_config];
@@ -664,6 +685,32 @@ void mem_read_base_set(unsigned int base, unsigned int index, uint8_t *mem_ptr)
     mem_read_base_tab[base][index] = mem_ptr;
 }
 
+/* Find the plain RAM pages of all the memory configurations.  The last
+   page is a copy of page 0 for accesses that wrap around; it is never
+   accessed directly.  */
+static void mem_ram_tab_init(void)
+{
+    int i, j, k;
+
+    for (i = 0; i < NUM_CONFIGS; i++) {
+        for (j = 0; j < 0x100; j++) {
+            mem_read_ram_tab[i][j] = (mem_read_tab[i][j] == ram_read) ? mem_ram : NULL;
+            for (k = 0; k < NUM_VBANKS; k++) {
+                mem_write_ram_tab[k][i][j] = (mem_write_tab[k][i][j] == ram_store) ? mem_ram : NULL;
+            }
+        }
+        mem_read_ram_tab[i][0x100] = NULL;
+        for (k = 0; k < NUM_VBANKS; k++) {
+            mem_write_ram_tab[k][i][0x100] = NULL;
+        }
+    }
+
+    if (!watchpoints_active) {
+        _mem_read_ram_tab_ptr = mem_read_ram_tab[mem_config];
+        _mem_write_ram_tab_ptr = mem_write_ram_tab[vbank][mem_config];
+    }
+}
+
 void mem_initialize_memory(void)
 {
     int i, j, k;
@@ -783,6 +830,9 @@ void mem_initialize_memory(void)
     if (board == 1) {
         mem_limit_max_init(mem_read_limit_tab);
     }
+
+    /* The expansions above are the last ones to set up the tables.  */
+    mem_ram_tab_init();
 }
 
 void mem_mmu_translate(unsigned int addr, uint8_t **base, int *start, int *limit)
@@ -820,6 +870,7 @@ void mem_set_vbank(int new_vbank)
     /* Do not override watchpoints on vbank switches.  */
     if (_mem_write_tab_ptr != mem_write_tab_watch) {
         _mem_write_tab_ptr = mem_write_tab[new_vbank][mem_config];
+        _mem_write_ram_tab_ptr = mem_write_ram_tab[new_vbank][mem_config];
     }
 
     vicii_set_vbank(new_vbank);
@@ -62,6 +62,12 @@ extern int c64_mem_init_cmdline_options(void);
 
 extern void mem_set_vbank(int new_vbank);
 
+/* Direct pointers to the plain RAM pages of the current configuration,
+   indexed by page, or NULL if the page must be accessed through
+   `_mem_read_tab_ptr' and `_mem_write_tab_ptr'.  */
+extern uint8_t **_mem_read_ram_tab_ptr;
+extern uint8_t **_mem_write_ram_tab_ptr;
+
 extern uint8_t ram_read(uint16_t addr);
 extern void ram_store(uint16_t addr, uint8_t value);
 extern void ram_hi_store(uint16_t addr, uint8_t value);
@@ -87,7 +87,7 @@ static uint8_t reg_f2 = 0;
 static uint8_t reg_h2 = 0;
 static uint8_t reg_l2 = 0;
 
-static int z80_started = 0;
+int cpmcart_z80_started = 0;
 static int cpmcart_enabled = 0;
 
 static read_func_ptr_t cpmcart_mem_read_tab[0x101];
@@ -183,10 +183,10 @@ static void cpmcart_io_store(uint16_t addr, uint8_t byte)
 {
     int val = byte & 1;
 
-    if (!z80_started && !val) {
-        z80_started = 1;
-    } else if (z80_started && val) {
-        z80_started = 0;
+    if (!cpmcart_z80_started && !val) {
+        cpmcart_z80_started = 1;
+    } else if (cpmcart_z80_started && val) {
+        cpmcart_z80_started = 0;
     }
 }
 
@@ -197,7 +197,7 @@ int cpmcart_cart_enabled(void)
 
 static int cpmcart_dump(void)
 {
-    mon_out("Active CPU: %s\n", z80_started ? "Z80" : "6510");
+    mon_out("Active CPU: %s\n", cpmcart_z80_started ? "Z80" : "6510");
     return 0;
 }
 
@@ -238,7 +238,7 @@ static int set_cpmcart_enabled(int value, void *param)
             io_source_unregister(cpmcart_list_item);
             cpmcart_list_item = NULL;
             cpmcart_enabled = 0;
-            z80_started = 0;
+            cpmcart_z80_started = 0;
         }
     }
     return 0;
@@ -6513,14 +6513,14 @@ static void cpmcart_mainloop(interrupt_cpu_status_t *cpu_int_status, alarm_conte
         }
 
         cpu_int_status->num_dma_per_opcode = 0;
-    } while (z80_started);
+    } while (cpmcart_z80_started);
 
     export_registers();
 }
 
 void cpmcart_check_and_run_z80(void)
 {
-    if (z80_started) {
+    if (cpmcart_z80_started) {
         cpmcart_mainloop(maincpu_int_status, maincpu_alarm_context);
     }
 }
@@ -6606,7 +6606,7 @@ int cpmcart_snapshot_write_module(snapshot_t *s)
         || SMW_B(m, reg_f2) < 0
         || SMW_B(m, reg_h2) < 0
         || SMW_B(m, reg_l2) < 0
-        || SMW_B(m, (uint8_t)z80_started) < 0
+        || SMW_B(m, (uint8_t)cpmcart_z80_started) < 0
         || SMW_DW(m, (uint32_t)z80_last_opcode_info) < 0
         || SMW_DW(m, (uint32_t)z80_last_opcode_addr) < 0) {
         snapshot_module_close(m);
@@ -6667,7 +6667,7 @@ int cpmcart_snapshot_read_module(snapshot_t *s)
         || SMR_B(m, &reg_f2) < 0
         || SMR_B(m, &reg_h2) < 0
         || SMR_B(m, &reg_l2) < 0
-        || SMR_B_INT(m, &z80_started) < 0
+        || SMR_B_INT(m, &cpmcart_z80_started) < 0
         || SMR_DW_UINT(m, &z80_last_opcode_info) < 0
         || SMR_DW_UINT(m, &z80_last_opcode_addr) < 0) {
         goto fail;
@@ -48,6 +48,9 @@ extern int cpmcart_cart_enabled(void);
 extern void cpmcart_clock_stretch(void);
 #endif
 
+/* Non-zero while the Z80 runs instead of the 6510.  */
+extern int cpmcart_z80_started;
+
 extern void cpmcart_check_and_run_z80(void);
 
 typedef int cpmcart_ba_check_callback_t (void);
@@ -176,6 +176,9 @@
 /* Define to 1 if you have the <FLAC/stream_decoder.h> header file. */
 #undef HAVE_FLAC_STREAM_DECODER_H
 
+/* Define to 1 if you have the `fopencookie' function. */
+#define HAVE_FOPENCOOKIE 1
+
 /* Use fontconfig for custom fonts. */
 #undef HAVE_FONTCONFIG
 
@@ -881,8 +884,13 @@
 /* Enable SDL2 UI support. */
 // #define USE_SDLUI2
 
-/* Enable SDL sound support. */
+/* Enable native PS Vita sound support. */
+#define USE_PSV_AUDIO
+
+/* Enable SDL sound support. The host benchmark build has no SDL. */
+#ifndef PSV_BENCH
 #define USE_SDL_AUDIO
+#endif
 
 /* Enable SDL prefix for header inclusion. */
 //#define USE_SDL_PREFIX
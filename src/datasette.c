@@ -60,7 +60,6 @@
 #endif
 
 #define MOTOR_DELAY         32000
-#define TAP_BUFFER_LENGTH   100000
 
 /* at least every DATASETTE_MAX_GAP cycle there should be an alarm */
 #define DATASETTE_MAX_GAP   100000
@@ -69,11 +68,12 @@
 /* Attached TAP tape image.  */
 static tap_t *current_image = NULL;
 
-/* Buffer for the TAP */
-static uint8_t tap_buffer[TAP_BUFFER_LENGTH];
+/* Pulse of the image at current_file_seek_position, and its offset.  */
+static int current_pulse = 0;
+static uint32_t current_offset = 0;
 
-/* Pointer and length of the tap-buffer */
-static long next_tap, last_tap;
+/* Have pulses been recorded since the image was indexed?  */
+static int index_changed = 0;
 
 /* State of the datasette motor.  */
 static int datasette_motor = 0;
@@ -124,6 +124,11 @@ static int datasette_enable = 0;
 
 static log_t datasette_log = LOG_ERR;
 
+#ifdef PSV_BENCH
+/* Machine tape behaviour of the self test, -1 for the machine's.  */
+static int datasette_test_c16 = -1;
+#endif
+
 static void datasette_internal_reset(void);
 static void datasette_event_record(int command);
 static void datasette_control_internal(int command);
@@ -332,75 +337,63 @@ void datasette_reset_counter(void)
 }
 
 
-inline static int datasette_move_buffer_forward(int offset)
+/* Does the machine read the tape as the C16 does?  */
+inline static int datasette_c16(void)
 {
-    /* reads buffer to fit the next gap-read
-       tap_buffer[next_tap] ~ current_file_seek_position
-    */
-    if (next_tap + offset >= last_tap) {
-        if (fseek(current_image->fd, current_image->current_file_seek_position
-                  + current_image->offset, SEEK_SET)) {
-            log_error(datasette_log, "Cannot read in tap-file.");
-            return 0;
-        }
-        last_tap = (long)fread(tap_buffer, 1, TAP_BUFFER_LENGTH, current_image->fd);
-        next_tap = 0;
-        if (next_tap >= last_tap) {
-            return 0;
-        }
+#ifdef PSV_BENCH
+    if (datasette_test_c16 >= 0) {
+        return datasette_test_c16;
     }
-    return 1;
+#endif
+    return machine_tape_behaviour() == TAPE_BEHAVIOUR_C16;
 }
 
-inline static int datasette_move_buffer_back(int offset)
+/* Find the pulse at current_file_seek_position again, if the position has
+   been moved by the tape image functions or a snapshot.  */
+inline static void datasette_sync_pulse(void)
 {
-    /* reads buffer to fit the next gap-read at current_file_seek_position-1
-       tap_buffer[next_tap] ~ current_file_seek_position
-    */
-    if (next_tap + offset < 0) {
-        if (current_image->current_file_seek_position >= TAP_BUFFER_LENGTH) {
-            next_tap = TAP_BUFFER_LENGTH;
-        } else {
-            next_tap = current_image->current_file_seek_position;
-        }
-        if (fseek(current_image->fd, current_image->current_file_seek_position
-                  - next_tap + current_image->offset, SEEK_SET)) {
-            log_error(datasette_log, "Cannot read in tap-file.");
-            return 0;
-        }
-        last_tap = (long)fread(tap_buffer, 1, TAP_BUFFER_LENGTH, current_image->fd);
-        if (next_tap > last_tap) {
-            return 0;
+    if (current_pulse > current_image->num_pulses
+        || current_offset != (uint32_t)current_image->current_file_seek_position) {
+        current_pulse = tap_find_pulse(current_image,
+                                       current_image->current_file_seek_position,
+                                       &current_offset);
+    }
+}
+
+/* Gap without wobble of the pulse at the offset `offset'.  */
+inline static CLOCK datasette_pulse_gap(uint32_t offset)
+{
+    const uint8_t *data;
+    CLOCK gap;
+
+    data = current_image->data + current_image->offset + offset;
+    gap = data[0];
+
+    if ((current_image->version == 0) || gap) {
+        gap = (gap ? (CLOCK)(gap * 8) : (CLOCK)datasette_zero_gap_delay)
+              + (CLOCK)datasette_speed_tuning;
+    } else {
+        gap = data[1] + (data[2] << 8) + (data[3] << 16);
+        if (!gap) {
+            gap = (CLOCK)datasette_zero_gap_delay;
         }
     }
-    return 1;
+    return gap;
 }
 
-inline static int fetch_gap(CLOCK *gap, int *direction, long read_tap)
+inline static int fetch_gap(CLOCK *gap, int pulse, uint32_t offset)
 {
     int wobble;
 
-    if ((read_tap >= last_tap) || (read_tap < 0)) {
+    if ((pulse < 0) || (pulse >= current_image->num_pulses)) {
         return -1;
     }
 
-    *gap = tap_buffer[read_tap];
-
-    if ((current_image->version == 0) || *gap) {
-        *gap = (*gap ? (CLOCK)(*gap * 8) : (CLOCK)datasette_zero_gap_delay)
-               + (CLOCK)datasette_speed_tuning;
-    } else {
-        if (read_tap >= last_tap - 3) {
-            return -1;
-        }
-        *direction *= 4;
-        *gap = tap_buffer[read_tap + 1]
-               + (tap_buffer[read_tap + 2] << 8)
-               + (tap_buffer[read_tap + 3] << 16);
-        if (!(*gap)) {
-            *gap = (CLOCK)datasette_zero_gap_delay;
-        }
+    *gap = datasette_pulse_gap(offset);
+    if (!(*gap)) {
+        return -1;
     }
+
     /* add some random wobble */
     if (datasette_tape_wobble) {
         wobble = lib_unsigned_rand(-datasette_tape_wobble, datasette_tape_wobble);
@@ -413,158 +406,158 @@ inline static int fetch_gap(CLOCK *gap, int *direction, long read_tap)
     return 0;
 }
 
-inline static void read_gap_forward(long *read_tap)
+static CLOCK datasette_read_gap(int direction)
 {
-    *read_tap = next_tap;
-}
+    /* direction 1: forward, -1: rewind */
+    int c16 = datasette_c16();
+    int pulse;
+    uint32_t offset;
+    CLOCK gap = 0;
 
-inline static void read_gap_backward_v0(long *read_tap)
-{
-    *read_tap = next_tap - 1;
-}
+    if (c16 && (current_image->version != 1) && (current_image->version != 2)) {
+        return 0;
+    }
 
-inline static int read_gap_backward_v1(long *read_tap)
-{
-    /* examine, if previous gap was long
-       by rewinding until 3 non-zero-values
-       in a row found, then reading forward (FIXME???)
-    */
-    int non_zeros_in_a_row = 0;
-    long remember_file_seek_position;
+    /* C16 TAPs of version 1 have one pulse for both half waves.  */
+    if (c16 && (current_image->version == 1) && fullwave) {
+        fullwave ^= 1;
+        return fullwave_gap;
+    }
 
-    remember_file_seek_position = current_image->current_file_seek_position;
+    datasette_sync_pulse();
+    if (direction > 0) {
+        pulse = current_pulse;
+        offset = current_offset;
+    } else {
+        pulse = current_pulse - 1;
+        offset = (pulse >= 0) ? tap_pulse_offset(current_image, pulse) : 0;
+    }
 
-    current_image->current_file_seek_position -= 4;
-    next_tap -= 4;
+    if (fetch_gap(&gap, pulse, offset) < 0) {
+        return 0;
+    }
 
-    while ((non_zeros_in_a_row < 3) && current_image->current_file_seek_position) {
-        if (!datasette_move_buffer_back(-1)) {
-            return 1;
-        }
-        current_image->current_file_seek_position--;
-        next_tap--;
-        if (tap_buffer[next_tap]) {
-            non_zeros_in_a_row++;
-        } else {
-            non_zeros_in_a_row = 0;
-        }
+    if (direction > 0) {
+        current_pulse = pulse + 1;
+        current_offset = offset + TAP_PULSE_LEN(current_image, offset);
+    } else {
+        current_pulse = pulse;
+        current_offset = offset;
     }
+    current_image->current_file_seek_position = (int)current_offset;
 
-    /* now forward */
-    while (current_image->current_file_seek_position < remember_file_seek_position - 4) {
-        if (!datasette_move_buffer_forward(1)) {
-            return -1;
-        }
-        if (tap_buffer[next_tap]) {
-            current_image->current_file_seek_position++;
-            next_tap++;
+    if (c16) {
+        if (current_image->version == 1) {
+            fullwave_gap = gap;
         } else {
-            current_image->current_file_seek_position += 4;
-            next_tap += 4;
+            gap *= 2;
         }
+        fullwave ^= 1;
     }
-    if (!datasette_move_buffer_forward(4)) {
-        return -1;
-    }
+    return gap;
+}
 
-    *read_tap = next_tap;
-    next_tap += (remember_file_seek_position - current_image->current_file_seek_position);
-    current_image->current_file_seek_position = remember_file_seek_position;
+/* Tape counter steps of the pulse at the offset `offset', the same as
+   playing it counts them.  */
+static uint32_t datasette_pulse_count(uint32_t offset, int c16)
+{
+    CLOCK gap = datasette_pulse_gap(offset);
 
-    return 0;
+    if (c16) {
+        if (current_image->version == 1) {
+            gap = (gap / 8) * 8 * 2;
+        } else if (current_image->version == 2) {
+            gap *= 2;
+        } else {
+            gap = 0;
+        }
+    }
+    return (uint32_t)(gap / 8);
 }
 
-static CLOCK datasette_read_gap(int direction)
+/* Fill in the tape counter of the pulse index from the entry before
+   `pulse' on.  */
+static void datasette_index_counter(int pulse)
 {
-    /* direction 1: forward, -1: rewind */
-    long read_tap = 0;
-    CLOCK gap = 0;
+    tap_t *tap = current_image;
+    int c16 = datasette_c16();
+    uint32_t offset, counter;
 
-/*    if (current_image->system != 2 || current_image->version != 1
-        || !fullwave) {*/
-    if (machine_tape_behaviour() != TAPE_BEHAVIOUR_C16) {
-        if ((direction < 0) && !datasette_move_buffer_back(direction * 4)) {
-            return 0;
-        }
-        if ((direction > 0 ) && !datasette_move_buffer_forward(direction * 4)) {
-            return 0;
+    pulse = (pulse / TAP_INDEX_STEP) * TAP_INDEX_STEP;
+    if (pulse == 0) {
+        tap->index_counter[0] = 0;
+    }
+    offset = tap->index_offset[pulse / TAP_INDEX_STEP];
+    counter = tap->index_counter[pulse / TAP_INDEX_STEP];
+
+    while (pulse < tap->num_pulses) {
+        counter += datasette_pulse_count(offset, c16);
+        offset += TAP_PULSE_LEN(tap, offset);
+        if (++pulse % TAP_INDEX_STEP == 0) {
+            tap->index_counter[pulse / TAP_INDEX_STEP] = counter;
         }
+    }
 
-        if (direction > 0) {
-            read_gap_forward(&read_tap);
-        } else {
-            if ((current_image->version == 0) || (next_tap < 4) || tap_buffer[next_tap - 4]) {
-                read_gap_backward_v0(&read_tap);
-            } else {
-                if (read_gap_backward_v1(&read_tap) < 0) {
-                    return 0;
-                }
-            }
-        }
-        if (fetch_gap(&gap, &direction, read_tap) < 0) {
-            return 0;
-        }
-        next_tap += direction;
-        current_image->current_file_seek_position += direction;
-    } else if (current_image->version == 1) {
-        if (!fullwave) {
-            if ((direction < 0) && !datasette_move_buffer_back(direction * 4)) {
-                return 0;
-            }
-            if ((direction > 0 ) && !datasette_move_buffer_forward(direction * 4)) {
-                return 0;
-            }
+    tap->cycle_counter_total = (int)counter;
+}
 
-            if (direction > 0) {
-                read_gap_forward(&read_tap);
-            } else {
-                if ((current_image->version == 0) || (next_tap < 4) || tap_buffer[next_tap - 4]) {
-                    read_gap_backward_v0(&read_tap);
-                } else {
-                    if (read_gap_backward_v1(&read_tap) < 0) {
-                        return 0;
-                    }
-                }
-            }
-            if (fetch_gap(&gap, &direction, read_tap) < 0) {
-                return 0;
-            }
+/* Index the pulses recorded since the image was indexed.  */
+static void datasette_update_index(void)
+{
+    int pulse = current_image->num_pulses;
 
-            fullwave_gap = gap;
-            next_tap += direction;
-            current_image->current_file_seek_position += direction;
-        } else {
-            gap = fullwave_gap;
-        }
-        fullwave ^= 1;
-    } else if (current_image->version == 2) {
-        if ((direction < 0) && !datasette_move_buffer_back(direction * 4)) {
-            return 0;
-        }
-        if ((direction > 0 ) && !datasette_move_buffer_forward(direction * 4)) {
-            return 0;
-        }
+    tap_index_pulses(current_image);
+    datasette_index_counter(pulse);
+    index_changed = 0;
 
-        if (direction > 0) {
-            read_gap_forward(&read_tap);
+    /* The pulses may have been numbered differently from the recording on.  */
+    current_pulse = tap_find_pulse(current_image,
+                                   current_image->current_file_seek_position,
+                                   &current_offset);
+}
+
+/* Move the tape to the last pulse that starts at or before the tape counter
+   `counter'.  */
+static void datasette_seek_counter(int counter)
+{
+    tap_t *tap = current_image;
+    int c16 = datasette_c16();
+    int low = 0;
+    int high = tap->num_pulses / TAP_INDEX_STEP;
+    int mid, pulse;
+    uint32_t offset, count, steps;
+
+    while (low < high) {
+        mid = (low + high + 1) / 2;
+        if (tap->index_counter[mid] <= (uint32_t)counter) {
+            low = mid;
         } else {
-            if ((current_image->version == 0) || (next_tap < 4) || tap_buffer[next_tap - 4]) {
-                read_gap_backward_v0(&read_tap);
-            } else {
-                if (read_gap_backward_v1(&read_tap) < 0) {
-                    return 0;
-                }
-            }
+            high = mid - 1;
         }
-        if (fetch_gap(&gap, &direction, read_tap) < 0) {
-            return 0;
+    }
+
+    pulse = low * TAP_INDEX_STEP;
+    offset = tap->index_offset[low];
+    count = tap->index_counter[low];
+    while (pulse < tap->num_pulses) {
+        steps = datasette_pulse_count(offset, c16);
+        if (count + steps > (uint32_t)counter) {
+            break;
         }
-        gap *= 2;
-        fullwave ^= 1;
-        next_tap += direction;
-        current_image->current_file_seek_position += direction;
+        count += steps;
+        offset += TAP_PULSE_LEN(tap, offset);
+        pulse++;
     }
-    return gap;
+
+    current_pulse = pulse;
+    current_offset = offset;
+    tap->current_file_seek_position = (int)offset;
+    tap->cycle_counter = (int)count;
+
+    datasette_long_gap_pending = 0;
+    datasette_long_gap_elapsed = 0;
+    datasette_last_direction = 0;
+    fullwave = 0;
 }
 
 /* this is the alarm function */
@@ -725,28 +718,22 @@ void datasette_init(void)
 
 void datasette_set_tape_image(tap_t *image)
 {
-    CLOCK gap;
-
     DBG(("datasette_set_tape_image (image present:%s)", image ? "yes" : "no"));
 
     current_image = image;
-    last_tap = next_tap = 0;
+    current_pulse = 0;
+    current_offset = 0;
+    index_changed = 0;
     datasette_internal_reset();
 
     if (image != NULL) {
         /* We need the length of tape for realistic counter. */
-        current_image->cycle_counter_total = 0;
-        do {
-            gap = datasette_read_gap(1);
-            current_image->cycle_counter_total += gap / 8;
-        } while (gap);
-        current_image->current_file_seek_position = 0;
+        datasette_index_counter(0);
     }
     if (datasette_list_item) {
         tapeport_set_tape_sense(0, datasette_device.id);
     }
 
-    last_tap = next_tap = 0;
     fullwave = 0;
 
     ui_set_tape_status(current_image ? 1 : 0);
@@ -826,9 +813,6 @@ void datasette_reset(void)
 static void datasette_start_motor(void)
 {
     DBG(("datasette_start_motor (image present:%s)", current_image ? "yes" : "no"));
-    if (current_image) {
-        fseek(current_image->fd, current_image->current_file_seek_position + current_image->offset, SEEK_SET);
-    }
     if (!datasette_alarm_pending) {
         alarm_set(datasette_alarm, maincpu_clk + MOTOR_DELAY);
         datasette_alarm_pending = 1;
@@ -836,14 +820,16 @@ static void datasette_start_motor(void)
 }
 
 #ifdef DEBUG_TAPE
-static char *cmdstr[8] = {
+static char *cmdstr[9] = {
     "DATASETTE_CONTROL_STOP",
     "DATASETTE_CONTROL_START",
     "DATASETTE_CONTROL_FORWARD",
     "DATASETTE_CONTROL_REWIND",
     "DATASETTE_CONTROL_RECORD",
     "DATASETTE_CONTROL_RESET",
-    "DATASETTE_CONTROL_RESET_COUNTER"
+    "DATASETTE_CONTROL_RESET_COUNTER",
+    "DATASETTE_CONTROL_WIND_START",
+    "DATASETTE_CONTROL_WIND_END"
 };
 #endif
 
@@ -851,10 +837,24 @@ static void datasette_control_internal(int command)
 {
     DBG(("datasette_control_internal (%s) (image present:%s)", cmdstr[command], current_image ? "yes" : "no"));
     if (current_image) {
+        if (index_changed) {
+            datasette_update_index();
+        }
         switch (command) {
             case DATASETTE_CONTROL_RESET_COUNTER:
                 datasette_reset_counter();
                 break;
+            case DATASETTE_CONTROL_WIND_START:
+            case DATASETTE_CONTROL_WIND_END:
+                datasette_seek_counter((command == DATASETTE_CONTROL_WIND_START)
+                                       ? 0 : current_image->cycle_counter_total);
+                current_image->mode = DATASETTE_CONTROL_STOP;
+                if (datasette_list_item) {
+                    tapeport_set_tape_sense(0, datasette_device.id);
+                }
+                last_write_clk = (CLOCK)0;
+                datasette_update_ui_counter();
+                break;
             case DATASETTE_CONTROL_RESET:
                 datasette_internal_reset();
                 /* falls through */
@@ -916,6 +916,8 @@ static void datasette_control_internal(int command)
             case DATASETTE_CONTROL_RESET:
                 datasette_internal_reset();
                 /* falls through */
+            case DATASETTE_CONTROL_WIND_START:
+            case DATASETTE_CONTROL_WIND_END:
             case DATASETTE_CONTROL_STOP:
                 notape_mode = DATASETTE_CONTROL_STOP;
                 if (datasette_list_item) {
@@ -961,8 +963,6 @@ static void datasette_control_internal(int command)
         }
         ui_display_tape_control_status(notape_mode);
     }
-    /* clear the tap-buffer */
-    last_tap = next_tap = 0;
 }
 
 void datasette_control(int command)
@@ -1010,7 +1010,8 @@ static void datasette_set_motor(int flag)
 inline static void bit_write(void)
 {
     CLOCK write_time;
-    uint8_t write_gap;
+    uint8_t write_gap[4];
+    int len;
 
     write_time = maincpu_clk - last_write_clk;
     last_write_clk = maincpu_clk;
@@ -1025,33 +1026,27 @@ inline static void bit_write(void)
     }
 
     if (write_time < (CLOCK)(255 * 8 + 7)) {
-        write_gap = (uint8_t)(write_time / (CLOCK)8);
-        if (fwrite(&write_gap, 1, 1, current_image->fd) < 1) {
-            datasette_control(DATASETTE_CONTROL_STOP);
-            return;
-        }
-        current_image->current_file_seek_position++;
+        write_gap[0] = (uint8_t)(write_time / (CLOCK)8);
+        len = 1;
     } else {
-        write_gap = 0;
-        if (fwrite(&write_gap, 1, 1, current_image->fd) != 1) {
-            log_debug("datasette bit_write failed.");
-        }
-        current_image->current_file_seek_position++;
+        write_gap[0] = 0;
+        len = 1;
         if (current_image->version >= 1) {
-            uint8_t long_gap[3];
-            int bytes_written;
-            long_gap[0] = (uint8_t)(write_time & 0xff);
-            long_gap[1] = (uint8_t)((write_time >> 8) & 0xff);
-            long_gap[2] = (uint8_t)((write_time >> 16) & 0xff);
+            write_gap[1] = (uint8_t)(write_time & 0xff);
+            write_gap[2] = (uint8_t)((write_time >> 8) & 0xff);
+            write_gap[3] = (uint8_t)((write_time >> 16) & 0xff);
             write_time &= 0xffffff;
-            bytes_written = (int)fwrite(long_gap, 1, 3, current_image->fd);
-            current_image->current_file_seek_position += bytes_written;
-            if (bytes_written < 3) {
-                datasette_control(DATASETTE_CONTROL_STOP);
-                return;
-            }
+            len = 4;
         }
     }
+    if (tap_write_data(current_image, current_image->current_file_seek_position,
+                       write_gap, len) < 0) {
+        datasette_control(DATASETTE_CONTROL_STOP);
+        return;
+    }
+    current_image->current_file_seek_position += len;
+    index_changed = 1;
+
     if (current_image->size < current_image->current_file_seek_position) {
         current_image->size = current_image->current_file_seek_position;
     }
@@ -1216,10 +1211,42 @@ static int datasette_read_snapshot(snapshot_t *s)
         }
     }
 
-    /* reset buffer */
-    next_tap = last_tap = 0;
-
     snapshot_module_close(m);
 
     return tape_snapshot_read_module(s);
 }
+
+#ifdef PSV_BENCH
+void datasette_test_set_image(tap_t *image, int c16)
+{
+    datasette_test_c16 = c16;
+    datasette_zero_gap_delay = 20000;
+    datasette_speed_tuning = 0;
+    datasette_tape_wobble = 0;
+
+    current_image = image;
+    current_pulse = 0;
+    current_offset = 0;
+    index_changed = 0;
+    fullwave = 0;
+
+    if (image != NULL) {
+        datasette_index_counter(0);
+    }
+}
+
+CLOCK datasette_test_read_gap(int direction)
+{
+    return datasette_read_gap(direction);
+}
+
+void datasette_test_seek_counter(int counter)
+{
+    datasette_seek_counter(counter);
+}
+
+void datasette_test_update_index(void)
+{
+    datasette_update_index();
+}
+#endif
@@ -37,6 +37,9 @@
 #define DATASETTE_CONTROL_RECORD  4
 #define DATASETTE_CONTROL_RESET   5
 #define DATASETTE_CONTROL_RESET_COUNTER   6
+/* Wind the tape at once to its start or its end, and stop it there.  */
+#define DATASETTE_CONTROL_WIND_START      7
+#define DATASETTE_CONTROL_WIND_END        8
 
 /* Counter is c=g*(sqrt(v*t/d*pi+r^2/d^2)-r/d)
    Some constants for the Datasette-Counter, maybe resourses in future */
@@ -67,6 +70,17 @@ extern void machine_set_tape_motor_in(int val);
 
 extern void datasette_set_tape_sense(int sense);
 
+#ifdef PSV_BENCH
+/* The pulse reading of the datasette, for the self test of the benchmark
+   runner.  datasette_test_set_image() puts `image' in without a machine,
+   with the default gap resources and no wobble; `c16' reads it as the C16
+   does.  */
+extern void datasette_test_set_image(struct tap_s *image, int c16);
+extern CLOCK datasette_test_read_gap(int direction);
+extern void datasette_test_seek_counter(int counter);
+extern void datasette_test_update_index(void);
+#endif
+
 /* For registering the resources.  */
 extern int datasette_resources_init(void);
 extern int datasette_cmdline_options_init(void);
@@ -53,6 +53,12 @@ static const cmdline_option_t cmdline_options[] =
     { "-drivesoundvolume", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
       NULL, NULL, "DriveSoundEmulationVolume", NULL,
       "<Volume>", "Set volume for disk drive sound emulation (0-4000)" },
+    { "-drivethread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "DriveThread", (void *)1,
+      NULL, "Run the emulated disk drives on a separate thread" },
+    { "+drivethread", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "DriveThread", (void *)0,
+      NULL, "Run the emulated disk drives on the main thread" },
     CMDLINE_LIST_END
 };
 
@@ -34,6 +34,7 @@
 #include "drivecpu.h"
 #include "drivecpu65c02.h"
 #include "driverom.h"
+#include "drivethread.h"
 #include "drivetypes.h"
 #include "ds1216e.h"
 #include "iecbus.h"
@@ -55,6 +56,9 @@ int drive_sound_emulation;
 /* volume of the drive sound */
 int drive_sound_emulation_volume;
 
+/* Are the drives run on a worker thread?  */
+static int drive_thread;
+
 static int set_drive_true_emulation(int val, void *param)
 {
     unsigned int dnr;
@@ -107,6 +111,14 @@ static int set_drive_sound_emulation_volume(int val, void *param)
     return 0;
 }
 
+static int set_drive_thread(int val, void *param)
+{
+    drive_thread = val ? 1 : 0;
+
+    drive_thread_set_enabled(drive_thread);
+    return 0;
+}
+
 static int set_drive_extend_image_policy(int val, void *param)
 {
     switch (val) {
@@ -284,6 +296,8 @@ static int set_drive_idling_method(int val, void *param)
             return -1;
     }
 
+    drive_thread_stop();
+
     drive->idling_method = val;
 
     if (!rom_loaded) {
@@ -338,6 +352,8 @@ static const resource_int_t resources_int[] = {
       &drive_sound_emulation, set_drive_sound_emulation, NULL },
     { "DriveSoundEmulationVolume", 1000, RES_EVENT_NO, (resource_value_t)1000,
       &drive_sound_emulation_volume, set_drive_sound_emulation_volume, NULL },
+    { "DriveThread", 0, RES_EVENT_NO, (resource_value_t)0,
+      &drive_thread, set_drive_thread, NULL },
     RESOURCE_INT_LIST_END
 };
 
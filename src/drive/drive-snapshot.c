@@ -310,6 +310,8 @@ int drive_snapshot_read_module(snapshot_t *s)
     drive_t *drive;
     int dummy;
     int half_track[DRIVE_NUM];
+    unsigned int old_type[DRIVE_NUM];
+    unsigned int old_enable[DRIVE_NUM];
 
     m = snapshot_module_open(s, snap_module_name,
                              &major_version, &minor_version);
@@ -321,6 +323,16 @@ int drive_snapshot_read_module(snapshot_t *s)
 
     drive_gcr_data_writeback_all();
 
+    /* Drives that keep running with the same type keep their GCR data, so
+       that e.g. going back to a recent in-memory snapshot does not decode
+       the whole disk image again.  */
+    resources_get_int("DriveTrueEmulation", &drive_true_emulation);
+    for (i = 0; i < 2; i++) {
+        drive = drive_context[i]->drive;
+        old_type[i] = drive->type;
+        old_enable[i] = drive_true_emulation ? drive->enable : 0;
+    }
+
     if (major_version > DRIVE_SNAP_MAJOR || minor_version > DRIVE_SNAP_MINOR) {
         log_error(drive_snapshot_log,
                   "Snapshot module version (%d.%d) newer than %d.%d.",
@@ -330,7 +342,9 @@ int drive_snapshot_read_module(snapshot_t *s)
 
     /* If this module exists true emulation is enabled.  */
     /* XXX drive_true_emulation = 1 */
-    resources_set_int("DriveTrueEmulation", 1);
+    if (!drive_true_emulation) {
+        resources_set_int("DriveTrueEmulation", 1);
+    }
 
     if (SMR_DW_INT(m, &sync_factor) < 0) {
         snapshot_module_close(m);
@@ -663,7 +677,11 @@ int drive_snapshot_read_module(snapshot_t *s)
     for (i = 0; i < 2; i++) {
         drive = drive_context[i]->drive;
         if (drive->type != DRIVE_TYPE_NONE) {
-            drive_enable(drive_context[i]);
+            if (old_enable[i] && old_type[i] == drive->type) {
+                drive_enable_keep_image(drive_context[i]);
+            } else {
+                drive_enable(drive_context[i]);
+            }
             drive->attach_clk = attach_clk[i];
             drive->detach_clk = detach_clk[i];
             drive->attach_detach_clk = attach_detach_clk[i];
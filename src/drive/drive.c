@@ -54,8 +54,10 @@
 #include "drivecpu65c02.h"
 #include "driveimage.h"
 #include "drivesync.h"
+#include "drivethread.h"
 #include "driverom.h"
 #include "drivetypes.h"
+#include "frameprof.h"
 #include "gcr.h"
 #include "iecbus.h"
 #include "iecdrive.h"
@@ -268,6 +270,8 @@ void drive_shutdown(void)
         return;
     }
 
+    drive_thread_shutdown();
+
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         if (drive_context[dnr]->drive->type == DRIVE_TYPE_2000 || drive_context[dnr]->drive->type == DRIVE_TYPE_4000) {
             drivecpu65c02_shutdown(drive_context[dnr]);
@@ -410,8 +414,7 @@ void drive_enable_update_ui(drive_context_t *drv)
                            drive_led_color);
 }
 
-/* Activate full drive emulation. */
-int drive_enable(drive_context_t *drv)
+static int drive_enable_internal(drive_context_t *drv, int reread_image)
 {
     int drive_true_emulation = 0;
     unsigned int dnr;
@@ -426,6 +429,8 @@ int drive_enable(drive_context_t *drv)
         return -1;
     }
 
+    drive_thread_stop();
+
     resources_get_int("DriveTrueEmulation", &drive_true_emulation);
 
     /* Always disable kernal traps. */
@@ -438,7 +443,7 @@ int drive_enable(drive_context_t *drv)
     }
 
     /* Recalculate drive geometry.  */
-    if (drive->image != NULL) {
+    if (drive->image != NULL && reread_image) {
         drive_image_attach(drive->image, dnr + 8);
     }
 
@@ -456,6 +461,20 @@ int drive_enable(drive_context_t *drv)
     return 0;
 }
 
+/* Activate full drive emulation. */
+int drive_enable(drive_context_t *drv)
+{
+    return drive_enable_internal(drv, 1);
+}
+
+/* Like drive_enable(), but keep the GCR data of the attached image instead
+   of decoding the whole image again.  Only valid if the drive has been
+   running with the same type since the image was read.  */
+int drive_enable_keep_image(drive_context_t *drv)
+{
+    return drive_enable_internal(drv, 0);
+}
+
 /* Disable full drive emulation.  */
 void drive_disable(drive_context_t *drv)
 {
@@ -464,6 +483,8 @@ void drive_disable(drive_context_t *drv)
 
     drive = drv->drive;
 
+    drive_thread_stop();
+
     /* This must come first, because this might be called before the true
        drive initialization.  */
     drive->enable = 0;
@@ -503,6 +524,8 @@ void drive_cpu_prevent_clk_overflow_all(CLOCK sub)
 {
     unsigned int dnr;
 
+    drive_thread_stop();
+
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         drive_t *drive = drive_context[dnr]->drive;
         if (drive->type == DRIVE_TYPE_2000 || drive->type == DRIVE_TYPE_4000) {
@@ -516,6 +539,9 @@ void drive_cpu_prevent_clk_overflow_all(CLOCK sub)
 void drive_cpu_trigger_reset(unsigned int dnr)
 {
     drive_t *drive = drive_context[dnr]->drive;
+
+    drive_thread_stop();
+
     if (drive->type == DRIVE_TYPE_2000 || drive->type == DRIVE_TYPE_4000) {
         drivecpu65c02_trigger_reset(dnr);
     } else {
@@ -529,6 +555,8 @@ void drive_reset(void)
     unsigned int dnr;
     drive_t *drive;
 
+    drive_thread_stop();
+
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         drive = drive_context[dnr]->drive;
 
@@ -798,6 +826,8 @@ void drive_cpu_execute_one(drive_context_t *drv, CLOCK clk_value)
 {
     drive_t *drive = drv->drive;
 
+    drive_thread_stop();
+
     if (drive->type == DRIVE_TYPE_2000 || drive->type == DRIVE_TYPE_4000) {
         drivecpu65c02_execute(drv, clk_value);
     } else {
@@ -810,12 +840,18 @@ void drive_cpu_execute_all(CLOCK clk_value)
     unsigned int dnr;
     drive_t *drive;
 
+    FRAMEPROF_ENTER(FRAMEPROF_DRIVE);
+
+    drive_thread_stop();
+
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         drive = drive_context[dnr]->drive;
         if (drive->enable) {
             drive_cpu_execute_one(drive_context[dnr], clk_value);
         }
     }
+
+    FRAMEPROF_LEAVE();
 }
 
 void drive_cpu_set_overflow(drive_context_t *drv)
@@ -834,6 +870,10 @@ void drive_vsync_hook(void)
 {
     unsigned int dnr;
 
+    /* The worker stays stopped until the next slice of the next frame, so
+       that the UI can look at the drives and change them.  */
+    drive_thread_stop();
+
     drive_update_ui_status();
 
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
@@ -852,6 +892,8 @@ void drive_vsync_hook(void)
             /* printf("drive_vsync_hook drv %d @clk:%d\n", dnr, maincpu_clk); */
         }
     }
+
+    drive_thread_vsync();
 }
 
 /* ------------------------------------------------------------------------- */
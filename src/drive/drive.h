@@ -342,6 +342,7 @@ extern int rom_loaded;
 
 extern int drive_init(void);
 extern int drive_enable(struct drive_context_s *drv);
+extern int drive_enable_keep_image(struct drive_context_s *drv);
 extern void drive_disable(struct drive_context_s *drv);
 extern void drive_move_head(int step, struct drive_s *drive);
 /* Don't use these pointers before the context is set up!  */
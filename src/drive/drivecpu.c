@@ -41,6 +41,7 @@
 #include "drivecpu.h"
 #include "drive-check.h"
 #include "drivemem.h"
+#include "drivethread.h"
 #include "drivetypes.h"
 #include "interrupt.h"
 #include "lib.h"
@@ -406,7 +407,7 @@ void drivecpu_execute(drive_context_t *drv, CLOCK clk_value)
      * There appears to be a nasty 32-bit overflow problem here, so we
      * paper over it by only considering subtractions of 2nd complement
      * integers. */
-    while ((int) (*(drv->clk_ptr) - cpu->stop_clk) < 0) {
+    while ((int) (*(drv->clk_ptr) - cpu->stop_clk) < 0 && !cpu->jam_pending) {
 /* Include the 6502/6510 CPU emulation core.  */
 
 #define CLK (*(drv->clk_ptr))
@@ -426,6 +427,8 @@ void drivecpu_execute(drive_context_t *drv, CLOCK clk_value)
 
 #define ROM_TRAP_HANDLER() drive_trap_handler(drv)
 
+#define CPU_CAN_DISPATCH() ((int) (CLK - cpu->stop_clk) < 0 && !cpu->jam_pending)
+
 #define CALLER (cpu->monspace)
 
 #define DMA_FUNC drive_generic_dma()
@@ -482,6 +485,11 @@ static void drive_jam(drive_context_t *drv)
 
     cpu = drv->cpu;
 
+    /* The JAM dialog and the reset must happen on the main thread.  */
+    if (drive_thread_jam(drv)) {
+        return;
+    }
+
     switch (drv->drive->type) {
         case DRIVE_TYPE_1540:
             dname = "  1540";
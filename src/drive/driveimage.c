@@ -33,6 +33,7 @@
 #include "diskimage.h"
 #include "drive.h"
 #include "driveimage.h"
+#include "drivethread.h"
 #include "drivetypes.h"
 #include "gcr.h"
 #include "log.h"
@@ -134,6 +135,8 @@ int drive_image_attach(disk_image_t *image, unsigned int unit)
         return -1;
     }
 
+    drive_thread_stop();
+
     dnr = unit - 8;
     drive = drive_context[dnr]->drive;
 
@@ -193,6 +196,8 @@ int drive_image_detach(disk_image_t *image, unsigned int unit)
         return -1;
     }
 
+    drive_thread_stop();
+
     dnr = unit - 8;
     drive = drive_context[dnr]->drive;
 
@@ -0,0 +1,360 @@
+/*
+ * drivethread.c - Run the drive CPUs on a worker thread.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The drives are normally run lazily: whenever the main CPU accesses the
+   serial bus, and once per frame, drive_cpu_execute_all() catches them up
+   with the main CPU clock.  With "DriveThread" set, a worker thread does
+   part of this catching up while the main CPU goes on.
+
+   Every DRIVE_THREAD_SLICE cycles an alarm of the main CPU posts the
+   current main CPU clock, and the worker runs the drives up to that clock.
+   It never runs them further: the main CPU cannot change the bus at a
+   clock that has already passed, so the drives see exactly the same bus
+   lines as if they had been run on the main thread, and nothing ever has
+   to be rolled back.  Before the main CPU accesses the bus, it waits for
+   the worker with drive_thread_stop() and runs the rest itself, as usual.
+
+   So only the time between two bus accesses of the main CPU overlaps.  A
+   loader polls $dd00 every few cycles while it waits for the drive, and
+   the worker gets next to nothing then: it helps while the C64 leaves the
+   bus alone, e.g. once a program has been loaded.  `vicebench -test drive'
+   prints the share of the drive cycles run by the worker.
+
+   Running the drives in slices gives the same result as running them in
+   one go only if no drive idles, so the worker is used only if all the
+   enabled drives are 1540/1541 drives without idling, parallel cable or
+   drive sound.  Otherwise the drives silently run on the main thread.
+
+   A drive CPU that hits a JAM on the worker stops there, since the JAM
+   dialog and the reset it may trigger belong to the main thread.  The JAM
+   opcode is executed again, and the JAM handled, when the main thread runs
+   the drive after drive_thread_stop(), at the same main CPU clock as
+   without the worker.
+
+   All the drives are run by the same worker, in the same order as
+   drive_cpu_execute_all(): the drives on the bus see each other's lines,
+   and running them in parallel would make the result depend on the
+   timing of the threads.  */
+
+#include "vice.h"
+
+#include <string.h>
+
+#include "alarm.h"
+#include "drive.h"
+#include "drivecpu.h"
+#include "drivethread.h"
+#include "drivetypes.h"
+#include "log.h"
+#include "maincpu.h"
+#include "types.h"
+
+#ifdef USE_DRIVE_THREAD
+
+#include <pthread.h>
+
+/* Main CPU cycles between two posts, about a tenth of a frame.  */
+#define DRIVE_THREAD_SLICE  2000
+
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define DRIVE_THREAD_LOAD(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define DRIVE_THREAD_STORE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define DRIVE_THREAD_LOAD(p)        (*(volatile unsigned int *)(p))
+#define DRIVE_THREAD_STORE(p, v)    (*(volatile unsigned int *)(p) = (v))
+#endif
+
+/* State of the worker.  */
+#define DRIVE_THREAD_IDLE       0   /* waiting; the main thread owns the drives */
+#define DRIVE_THREAD_POSTED     1   /* a clock has been posted */
+#define DRIVE_THREAD_RUNNING    2   /* running the drives up to the clock */
+
+extern int drive_sound_emulation;
+
+static int drive_thread_enabled = 0;
+
+static pthread_t thread_id;
+static int thread_running = 0;
+static pthread_mutex_t thread_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t post_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int thread_state = DRIVE_THREAD_IDLE;
+static unsigned int thread_quit = 0;
+static CLOCK thread_clk;
+
+static alarm_t *post_alarm = NULL;
+
+/* Written by the worker while it runs, read by the main thread when it is
+   idle.  */
+static drive_thread_info_t thread_info;
+
+static log_t drive_thread_log = LOG_DEFAULT;
+
+/* ------------------------------------------------------------------------- */
+
+/* Can the drives be run in slices by the worker?  */
+static int drive_thread_usable(void)
+{
+    unsigned int dnr;
+    int enabled = 0;
+
+    if (drive_sound_emulation) {
+        return 0;
+    }
+
+    for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+        drive_t *drive = drive_context[dnr]->drive;
+
+        if (!drive->enable) {
+            continue;
+        }
+
+        switch (drive->type) {
+            case DRIVE_TYPE_1540:
+            case DRIVE_TYPE_1541:
+            case DRIVE_TYPE_1541II:
+                break;
+            default:
+                return 0;
+        }
+
+        if (drive->idling_method != DRIVE_IDLE_NO_IDLE
+            || drive->parallel_cable != DRIVE_PC_NONE) {
+            return 0;
+        }
+
+        enabled = 1;
+    }
+
+    return enabled;
+}
+
+static void *drive_thread(void *unused)
+{
+    unsigned int dnr;
+    CLOCK clk, drive_clk;
+
+    pthread_mutex_lock(&thread_mutex);
+
+    for (;;) {
+        while (thread_state != DRIVE_THREAD_POSTED && !thread_quit) {
+            pthread_cond_wait(&post_cond, &thread_mutex);
+        }
+        if (thread_quit) {
+            break;
+        }
+        clk = thread_clk;
+        DRIVE_THREAD_STORE(&thread_state, DRIVE_THREAD_RUNNING);
+        pthread_mutex_unlock(&thread_mutex);
+
+        for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+            if (drive_context[dnr]->drive->enable) {
+                drive_clk = *(drive_context[dnr]->clk_ptr);
+                drivecpu_execute(drive_context[dnr], clk);
+                thread_info.worker_cycles += *(drive_context[dnr]->clk_ptr) - drive_clk;
+            }
+        }
+
+        pthread_mutex_lock(&thread_mutex);
+        DRIVE_THREAD_STORE(&thread_state, DRIVE_THREAD_IDLE);
+        pthread_cond_broadcast(&idle_cond);
+    }
+
+    pthread_mutex_unlock(&thread_mutex);
+
+    return NULL;
+}
+
+static void post_alarm_handler(CLOCK offset, void *data)
+{
+    unsigned int dnr;
+
+    alarm_set(post_alarm, maincpu_clk + DRIVE_THREAD_SLICE);
+
+    /* Don't wait for a slow worker, it gets the next slice instead.  */
+    if (DRIVE_THREAD_LOAD(&thread_state) != DRIVE_THREAD_IDLE
+        || !drive_thread_usable()) {
+        return;
+    }
+
+    /* The drives were all run to the same clock by the main thread.  */
+    for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+        if (drive_context[dnr]->drive->enable) {
+            if (maincpu_clk > drive_context[dnr]->cpu->last_clk) {
+                thread_info.slice_cycles += maincpu_clk - drive_context[dnr]->cpu->last_clk;
+            }
+            break;
+        }
+    }
+    thread_info.slices++;
+
+    pthread_mutex_lock(&thread_mutex);
+    thread_clk = maincpu_clk;
+    DRIVE_THREAD_STORE(&thread_state, DRIVE_THREAD_POSTED);
+    pthread_cond_signal(&post_cond);
+    pthread_mutex_unlock(&thread_mutex);
+}
+
+static int drive_thread_start(void)
+{
+    if (drive_thread_log == LOG_DEFAULT) {
+        drive_thread_log = log_open("DriveThread");
+    }
+
+    thread_quit = 0;
+    thread_state = DRIVE_THREAD_IDLE;
+
+    if (pthread_create(&thread_id, NULL, drive_thread, NULL) != 0) {
+        log_error(drive_thread_log, "Cannot create drive thread.");
+        return -1;
+    }
+    thread_running = 1;
+
+    if (post_alarm == NULL) {
+        post_alarm = alarm_new(maincpu_alarm_context, "DriveThread",
+                               post_alarm_handler, NULL);
+    }
+
+    log_message(drive_thread_log, "Drive thread started.");
+    return 0;
+}
+
+static void drive_thread_join(void)
+{
+    if (!thread_running) {
+        return;
+    }
+
+    drive_thread_stop();
+
+    pthread_mutex_lock(&thread_mutex);
+    thread_quit = 1;
+    pthread_cond_signal(&post_cond);
+    pthread_mutex_unlock(&thread_mutex);
+    pthread_join(thread_id, NULL);
+    thread_running = 0;
+
+    if (post_alarm != NULL) {
+        alarm_unset(post_alarm);
+    }
+
+    log_message(drive_thread_log, "Drive thread stopped.");
+}
+
+/* ------------------------------------------------------------------------- */
+
+void drive_thread_set_enabled(int val)
+{
+    drive_thread_enabled = val ? 1 : 0;
+}
+
+void drive_thread_vsync(void)
+{
+    if (drive_thread_enabled && !thread_running) {
+        if (drive_thread_start() < 0) {
+            drive_thread_enabled = 0;
+            return;
+        }
+    } else if (!drive_thread_enabled && thread_running) {
+        drive_thread_join();
+    }
+
+    /* Snapshots may have moved the main CPU clock anywhere, so the alarm is
+       set again at every frame.  */
+    if (thread_running) {
+        alarm_set(post_alarm, maincpu_clk + DRIVE_THREAD_SLICE);
+    }
+}
+
+void drive_thread_stop(void)
+{
+    unsigned int dnr;
+
+    if (DRIVE_THREAD_LOAD(&thread_state) != DRIVE_THREAD_IDLE) {
+        pthread_mutex_lock(&thread_mutex);
+        if (thread_state == DRIVE_THREAD_POSTED) {
+            DRIVE_THREAD_STORE(&thread_state, DRIVE_THREAD_IDLE);
+        }
+        while (thread_state == DRIVE_THREAD_RUNNING) {
+            pthread_cond_wait(&idle_cond, &thread_mutex);
+        }
+        pthread_mutex_unlock(&thread_mutex);
+    }
+
+    /* Let the main thread run into the JAMs met by the worker.  */
+    if (thread_running) {
+        for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+            drive_context[dnr]->cpu->jam_pending = 0;
+        }
+    }
+}
+
+int drive_thread_jam(drive_context_t *drv)
+{
+    if (!thread_running || !pthread_equal(pthread_self(), thread_id)) {
+        return 0;
+    }
+
+    drv->cpu->jam_pending = 1;
+    return 1;
+}
+
+void drive_thread_shutdown(void)
+{
+    drive_thread_join();
+}
+
+void drive_thread_get_info(drive_thread_info_t *info)
+{
+    *info = thread_info;
+}
+
+#else /* !USE_DRIVE_THREAD */
+
+void drive_thread_set_enabled(int val)
+{
+}
+
+void drive_thread_vsync(void)
+{
+}
+
+void drive_thread_stop(void)
+{
+}
+
+int drive_thread_jam(drive_context_t *drv)
+{
+    return 0;
+}
+
+void drive_thread_shutdown(void)
+{
+}
+
+void drive_thread_get_info(drive_thread_info_t *info)
+{
+    memset(info, 0, sizeof(drive_thread_info_t));
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * drivethread.h - Run the drive CPUs on a worker thread.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_DRIVETHREAD_H
+#define VICE_DRIVETHREAD_H
+
+struct drive_context_s;
+
+typedef struct drive_thread_info_s {
+    /* Slices posted to the worker, and the main CPU cycles by which the
+       drives were behind when they were posted.  */
+    unsigned long slices;
+    unsigned long long slice_cycles;
+
+    /* Drive cycles run by the worker.  The drives run the rest on the main
+       thread.  */
+    unsigned long long worker_cycles;
+} drive_thread_info_t;
+
+/* Value of the "DriveThread" resource.  The thread is started or stopped at
+   the next frame.  */
+extern void drive_thread_set_enabled(int val);
+
+/* Called from drive_vsync_hook() once per frame.  */
+extern void drive_thread_vsync(void);
+
+/* Wait until the worker is idle.  Must be called by the main thread before
+   it looks at or changes the state of any drive; the worker is not started
+   again before the main CPU has moved on.  */
+extern void drive_thread_stop(void);
+
+/* Called when a drive CPU hits a JAM.  On the worker, the JAM is left
+   pending and 1 is returned: the drive stops at the JAM opcode, and the
+   main thread runs it again, and so handles the JAM, after
+   drive_thread_stop().  */
+extern int drive_thread_jam(struct drive_context_s *drv);
+
+extern void drive_thread_shutdown(void);
+
+/* Totals since the start, for the benchmark runner.  Must be called by the
+   main thread after drive_thread_stop().  */
+extern void drive_thread_get_info(drive_thread_info_t *info);
+
+#endif
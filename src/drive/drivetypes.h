@@ -103,6 +103,10 @@ typedef struct drivecpu_context_s {
     char *snap_module_name;
 
     char *identification_string;
+
+    /* Set when the CPU hits a JAM on the drive thread.  The CPU stops at
+       the JAM until the main thread runs it again.  */
+    int jam_pending;
 } drivecpu_context_t;
 
 
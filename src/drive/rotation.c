@@ -32,7 +32,6 @@
 
 #include "drive.h"
 #include "drivetypes.h"
-#include "lib.h"
 #include "rotation.h"
 #include "types.h"
 #include "p64.h"
@@ -320,8 +319,12 @@ static void rotation_1541_gcr(drive_t *dptr, int ref_cycles)
      * -> the reference cycles are 3200000 +/- ~54000 in worst case
      *    in reality the constant offset can be relatively large, but does not
      *    change a lot over time, so the random offset is rather small.
+     *
+     * The offset comes from the generator of the drive rather than rand(),
+     * so that it does not depend on when (and on which thread) the drive
+     * is run.
      */
-    wobble = dptr->rpm_wobble ? lib_unsigned_rand(0, dptr->rpm_wobble) - (dptr->rpm_wobble / 2) : 0;
+    wobble = dptr->rpm_wobble ? (RANDOM_nextUInt(rptr) >> 16) % (dptr->rpm_wobble + 1) - (dptr->rpm_wobble / 2) : 0;
     tmp *= clk_ref_per_rev;
     tmp /= dptr->rpm + wobble;
     clk_ref_per_rev = (int)tmp;
@@ -961,7 +964,7 @@ static void rotation_1541_simple(drive_t *dptr)
     delta = *(dptr->clk) - rptr->rotation_last_clk;
     rptr->rotation_last_clk = *(dptr->clk);
 
-    wobble = dptr->rpm_wobble ? lib_unsigned_rand(0, dptr->rpm_wobble) - (dptr->rpm_wobble / 2) : 0;
+    wobble = dptr->rpm_wobble ? (RANDOM_nextUInt(rptr) >> 16) % (dptr->rpm_wobble + 1) - (dptr->rpm_wobble / 2) : 0;
     tmp *= 30000UL;
     tmp /= (dptr->rpm + wobble);
     rpmscale = (unsigned long)(tmp);
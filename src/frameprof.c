@@ -0,0 +1,325 @@
+/*
+ * frameprof.c - Per-frame profiling of the emulation loop.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "cmdline.h"
+#include "frameprof.h"
+#include "lib.h"
+#include "log.h"
+#include "resources.h"
+#include "util.h"
+#include "vsyncapi.h"
+
+/* Maximum nesting of sections.  */
+#define FRAMEPROF_MAX_DEPTH 8
+
+static const char * const section_names[FRAMEPROF_NUM] = {
+    "cpu", "video", "sid", "drive", "sound", "view", "snap", "sleep"
+};
+
+int frameprof_enabled = 0;
+
+/* Value of the "FrameProfile" resource; takes effect at the next frame
+   boundary so that no section is left open.  */
+static int frameprof_requested = 0;
+
+static char *csv_file_name = NULL;
+static FILE *csv_file = NULL;
+static int csv_file_changed = 0;
+
+/* Stack of the entered sections.  */
+static int stack[FRAMEPROF_MAX_DEPTH];
+static int depth = 0;
+
+/* Time of the last section change, and the time charged so far in the
+   current frame, both in vsyncarch timer units.  */
+static unsigned long last_time;
+static unsigned long frame_start;
+static unsigned long ticks[FRAMEPROF_NUM];
+
+static frameprof_frame_t history[FRAMEPROF_HISTORY];
+static int history_next = 0;
+static int history_count = 0;
+static unsigned long frame_number = 0;
+
+static log_t frameprof_log = LOG_DEFAULT;
+
+/* ------------------------------------------------------------------------- */
+
+/* Charge the time since the last section change to the current section.  */
+inline static unsigned long charge(void)
+{
+    unsigned long now = vsyncarch_gettime();
+    int top = depth < FRAMEPROF_MAX_DEPTH ? depth : FRAMEPROF_MAX_DEPTH;
+
+    ticks[top ? stack[top - 1] : FRAMEPROF_CPU] += now - last_time;
+    last_time = now;
+
+    return now;
+}
+
+void frameprof_enter(int section)
+{
+    charge();
+
+    if (depth < FRAMEPROF_MAX_DEPTH) {
+        stack[depth] = section;
+    }
+    depth++;
+}
+
+void frameprof_leave(void)
+{
+    /* Profiling may have been enabled inside a section.  */
+    if (depth == 0) {
+        return;
+    }
+
+    charge();
+    depth--;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void csv_close(void)
+{
+    if (csv_file) {
+        fclose(csv_file);
+        csv_file = NULL;
+    }
+}
+
+static void csv_open(void)
+{
+    int i;
+
+    csv_close();
+
+    if (csv_file_name == NULL || *csv_file_name == '\0') {
+        return;
+    }
+
+    csv_file = fopen(csv_file_name, MODE_WRITE_TEXT);
+    if (csv_file == NULL) {
+        log_error(frameprof_log, "Cannot open `%s' for writing.", csv_file_name);
+        return;
+    }
+
+    fprintf(csv_file, "frame,total");
+    for (i = 0; i < FRAMEPROF_NUM; i++) {
+        fprintf(csv_file, ",%s", section_names[i]);
+    }
+    fprintf(csv_file, "\n");
+}
+
+static void csv_write(const frameprof_frame_t *f)
+{
+    int i;
+
+    fprintf(csv_file, "%lu,%lu", f->frame, f->total);
+    for (i = 0; i < FRAMEPROF_NUM; i++) {
+        fprintf(csv_file, ",%lu", f->usec[i]);
+    }
+    fprintf(csv_file, "\n");
+}
+
+static void reset(unsigned long now)
+{
+    memset(ticks, 0, sizeof(ticks));
+    depth = 0;
+    last_time = now;
+    frame_start = now;
+}
+
+/* Turn profiling on or off at a frame boundary.  */
+static void apply_request(void)
+{
+    frameprof_enabled = frameprof_requested;
+
+    if (frameprof_enabled) {
+        frame_number = 0;
+        history_next = 0;
+        history_count = 0;
+        csv_open();
+        reset(vsyncarch_gettime());
+    } else {
+        csv_close();
+    }
+
+    csv_file_changed = 0;
+}
+
+void frameprof_end_frame(void)
+{
+    frameprof_frame_t *f;
+    unsigned long now, freq;
+    int i;
+
+    if (frameprof_enabled != frameprof_requested) {
+        apply_request();
+        return;
+    }
+
+    if (!frameprof_enabled) {
+        return;
+    }
+
+    if (csv_file_changed) {
+        csv_open();
+        csv_file_changed = 0;
+    }
+
+    now = charge();
+    freq = vsyncarch_frequency();
+
+    f = &history[history_next];
+    f->frame = frame_number++;
+    f->total = (unsigned long)((double)(now - frame_start) * 1000000.0 / freq);
+    for (i = 0; i < FRAMEPROF_NUM; i++) {
+        f->usec[i] = (unsigned long)((double)ticks[i] * 1000000.0 / freq);
+    }
+
+    history_next = (history_next + 1) % FRAMEPROF_HISTORY;
+    if (history_count < FRAMEPROF_HISTORY) {
+        history_count++;
+    }
+
+    if (csv_file) {
+        csv_write(f);
+    }
+
+    /* Keep the open sections open across the frame boundary.  */
+    memset(ticks, 0, sizeof(ticks));
+    frame_start = now;
+}
+
+int frameprof_get_history(frameprof_frame_t *dest, int max)
+{
+    int i, n, pos;
+
+    n = history_count < max ? history_count : max;
+    pos = history_next - n;
+    if (pos < 0) {
+        pos += FRAMEPROF_HISTORY;
+    }
+
+    for (i = 0; i < n; i++) {
+        dest[i] = history[pos];
+        pos = (pos + 1) % FRAMEPROF_HISTORY;
+    }
+
+    return n;
+}
+
+const frameprof_frame_t *frameprof_get_last_frame(void)
+{
+    if (!frameprof_enabled || history_count == 0) {
+        return NULL;
+    }
+
+    return &history[(history_next + FRAMEPROF_HISTORY - 1) % FRAMEPROF_HISTORY];
+}
+
+const char *frameprof_section_name(int section)
+{
+    if (section < 0 || section >= FRAMEPROF_NUM) {
+        return NULL;
+    }
+
+    return section_names[section];
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int set_frameprof_enabled(int val, void *param)
+{
+    frameprof_requested = val ? 1 : 0;
+
+    if (frameprof_log == LOG_DEFAULT) {
+        frameprof_log = log_open("FrameProfile");
+    }
+
+    return 0;
+}
+
+static int set_csv_file_name(const char *val, void *param)
+{
+    if (util_string_set(&csv_file_name, val)) {
+        return 0;
+    }
+
+    csv_file_changed = 1;
+    return 0;
+}
+
+static const resource_string_t resources_string[] = {
+    { "FrameProfileFile", "", RES_EVENT_NO, NULL,
+      &csv_file_name, set_csv_file_name, NULL },
+    RESOURCE_STRING_LIST_END
+};
+
+static const resource_int_t resources_int[] = {
+    { "FrameProfile", 0, RES_EVENT_NO, NULL,
+      &frameprof_requested, set_frameprof_enabled, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+int frameprof_resources_init(void)
+{
+    if (resources_register_string(resources_string) < 0) {
+        return -1;
+    }
+
+    return resources_register_int(resources_int);
+}
+
+void frameprof_resources_shutdown(void)
+{
+    csv_close();
+    lib_free(csv_file_name);
+    csv_file_name = NULL;
+}
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-frameprofile", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "FrameProfile", (resource_value_t)1,
+      NULL, "Enable per-frame profiling of the emulation loop" },
+    { "+frameprofile", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "FrameProfile", (resource_value_t)0,
+      NULL, "Disable per-frame profiling of the emulation loop" },
+    { "-frameprofilefile", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "FrameProfileFile", NULL,
+      "<Name>", "Write the per-frame profile to a CSV file" },
+    CMDLINE_LIST_END
+};
+
+int frameprof_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
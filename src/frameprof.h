@@ -0,0 +1,91 @@
+/*
+ * frameprof.h - Per-frame profiling of the emulation loop.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_FRAMEPROF_H
+#define VICE_FRAMEPROF_H
+
+/* Sections a frame's time is split into.  Time is charged to the innermost
+   section that is entered, so the sections add up to the frame time.
+   Whatever is not inside any other section is charged to the CPU.  */
+enum {
+    FRAMEPROF_CPU = 0,
+    FRAMEPROF_VIDEO,
+    FRAMEPROF_SID,
+    FRAMEPROF_DRIVE,
+    FRAMEPROF_SOUND,
+    FRAMEPROF_VIEW,
+    FRAMEPROF_SNAPSHOT,
+    FRAMEPROF_SLEEP,
+    FRAMEPROF_NUM
+};
+
+/* Number of frames kept in the history.  */
+#define FRAMEPROF_HISTORY 128
+
+typedef struct frameprof_frame_s {
+    /* Frame number, counted from when profiling was enabled.  */
+    unsigned long frame;
+
+    /* Time spent in each section, and in the whole frame, in microseconds.  */
+    unsigned long usec[FRAMEPROF_NUM];
+    unsigned long total;
+} frameprof_frame_t;
+
+/* Non-zero while profiling.  Only read this through the macros below on
+   hot paths, so that disabled profiling costs a single test.  */
+extern int frameprof_enabled;
+
+extern void frameprof_enter(int section);
+extern void frameprof_leave(void);
+
+#define FRAMEPROF_ENTER(section)            \
+    do {                                    \
+        if (frameprof_enabled) {            \
+            frameprof_enter(section);       \
+        }                                   \
+    } while (0)
+
+#define FRAMEPROF_LEAVE()                   \
+    do {                                    \
+        if (frameprof_enabled) {            \
+            frameprof_leave();              \
+        }                                   \
+    } while (0)
+
+/* Called once at the end of every frame from vsync_do_vsync().  */
+extern void frameprof_end_frame(void);
+
+/* Copy up to `max' of the most recent frames to `dest', oldest first.
+   Returns the number of frames copied.  */
+extern int frameprof_get_history(frameprof_frame_t *dest, int max);
+
+/* The most recently finished frame, or NULL if there is none.  */
+extern const frameprof_frame_t *frameprof_get_last_frame(void);
+
+extern const char *frameprof_section_name(int section);
+
+extern int frameprof_resources_init(void);
+extern void frameprof_resources_shutdown(void);
+extern int frameprof_cmdline_options_init(void);
+
+#endif
@@ -33,6 +33,7 @@
 #include "console.h"
 #include "debug.h"
 #include "drive.h"
+#include "frameprof.h"
 #include "initcmdline.h"
 #include "keyboard.h"
 #include "log.h"
@@ -47,6 +48,8 @@
 #include "palette.h"
 #include "ram.h"
 #include "resources.h"
+#include "rewind.h"
+#include "runahead.h"
 #include "romset.h"
 #include "screenshot.h"
 #include "signals.h"
@@ -103,6 +106,18 @@ int init_resources(void)
         init_resource_fail("vsync");
         return -1;
     }
+    if (frameprof_resources_init() < 0) {
+        init_resource_fail("frame profiler");
+        return -1;
+    }
+    if (rewind_resources_init() < 0) {
+        init_resource_fail("rewind");
+        return -1;
+    }
+    if (runahead_resources_init() < 0) {
+        init_resource_fail("run-ahead");
+        return -1;
+    }
     if (sound_resources_init() < 0) {
         init_resource_fail("sound");
         return -1;
@@ -182,6 +197,18 @@ int init_cmdline_options(void)
         init_cmdline_options_fail("vsync");
         return -1;
     }
+    if (frameprof_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("frame profiler");
+        return -1;
+    }
+    if (rewind_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("rewind");
+        return -1;
+    }
+    if (runahead_cmdline_options_init() < 0) {
+        init_cmdline_options_fail("run-ahead");
+        return -1;
+    }
     if (sound_cmdline_options_init() < 0) {
         init_cmdline_options_fail("sound");
         return -1;
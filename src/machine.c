@@ -41,6 +41,7 @@
 #include "drive.h"
 #include "vice-event.h"
 #include "fliplist.h"
+#include "frameprof.h"
 #include "fsdevice.h"
 #include "gfxoutput.h"
 #include "interrupt.h"
@@ -57,6 +58,8 @@
 #include "network.h"
 #include "printer.h"
 #include "resources.h"
+#include "rewind.h"
+#include "runahead.h"
 #include "romset.h"
 #include "screenshot.h"
 #include "sound.h"
@@ -344,6 +347,9 @@ void machine_shutdown(void)
 
     autostart_resources_shutdown();
     sound_resources_shutdown();
+    frameprof_resources_shutdown();
+    rewind_resources_shutdown();
+    runahead_resources_shutdown();
     video_resources_shutdown();
     machine_resources_shutdown();
     machine_common_resources_shutdown();
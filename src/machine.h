@@ -28,6 +28,8 @@
 #ifndef VICE_MACHINE_H
 #define VICE_MACHINE_H
 
+#include <stddef.h>
+
 #include "types.h"
 
 /* The following stuff must be defined once per every emulated CBM machine.  */
@@ -142,6 +144,22 @@ extern int machine_write_snapshot(const char *name, int save_roms,
 /* Read a snapshot.  */
 extern int machine_read_snapshot(const char *name, int even_mode);
 
+struct snapshot_s;
+struct snapshot_buffer_s;
+
+/* Create a snapshot of the machine's type, in memory if `name' is NULL.
+   Modules written to it after machine_write_snapshot_modules() are kept as
+   extra modules; everything is written to the file by snapshot_close().
+   Memory snapshots are built in `buffer', which may be NULL.  */
+extern struct snapshot_s *machine_snapshot_create(const char *name,
+                                                  struct snapshot_buffer_s *buffer);
+extern int machine_write_snapshot_modules(struct snapshot_s *s, int save_roms,
+                                          int save_disks, int event_mode);
+
+/* Read a snapshot from memory.  */
+extern int machine_read_snapshot_memory(const uint8_t *data, size_t size,
+                                        int event_mode);
+
 /* handle pending interrupts - needed by libsid.a.  */
 extern void machine_handle_pending_alarms(int num_write_cycles);
 
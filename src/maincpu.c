@@ -506,6 +506,17 @@ void maincpu_mainloop(void)
 
 #define ROM_TRAP_ALLOWED() mem_rom_trap_allowed((uint16_t)reg_pc)
 
+/* Opcodes may only go straight to the next one if there is nothing for the
+   end of the loop to do.  */
+#ifndef CHECK_AND_RUN_ALTERNATE_CPU
+#define CPU_CAN_DISPATCH() \
+    (maincpu_int_status->num_dma_per_opcode == 0 && !maincpu_clk_limit)
+#elif defined ALTERNATE_CPU_STARTED
+#define CPU_CAN_DISPATCH()                                             \
+    (maincpu_int_status->num_dma_per_opcode == 0 && !maincpu_clk_limit \
+     && !ALTERNATE_CPU_STARTED())
+#endif
+
 #define GLOBAL_REGS maincpu_regs
 
 #include "6510core.c"
@@ -28,9 +28,11 @@
 #include "vice.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include "videoarch.h"
 
+#include "frameprof.h"
 #include "lib.h"
 #include "machine.h"
 #include "raster-canvas.h"
@@ -97,12 +99,21 @@ inline static void refresh_canvas(raster_t *raster)
 
     if ((int)(raster->canvas->draw_buffer->canvas_height) >= yy
         && (int)(raster->canvas->draw_buffer->canvas_width) >= xx) {
+#ifdef VIDEO_ARCH_DIRTY_LINES
+        /* The CRT filter blurs into the neighbouring lines, so let the
+           driver redraw everything in that case.  */
+        if (raster->canvas->videoconfig->filter != VIDEO_FILTER_CRT) {
+            video_arch_canvas_dirty_lines(raster->canvas, update_area->dirty_lines,
+                                          RASTER_CANVAS_DIRTY_LINES);
+        }
+#endif
         video_canvas_refresh(raster->canvas, x, y, xx, yy,
                              MIN(w, (int)(raster->canvas->draw_buffer->canvas_width - xx)),
                              MIN(h, (int)(raster->canvas->draw_buffer->canvas_height - yy)));
     }
 
     update_area->is_null = 1;
+    memset(update_area->dirty_lines, 0, sizeof(update_area->dirty_lines));
 }
 
 void raster_canvas_handle_end_of_frame(raster_t *raster)
@@ -119,16 +130,20 @@ void raster_canvas_handle_end_of_frame(raster_t *raster)
         return;
     }
 
+    FRAMEPROF_ENTER(FRAMEPROF_VIEW);
+
     if (raster->dont_cache) {
         video_canvas_refresh_all(raster->canvas);
     } else {
         refresh_canvas(raster);
     }
+
+    FRAMEPROF_LEAVE();
 }
 
 void raster_canvas_init(raster_t *raster)
 {
-    raster->update_area = lib_malloc(sizeof(raster_canvas_area_t));
+    raster->update_area = lib_calloc(1, sizeof(raster_canvas_area_t));
 
     raster->update_area->is_null = 1;
 }
@@ -27,8 +27,13 @@
 #ifndef VICE_RASTER_CANVAS_H
 #define VICE_RASTER_CANVAS_H
 
+#include "types.h"
+
 struct raster_s;
 
+/* Number of frame buffer lines tracked in the dirty line bitmap.  */
+#define RASTER_CANVAS_DIRTY_LINES 1024
+
 /* A simple convenience type for defining a rectangular area on the screen.  */
 struct raster_canvas_area_s {
     unsigned int xs;
@@ -36,6 +41,10 @@ struct raster_canvas_area_s {
     unsigned int xe;
     unsigned int ye;
     int is_null;
+
+    /* One bit per frame buffer line that changed since the last refresh,
+       for video drivers that can redraw individual lines.  */
+    uint32_t dirty_lines[RASTER_CANVAS_DIRTY_LINES / 32];
 };
 typedef struct raster_canvas_area_s raster_canvas_area_t;
 
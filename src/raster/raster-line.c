@@ -33,6 +33,7 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "frameprof.h"
 #include "raster-cache.h"
 #include "raster-canvas.h"
 #include "raster-changes.h"
@@ -68,6 +69,9 @@ inline static void add_line_to_area(raster_canvas_area_t *area, unsigned int y,
         area->ys = MIN(y, area->ys);
         area->ye = MAX(y, area->ye);
     }
+    if (y < RASTER_CANVAS_DIRTY_LINES) {
+        area->dirty_lines[y >> 5] |= 1U << (y & 31);
+    }
 }
 
 inline void raster_line_draw_blank(raster_t *raster, unsigned int start,
@@ -650,6 +654,8 @@ inline static void handle_visible_line(raster_t *raster)
 
 void raster_line_emulate(raster_t *raster)
 {
+    FRAMEPROF_ENTER(FRAMEPROF_VIDEO);
+
     raster_draw_buffer_ptr_update(raster);
 
     /* Emulate the vertical blank flip-flops.  (Well, sort of.)  */
@@ -735,4 +741,6 @@ void raster_line_emulate(raster_t *raster)
     }
 
     raster->blank_this_line = 0;
+
+    FRAMEPROF_LEAVE();
 }
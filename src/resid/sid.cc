@@ -26,6 +26,14 @@
 
 #include "sid.h"
 #include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESID_FIR_NEON 1
+#else
+#define RESID_FIR_NEON 0
+#endif
 
 #ifndef round
 #define round(x) (x>=0.0?floor(x+0.5):ceil(x-0.5))
@@ -44,6 +52,9 @@ SID::SID()
   fir = 0;
   fir_N = 0;
   fir_RES = 0;
+  fir_stride = 0;
+  fir_simd = true;
+  clock_blocks = true;
   fir_beta = 0;
   fir_f_cycles_per_sample = 0;
   fir_filter_scale = 0;
@@ -562,10 +573,10 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
 
   // Allocate sample buffer.
   if (!sample) {
-    sample = new short[RINGSIZE*2];
+    sample = new short[RINGSIZE*2 + FIR_ALIGN];
   }
   // Clear sample buffer.
-  for (int j = 0; j < RINGSIZE*2; j++) {
+  for (int j = 0; j < RINGSIZE*2 + FIR_ALIGN; j++) {
     sample[j] = 0;
   }
   sample_index = 0;
@@ -615,17 +626,24 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
   }
   fir_RES = fir_RES_new;
   fir_N = fir_N_new;
+  // Room for the delayed wrap-around table, rounded up to FIR_ALIGN taps.
+  fir_stride = (fir_N + 1 + FIR_ALIGN - 1) & ~(FIR_ALIGN - 1);
   fir_beta = beta;
   fir_f_cycles_per_sample = f_cycles_per_sample;
   fir_filter_scale = filter_scale;
 
   // Allocate memory for FIR tables.
   delete[] fir;
-  fir = new short[fir_N*fir_RES];
+  fir = new short[fir_stride*(fir_RES + 1)];
+
+  // Clear the padding taps.
+  for (int j = 0; j < fir_stride*(fir_RES + 1); j++) {
+    fir[j] = 0;
+  }
 
   // Calculate fir_RES FIR tables for linear interpolation.
   for (int i = 0; i < fir_RES; i++) {
-    int fir_offset = i*fir_N + fir_N/2;
+    int fir_offset = i*fir_stride + fir_N/2;
     double j_offset = double(i)/fir_RES;
     // Calculate FIR table. This is the sinc function, weighted by the
     // Kaiser window.
@@ -640,10 +658,43 @@ bool SID::set_sampling_parameters(double clock_freq, sampling_method method,
     }
   }
 
+  // Table fir_RES is table 0 delayed by one sample.
+  short* fir_wrap = fir + fir_RES*fir_stride;
+  for (int j = 0; j < fir_N; j++) {
+    fir_wrap[j + 1] = fir[j];
+  }
+
   return true;
 }
 
 
+// ----------------------------------------------------------------------------
+// Select the convolution used by the resampling methods.
+//
+// The vectorized convolution evaluates both FIR tables in a single pass
+// over the padded tables (using NEON where available), while the plain
+// convolution is the original scalar reference implementation. Both yield
+// bit-identical output.
+// ----------------------------------------------------------------------------
+void SID::enable_fir_simd(bool enable)
+{
+  fir_simd = enable;
+}
+
+
+// ----------------------------------------------------------------------------
+// Select how the resampling methods fill the sample ring buffer.
+//
+// clock_block() clocks the chip in contiguous runs, while the plain loop
+// clocks and stores one cycle at a time, as the original implementation.
+// Both yield bit-identical output.
+// ----------------------------------------------------------------------------
+void SID::enable_clock_block(bool enable)
+{
+  clock_blocks = enable;
+}
+
+
 // ----------------------------------------------------------------------------
 // Adjustment of SID sampling frequency.
 //
@@ -860,6 +911,121 @@ int SID::clock_interpolate(cycle_count& delta_t, short* buf, int n, int interlea
 }
 
 
+// ----------------------------------------------------------------------------
+// Clock the chip delta_t cycles, storing the output of every cycle in the
+// sample ring buffer. The ring is filled in contiguous blocks, and the
+// overflow copy is made once per block rather than once per sample.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void SID::clock_ring(cycle_count delta_t)
+{
+  if (unlikely(!clock_blocks)) {
+    for (int i = 0; i < delta_t; i++) {
+      clock();
+      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
+      ++sample_index &= RINGMASK;
+    }
+    return;
+  }
+
+  while (delta_t > 0) {
+    cycle_count n = RINGSIZE - sample_index;
+    if (n > delta_t) {
+      n = delta_t;
+    }
+
+    clock_block(sample + sample_index, n);
+    memcpy(sample + sample_index + RINGSIZE, sample + sample_index,
+           n*sizeof(short));
+
+    sample_index = (sample_index + n) & RINGMASK;
+    delta_t -= n;
+  }
+}
+
+
+// ----------------------------------------------------------------------------
+// FIR convolutions for the resampling methods.
+//
+// n must be a multiple of FIR_ALIGN. convolve2() computes the convolution
+// of the same samples with two FIR tables in one pass.
+// ----------------------------------------------------------------------------
+#if RESID_FIR_NEON
+
+RESID_INLINE
+void SID::convolve2(const short* s, const short* f1, const short* f2,
+                    int n, int& v1, int& v2)
+{
+  int32x4_t acc1 = vdupq_n_s32(0);
+  int32x4_t acc2 = vdupq_n_s32(0);
+
+  for (int j = 0; j < n; j += 8) {
+    int16x8_t sv = vld1q_s16(s + j);
+    int16x8_t f1v = vld1q_s16(f1 + j);
+    int16x8_t f2v = vld1q_s16(f2 + j);
+    acc1 = vmlal_s16(acc1, vget_low_s16(sv), vget_low_s16(f1v));
+    acc1 = vmlal_s16(acc1, vget_high_s16(sv), vget_high_s16(f1v));
+    acc2 = vmlal_s16(acc2, vget_low_s16(sv), vget_low_s16(f2v));
+    acc2 = vmlal_s16(acc2, vget_high_s16(sv), vget_high_s16(f2v));
+  }
+
+  int32x2_t sum = vpadd_s32(vadd_s32(vget_low_s32(acc1), vget_high_s32(acc1)),
+                            vadd_s32(vget_low_s32(acc2), vget_high_s32(acc2)));
+  v1 = vget_lane_s32(sum, 0);
+  v2 = vget_lane_s32(sum, 1);
+}
+
+RESID_INLINE
+int SID::convolve(const short* s, const short* f, int n)
+{
+  int32x4_t acc = vdupq_n_s32(0);
+
+  for (int j = 0; j < n; j += 8) {
+    int16x8_t sv = vld1q_s16(s + j);
+    int16x8_t fv = vld1q_s16(f + j);
+    acc = vmlal_s16(acc, vget_low_s16(sv), vget_low_s16(fv));
+    acc = vmlal_s16(acc, vget_high_s16(sv), vget_high_s16(fv));
+  }
+
+  int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  return vget_lane_s32(vpadd_s32(sum, sum), 0);
+}
+
+#else
+
+// Portable version. The sums are accumulated in unsigned arithmetic, which
+// wraps around exactly like the NEON lanes do.
+RESID_INLINE
+void SID::convolve2(const short* s, const short* f1, const short* f2,
+                    int n, int& v1, int& v2)
+{
+  unsigned int a1 = 0, a2 = 0;
+
+  for (int j = 0; j < n; j++) {
+    int sj = s[j];
+    a1 += unsigned(sj*f1[j]);
+    a2 += unsigned(sj*f2[j]);
+  }
+
+  v1 = int(a1);
+  v2 = int(a2);
+}
+
+RESID_INLINE
+int SID::convolve(const short* s, const short* f, int n)
+{
+  unsigned int a = 0;
+
+  for (int j = 0; j < n; j++) {
+    a += unsigned(s[j]*f[j]);
+  }
+
+  return int(a);
+}
+
+#endif // RESID_FIR_NEON
+
+
 // ----------------------------------------------------------------------------
 // SID clocking with audio sampling - cycle based with audio resampling.
 //
@@ -908,11 +1074,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index &= RINGMASK;
-    }
+    clock_ring(delta_t_sample);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -923,27 +1085,37 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
     int fir_offset_rmd = sample_offset*fir_RES & FIXP_MASK;
-    short* fir_start = fir + fir_offset*fir_N;
+    short* fir_start = fir + fir_offset*fir_stride;
     short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
 
-    // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
+    int v1, v2;
+    if (likely(fir_simd)) {
+      // Convolution with both filter impulse responses in one pass; the
+      // next FIR table is always adjacent thanks to the delayed table
+      // fir_RES, which covers the wrap around.
+      convolve2(sample_start, fir_start, fir_start + fir_stride,
+                fir_stride, v1, v2);
     }
+    else {
+      // Convolution with filter impulse response.
+      v1 = 0;
+      for (int j = 0; j < fir_N; j++) {
+        v1 += sample_start[j]*fir_start[j];
+      }
 
-    // Use next FIR table, wrap around to first FIR table using
-    // next sample.
-    if (unlikely(++fir_offset == fir_RES)) {
-      fir_offset = 0;
-      ++sample_start;
-    }
-    fir_start = fir + fir_offset*fir_N;
+      // Use next FIR table, wrap around to first FIR table using
+      // next sample.
+      if (unlikely(++fir_offset == fir_RES)) {
+        fir_offset = 0;
+        ++sample_start;
+      }
+      fir_start = fir + fir_offset*fir_stride;
 
-    // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
+      // Convolution with filter impulse response.
+      v2 = 0;
+      for (int k = 0; k < fir_N; k++) {
+        v2 += sample_start[k]*fir_start[k];
+      }
     }
 
     // Linear interpolation.
@@ -984,11 +1156,7 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
       delta_t_sample = delta_t;
     }
 
-    for (int i = 0; i < delta_t_sample; i++) {
-      clock();
-      sample[sample_index] = sample[sample_index + RINGSIZE] = output();
-      ++sample_index &= RINGMASK;
-    }
+    clock_ring(delta_t_sample);
 
     if ((delta_t -= delta_t_sample) == 0) {
       sample_offset -= delta_t_sample << FIXP_SHIFT;
@@ -998,13 +1166,19 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
     sample_offset = next_sample_offset & FIXP_MASK;
 
     int fir_offset = sample_offset*fir_RES >> FIXP_SHIFT;
-    short* fir_start = fir + fir_offset*fir_N;
+    short* fir_start = fir + fir_offset*fir_stride;
     short* sample_start = sample + sample_index - fir_N + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
+    int v;
+    if (likely(fir_simd)) {
+      v = convolve(sample_start, fir_start, fir_stride);
+    }
+    else {
+      v = 0;
+      for (int j = 0; j < fir_N; j++) {
+        v += sample_start[j]*fir_start[j];
+      }
     }
 
     v >>= FIR_SHIFT;
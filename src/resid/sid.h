@@ -46,9 +46,12 @@ public:
   double sample_freq, double pass_freq = -1,
   double filter_scale = 0.97);
   void adjust_sampling_frequency(double sample_freq);
+  void enable_fir_simd(bool enable);
+  void enable_clock_block(bool enable);
 
   void clock();
   void clock(cycle_count delta_t);
+  void clock_block(short* buf, cycle_count n);
   int clock(cycle_count& delta_t, short* buf, int n, int interleave = 1);
   void reset();
 
@@ -98,10 +101,15 @@ public:
 
  protected:
   static double I0(double x);
+  static void convolve2(const short* s, const short* f1, const short* f2,
+                        int n, int& v1, int& v2);
+  static int convolve(const short* s, const short* f, int n);
   int clock_fast(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_interpolate(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample(cycle_count& delta_t, short* buf, int n, int interleave);
   int clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int interleave);
+  void clock_chip();
+  void clock_ring(cycle_count delta_t);
   void write();
 
   chip_model sid_model;
@@ -135,6 +143,9 @@ public:
     FIR_RES = 285,
     FIR_RES_FASTMEM = 51473,
     FIR_SHIFT = 15,
+    // FIR tables are padded with zeros to a multiple of FIR_ALIGN taps so
+    // the vectorized convolutions need no scalar tail.
+    FIR_ALIGN = 8,
 
     RINGSIZE = 1 << 14,
     RINGMASK = RINGSIZE - 1,
@@ -152,14 +163,20 @@ public:
   short sample_prev, sample_now;
   int fir_N;
   int fir_RES;
+  int fir_stride;
+  bool fir_simd;
+  bool clock_blocks;
   double fir_beta;
   double fir_f_cycles_per_sample;
   double fir_filter_scale;
 
-  // Ring buffer with overflow for contiguous storage of RINGSIZE samples.
+  // Ring buffer with overflow for contiguous storage of RINGSIZE samples,
+  // plus FIR_ALIGN zero samples which may be read by padded convolutions.
   short* sample;
 
-  // FIR_RES filter tables (FIR_N*FIR_RES).
+  // fir_RES + 1 filter tables (fir_stride*(fir_RES + 1)). The extra table
+  // is table 0 delayed by one sample, so that the two tables used for
+  // linear interpolation are always adjacent and share the same samples.
   short* fir;
 };
 
@@ -183,10 +200,10 @@ short SID::output()
 
 
 // ----------------------------------------------------------------------------
-// SID clocking - 1 cycle.
+// Clock voices, filter and external filter - 1 cycle.
 // ----------------------------------------------------------------------------
 RESID_INLINE
-void SID::clock()
+void SID::clock_chip()
 {
   int i;
 
@@ -215,6 +232,16 @@ void SID::clock()
 
   // Clock external filter.
   extfilt.clock(filter.output());
+}
+
+
+// ----------------------------------------------------------------------------
+// SID clocking - 1 cycle.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void SID::clock()
+{
+  clock_chip();
 
   // Pipelined writes on the MOS8580.
   if (unlikely(write_pipeline)) {
@@ -227,6 +254,35 @@ void SID::clock()
   }
 }
 
+
+// ----------------------------------------------------------------------------
+// SID clocking - n cycles, storing the audio output of every cycle in buf.
+// This is equivalent to n calls to clock() followed by output(), but the
+// write pipeline and bus value bookkeeping is done once per block.
+// ----------------------------------------------------------------------------
+RESID_INLINE
+void SID::clock_block(short* buf, cycle_count n)
+{
+  cycle_count i = 0;
+
+  // The write pipeline can only be pending in the first cycle.
+  if (unlikely(write_pipeline) && likely(n > 0)) {
+    clock();
+    buf[i++] = output();
+  }
+
+  // Age bus value.
+  if (unlikely(bus_value_ttl > 0 && bus_value_ttl <= n - i)) {
+    bus_value = 0;
+  }
+  bus_value_ttl -= n - i;
+
+  for (; i < n; i++) {
+    clock_chip();
+    buf[i] = output();
+  }
+}
+
 #endif // RESID_INLINING || defined(RESID_SID_CC)
 
 } // namespace reSID
@@ -0,0 +1,590 @@
+/*
+ * rewind.c - Rewind buffer of periodic in-memory snapshots.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The states are whole machine snapshots written to memory with the usual
+   module writers.  Only the first state is stored as it is.  The others are
+   XORed with a keyframe and the zero words are run-length encoded, which
+   leaves little more than the bytes that changed:
+
+   - a delta is the XOR of the state with the current keyframe;
+   - a keyframe is the XOR of the keyframe with the previous keyframe.
+
+   The raw current keyframe is kept aside.  Stepping back over a keyframe
+   XORs it into the raw keyframe, which gives back the previous one, so the
+   buffer can be decoded from the newest state backwards whatever has been
+   dropped from its oldest end.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "cmdline.h"
+#include "frameprof.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "resources.h"
+#include "rewind.h"
+#include "snapshot.h"
+#include "types.h"
+#include "vsync.h"
+#include "vsyncapi.h"
+
+/* Number of states between keyframes.  */
+#define REWIND_KEYFRAME_INTERVAL 20
+
+/* Most states kept, whatever the buffer size.  */
+#define REWIND_MAX_STATES 4096
+
+enum {
+    /* XOR of the state with the current keyframe.  */
+    REWIND_DELTA,
+
+    /* XOR of the keyframe with the previous keyframe.  */
+    REWIND_KEYFRAME,
+
+    /* Keyframe with nothing before it, stored as it is.  */
+    REWIND_FULL
+};
+
+typedef struct rewind_state_s {
+    int type;
+
+    /* Encoded state.  */
+    uint8_t *data;
+    size_t encoded_size;
+
+    /* Size of the snapshot.  */
+    size_t size;
+} rewind_state_t;
+
+/* Resources.  */
+static int rewind_enabled = 0;
+static int rewind_interval = 5;
+static int rewind_buffer_size = 16384;
+
+/* Ring of states, oldest first.  */
+static rewind_state_t *states = NULL;
+static int first_state = 0;
+static int num_states = 0;
+static size_t used_bytes = 0;
+
+/* The current keyframe, as it is.  */
+static uint8_t *key_data = NULL;
+static size_t key_size = 0;
+static size_t key_allocated = 0;
+static int key_valid = 0;
+static int since_key = 0;
+
+/* Buffer states are encoded into and decoded from.  */
+static uint8_t *work_data = NULL;
+static size_t work_allocated = 0;
+
+/* Buffer the snapshots are written to.  */
+static snapshot_buffer_t snapshot_buffer = { NULL, 0 };
+
+static int frame_count = 0;
+static int rewind_active = 0;
+
+static unsigned long captures = 0;
+static unsigned long long capture_usec = 0;
+
+static log_t rewind_log = LOG_DEFAULT;
+
+/* ------------------------------------------------------------------------- */
+
+static void reserve(uint8_t **data, size_t *allocated, size_t size)
+{
+    if (size > *allocated) {
+        *data = lib_realloc(*data, size);
+        *allocated = size;
+    }
+}
+
+static uint8_t *put_count(uint8_t *p, size_t n)
+{
+    while (n >= 0x80) {
+        *p++ = (uint8_t)(n | 0x80);
+        n >>= 7;
+    }
+    *p++ = (uint8_t)n;
+
+    return p;
+}
+
+static const uint8_t *get_count(const uint8_t *p, const uint8_t *end, size_t *n)
+{
+    int shift = 0;
+
+    *n = 0;
+    while (p < end && shift < 35) {
+        *n |= (size_t)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80)) {
+            return p;
+        }
+        shift += 7;
+    }
+
+    return NULL;
+}
+
+/* Encode `data' XORed with `ref' (`data' as it is if `ref' is NULL) as runs
+   of zero words, each followed by a run of literal words.  A run is stored
+   as the two word counts and the literal words.  The bytes after the last
+   whole word are stored XORed.  `dest' needs room for `size' + 16 bytes.
+   Returns the encoded size.  */
+static size_t encode(uint8_t *dest, const uint8_t *data, const uint8_t *ref, size_t size)
+{
+    const uint32_t *d = (const uint32_t *)data;
+    const uint32_t *r = (const uint32_t *)ref;
+    size_t words = size / 4;
+    size_t i = 0, start, zeros, j;
+    uint8_t *p = dest;
+    uint32_t v;
+
+    while (i < words) {
+        start = i;
+        if (r) {
+            while (i < words && d[i] == r[i]) {
+                i++;
+            }
+        } else {
+            while (i < words && d[i] == 0) {
+                i++;
+            }
+        }
+        zeros = i - start;
+
+        start = i;
+        if (r) {
+            while (i < words && d[i] != r[i]) {
+                i++;
+            }
+        } else {
+            while (i < words && d[i] != 0) {
+                i++;
+            }
+        }
+
+        p = put_count(p, zeros);
+        p = put_count(p, i - start);
+        for (j = start; j < i; j++) {
+            v = r ? d[j] ^ r[j] : d[j];
+            memcpy(p, &v, 4);
+            p += 4;
+        }
+    }
+
+    for (j = words * 4; j < size; j++) {
+        *p++ = ref ? data[j] ^ ref[j] : data[j];
+    }
+
+    return (size_t)(p - dest);
+}
+
+/* Decode the output of encode() into `dest'.  `dest' may be `ref'.  */
+static int decode(uint8_t *dest, const uint8_t *src, size_t src_size, const uint8_t *ref, size_t size)
+{
+    uint32_t *d = (uint32_t *)dest;
+    const uint32_t *r = (const uint32_t *)ref;
+    const uint8_t *p = src, *end = src + src_size;
+    size_t words = size / 4;
+    size_t i = 0, zeros, literals, j;
+    uint32_t v;
+
+    while (i < words) {
+        if ((p = get_count(p, end, &zeros)) == NULL
+            || (p = get_count(p, end, &literals)) == NULL
+            || zeros > words - i
+            || literals > words - i - zeros
+            || (size_t)(end - p) < literals * 4) {
+            return -1;
+        }
+
+        if (r == NULL) {
+            memset(d + i, 0, zeros * 4);
+        } else if (d != r) {
+            memcpy(d + i, r + i, zeros * 4);
+        }
+        i += zeros;
+
+        for (j = 0; j < literals; j++, i++) {
+            memcpy(&v, p, 4);
+            p += 4;
+            d[i] = r ? r[i] ^ v : v;
+        }
+    }
+
+    if ((size_t)(end - p) != size - words * 4) {
+        return -1;
+    }
+
+    for (j = words * 4; j < size; j++) {
+        dest[j] = ref ? ref[j] ^ *p++ : *p++;
+    }
+
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static rewind_state_t *newest_state(void)
+{
+    return &states[(first_state + num_states - 1) % REWIND_MAX_STATES];
+}
+
+static void drop_oldest(void)
+{
+    rewind_state_t *st = &states[first_state];
+
+    used_bytes -= st->encoded_size;
+    lib_free(st->data);
+    st->data = NULL;
+
+    first_state = (first_state + 1) % REWIND_MAX_STATES;
+    num_states--;
+}
+
+static void drop_newest(void)
+{
+    rewind_state_t *st = newest_state();
+
+    used_bytes -= st->encoded_size;
+    lib_free(st->data);
+    st->data = NULL;
+
+    num_states--;
+}
+
+static void push_state(int type, const uint8_t *data, size_t encoded_size, size_t size)
+{
+    size_t budget = (size_t)rewind_buffer_size * 1024;
+    rewind_state_t *st;
+
+    if (states == NULL) {
+        states = lib_calloc(REWIND_MAX_STATES, sizeof(rewind_state_t));
+    }
+
+    while (num_states > 0
+           && (num_states == REWIND_MAX_STATES || used_bytes + encoded_size > budget)) {
+        drop_oldest();
+    }
+
+    st = &states[(first_state + num_states) % REWIND_MAX_STATES];
+    st->type = type;
+    st->data = lib_malloc(encoded_size);
+    memcpy(st->data, data, encoded_size);
+    st->encoded_size = encoded_size;
+    st->size = size;
+
+    used_bytes += encoded_size;
+    num_states++;
+}
+
+static void rewind_capture(void)
+{
+    snapshot_t *s;
+    const uint8_t *data;
+    size_t size, encoded_size;
+    unsigned long start = vsyncarch_gettime();
+    int type;
+
+    FRAMEPROF_ENTER(FRAMEPROF_SNAPSHOT);
+
+    s = machine_snapshot_create(NULL, &snapshot_buffer);
+    if (s == NULL) {
+        goto done;
+    }
+
+    if (machine_write_snapshot_modules(s, 0, 0, 0) < 0) {
+        log_error(rewind_log, "Cannot capture the machine state.");
+        snapshot_close(s);
+        goto done;
+    }
+
+    data = snapshot_memory_get_data(s, &size);
+
+    /* The layout of the snapshot changes with the attached media.  The
+       older states can't be decoded against a different one.  */
+    if (key_valid && size != key_size) {
+        rewind_reset();
+    }
+
+    if (!key_valid) {
+        type = REWIND_FULL;
+    } else if (since_key >= REWIND_KEYFRAME_INTERVAL) {
+        type = REWIND_KEYFRAME;
+    } else {
+        type = REWIND_DELTA;
+    }
+
+    reserve(&work_data, &work_allocated, size + 16);
+    encoded_size = encode(work_data, data, type == REWIND_FULL ? NULL : key_data, size);
+
+    if (type == REWIND_DELTA) {
+        since_key++;
+    } else {
+        reserve(&key_data, &key_allocated, size);
+        memcpy(key_data, data, size);
+        key_size = size;
+        key_valid = 1;
+        since_key = 0;
+    }
+
+    snapshot_close(s);
+
+    push_state(type, work_data, encoded_size, size);
+
+done:
+    FRAMEPROF_LEAVE();
+
+    captures++;
+    capture_usec += (unsigned long long)((double)(vsyncarch_gettime() - start)
+                                         * 1000000.0 / vsyncarch_frequency());
+}
+
+static void rewind_step_back(void)
+{
+    rewind_state_t *st;
+    const uint8_t *data;
+
+    if (num_states == 0) {
+        return;
+    }
+
+    FRAMEPROF_ENTER(FRAMEPROF_SNAPSHOT);
+
+    st = newest_state();
+
+    /* All the states after a keyframe have been dropped, so a keyframe is
+       the current one.  */
+    if (st->type == REWIND_DELTA) {
+        reserve(&work_data, &work_allocated, st->size + 16);
+        if (!key_valid
+            || key_size != st->size
+            || decode(work_data, st->data, st->encoded_size, key_data, st->size) < 0) {
+            log_error(rewind_log, "Broken state in the rewind buffer.");
+            rewind_reset();
+            goto done;
+        }
+        data = work_data;
+    } else {
+        data = key_data;
+    }
+
+    if (machine_read_snapshot_memory(data, st->size, 0) < 0) {
+        log_error(rewind_log, "Cannot restore the machine state.");
+        rewind_reset();
+        goto done;
+    }
+
+    if (st->type == REWIND_KEYFRAME) {
+        decode(key_data, st->data, st->encoded_size, key_data, key_size);
+    } else if (st->type == REWIND_FULL) {
+        key_valid = 0;
+    }
+    since_key = 0;
+
+    drop_newest();
+
+done:
+    FRAMEPROF_LEAVE();
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* The CPU keeps its registers in locals while it runs, and only exports and
+   imports them around traps.  States are captured and restored in a trap
+   so that the snapshot holds the current registers, and the restored ones
+   are used.  */
+static void rewind_trap(uint16_t addr, void *data)
+{
+    if (!rewind_enabled) {
+        return;
+    }
+
+    if (rewind_active) {
+        rewind_step_back();
+    } else {
+        rewind_capture();
+    }
+}
+
+void rewind_end_frame(void)
+{
+    if (!rewind_enabled) {
+        return;
+    }
+
+    /* There is room for a single trap.  Don't replace one that is pending,
+       e.g. a snapshot being loaded; try again at the next frame.  */
+    if (maincpu_int_status->global_pending_int & IK_TRAP) {
+        return;
+    }
+
+    if (!rewind_active) {
+        if (++frame_count < rewind_interval) {
+            return;
+        }
+        frame_count = 0;
+    } else if (num_states == 0) {
+        return;
+    }
+
+    interrupt_maincpu_trigger_trap(rewind_trap, NULL);
+}
+
+void rewind_set_active(int active)
+{
+    rewind_active = active ? 1 : 0;
+    frame_count = 0;
+}
+
+int rewind_is_active(void)
+{
+    return rewind_active;
+}
+
+void rewind_reset(void)
+{
+    while (num_states > 0) {
+        drop_oldest();
+    }
+
+    first_state = 0;
+    key_valid = 0;
+    since_key = 0;
+    frame_count = 0;
+}
+
+void rewind_get_info(rewind_info_t *info)
+{
+    double refresh = vsync_get_refresh_frequency();
+
+    info->states = num_states;
+    info->seconds = refresh > 0 ? num_states * rewind_interval / refresh : 0;
+    info->bytes = used_bytes + key_allocated + work_allocated
+                  + snapshot_buffer.allocated;
+    info->captures = captures;
+    info->capture_usec = capture_usec;
+}
+
+/* Free everything, the buffers are allocated again when needed.  */
+static void rewind_free(void)
+{
+    rewind_reset();
+
+    lib_free(states);
+    states = NULL;
+    lib_free(key_data);
+    key_data = NULL;
+    key_allocated = 0;
+    lib_free(work_data);
+    work_data = NULL;
+    work_allocated = 0;
+    lib_free(snapshot_buffer.data);
+    snapshot_buffer.data = NULL;
+    snapshot_buffer.allocated = 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int set_rewind_enabled(int val, void *param)
+{
+    rewind_enabled = val ? 1 : 0;
+
+    if (rewind_log == LOG_DEFAULT) {
+        rewind_log = log_open("Rewind");
+    }
+
+    if (!rewind_enabled) {
+        rewind_active = 0;
+        rewind_free();
+    }
+
+    return 0;
+}
+
+static int set_rewind_interval(int val, void *param)
+{
+    if (val < 1) {
+        return -1;
+    }
+
+    rewind_interval = val;
+    return 0;
+}
+
+static int set_rewind_buffer_size(int val, void *param)
+{
+    if (val < 1) {
+        return -1;
+    }
+
+    rewind_buffer_size = val;
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "Rewind", 0, RES_EVENT_NO, NULL,
+      &rewind_enabled, set_rewind_enabled, NULL },
+    { "RewindInterval", 5, RES_EVENT_NO, NULL,
+      &rewind_interval, set_rewind_interval, NULL },
+    { "RewindBufferSize", 16384, RES_EVENT_NO, NULL,
+      &rewind_buffer_size, set_rewind_buffer_size, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+int rewind_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
+void rewind_resources_shutdown(void)
+{
+    rewind_free();
+}
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-rewind", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "Rewind", (resource_value_t)1,
+      NULL, "Keep a buffer of past machine states to rewind to" },
+    { "+rewind", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
+      NULL, NULL, "Rewind", (resource_value_t)0,
+      NULL, "Do not keep a rewind buffer" },
+    { "-rewindinterval", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "RewindInterval", NULL,
+      "<frames>", "Capture a rewind state every <frames> frames" },
+    { "-rewindbuffersize", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "RewindBufferSize", NULL,
+      "<KB>", "Size of the rewind buffer in KB" },
+    CMDLINE_LIST_END
+};
+
+int rewind_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
@@ -0,0 +1,62 @@
+/*
+ * rewind.h - Rewind buffer of periodic in-memory snapshots.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_REWIND_H
+#define VICE_REWIND_H
+
+#include <stddef.h>
+
+typedef struct rewind_info_s {
+    /* Number of states in the buffer, and how far back they reach.  */
+    int states;
+    double seconds;
+
+    /* Memory used by the buffer, in bytes.  */
+    size_t bytes;
+
+    /* Number of states captured, and the time spent capturing them, in
+       microseconds.  */
+    unsigned long captures;
+    unsigned long long capture_usec;
+} rewind_info_t;
+
+/* Called once at the end of every frame from vsync_do_vsync().  Captures
+   the machine state every "RewindInterval" frames, or steps back one state
+   while rewinding.  Both happen in a CPU trap shortly after.  */
+extern void rewind_end_frame(void);
+
+/* Start or stop rewinding.  While rewinding, every frame goes back to the
+   previous state in the buffer and no states are captured.  */
+extern void rewind_set_active(int active);
+extern int rewind_is_active(void);
+
+/* Drop all the states, e.g. when a new program is started.  */
+extern void rewind_reset(void);
+
+extern void rewind_get_info(rewind_info_t *info);
+
+extern int rewind_resources_init(void);
+extern void rewind_resources_shutdown(void);
+extern int rewind_cmdline_options_init(void);
+
+#endif
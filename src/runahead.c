@@ -0,0 +1,252 @@
+/*
+ * runahead.c - Run-ahead to hide the input latency of the games.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* Most games read the controls once per frame, and show the result in the
+   next frame or later.  Run-ahead emulates a few frames ahead with the
+   current input and shows the last of them, then goes back to the real
+   timeline.  With run-ahead set to N frames, every displayed frame goes:
+
+   - the real frame is emulated with sound but without video output;
+   - its state is saved to memory;
+   - N frames are emulated without sound, and only the last one is drawn;
+   - the saved state is restored and the frame is synchronized: sound is
+     flushed, the controls are scanned, the emulation sleeps...
+
+   The state is saved and restored in a CPU trap, so that the CPU registers
+   are up to date.  Everything that vsync_sync_frame() does (the controls,
+   the keyboard buffer, autostart...) only happens on the real timeline.  */
+
+#include "vice.h"
+
+#include <stdio.h>
+
+#include "cmdline.h"
+#include "frameprof.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "resources.h"
+#include "runahead.h"
+#include "snapshot.h"
+#include "sound.h"
+#include "types.h"
+#include "vsync.h"
+
+/* Resource.  */
+static int runahead_frames = 0;
+
+/* Non-zero from the end of a real frame until its state is restored.  */
+static int running = 0;
+
+/* The trap that has been triggered and has not run yet, if any.  */
+static enum {
+    TRAP_NONE,
+    TRAP_SAVE,
+    TRAP_RESTORE
+} pending_trap = TRAP_NONE;
+
+/* Number of frames emulated ahead in the current run, and how many of them
+   are done.  */
+static int run_frames;
+static int frames_done;
+
+/* The saved state of the real frame, and the buffer it is built in.  */
+static snapshot_t *state = NULL;
+static snapshot_buffer_t state_buffer = { NULL, 0 };
+
+/* What vsync_sync_frame() said about the frame to show, and whether the
+   last shown frame was skipped.  */
+static int skip_shown = 0;
+static int shown_been_skipped = 0;
+
+static log_t runahead_log = LOG_DEFAULT;
+
+/* ------------------------------------------------------------------------- */
+
+static void runahead_save_trap(uint16_t addr, void *data)
+{
+    /* The run has been given up.  */
+    if (pending_trap != TRAP_SAVE) {
+        return;
+    }
+    pending_trap = TRAP_NONE;
+
+    FRAMEPROF_ENTER(FRAMEPROF_SNAPSHOT);
+
+    state = machine_snapshot_create(NULL, &state_buffer);
+    if (state != NULL && machine_write_snapshot_modules(state, 0, 0, 0) < 0) {
+        snapshot_close(state);
+        state = NULL;
+    }
+
+    FRAMEPROF_LEAVE();
+
+    if (state == NULL) {
+        log_error(runahead_log, "Cannot save the machine state, run-ahead disabled.");
+        running = 0;
+        resources_set_int("RunAhead", 0);
+
+        /* The next frame is a real one.  */
+        vsync_sync_frame(0);
+        return;
+    }
+
+    sound_set_muted(1);
+}
+
+static void runahead_restore_trap(uint16_t addr, void *data)
+{
+    const uint8_t *state_data;
+    size_t size;
+
+    pending_trap = TRAP_NONE;
+
+    FRAMEPROF_ENTER(FRAMEPROF_SNAPSHOT);
+
+    sound_set_muted(0);
+
+    state_data = snapshot_memory_get_data(state, &size);
+    if (machine_read_snapshot_memory(state_data, size, 0) < 0) {
+        log_error(runahead_log, "Cannot restore the machine state, run-ahead disabled.");
+        resources_set_int("RunAhead", 0);
+    }
+
+    snapshot_close(state);
+    state = NULL;
+    running = 0;
+
+    FRAMEPROF_LEAVE();
+
+    skip_shown = vsync_sync_frame(shown_been_skipped);
+}
+
+int runahead_end_frame(int been_skipped, int *skip_next)
+{
+    int warp_mode = 0;
+
+    /* The VIC-II can also end frames outside of the CPU loop, e.g. when it
+       catches up during a reset.  The CPU must run the trap before the
+       machine can go on.  */
+    if (pending_trap == TRAP_SAVE) {
+        pending_trap = TRAP_NONE;
+        running = 0;
+        return 0;
+    }
+    if (pending_trap == TRAP_RESTORE) {
+        *skip_next = 1;
+        return 1;
+    }
+
+    if (!running) {
+        if (runahead_frames == 0) {
+            return 0;
+        }
+
+        resources_get_int("WarpMode", &warp_mode);
+
+        /* There is room for a single trap.  If one is pending, this frame
+           is synchronized as usual.  */
+        if (warp_mode || (maincpu_int_status->global_pending_int & IK_TRAP)) {
+            return 0;
+        }
+
+        /* End of a real frame: save it, and emulate ahead from there.  */
+        running = 1;
+        run_frames = runahead_frames;
+        frames_done = 0;
+        pending_trap = TRAP_SAVE;
+        interrupt_maincpu_trigger_trap(runahead_save_trap, NULL);
+
+        *skip_next = run_frames > 1 ? 1 : skip_shown;
+        return 1;
+    }
+
+    if (++frames_done < run_frames) {
+        *skip_next = frames_done < run_frames - 1 ? 1 : skip_shown;
+        return 1;
+    }
+
+    /* The frame to show is done.  Go back to the real frame, which is not
+       drawn.  A pending trap can only come from the frames emulated ahead,
+       and is triggered again on the real timeline, so it is replaced.  */
+    shown_been_skipped = been_skipped;
+    pending_trap = TRAP_RESTORE;
+    interrupt_maincpu_trigger_trap(runahead_restore_trap, NULL);
+
+    *skip_next = 1;
+    return 1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int set_runahead_frames(int val, void *param)
+{
+    if (val < 0 || val > RUNAHEAD_MAX_FRAMES) {
+        return -1;
+    }
+
+    /* Takes effect at the end of the next real frame.  */
+    runahead_frames = val;
+
+    if (runahead_log == LOG_DEFAULT) {
+        runahead_log = log_open("RunAhead");
+    }
+
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "RunAhead", 0, RES_EVENT_NO, NULL,
+      &runahead_frames, set_runahead_frames, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+int runahead_resources_init(void)
+{
+    return resources_register_int(resources_int);
+}
+
+void runahead_resources_shutdown(void)
+{
+    if (state != NULL) {
+        snapshot_close(state);
+        state = NULL;
+    }
+    lib_free(state_buffer.data);
+    state_buffer.data = NULL;
+    state_buffer.allocated = 0;
+}
+
+static const cmdline_option_t cmdline_options[] =
+{
+    { "-runahead", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "RunAhead", NULL,
+      "<frames>", "Emulate <frames> frames ahead to hide input latency (0: off)" },
+    CMDLINE_LIST_END
+};
+
+int runahead_cmdline_options_init(void)
+{
+    return cmdline_register_options(cmdline_options);
+}
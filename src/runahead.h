@@ -0,0 +1,40 @@
+/*
+ * runahead.h - Run-ahead to hide the input latency of the games.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_RUNAHEAD_H
+#define VICE_RUNAHEAD_H
+
+/* Most frames that can be emulated ahead.  */
+#define RUNAHEAD_MAX_FRAMES 4
+
+/* Called at the end of every frame from vsync_do_vsync().  Returns non-zero
+   if the frame was emulated ahead, or is a real frame that is saved to
+   emulate ahead from.  In this case the frame is not synchronized, and
+   `skip_next' tells whether the next frame must be drawn.  */
+extern int runahead_end_frame(int been_skipped, int *skip_next);
+
+extern int runahead_resources_init(void);
+extern void runahead_resources_shutdown(void);
+extern int runahead_cmdline_options_init(void);
+
+#endif
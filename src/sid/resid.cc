@@ -126,6 +126,7 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec, int factor)
     char method_text[100];
     double passband, gain;
     int filters_enabled, model, sampling, passband_percentage, gain_percentage, filter_bias_mV;
+    int fir_simd;
 
     if (resources_get_int("SidFilters", &filters_enabled) < 0) {
         return 0;
@@ -139,6 +140,10 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec, int factor)
         return 0;
     }
 
+    if (resources_get_int("SidResidFirSimd", &fir_simd) < 0) {
+        return 0;
+    }
+
     if ((model == 1) || (model == 2)) {
         /* 8580 */
         if (resources_get_int("SidResid8580Passband", &passband_percentage) < 0) {
@@ -208,6 +213,7 @@ static int resid_init(sound_t *psid, int speed, int cycles_per_sec, int factor)
     psid->sid->enable_filter(filters_enabled ? true : false);
     psid->sid->adjust_filter_bias(filter_bias_mV / 1000.0);
     psid->sid->enable_external_filter(filters_enabled ? true : false);
+    psid->sid->enable_fir_simd(fir_simd ? true : false);
 
     switch (sampling) {
       default:
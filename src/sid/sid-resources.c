@@ -62,6 +62,7 @@ static int sid_resid_filter_bias;
 static int sid_resid_8580_passband;
 static int sid_resid_8580_gain;
 static int sid_resid_8580_filter_bias;
+static int sid_resid_fir_simd;
 #endif
 int sid_stereo = 0;
 int checking_sid_stereo;
@@ -336,6 +337,13 @@ static int set_sid_resid_8580_filter_bias(int i, void *param)
     return 0;
 }
 
+static int set_sid_resid_fir_simd(int val, void *param)
+{
+    sid_resid_fir_simd = val ? 1 : 0;
+    sid_state_changed = 1;
+    return 0;
+}
+
 #endif
 
 #ifdef HAVE_HARDSID
@@ -393,6 +401,8 @@ static const resource_int_t resid_resources_int[] = {
       &sid_resid_8580_gain, set_sid_resid_8580_gain, NULL },
     { "SidResid8580FilterBias", -3000, RES_EVENT_NO, NULL,
       &sid_resid_8580_filter_bias, set_sid_resid_8580_filter_bias, NULL },
+    { "SidResidFirSimd", 1, RES_EVENT_NO, NULL,
+      &sid_resid_fir_simd, set_sid_resid_fir_simd, NULL },
     RESOURCE_INT_LIST_END
 };
 #endif
@@ -60,6 +60,9 @@ static void set_sid_engine_with_fallback(int engine)
 
 static int intended_sid_engine = -1;
 
+/* Set when reading the first SID module reopened the sound device.  */
+static int sound_reopened = 0;
+
 /* ---------------------------------------------------------------------*/
 
 /* SID snapshot module format:
@@ -170,6 +173,24 @@ fail:
     return -1;
 }
 
+/* Write the registers read from a snapshot into the running engine, as
+   opening the sound device would.  The extended module then restores the
+   rest of the engine state, if the engine has one.  */
+static void sid_snapshot_store_registers(int sidnr)
+{
+    sound_t *psid = sound_get_psid(sidnr);
+    uint8_t *siddata = sid_get_siddata(sidnr);
+    uint16_t i;
+
+    if (psid == NULL) {
+        return;
+    }
+
+    for (i = 0; i <= 0x18; i++) {
+        sid_sound_machine_store(psid, i, siddata[i]);
+    }
+}
+
 static int sid_snapshot_read_module_simple(snapshot_t *s, int sidnr)
 {
     uint8_t major_version, minor_version;
@@ -178,6 +199,7 @@ static int sid_snapshot_read_module_simple(snapshot_t *s, int sidnr)
     const char *snap_module_name_simple = NULL;
     int sids = 0;
     int sid_address;
+    int cur_sound, cur_engine, cur_sids;
 
     switch (sidnr) {
         default:
@@ -210,19 +232,33 @@ static int sid_snapshot_read_module_simple(snapshot_t *s, int sidnr)
             if (SMR_B_INT(m, &sids) < 0) {
                 goto fail;
             }
+            resources_get_int("SidStereo", &cur_sids);
             resources_set_int("SidStereo", sids);
             if (0
                 || SMR_B(m, &tmp[0]) < 0
                 || SMR_B(m, &tmp[1]) < 0) {
                 goto fail;
             }
-            screenshot_prepare_reopen();
-            sound_close();
-            screenshot_try_reopen();
-            resources_set_int("Sound", (int)tmp[0]);
-
             intended_sid_engine = tmp[1];
-            set_sid_engine_with_fallback(tmp[1]);
+
+            /* Reopening the sound device is slow and drops the queued
+               samples.  If the snapshot uses the current setup, the
+               extended modules restore the state of the running engine
+               instead, which matters when snapshots are read every frame
+               (rewind).  */
+            resources_get_int("Sound", &cur_sound);
+            resources_get_int("SidEngine", &cur_engine);
+            sound_reopened = !(cur_sids == sids
+                               && cur_sound == (int)tmp[0]
+                               && cur_engine == (int)tmp[1]
+                               && sound_get_psid(0) != NULL);
+            if (sound_reopened) {
+                screenshot_prepare_reopen();
+                sound_close();
+                screenshot_try_reopen();
+                resources_set_int("Sound", (int)tmp[0]);
+                set_sid_engine_with_fallback(tmp[1]);
+            }
         } else {
             if (SMR_W_INT(m, &sid_address) < 0) {
                 goto fail;
@@ -238,7 +274,11 @@ static int sid_snapshot_read_module_simple(snapshot_t *s, int sidnr)
             goto fail;
         }
         memcpy(sid_get_siddata(sidnr), &tmp[2], 32);
-        sound_open();
+        if (sound_reopened) {
+            sound_open();
+        } else {
+            sid_snapshot_store_registers(sidnr);
+        }
         return snapshot_module_close(m);
     }
 
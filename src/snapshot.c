@@ -57,9 +57,62 @@ char snapshot_version_magic_string[] = "VICE Version\032";
 #define SNAPSHOT_MAGIC_LEN              19
 #define SNAPSHOT_VERSION_MAGIC_LEN      13
 
+/* Snapshots are built and parsed in a memory buffer.  Files are read in one
+   go by snapshot_open() and written in one go by snapshot_close().  */
+typedef struct snapshot_stream_s {
+    /* Snapshot data.  */
+    uint8_t *data;
+
+    /* Number of valid bytes and allocated size of `data'.  */
+    size_t size;
+    size_t allocated;
+
+    /* Current position.  */
+    size_t pos;
+
+    /* Flag: is `data' ours to free?  */
+    int owns_data;
+} snapshot_stream_t;
+
+#define SNAPSHOT_STREAM_INITIAL_SIZE    (128 * 1024)
+
+/* Size of a module header: name, version and size.  */
+#define SNAPSHOT_MODULE_HEADER_LEN      (SNAPSHOT_MODULE_NAME_LEN + 2 + 4)
+
+/* Longest snapshot header: magic, version, machine and VICE version.  */
+#define SNAPSHOT_HEADER_MAX_LEN         (SNAPSHOT_MAGIC_LEN + 2 + SNAPSHOT_MACHINE_NAME_LEN \
+                                         + SNAPSHOT_VERSION_MAGIC_LEN + 4 + 4)
+
+/* Snapshot files end with a table of contents module, so that single
+   modules can be found without walking all the others.  Its last dword is
+   the offset of the module itself.  Readers that don't know about it just
+   see one more module.  */
+#define SNAPSHOT_TOC_NAME               "TOC"
+#define SNAPSHOT_TOC_MAJOR              1
+#define SNAPSHOT_TOC_MINOR              0
+
+/* Entry of the module index of a snapshot.  */
+typedef struct snapshot_index_entry_s {
+    char name[SNAPSHOT_MODULE_NAME_LEN];
+    uint8_t major_version;
+    uint8_t minor_version;
+
+    /* Offset and size of the module, header included.  */
+    long offset;
+    uint32_t size;
+
+    /* Flag: is the module in memory?  Only lazily opened snapshots have
+       modules that are not.  */
+    int loaded;
+} snapshot_index_entry_t;
+
 struct snapshot_module_s {
-    /* File descriptor.  */
-    FILE *file;
+    /* Snapshot the module belongs to, and its stream.  */
+    snapshot_t *snapshot;
+    snapshot_stream_t *stream;
+
+    /* Index entry of the module.  */
+    int index;
 
     /* Flag: are we writing it?  */
     int write_mode;
@@ -75,21 +128,109 @@ struct snapshot_module_s {
 };
 
 struct snapshot_s {
-    /* File descriptor.  */
+    /* Snapshot data.  */
+    snapshot_stream_t stream;
+
+    /* File written on close, NULL for memory snapshots.  Lazily opened
+       snapshots read their modules from it.  */
     FILE *file;
 
     /* Offset of the first module.  */
     long first_module_offset;
 
+    /* Module index.  When reading it is built on the first lookup, unless
+       the table of contents was read.  */
+    snapshot_index_entry_t *index;
+    int index_num;
+    int index_allocated;
+    int index_built;
+
     /* Flag: are we writing it?  */
     int write_mode;
+
+    /* Buffer the data was taken from, given back on close.  */
+    snapshot_buffer_t *buffer;
 };
 
 /* ------------------------------------------------------------------------- */
 
-static int snapshot_write_byte(FILE *f, uint8_t data)
+static int stream_reserve(snapshot_stream_t *f, size_t size)
+{
+    size_t allocated;
+
+    if (size <= f->allocated) {
+        return 0;
+    }
+
+    if (!f->owns_data) {
+        return -1;
+    }
+
+    allocated = f->allocated ? f->allocated : SNAPSHOT_STREAM_INITIAL_SIZE;
+    while (allocated < size) {
+        allocated *= 2;
+    }
+
+    f->data = lib_realloc(f->data, allocated);
+    f->allocated = allocated;
+    return 0;
+}
+
+static int stream_write(snapshot_stream_t *f, const void *data, size_t num)
+{
+    if (stream_reserve(f, f->pos + num) < 0) {
+        return -1;
+    }
+
+    memcpy(f->data + f->pos, data, num);
+    f->pos += num;
+    if (f->pos > f->size) {
+        f->size = f->pos;
+    }
+
+    return 0;
+}
+
+static int stream_read(snapshot_stream_t *f, void *data, size_t num)
+{
+    if (num > f->size - f->pos) {
+        return -1;
+    }
+
+    memcpy(data, f->data + f->pos, num);
+    f->pos += num;
+    return 0;
+}
+
+static long stream_tell(snapshot_stream_t *f)
+{
+    return (long)f->pos;
+}
+
+/* Only seeking within the data is allowed.  */
+static int stream_seek(snapshot_stream_t *f, long offset)
+{
+    if (offset < 0 || (size_t)offset > f->size) {
+        return -1;
+    }
+
+    f->pos = (size_t)offset;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int snapshot_write_byte(snapshot_stream_t *f, uint8_t data)
 {
-    if (fputc(data, f) == EOF) {
+    if (f->pos < f->allocated) {
+        f->data[f->pos++] = data;
+        if (f->pos > f->size) {
+            f->size = f->pos;
+        }
+        return 0;
+    }
+
+    if (stream_write(f, &data, 1) < 0) {
         snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
         return -1;
     }
@@ -97,7 +238,7 @@ static int snapshot_write_byte(FILE *f, uint8_t data)
     return 0;
 }
 
-static int snapshot_write_word(FILE *f, uint16_t data)
+static int snapshot_write_word(snapshot_stream_t *f, uint16_t data)
 {
     if (snapshot_write_byte(f, (uint8_t)(data & 0xff)) < 0
         || snapshot_write_byte(f, (uint8_t)(data >> 8)) < 0) {
@@ -107,7 +248,7 @@ static int snapshot_write_word(FILE *f, uint16_t data)
     return 0;
 }
 
-static int snapshot_write_dword(FILE *f, uint32_t data)
+static int snapshot_write_dword(snapshot_stream_t *f, uint32_t data)
 {
     if (snapshot_write_word(f, (uint16_t)(data & 0xffff)) < 0
         || snapshot_write_word(f, (uint16_t)(data >> 16)) < 0) {
@@ -117,7 +258,7 @@ static int snapshot_write_dword(FILE *f, uint32_t data)
     return 0;
 }
 
-static int snapshot_write_double(FILE *f, double data)
+static int snapshot_write_double(snapshot_stream_t *f, double data)
 {
     uint8_t *byte_data = (uint8_t *)&data;
     int i;
@@ -130,7 +271,7 @@ static int snapshot_write_double(FILE *f, double data)
     return 0;
 }
 
-static int snapshot_write_padded_string(FILE *f, const char *s, uint8_t pad_char,
+static int snapshot_write_padded_string(snapshot_stream_t *f, const char *s, uint8_t pad_char,
                                         int len)
 {
     int i, found_zero;
@@ -149,9 +290,9 @@ static int snapshot_write_padded_string(FILE *f, const char *s, uint8_t pad_char
     return 0;
 }
 
-static int snapshot_write_byte_array(FILE *f, const uint8_t *data, unsigned int num)
+static int snapshot_write_byte_array(snapshot_stream_t *f, const uint8_t *data, unsigned int num)
 {
-    if (num > 0 && fwrite(data, (size_t)num, 1, f) < 1) {
+    if (num > 0 && stream_write(f, data, (size_t)num) < 0) {
         snapshot_error = SNAPSHOT_WRITE_BYTE_ARRAY_ERROR;
         return -1;
     }
@@ -159,7 +300,7 @@ static int snapshot_write_byte_array(FILE *f, const uint8_t *data, unsigned int
     return 0;
 }
 
-static int snapshot_write_word_array(FILE *f, const uint16_t *data, unsigned int num)
+static int snapshot_write_word_array(snapshot_stream_t *f, const uint16_t *data, unsigned int num)
 {
     unsigned int i;
 
@@ -172,7 +313,7 @@ static int snapshot_write_word_array(FILE *f, const uint16_t *data, unsigned int
     return 0;
 }
 
-static int snapshot_write_dword_array(FILE *f, const uint32_t *data, unsigned int num)
+static int snapshot_write_dword_array(snapshot_stream_t *f, const uint32_t *data, unsigned int num)
 {
     unsigned int i;
 
@@ -186,7 +327,7 @@ static int snapshot_write_dword_array(FILE *f, const uint32_t *data, unsigned in
 }
 
 
-static int snapshot_write_string(FILE *f, const char *s)
+static int snapshot_write_string(snapshot_stream_t *f, const char *s)
 {
     size_t len, i;
 
@@ -205,20 +346,17 @@ static int snapshot_write_string(FILE *f, const char *s)
     return (int)(len + sizeof(uint16_t));
 }
 
-static int snapshot_read_byte(FILE *f, uint8_t *b_return)
+static int snapshot_read_byte(snapshot_stream_t *f, uint8_t *b_return)
 {
-    int c;
-
-    c = fgetc(f);
-    if (c == EOF) {
+    if (f->pos >= f->size) {
         snapshot_error = SNAPSHOT_READ_EOF_ERROR;
         return -1;
     }
-    *b_return = (uint8_t)c;
+    *b_return = f->data[f->pos++];
     return 0;
 }
 
-static int snapshot_read_word(FILE *f, uint16_t *w_return)
+static int snapshot_read_word(snapshot_stream_t *f, uint16_t *w_return)
 {
     uint8_t lo, hi;
 
@@ -230,7 +368,7 @@ static int snapshot_read_word(FILE *f, uint16_t *w_return)
     return 0;
 }
 
-static int snapshot_read_dword(FILE *f, uint32_t *dw_return)
+static int snapshot_read_dword(snapshot_stream_t *f, uint32_t *dw_return)
 {
     uint16_t lo, hi;
 
@@ -242,28 +380,21 @@ static int snapshot_read_dword(FILE *f, uint32_t *dw_return)
     return 0;
 }
 
-static int snapshot_read_double(FILE *f, double *d_return)
+static int snapshot_read_double(snapshot_stream_t *f, double *d_return)
 {
-    int i;
-    int c;
     double val;
-    uint8_t *byte_val = (uint8_t *)&val;
 
-    for (i = 0; i < sizeof(double); i++) {
-        c = fgetc(f);
-        if (c == EOF) {
-            snapshot_error = SNAPSHOT_READ_EOF_ERROR;
-            return -1;
-        }
-        byte_val[i] = (uint8_t)c;
+    if (stream_read(f, &val, sizeof(double)) < 0) {
+        snapshot_error = SNAPSHOT_READ_EOF_ERROR;
+        return -1;
     }
     *d_return = val;
     return 0;
 }
 
-static int snapshot_read_byte_array(FILE *f, uint8_t *b_return, unsigned int num)
+static int snapshot_read_byte_array(snapshot_stream_t *f, uint8_t *b_return, unsigned int num)
 {
-    if (num > 0 && fread(b_return, (size_t)num, 1, f) < 1) {
+    if (num > 0 && stream_read(f, b_return, (size_t)num) < 0) {
         snapshot_error = SNAPSHOT_READ_BYTE_ARRAY_ERROR;
         return -1;
     }
@@ -271,7 +402,7 @@ static int snapshot_read_byte_array(FILE *f, uint8_t *b_return, unsigned int num
     return 0;
 }
 
-static int snapshot_read_word_array(FILE *f, uint16_t *w_return, unsigned int num)
+static int snapshot_read_word_array(snapshot_stream_t *f, uint16_t *w_return, unsigned int num)
 {
     unsigned int i;
 
@@ -284,7 +415,7 @@ static int snapshot_read_word_array(FILE *f, uint16_t *w_return, unsigned int nu
     return 0;
 }
 
-static int snapshot_read_dword_array(FILE *f, uint32_t *dw_return, unsigned int num)
+static int snapshot_read_dword_array(snapshot_stream_t *f, uint32_t *dw_return, unsigned int num)
 {
     unsigned int i;
 
@@ -297,7 +428,7 @@ static int snapshot_read_dword_array(FILE *f, uint32_t *dw_return, unsigned int
     return 0;
 }
 
-static int snapshot_read_string(FILE *f, char **s)
+static int snapshot_read_string(snapshot_stream_t *f, char **s)
 {
     int i, len;
     uint16_t w;
@@ -332,7 +463,7 @@ static int snapshot_read_string(FILE *f, char **s)
 
 int snapshot_module_write_byte(snapshot_module_t *m, uint8_t b)
 {
-    if (snapshot_write_byte(m->file, b) < 0) {
+    if (snapshot_write_byte(m->stream, b) < 0) {
         return -1;
     }
 
@@ -342,7 +473,7 @@ int snapshot_module_write_byte(snapshot_module_t *m, uint8_t b)
 
 int snapshot_module_write_word(snapshot_module_t *m, uint16_t w)
 {
-    if (snapshot_write_word(m->file, w) < 0) {
+    if (snapshot_write_word(m->stream, w) < 0) {
         return -1;
     }
 
@@ -352,7 +483,7 @@ int snapshot_module_write_word(snapshot_module_t *m, uint16_t w)
 
 int snapshot_module_write_dword(snapshot_module_t *m, uint32_t dw)
 {
-    if (snapshot_write_dword(m->file, dw) < 0) {
+    if (snapshot_write_dword(m->stream, dw) < 0) {
         return -1;
     }
 
@@ -362,7 +493,7 @@ int snapshot_module_write_dword(snapshot_module_t *m, uint32_t dw)
 
 int snapshot_module_write_double(snapshot_module_t *m, double db)
 {
-    if (snapshot_write_double(m->file, db) < 0) {
+    if (snapshot_write_double(m->stream, db) < 0) {
         return -1;
     }
 
@@ -372,7 +503,7 @@ int snapshot_module_write_double(snapshot_module_t *m, double db)
 
 int snapshot_module_write_padded_string(snapshot_module_t *m, const char *s, uint8_t pad_char, int len)
 {
-    if (snapshot_write_padded_string(m->file, s, (uint8_t)pad_char, len) < 0) {
+    if (snapshot_write_padded_string(m->stream, s, (uint8_t)pad_char, len) < 0) {
         return -1;
     }
 
@@ -382,7 +513,7 @@ int snapshot_module_write_padded_string(snapshot_module_t *m, const char *s, uin
 
 int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *b, unsigned int num)
 {
-    if (snapshot_write_byte_array(m->file, b, num) < 0) {
+    if (snapshot_write_byte_array(m->stream, b, num) < 0) {
         return -1;
     }
 
@@ -392,7 +523,7 @@ int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *b, uns
 
 int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *w, unsigned int num)
 {
-    if (snapshot_write_word_array(m->file, w, num) < 0) {
+    if (snapshot_write_word_array(m->stream, w, num) < 0) {
         return -1;
     }
 
@@ -402,7 +533,7 @@ int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *w, un
 
 int snapshot_module_write_dword_array(snapshot_module_t *m, const uint32_t *dw, unsigned int num)
 {
-    if (snapshot_write_dword_array(m->file, dw, num) < 0) {
+    if (snapshot_write_dword_array(m->stream, dw, num) < 0) {
         return -1;
     }
 
@@ -413,7 +544,7 @@ int snapshot_module_write_dword_array(snapshot_module_t *m, const uint32_t *dw,
 int snapshot_module_write_string(snapshot_module_t *m, const char *s)
 {
     int len;
-    len = snapshot_write_string(m->file, s);
+    len = snapshot_write_string(m->stream, s);
     if (len < 0) {
         snapshot_error = SNAPSHOT_ILLEGAL_STRING_LENGTH_ERROR;
         return -1;
@@ -427,82 +558,82 @@ int snapshot_module_write_string(snapshot_module_t *m, const char *s)
 
 int snapshot_module_read_byte(snapshot_module_t *m, uint8_t *b_return)
 {
-    if (ftell(m->file) + sizeof(uint8_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint8_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_byte(m->file, b_return);
+    return snapshot_read_byte(m->stream, b_return);
 }
 
 int snapshot_module_read_word(snapshot_module_t *m, uint16_t *w_return)
 {
-    if (ftell(m->file) + sizeof(uint16_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint16_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_word(m->file, w_return);
+    return snapshot_read_word(m->stream, w_return);
 }
 
 int snapshot_module_read_dword(snapshot_module_t *m, uint32_t *dw_return)
 {
-    if (ftell(m->file) + sizeof(uint32_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint32_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_dword(m->file, dw_return);
+    return snapshot_read_dword(m->stream, dw_return);
 }
 
 int snapshot_module_read_double(snapshot_module_t *m, double *db_return)
 {
-    if (ftell(m->file) + sizeof(double) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(double) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_double(m->file, db_return);
+    return snapshot_read_double(m->stream, db_return);
 }
 
 int snapshot_module_read_byte_array(snapshot_module_t *m, uint8_t *b_return, unsigned int num)
 {
-    if ((long)(ftell(m->file) + num) > (long)(m->offset + m->size)) {
+    if ((long)(stream_tell(m->stream) + num) > (long)(m->offset + m->size)) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_byte_array(m->file, b_return, num);
+    return snapshot_read_byte_array(m->stream, b_return, num);
 }
 
 int snapshot_module_read_word_array(snapshot_module_t *m, uint16_t *w_return, unsigned int num)
 {
-    if ((long)(ftell(m->file) + num * sizeof(uint16_t)) > (long)(m->offset + m->size)) {
+    if ((long)(stream_tell(m->stream) + num * sizeof(uint16_t)) > (long)(m->offset + m->size)) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_word_array(m->file, w_return, num);
+    return snapshot_read_word_array(m->stream, w_return, num);
 }
 
 int snapshot_module_read_dword_array(snapshot_module_t *m, uint32_t *dw_return, unsigned int num)
 {
-    if ((long)(ftell(m->file) + num * sizeof(uint32_t)) > (long)(m->offset + m->size)) {
+    if ((long)(stream_tell(m->stream) + num * sizeof(uint32_t)) > (long)(m->offset + m->size)) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_dword_array(m->file, dw_return, num);
+    return snapshot_read_dword_array(m->stream, dw_return, num);
 }
 
 int snapshot_module_read_string(snapshot_module_t *m, char **charp_return)
 {
-    if (ftell(m->file) + sizeof(uint16_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint16_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_string(m->file, charp_return);
+    return snapshot_read_string(m->stream, charp_return);
 }
 
 int snapshot_module_read_byte_into_int(snapshot_module_t *m, int *value_return)
@@ -562,6 +693,156 @@ int snapshot_module_read_dword_into_uint(snapshot_module_t *m, unsigned int *val
 
 /* ------------------------------------------------------------------------- */
 
+static int index_add(snapshot_t *s, const char *name, uint8_t major_version, uint8_t minor_version, long offset, uint32_t size)
+{
+    snapshot_index_entry_t *e;
+
+    if (s->index_num == s->index_allocated) {
+        s->index_allocated = s->index_allocated ? s->index_allocated * 2 : 32;
+        s->index = lib_realloc(s->index, s->index_allocated * sizeof(snapshot_index_entry_t));
+    }
+
+    e = &s->index[s->index_num];
+    strncpy(e->name, name, SNAPSHOT_MODULE_NAME_LEN);
+    e->major_version = major_version;
+    e->minor_version = minor_version;
+    e->offset = offset;
+    e->size = size;
+    e->loaded = 1;
+
+    return s->index_num++;
+}
+
+/* Find the first module called `name'.  */
+static int index_find(snapshot_t *s, const char *name)
+{
+    size_t name_len = strlen(name);
+    int i;
+
+    if (name_len > SNAPSHOT_MODULE_NAME_LEN) {
+        return -1;
+    }
+
+    for (i = 0; i < s->index_num; i++) {
+        if (memcmp(s->index[i].name, name, name_len) == 0
+            && (name_len == SNAPSHOT_MODULE_NAME_LEN || s->index[i].name[name_len] == 0)) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+/* Build the index by walking the module headers once.  */
+static int index_build(snapshot_t *s)
+{
+    snapshot_stream_t *f = &s->stream;
+    long offset = s->first_module_offset;
+    char name[SNAPSHOT_MODULE_NAME_LEN];
+    uint8_t major_version, minor_version;
+    uint32_t size;
+
+    s->index_num = 0;
+
+    while ((size_t)offset + SNAPSHOT_MODULE_HEADER_LEN <= f->size) {
+        if (stream_seek(f, offset) < 0
+            || snapshot_read_byte_array(f, (uint8_t *)name, SNAPSHOT_MODULE_NAME_LEN) < 0
+            || snapshot_read_byte(f, &major_version) < 0
+            || snapshot_read_byte(f, &minor_version) < 0
+            || snapshot_read_dword(f, &size) < 0) {
+            snapshot_error = SNAPSHOT_MODULE_HEADER_READ_ERROR;
+            return -1;
+        }
+
+        /* Stop at a broken module rather than looping forever (PSVITA).  */
+        if (size < SNAPSHOT_MODULE_HEADER_LEN || size > f->size - offset) {
+            break;
+        }
+
+        index_add(s, name, major_version, minor_version, offset, size);
+        offset += size;
+    }
+
+    s->index_built = 1;
+    return 0;
+}
+
+/* Read a module of a lazily opened snapshot from the file.  */
+static int index_load(snapshot_t *s, snapshot_index_entry_t *e)
+{
+    if (s->file == NULL
+        || fseek(s->file, e->offset, SEEK_SET) != 0
+        || fread(s->stream.data + e->offset, 1, e->size, s->file) != e->size) {
+        return -1;
+    }
+
+    e->loaded = 1;
+    return 0;
+}
+
+/* Read the table of contents at the end of the `file_size' bytes long file
+   of a lazily opened snapshot into the index.  */
+static int snapshot_read_toc(snapshot_t *s, long file_size)
+{
+    snapshot_stream_t *f = &s->stream;
+    char name[SNAPSHOT_MODULE_NAME_LEN];
+    uint8_t major_version, minor_version;
+    uint32_t toc_offset, size, num, offset, i;
+    int n;
+
+    if (file_size < s->first_module_offset + SNAPSHOT_MODULE_HEADER_LEN + 8
+        || fseek(s->file, file_size - 4, SEEK_SET) != 0
+        || fread(f->data + file_size - 4, 1, 4, s->file) != 4
+        || stream_seek(f, file_size - 4) < 0
+        || snapshot_read_dword(f, &toc_offset) < 0
+        || toc_offset < (uint32_t)s->first_module_offset
+        || toc_offset > (uint32_t)file_size - SNAPSHOT_MODULE_HEADER_LEN - 8) {
+        return -1;
+    }
+
+    if (fseek(s->file, toc_offset, SEEK_SET) != 0
+        || fread(f->data + toc_offset, 1, file_size - toc_offset, s->file) != (size_t)(file_size - toc_offset)
+        || stream_seek(f, toc_offset) < 0
+        || snapshot_read_byte_array(f, (uint8_t *)name, SNAPSHOT_MODULE_NAME_LEN) < 0
+        || snapshot_read_byte(f, &major_version) < 0
+        || snapshot_read_byte(f, &minor_version) < 0
+        || snapshot_read_dword(f, &size) < 0
+        || size != file_size - toc_offset
+        || strncmp(name, SNAPSHOT_TOC_NAME, SNAPSHOT_MODULE_NAME_LEN) != 0
+        || major_version != SNAPSHOT_TOC_MAJOR
+        || snapshot_read_dword(f, &num) < 0
+        || num > (size - SNAPSHOT_MODULE_HEADER_LEN - 8) / (SNAPSHOT_MODULE_NAME_LEN + 2 + 8)) {
+        return -1;
+    }
+
+    s->index_num = 0;
+    for (i = 0; i < num; i++) {
+        if (snapshot_read_byte_array(f, (uint8_t *)name, SNAPSHOT_MODULE_NAME_LEN) < 0
+            || snapshot_read_byte(f, &major_version) < 0
+            || snapshot_read_byte(f, &minor_version) < 0
+            || snapshot_read_dword(f, &offset) < 0
+            || snapshot_read_dword(f, &size) < 0
+            || offset < (uint32_t)s->first_module_offset
+            || offset >= toc_offset
+            || size < SNAPSHOT_MODULE_HEADER_LEN
+            || size > toc_offset - offset) {
+            s->index_num = 0;
+            return -1;
+        }
+
+        n = index_add(s, name, major_version, minor_version, offset, size);
+        s->index[n].loaded = 0;
+    }
+
+    /* The table of contents itself.  */
+    index_add(s, SNAPSHOT_TOC_NAME, SNAPSHOT_TOC_MAJOR, SNAPSHOT_TOC_MINOR, toc_offset, file_size - toc_offset);
+
+    s->index_built = 1;
+    return 0;
+}
+
+/* ------------------------------------------------------------------------- */
+
 snapshot_module_t *snapshot_module_create(snapshot_t *s, const char *name, uint8_t major_version, uint8_t minor_version)
 {
     snapshot_module_t *m;
@@ -569,8 +850,9 @@ snapshot_module_t *snapshot_module_create(snapshot_t *s, const char *name, uint8
     current_module = (char *)name;
 
     m = lib_malloc(sizeof(snapshot_module_t));
-    m->file = s->file;
-    m->offset = ftell(s->file);
+    m->snapshot = s;
+    m->stream = &s->stream;
+    m->offset = stream_tell(&s->stream);
     if (m->offset == -1) {
         snapshot_error = SNAPSHOT_ILLEGAL_OFFSET_ERROR;
         lib_free(m);
@@ -578,15 +860,17 @@ snapshot_module_t *snapshot_module_create(snapshot_t *s, const char *name, uint8
     }
     m->write_mode = 1;
 
-    if (snapshot_write_padded_string(s->file, name, (uint8_t)0, SNAPSHOT_MODULE_NAME_LEN) < 0
-        || snapshot_write_byte(s->file, major_version) < 0
-        || snapshot_write_byte(s->file, minor_version) < 0
-        || snapshot_write_dword(s->file, 0) < 0) {
+    if (snapshot_write_padded_string(&s->stream, name, (uint8_t)0, SNAPSHOT_MODULE_NAME_LEN) < 0
+        || snapshot_write_byte(&s->stream, major_version) < 0
+        || snapshot_write_byte(&s->stream, minor_version) < 0
+        || snapshot_write_dword(&s->stream, 0) < 0) {
+        lib_free(m);
         return NULL;
     }
 
-    m->size = ftell(s->file) - m->offset;
-    m->size_offset = ftell(s->file) - sizeof(uint32_t);
+    m->size = stream_tell(&s->stream) - m->offset;
+    m->size_offset = stream_tell(&s->stream) - sizeof(uint32_t);
+    m->index = index_add(s, name, major_version, minor_version, m->offset, m->size);
 
     return m;
 }
@@ -594,75 +878,61 @@ snapshot_module_t *snapshot_module_create(snapshot_t *s, const char *name, uint8
 snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name, uint8_t *major_version_return, uint8_t *minor_version_return)
 {
     snapshot_module_t *m;
-    char n[SNAPSHOT_MODULE_NAME_LEN];
-    unsigned int name_len = (unsigned int)strlen(name);
+    snapshot_index_entry_t *e;
+    int i;
 
     current_module = (char *)name;
 
-    if (fseek(s->file, s->first_module_offset, SEEK_SET) < 0) {
-        snapshot_error = SNAPSHOT_FIRST_MODULE_NOT_FOUND_ERROR;
+    if (!s->index_built && index_build(s) < 0) {
         return NULL;
     }
 
-    m = lib_malloc(sizeof(snapshot_module_t));
-    m->file = s->file;
-    m->write_mode = 0;
-
-    m->offset = s->first_module_offset;
-
-    /* Search for the module name.  This is quite inefficient, but I don't
-       think we care.  */
-    while (1) {
-        if (snapshot_read_byte_array(s->file, (uint8_t *)n,
-                                     SNAPSHOT_MODULE_NAME_LEN) < 0
-            || snapshot_read_byte(s->file, major_version_return) < 0
-            || snapshot_read_byte(s->file, minor_version_return) < 0
-            || snapshot_read_dword(s->file, &m->size)) {
-            snapshot_error = SNAPSHOT_MODULE_HEADER_READ_ERROR;
-            goto fail;
-        }
-
-        /* Found?  */
-        if (memcmp(n, name, name_len) == 0
-            && (name_len == SNAPSHOT_MODULE_NAME_LEN || n[name_len] == 0)) {
-            break;
-        }
+    i = index_find(s, name);
+    if (i < 0) {
+        snapshot_error = SNAPSHOT_MODULE_NOT_FOUND_ERROR;
+        return NULL;
+    }
 
-        m->offset += m->size;
-        if (fseek(s->file, m->offset, SEEK_SET) < 0) {
-            snapshot_error = SNAPSHOT_MODULE_NOT_FOUND_ERROR;
-            goto fail;
-        }
+    e = &s->index[i];
+    if (!e->loaded && index_load(s, e) < 0) {
+        snapshot_error = SNAPSHOT_MODULE_HEADER_READ_ERROR;
+        return NULL;
+    }
 
-		if (m->size == 0){
-			// Prevent infinite loop (PSVITA).
-			snapshot_error = SNAPSHOT_MODULE_HEADER_READ_ERROR;
-            goto fail;
-		}
+    if (stream_seek(&s->stream, e->offset + SNAPSHOT_MODULE_HEADER_LEN) < 0) {
+        snapshot_error = SNAPSHOT_MODULE_HEADER_READ_ERROR;
+        return NULL;
     }
 
-    m->size_offset = ftell(s->file) - sizeof(uint32_t);
+    *major_version_return = e->major_version;
+    *minor_version_return = e->minor_version;
 
-    return m;
+    m = lib_malloc(sizeof(snapshot_module_t));
+    m->snapshot = s;
+    m->stream = &s->stream;
+    m->index = i;
+    m->write_mode = 0;
+    m->offset = e->offset;
+    m->size = e->size;
+    m->size_offset = stream_tell(&s->stream) - sizeof(uint32_t);
 
-fail:
-    fseek(s->file, s->first_module_offset, SEEK_SET);
-    lib_free(m);
-    return NULL;
+    return m;
 }
 
 int snapshot_module_close(snapshot_module_t *m)
 {
     /* Backpatch module size if writing.  */
-    if (m->write_mode
-        && (fseek(m->file, m->size_offset, SEEK_SET) < 0
-            || snapshot_write_dword(m->file, m->size) < 0)) {
-        snapshot_error = SNAPSHOT_MODULE_CLOSE_ERROR;
-        return -1;
+    if (m->write_mode) {
+        if (stream_seek(m->stream, m->size_offset) < 0
+            || snapshot_write_dword(m->stream, m->size) < 0) {
+            snapshot_error = SNAPSHOT_MODULE_CLOSE_ERROR;
+            return -1;
+        }
+        m->snapshot->index[m->index].size = m->size;
     }
 
     /* Skip module.  */
-    if (fseek(m->file, m->offset + m->size, SEEK_SET) < 0) {
+    if (stream_seek(m->stream, m->offset + m->size) < 0) {
         snapshot_error = SNAPSHOT_MODULE_SKIP_ERROR;
         return -1;
     }
@@ -673,43 +943,35 @@ int snapshot_module_close(snapshot_module_t *m)
 
 /* ------------------------------------------------------------------------- */
 
-snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t minor_version, const char *snapshot_machine_name)
+/* Write the snapshot header to the (empty) stream of `s'.  */
+static int snapshot_write_header(snapshot_t *s, uint8_t major_version, uint8_t minor_version, const char *snapshot_machine_name)
 {
-    FILE *f;
-    snapshot_t *s;
+    snapshot_stream_t *f = &s->stream;
     unsigned char viceversion[4] = { VERSION_RC_NUMBER };
 
-    current_filename = (char *)filename;
-
-    f = fopen(filename, MODE_WRITE);
-    if (f == NULL) {
-        snapshot_error = SNAPSHOT_CANNOT_CREATE_SNAPSHOT_ERROR;
-        return NULL;
-    }
-
     /* Magic string.  */
     if (snapshot_write_padded_string(f, snapshot_magic_string, (uint8_t)0, SNAPSHOT_MAGIC_LEN) < 0) {
         snapshot_error = SNAPSHOT_CANNOT_WRITE_MAGIC_STRING_ERROR;
-        goto fail;
+        return -1;
     }
 
     /* Version number.  */
     if (snapshot_write_byte(f, major_version) < 0
         || snapshot_write_byte(f, minor_version) < 0) {
         snapshot_error = SNAPSHOT_CANNOT_WRITE_VERSION_ERROR;
-        goto fail;
+        return -1;
     }
 
     /* Machine.  */
     if (snapshot_write_padded_string(f, snapshot_machine_name, (uint8_t)0, SNAPSHOT_MACHINE_NAME_LEN) < 0) {
         snapshot_error = SNAPSHOT_CANNOT_WRITE_MACHINE_NAME_ERROR;
-        goto fail;
+        return -1;
     }
 
     /* VICE version and revision */
     if (snapshot_write_padded_string(f, snapshot_version_magic_string, (uint8_t)0, SNAPSHOT_VERSION_MAGIC_LEN) < 0) {
         snapshot_error = SNAPSHOT_CANNOT_WRITE_MAGIC_STRING_ERROR;
-        goto fail;
+        return -1;
     }
 
     if (snapshot_write_byte(f, viceversion[0]) < 0
@@ -722,62 +984,143 @@ snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t
         || snapshot_write_dword(f, 0) < 0) {
 #endif
         snapshot_error = SNAPSHOT_CANNOT_WRITE_VERSION_ERROR;
+        return -1;
+    }
+
+    s->first_module_offset = stream_tell(f);
+    return 0;
+}
+
+/* Append the table of contents module.  */
+static int snapshot_write_toc(snapshot_t *s)
+{
+    snapshot_module_t *m;
+    int i, num = s->index_num;
+
+    m = snapshot_module_create(s, SNAPSHOT_TOC_NAME, SNAPSHOT_TOC_MAJOR, SNAPSHOT_TOC_MINOR);
+    if (m == NULL) {
+        return -1;
+    }
+
+    if (snapshot_module_write_dword(m, (uint32_t)num) < 0) {
         goto fail;
     }
 
-    s = lib_malloc(sizeof(snapshot_t));
-    s->file = f;
-    s->first_module_offset = ftell(f);
-    s->write_mode = 1;
+    for (i = 0; i < num; i++) {
+        snapshot_index_entry_t *e = &s->index[i];
 
-    return s;
+        if (snapshot_module_write_byte_array(m, (uint8_t *)e->name, SNAPSHOT_MODULE_NAME_LEN) < 0
+            || snapshot_module_write_byte(m, e->major_version) < 0
+            || snapshot_module_write_byte(m, e->minor_version) < 0
+            || snapshot_module_write_dword(m, (uint32_t)e->offset) < 0
+            || snapshot_module_write_dword(m, e->size) < 0) {
+            goto fail;
+        }
+    }
+
+    if (snapshot_module_write_dword(m, (uint32_t)m->offset) < 0) {
+        goto fail;
+    }
+
+    return snapshot_module_close(m);
 
 fail:
-    fclose(f);
-    ioutil_remove(filename);
-    return NULL;
+    snapshot_module_close(m);
+    return -1;
 }
 
-/* informal only, used by the error message created below */
-static unsigned char snapshot_viceversion[4];
-static uint32_t snapshot_vicerevision;
+static void snapshot_free(snapshot_t *s)
+{
+    if (s->buffer != NULL) {
+        s->buffer->data = s->stream.data;
+        s->buffer->allocated = s->stream.allocated;
+    } else if (s->stream.owns_data) {
+        lib_free(s->stream.data);
+    }
+    lib_free(s->index);
+    lib_free(s);
+}
 
-snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, uint8_t *minor_version_return, const char *snapshot_machine_name)
+snapshot_t *snapshot_memory_create(uint8_t major_version, uint8_t minor_version, const char *snapshot_machine_name, snapshot_buffer_t *buffer)
+{
+    snapshot_t *s;
+
+    s = lib_calloc(1, sizeof(snapshot_t));
+    s->stream.owns_data = 1;
+    s->write_mode = 1;
+
+    if (buffer != NULL) {
+        s->stream.data = buffer->data;
+        s->stream.allocated = buffer->allocated;
+        buffer->data = NULL;
+        buffer->allocated = 0;
+        s->buffer = buffer;
+    }
+
+    if (snapshot_write_header(s, major_version, minor_version, snapshot_machine_name) < 0) {
+        snapshot_free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t minor_version, const char *snapshot_machine_name)
 {
     FILE *f;
-    char magic[SNAPSHOT_MAGIC_LEN];
-    snapshot_t *s = NULL;
-    int machine_name_len;
-    size_t offs;
+    snapshot_t *s;
 
-    current_machine_name = (char *)snapshot_machine_name;
     current_filename = (char *)filename;
-    current_module = NULL;
 
-    f = zfile_fopen(filename, MODE_READ);
+    /* The file is only written on close, but open it now so that errors are
+       reported before the machine state is saved.  */
+    f = fopen(filename, MODE_WRITE);
     if (f == NULL) {
-        snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+        snapshot_error = SNAPSHOT_CANNOT_CREATE_SNAPSHOT_ERROR;
         return NULL;
     }
 
+    s = snapshot_memory_create(major_version, minor_version, snapshot_machine_name, NULL);
+    if (s == NULL) {
+        fclose(f);
+        ioutil_remove(filename);
+        return NULL;
+    }
+
+    s->file = f;
+    return s;
+}
+
+/* informal only, used by the error message created below */
+static unsigned char snapshot_viceversion[4];
+static uint32_t snapshot_vicerevision;
+
+/* Parse the snapshot header from the stream of `s'.  */
+static int snapshot_read_header(snapshot_t *s, uint8_t *major_version_return, uint8_t *minor_version_return, const char *snapshot_machine_name)
+{
+    snapshot_stream_t *f = &s->stream;
+    char magic[SNAPSHOT_MAGIC_LEN];
+    int machine_name_len;
+    long offs;
+
     /* Magic string.  */
     if (snapshot_read_byte_array(f, (uint8_t *)magic, SNAPSHOT_MAGIC_LEN) < 0
         || memcmp(magic, snapshot_magic_string, SNAPSHOT_MAGIC_LEN) != 0) {
         snapshot_error = SNAPSHOT_MAGIC_STRING_MISMATCH_ERROR;
-        goto fail;
+        return -1;
     }
 
     /* Version number.  */
     if (snapshot_read_byte(f, major_version_return) < 0
         || snapshot_read_byte(f, minor_version_return) < 0) {
         snapshot_error = SNAPSHOT_CANNOT_READ_VERSION_ERROR;
-        goto fail;
+        return -1;
     }
 
     /* Machine.  */
     if (snapshot_read_byte_array(f, (uint8_t *)read_name, SNAPSHOT_MACHINE_NAME_LEN) < 0) {
         snapshot_error = SNAPSHOT_CANNOT_READ_MACHINE_NAME_ERROR;
-        goto fail;
+        return -1;
     }
 
     /* Check machine name.  */
@@ -786,18 +1129,18 @@ snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, u
         || (machine_name_len != SNAPSHOT_MODULE_NAME_LEN
             && read_name[machine_name_len] != 0)) {
         snapshot_error = SNAPSHOT_MACHINE_MISMATCH_ERROR;
-        goto fail;
+        return -1;
     }
 
     /* VICE version and revision */
     memset(snapshot_viceversion, 0, 4);
     snapshot_vicerevision = 0;
-    offs = ftell(f);
+    offs = stream_tell(f);
 
     if (snapshot_read_byte_array(f, (uint8_t *)magic, SNAPSHOT_VERSION_MAGIC_LEN) < 0
         || memcmp(magic, snapshot_version_magic_string, SNAPSHOT_VERSION_MAGIC_LEN) != 0) {
         /* old snapshots do not contain VICE version */
-        fseek(f, offs, SEEK_SET);
+        stream_seek(f, offs);
         log_warning(LOG_DEFAULT, "attempting to load pre 2.4.30 snapshot");
     } else {
         /* actually read the version */
@@ -807,44 +1150,169 @@ snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, u
             || snapshot_read_byte(f, &snapshot_viceversion[3]) < 0
             || snapshot_read_dword(f, &snapshot_vicerevision) < 0) {
             snapshot_error = SNAPSHOT_CANNOT_READ_VERSION_ERROR;
-            goto fail;
+            return -1;
         }
     }
 
-    s = lib_malloc(sizeof(snapshot_t));
-    s->file = f;
-    s->first_module_offset = ftell(f);
-    s->write_mode = 0;
+    s->first_module_offset = stream_tell(f);
+    return 0;
+}
+
+snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, uint8_t *minor_version_return, const char *snapshot_machine_name)
+{
+    FILE *f;
+    snapshot_t *s;
+    size_t n;
+
+    current_machine_name = (char *)snapshot_machine_name;
+    current_filename = (char *)filename;
+    current_module = NULL;
+
+    f = zfile_fopen(filename, MODE_READ);
+    if (f == NULL) {
+        snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+        return NULL;
+    }
+
+    s = lib_calloc(1, sizeof(snapshot_t));
+    s->stream.owns_data = 1;
+
+    /* Read the whole file, the modules are then parsed from memory.  */
+    do {
+        if (stream_reserve(&s->stream, s->stream.size + SNAPSHOT_STREAM_INITIAL_SIZE / 2) < 0) {
+            break;
+        }
+        n = fread(s->stream.data + s->stream.size, 1, s->stream.allocated - s->stream.size, f);
+        s->stream.size += n;
+    } while (n > 0);
+
+    if (ferror(f)) {
+        snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+        zfile_fclose(f);
+        snapshot_free(s);
+        return NULL;
+    }
+
+    zfile_fclose(f);
+
+    if (snapshot_read_header(s, major_version_return, minor_version_return, snapshot_machine_name) < 0) {
+        snapshot_free(s);
+        return NULL;
+    }
 
     vsync_suspend_speed_eval();
     return s;
+}
+
+snapshot_t *snapshot_open_lazy(const char *filename, uint8_t *major_version_return, uint8_t *minor_version_return, const char *snapshot_machine_name)
+{
+    FILE *f;
+    snapshot_t *s;
+    long file_size;
+    size_t header_size;
+
+    current_machine_name = (char *)snapshot_machine_name;
+    current_filename = (char *)filename;
+    current_module = NULL;
+
+    f = zfile_fopen(filename, MODE_READ);
+    if (f == NULL) {
+        snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+        return NULL;
+    }
+
+    if (fseek(f, 0, SEEK_END) != 0 || (file_size = ftell(f)) < 0) {
+        snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+        zfile_fclose(f);
+        return NULL;
+    }
+
+    /* The data is only read where needed, so most of the buffer is never
+       touched.  */
+    s = lib_calloc(1, sizeof(snapshot_t));
+    s->file = f;
+    s->stream.owns_data = 1;
+    s->stream.data = lib_malloc(file_size > 0 ? file_size : 1);
+    s->stream.size = file_size;
+    s->stream.allocated = file_size;
+
+    header_size = file_size < SNAPSHOT_HEADER_MAX_LEN ? file_size : SNAPSHOT_HEADER_MAX_LEN;
+    if (fseek(f, 0, SEEK_SET) != 0
+        || fread(s->stream.data, 1, header_size, f) != header_size) {
+        snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+        goto fail;
+    }
+
+    if (snapshot_read_header(s, major_version_return, minor_version_return, snapshot_machine_name) < 0) {
+        goto fail;
+    }
+
+    /* Without a table of contents, read everything.  */
+    if (snapshot_read_toc(s, file_size) < 0) {
+        if (fseek(f, 0, SEEK_SET) != 0
+            || fread(s->stream.data, 1, file_size, f) != (size_t)file_size) {
+            snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+            goto fail;
+        }
+    }
+
+    return s;
 
 fail:
-    fclose(f);
+    zfile_fclose(f);
+    s->file = NULL;
+    snapshot_free(s);
     return NULL;
 }
 
+snapshot_t *snapshot_memory_open(const uint8_t *data, size_t size, uint8_t *major_version_return, uint8_t *minor_version_return, const char *snapshot_machine_name)
+{
+    snapshot_t *s;
+
+    current_machine_name = (char *)snapshot_machine_name;
+    current_module = NULL;
+
+    s = lib_calloc(1, sizeof(snapshot_t));
+    s->stream.data = (uint8_t *)data;
+    s->stream.size = size;
+    s->stream.allocated = size;
+    s->stream.owns_data = 0;
+
+    if (snapshot_read_header(s, major_version_return, minor_version_return, snapshot_machine_name) < 0) {
+        snapshot_free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+const uint8_t *snapshot_memory_get_data(snapshot_t *s, size_t *size)
+{
+    *size = s->stream.size;
+    return s->stream.data;
+}
+
 int snapshot_close(snapshot_t *s)
 {
-    int retval;
+    int retval = 0;
 
-    if (!s->write_mode) {
-        if (zfile_fclose(s->file) == EOF) {
-            snapshot_error = SNAPSHOT_READ_CLOSE_EOF_ERROR;
+    if (s->write_mode && s->file != NULL) {
+        if (snapshot_write_toc(s) < 0) {
+            retval = -1;
+        }
+        if (fwrite(s->stream.data, 1, s->stream.size, s->file) != s->stream.size) {
+            snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
             retval = -1;
-        } else {
-            retval = 0;
         }
-    } else {
         if (fclose(s->file) == EOF) {
             snapshot_error = SNAPSHOT_WRITE_CLOSE_EOF_ERROR;
             retval = -1;
-        } else {
-            retval = 0;
         }
+    } else if (s->file != NULL) {
+        zfile_fclose(s->file);
     }
 
-    lib_free(s);
+    snapshot_free(s);
     return retval;
 }
 
@@ -28,6 +28,8 @@
 #ifndef SNAPSHOT_H
 #define SNAPSHOT_H
 
+#include <stddef.h>
+
 #include "types.h"
 
 #define SNAPSHOT_MACHINE_NAME_LEN       16
@@ -145,6 +147,39 @@ extern snapshot_t *snapshot_open(const char *filename,
                                  const char *snapshot_machine_name);
 extern int snapshot_close(snapshot_t *s);
 
+/* Like snapshot_open(), but only the header and the table of contents are
+   read from the file; modules are read when they are opened.  Meant for
+   picking a few modules out of a big snapshot.  Snapshots without a table of
+   contents are read completely.  */
+extern snapshot_t *snapshot_open_lazy(const char *filename,
+                                      uint8_t *major_version_return,
+                                      uint8_t *minor_version_return,
+                                      const char *snapshot_machine_name);
+
+/* Buffer kept by the caller of snapshot_memory_create(), so that snapshots
+   taken every frame don't grow a new buffer every time.  The snapshot
+   takes the buffer and gives it back, maybe grown, on snapshot_close().
+   The owner frees `data' with lib_free().  */
+typedef struct snapshot_buffer_s {
+    uint8_t *data;
+    size_t allocated;
+} snapshot_buffer_t;
+
+/* Snapshots that live in memory only.  A snapshot opened with
+   snapshot_memory_open() reads `data' in place, so it must stay valid until
+   the snapshot is closed.  snapshot_memory_get_data() returns the data
+   written so far; it is valid until the next write or snapshot_close().
+   `buffer' may be NULL.  */
+extern snapshot_t *snapshot_memory_create(uint8_t major_version,
+                                          uint8_t minor_version,
+                                          const char *snapshot_machine_name,
+                                          snapshot_buffer_t *buffer);
+extern snapshot_t *snapshot_memory_open(const uint8_t *data, size_t size,
+                                        uint8_t *major_version_return,
+                                        uint8_t *minor_version_return,
+                                        const char *snapshot_machine_name);
+extern const uint8_t *snapshot_memory_get_data(snapshot_t *s, size_t *size);
+
 extern void snapshot_set_error(int error);
 
 extern int snapshot_version_at_least(uint8_t major_version, uint8_t minor_version, uint8_t major_version_required, uint8_t minor_version_required);
@@ -45,6 +45,7 @@
 #include "cmdline.h"
 #include "debug.h"
 #include "fixpoint.h"
+#include "frameprof.h"
 #include "lib.h"
 #include "log.h"
 #include "machine.h"
@@ -147,6 +148,10 @@ static sound_register_devices_t sound_register_devices[] = {
     { "ahi", sound_init_ahi_device, SOUND_PLAYBACK_DEVICE },
 #endif
 
+#ifdef USE_PSV_AUDIO
+    { "psv", sound_init_psv_device, SOUND_PLAYBACK_DEVICE },
+#endif
+
     /* SDL driver last, after all platform specific ones */
 #ifdef USE_SDL_AUDIO
     { "sdl", sound_init_sdl_device, SOUND_PLAYBACK_DEVICE },
@@ -331,6 +336,9 @@ static int speed_adjustment_setting;   /* app_resources.soundSpeedAdjustment */
 static int volume;
 static int amp;
 static int fragment_size;
+
+/* If non-zero, the sound chips still run but their samples are dropped.  */
+static int muted = 0;
 static int output_option;
 
 /* divisors for fragment size calculation */
@@ -1050,6 +1058,9 @@ int sound_open(void)
             } else {
                 snddata.sound_output_channels = channels;
             }
+        } else {
+            /* Devices without init (e.g. dummy) take any channel count.  */
+            snddata.sound_output_channels = channels;
         }
         snddata.issuspended = 0;
 
@@ -1204,12 +1215,14 @@ static int sound_run_sound(void)
     if (cycle_based) {
         delta_t = maincpu_clk - snddata.lastclk;
         bufferptr = snddata.buffer + snddata.bufptr * snddata.sound_output_channels;
+        FRAMEPROF_ENTER(FRAMEPROF_SID);
         nr = sound_machine_calculate_samples(snddata.psid,
                                              bufferptr,
                                              SOUND_BUFSIZE - snddata.bufptr,
                                              snddata.sound_output_channels,
                                              snddata.sound_chip_channels,
                                              &delta_t);
+        FRAMEPROF_LEAVE();
         if (delta_t) {
             if (overflow_warning_count < 25) {
                 log_warning(sound_log, "%s", "Sound buffer overflow (cycle based)");
@@ -1236,15 +1249,22 @@ static int sound_run_sound(void)
 #endif
         }
         bufferptr = snddata.buffer + snddata.bufptr * snddata.sound_output_channels;
+        FRAMEPROF_ENTER(FRAMEPROF_SID);
         sound_machine_calculate_samples(snddata.psid,
                                         bufferptr,
                                         nr,
                                         snddata.sound_output_channels,
                                         snddata.sound_chip_channels,
                                         &delta_t);
+        FRAMEPROF_LEAVE();
         snddata.fclk += nr * snddata.clkstep;
     }
 
+    if (muted) {
+        snddata.lastclk = maincpu_clk;
+        return 0;
+    }
+
     if (amp < 4096) {
         if (amp) {
             for (i = 0; i < (nr * snddata.sound_output_channels); i++) {
@@ -1330,6 +1350,10 @@ double sound_flush()
         sid_state_changed = FALSE;
     }
 
+    if (muted) {
+        return 0;
+    }
+
     if (warp_mode_enabled && snddata.recdev == NULL) {
         snddata.bufptr = 0;
         return 0;
@@ -1488,6 +1512,49 @@ double sound_flush()
     return 0;
 }
 
+/* Return the amount of sound queued for playback in seconds at the current
+   speed, i.e. the samples in the device buffer plus the ones not flushed to
+   it yet.  The size of the device buffer in seconds is stored in `bufsize'.
+   Returns -1 if the device can't tell, e.g. because it has no bufferspace()
+   call or sound is suspended.  */
+double sound_get_queued_time(double *bufsize)
+{
+    int space;
+    double rate;
+
+    if (!playback_enabled || !sdev_open || !snddata.playdev
+        || !snddata.playdev->bufferspace || snddata.issuspended
+        || warp_mode_enabled) {
+        return -1;
+    }
+
+    space = snddata.playdev->bufferspace();
+    if (space < 0 || space > snddata.bufsize) {
+        return -1;
+    }
+
+    /* Count the samples at the rate sound_flush() generates them at, which
+       follows the speed.  */
+    rate = (double)sample_rate * (speed_percent > 0 ? speed_percent : 100) / 100;
+
+    if (bufsize) {
+        *bufsize = (double)snddata.bufsize / rate;
+    }
+
+    return (double)(snddata.bufsize - space + snddata.bufptr) / rate;
+}
+
+/* Get the number of buffer underruns and overruns reported by the sound
+   device.  Returns -1 if the device doesn't count them.  */
+int sound_get_xruns(unsigned int *underruns, unsigned int *overruns)
+{
+    if (!snddata.playdev || !snddata.playdev->xruns) {
+        return -1;
+    }
+
+    return snddata.playdev->xruns(underruns, overruns);
+}
+
 /* suspend sid (eg. before pause) */
 void sound_suspend(void)
 {
@@ -1539,6 +1606,14 @@ void sound_resume(void)
     }
 }
 
+/* Drop the samples generated from now on, e.g. for frames that are emulated
+   ahead and thrown away.  The chips are still clocked, so that reading
+   them gives the same values as when the sound is played.  */
+void sound_set_muted(int value)
+{
+    muted = value;
+}
+
 /* set PAL/NTSC clock speed */
 void sound_set_machine_parameter(long clock_rate, long ticks_per_frame)
 {
@@ -1666,6 +1741,9 @@ void sound_snapshot_prepare(void)
 
 void sound_snapshot_finish(void)
 {
+    /* The clock may have gone back if the device has not been reopened.  */
+    snddata.fclk = SOUNDCLK_CONSTANT(maincpu_clk);
+    snddata.wclk = maincpu_clk;
     snddata.lastclk = maincpu_clk;
 }
 
@@ -116,6 +116,8 @@ typedef struct sound_device_s {
     int need_attenuation;
     /* maximum amount of channels */
     int max_channels;
+    /* return the number of buffer underruns and overruns so far */
+    int (*xruns)(unsigned int *underruns, unsigned int *overruns);
 } sound_device_t;
 
 static inline int16_t sound_audio_mix(int ch1, int ch2)
@@ -161,8 +163,11 @@ static inline int16_t sound_audio_mix(int ch1, int ch2)
 extern void sound_init(unsigned int clock_rate, unsigned int ticks_per_frame);
 extern void sound_reset(void);
 extern double sound_flush(void);
+extern double sound_get_queued_time(double *bufsize);
+extern int sound_get_xruns(unsigned int *underruns, unsigned int *overruns);
 extern void sound_suspend(void);
 extern void sound_resume(void);
+extern void sound_set_muted(int value);
 extern int sound_open(void);
 extern void sound_close(void);
 extern void sound_set_relative_speed(int value);
@@ -211,6 +216,7 @@ extern int sound_init_mp3_device(void);
 extern int sound_init_flac_device(void);
 extern int sound_init_vorbis_device(void);
 extern int sound_init_pulse_device(void);
+extern int sound_init_psv_device(void);
 
 /* internal function for sound device registration */
 extern int sound_register_device(sound_device_t *pdevice);
@@ -0,0 +1,535 @@
+/*
+ * soundpsv.c - Implementation of the native PS Vita sound device
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The device feeds an audio output port directly from its own thread, one
+   grain at a time.  The grain is the number of frames the port consumes per
+   output call; a smaller grain means lower latency and more wake-ups.
+
+   The device argument (SoundDeviceArg) is "[grain][:file]".  The grain is
+   rounded to a multiple of 64 frames and defaults to the fragment size
+   chosen by sound.c.  The file is only used by the stand-in port that is
+   built when not compiling for the Vita: it consumes grains in real time
+   like the hardware would, and writes the raw samples to the file if one
+   is given.  This allows the driver to be tested on a desktop system.  */
+
+#include "vice.h"
+
+#ifdef USE_PSV_AUDIO
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef PSVITA
+#include <psp2/audioout.h>
+#endif
+
+#include "lib.h"
+#include "log.h"
+#include "sound.h"
+
+/* The audio port consumes grains of a multiple of 64 frames.  */
+#define PSV_GRAIN_ALIGN     64
+#define PSV_GRAIN_MIN       64
+#define PSV_GRAIN_MAX       65472
+
+/* Same scheme as the SDL driver: a lock-free single producer (psv_write())
+   single consumer (psv_thread()) ring of frames.  Positions run from 0 to
+   2 * psv_len - 1, so that a full ring can be told apart from an empty
+   one.  */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define PSV_RING_LOAD(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define PSV_RING_STORE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+#define PSV_RING_LOAD(p)        (*(volatile unsigned int *)(p))
+#define PSV_RING_STORE(p, v)    (*(volatile unsigned int *)(p) = (v))
+#endif
+
+static int16_t *psv_buf = NULL;
+static unsigned int psv_inpos = 0;
+static unsigned int psv_outpos = 0;
+static int psv_len = 0;         /* ring size in frames */
+static int psv_channels = 0;
+static int psv_speed = 0;
+static int psv_grain = 0;
+
+/* The port may still be reading the previous grain while the next output
+   call is prepared, so the thread alternates between two grain buffers.  */
+static int16_t *psv_grain_buf[2] = { NULL, NULL };
+
+static pthread_t psv_thread_id;
+static int psv_thread_running = 0;
+static pthread_mutex_t psv_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t psv_space_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t psv_resume_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int psv_quit = 0;
+static unsigned int psv_suspended = 0;
+static unsigned int psv_write_waiting = 0;
+
+/* Underruns are counted by the thread, overruns by psv_write().  */
+static unsigned int psv_underruns = 0;
+static unsigned int psv_overruns = 0;
+
+static log_t psv_log = LOG_DEFAULT;
+
+/* ------------------------------------------------------------------------- */
+/* Audio port */
+
+#ifdef PSVITA
+
+static int psv_port = -1;
+
+static int psv_port_open(int speed, int channels, int grain, const char *path)
+{
+    int vol[2] = { SCE_AUDIO_VOLUME_0DB, SCE_AUDIO_VOLUME_0DB };
+
+    /* The main port only runs at 48kHz, the BGM port takes any of the
+       usual rates.  */
+    psv_port = sceAudioOutOpenPort(SCE_AUDIO_OUT_PORT_TYPE_BGM, grain, speed,
+                                   channels == 2 ? SCE_AUDIO_OUT_MODE_STEREO
+                                                 : SCE_AUDIO_OUT_MODE_MONO);
+    if (psv_port < 0) {
+        log_error(psv_log, "Cannot open audio port (0x%08x).", (unsigned int)psv_port);
+        psv_port = -1;
+        return -1;
+    }
+
+    sceAudioOutSetVolume(psv_port, SCE_AUDIO_VOLUME_FLAG_L_CH | SCE_AUDIO_VOLUME_FLAG_R_CH, vol);
+    return 0;
+}
+
+/* Blocks until the port has room for the grain.  */
+static void psv_port_output(const int16_t *grain_buf)
+{
+    sceAudioOutOutput(psv_port, grain_buf);
+}
+
+static void psv_port_close(void)
+{
+    if (psv_port >= 0) {
+        /* Wait for the queued grain to play out before releasing.  */
+        sceAudioOutOutput(psv_port, NULL);
+        sceAudioOutReleasePort(psv_port);
+        psv_port = -1;
+    }
+}
+
+#else /* !PSVITA */
+
+/* Stand-in port: a null or raw file sink that consumes grains at the rate
+   the hardware would.  */
+
+static FILE *psv_port_file = NULL;
+static struct timespec psv_port_deadline;
+static long psv_port_grain_ns = 0;
+
+static int psv_port_open(int speed, int channels, int grain, const char *path)
+{
+    if (path && *path) {
+        psv_port_file = fopen(path, "wb");
+        if (!psv_port_file) {
+            log_error(psv_log, "Cannot open `%s' for writing.", path);
+            return -1;
+        }
+    }
+
+    psv_port_grain_ns = (long)((1000000000.0 * grain) / speed);
+    clock_gettime(CLOCK_MONOTONIC, &psv_port_deadline);
+    return 0;
+}
+
+static void psv_port_output(const int16_t *grain_buf)
+{
+    struct timespec now;
+
+    if (psv_port_file) {
+        fwrite(grain_buf, sizeof(int16_t), (size_t)(psv_grain * psv_channels), psv_port_file);
+    }
+
+    /* Like the hardware, accept the grain immediately if the previous one
+       has not been played yet, and otherwise block until it has.  The
+       deadline is absolute so that sleeping late does not drift.  */
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > psv_port_deadline.tv_sec
+        || (now.tv_sec == psv_port_deadline.tv_sec && now.tv_nsec > psv_port_deadline.tv_nsec)) {
+        /* Starved: the port restarts from now.  */
+        psv_port_deadline = now;
+    } else {
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &psv_port_deadline, NULL);
+    }
+
+    psv_port_deadline.tv_nsec += psv_port_grain_ns;
+    while (psv_port_deadline.tv_nsec >= 1000000000L) {
+        psv_port_deadline.tv_nsec -= 1000000000L;
+        psv_port_deadline.tv_sec++;
+    }
+}
+
+static void psv_port_close(void)
+{
+    if (psv_port_file) {
+        fclose(psv_port_file);
+        psv_port_file = NULL;
+    }
+}
+
+#endif /* PSVITA */
+
+/* ------------------------------------------------------------------------- */
+/* Ring buffer */
+
+static int psv_ring_fill(unsigned int inpos, unsigned int outpos)
+{
+    int fill = (int)inpos - (int)outpos;
+
+    return fill < 0 ? fill + 2 * psv_len : fill;
+}
+
+static unsigned int psv_ring_advance(unsigned int pos, int amount)
+{
+    pos += (unsigned int)amount;
+
+    return pos >= (unsigned int)(2 * psv_len) ? pos - (unsigned int)(2 * psv_len) : pos;
+}
+
+static int psv_ring_index(unsigned int pos)
+{
+    return pos < (unsigned int)psv_len ? (int)pos : (int)pos - psv_len;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Takes one grain out of the ring, padding with silence if the ring runs
+   dry.  Returns the number of frames taken.  */
+static int psv_take_grain(int16_t *dst)
+{
+    unsigned int outpos = psv_outpos;
+    int avail, amount, total;
+
+    avail = psv_ring_fill(PSV_RING_LOAD(&psv_inpos), outpos);
+    total = 0;
+
+    while (total < psv_grain && avail > 0) {
+        int idx = psv_ring_index(outpos);
+
+        amount = psv_len - idx;
+        if (amount > avail) {
+            amount = avail;
+        }
+        if (amount > psv_grain - total) {
+            amount = psv_grain - total;
+        }
+
+        memcpy(dst + total * psv_channels, psv_buf + idx * psv_channels,
+               (size_t)(amount * psv_channels) * sizeof(int16_t));
+        total += amount;
+        avail -= amount;
+        outpos = psv_ring_advance(outpos, amount);
+    }
+
+    if (total < psv_grain) {
+        memset(dst + total * psv_channels, 0,
+               (size_t)((psv_grain - total) * psv_channels) * sizeof(int16_t));
+    }
+
+    PSV_RING_STORE(&psv_outpos, outpos);
+
+    return total;
+}
+
+static void *psv_thread(void *arg)
+{
+    int cur = 0;
+    /* The ring starts out empty, so the grains before the first write are
+       not an underrun.  */
+    int starved = 1;
+
+    while (!PSV_RING_LOAD(&psv_quit)) {
+        int taken;
+
+        if (PSV_RING_LOAD(&psv_suspended)) {
+            pthread_mutex_lock(&psv_mutex);
+            while (psv_suspended && !psv_quit) {
+                pthread_cond_wait(&psv_resume_cond, &psv_mutex);
+            }
+            pthread_mutex_unlock(&psv_mutex);
+            continue;
+        }
+
+        taken = psv_take_grain(psv_grain_buf[cur]);
+
+        if (taken < psv_grain) {
+            if (!starved) {
+                starved = 1;
+                PSV_RING_STORE(&psv_underruns, psv_underruns + 1);
+            }
+        } else {
+            starved = 0;
+        }
+
+        if (taken) {
+            pthread_mutex_lock(&psv_mutex);
+            if (psv_write_waiting) {
+                pthread_cond_signal(&psv_space_cond);
+            }
+            pthread_mutex_unlock(&psv_mutex);
+        }
+
+        psv_port_output(psv_grain_buf[cur]);
+        cur ^= 1;
+    }
+
+    return NULL;
+}
+
+/* Wait until the thread has consumed some frames, or the time it takes to
+   play the whole buffer has passed.  Returns 0 on timeout.  */
+static int psv_wait_for_space(void)
+{
+    struct timespec deadline;
+    long timeout_ms;
+    int ret = 1;
+
+    timeout_ms = 1000L * psv_len / psv_speed + 10;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_nsec -= 1000000000L;
+        deadline.tv_sec++;
+    }
+
+    pthread_mutex_lock(&psv_mutex);
+    psv_write_waiting = 1;
+    while (ret && psv_ring_fill(psv_inpos, PSV_RING_LOAD(&psv_outpos)) >= psv_len) {
+        ret = (pthread_cond_timedwait(&psv_space_cond, &psv_mutex, &deadline) == 0);
+    }
+    psv_write_waiting = 0;
+    pthread_mutex_unlock(&psv_mutex);
+
+    return ret;
+}
+
+static void psv_free_buffers(void)
+{
+    lib_free(psv_buf);
+    lib_free(psv_grain_buf[0]);
+    lib_free(psv_grain_buf[1]);
+    psv_buf = NULL;
+    psv_grain_buf[0] = NULL;
+    psv_grain_buf[1] = NULL;
+}
+
+static int psv_init(const char *param, int *speed,
+                    int *fragsize, int *fragnr, int *channels)
+{
+    const char *path = NULL;
+    char *end;
+    int grain, nr;
+
+    if (psv_log == LOG_DEFAULT) {
+        psv_log = log_open("SoundPSV");
+    }
+
+    if (*channels > 2) {
+        *channels = 2;
+    }
+
+    /* "[grain][:file]" */
+    grain = *fragsize;
+    if (param && *param) {
+        long val = strtol(param, &end, 10);
+
+        if (end != param) {
+            grain = (int)val;
+        }
+        if (*end == ':') {
+            path = end + 1;
+        }
+    }
+
+    grain = (grain + PSV_GRAIN_ALIGN - 1) / PSV_GRAIN_ALIGN * PSV_GRAIN_ALIGN;
+    if (grain < PSV_GRAIN_MIN) {
+        grain = PSV_GRAIN_MIN;
+    } else if (grain > PSV_GRAIN_MAX) {
+        grain = PSV_GRAIN_MAX;
+    }
+
+    /* Keep approximately the buffer size asked for, but always leave room
+       for the grain being played and the one being written.  */
+    nr = ((*fragnr) * (*fragsize) + grain - 1) / grain;
+    if (nr < 2) {
+        nr = 2;
+    }
+
+    psv_speed = *speed;
+    psv_channels = *channels;
+    psv_grain = grain;
+    psv_len = grain * nr;
+    psv_inpos = psv_outpos = 0;
+    psv_quit = 0;
+    psv_suspended = 0;
+    psv_write_waiting = 0;
+    /* Count the xruns of this device only.  */
+    psv_underruns = 0;
+    psv_overruns = 0;
+
+    psv_buf = lib_calloc((size_t)(psv_len * psv_channels), sizeof(int16_t));
+    psv_grain_buf[0] = lib_calloc((size_t)(grain * psv_channels), sizeof(int16_t));
+    psv_grain_buf[1] = lib_calloc((size_t)(grain * psv_channels), sizeof(int16_t));
+
+    if (psv_port_open(psv_speed, psv_channels, grain, path) < 0) {
+        psv_free_buffers();
+        return 1;
+    }
+
+    if (pthread_create(&psv_thread_id, NULL, psv_thread, NULL) != 0) {
+        log_error(psv_log, "Cannot create audio thread.");
+        psv_port_close();
+        psv_free_buffers();
+        return 1;
+    }
+    psv_thread_running = 1;
+
+    log_message(psv_log, "Grain %d frames (%.1fms), %d grains buffered.",
+                grain, 1000.0 * grain / psv_speed, nr);
+
+    *fragsize = grain;
+    *fragnr = nr;
+    return 0;
+}
+
+/* nr is the number of samples, i.e. frames times channels.  */
+static int psv_write(int16_t *pbuf, size_t nr)
+{
+    unsigned int inpos = psv_inpos;
+    int frames = (int)nr / psv_channels;
+    int total, amount, space;
+
+    total = 0;
+
+    while (total < frames) {
+        int idx;
+
+        space = psv_len - psv_ring_fill(inpos, PSV_RING_LOAD(&psv_outpos));
+
+        if (space <= 0) {
+            if (!psv_wait_for_space()) {
+                /* The thread is not draining the buffer; drop the rest. */
+                psv_overruns++;
+                break;
+            }
+            continue;
+        }
+
+        idx = psv_ring_index(inpos);
+        amount = psv_len - idx;
+
+        if (amount > space) {
+            amount = space;
+        }
+
+        if (total + amount > frames) {
+            amount = frames - total;
+        }
+
+        memcpy(psv_buf + idx * psv_channels, pbuf + total * psv_channels,
+               (size_t)(amount * psv_channels) * sizeof(int16_t));
+        total += amount;
+        inpos = psv_ring_advance(inpos, amount);
+
+        PSV_RING_STORE(&psv_inpos, inpos);
+    }
+
+    return 0;
+}
+
+static int psv_bufferspace(void)
+{
+    return psv_len - psv_ring_fill(psv_inpos, PSV_RING_LOAD(&psv_outpos));
+}
+
+static void psv_close(void)
+{
+    if (psv_thread_running) {
+        pthread_mutex_lock(&psv_mutex);
+        PSV_RING_STORE(&psv_quit, 1);
+        pthread_cond_signal(&psv_resume_cond);
+        pthread_mutex_unlock(&psv_mutex);
+        pthread_join(psv_thread_id, NULL);
+        psv_thread_running = 0;
+    }
+
+    psv_port_close();
+    psv_free_buffers();
+    psv_inpos = psv_outpos = 0;
+    psv_len = 0;
+}
+
+static int psv_suspend(void)
+{
+    pthread_mutex_lock(&psv_mutex);
+    PSV_RING_STORE(&psv_suspended, 1);
+    pthread_mutex_unlock(&psv_mutex);
+    return 0;
+}
+
+static int psv_resume(void)
+{
+    pthread_mutex_lock(&psv_mutex);
+    PSV_RING_STORE(&psv_suspended, 0);
+    pthread_cond_signal(&psv_resume_cond);
+    pthread_mutex_unlock(&psv_mutex);
+    return 0;
+}
+
+static int psv_xruns(unsigned int *underruns, unsigned int *overruns)
+{
+    *underruns = PSV_RING_LOAD(&psv_underruns);
+    *overruns = psv_overruns;
+    return 0;
+}
+
+static sound_device_t psv_device =
+{
+    "psv",
+    psv_init,
+    psv_write,
+    NULL,
+    NULL,
+    psv_bufferspace,
+    psv_close,
+    psv_suspend,
+    psv_resume,
+    1,
+    2,
+    psv_xruns
+};
+
+int sound_init_psv_device(void)
+{
+    return sound_register_device(&psv_device);
+}
+#endif
@@ -43,20 +43,68 @@
 #include "loader.h"
 #endif
 
+/* The sample buffer is a lock-free single producer (sdl_write()) single
+   consumer (sdl_callback()) ring.  Each side owns one position and
+   publishes it with release semantics after touching the buffer, and reads
+   the other side's position with acquire semantics before touching it.
+   Positions run from 0 to 2 * sdl_len - 1, so that a full ring can be told
+   apart from an empty one without a shared flag.  */
+#if defined(__GNUC__) && defined(__ATOMIC_ACQUIRE)
+#define SDL_RING_LOAD(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SDL_RING_STORE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define SDL_RING_FENCE()        __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#else
+#define SDL_RING_LOAD(p)        (*(volatile unsigned int *)(p))
+#define SDL_RING_STORE(p, v)    (*(volatile unsigned int *)(p) = (v))
+#define SDL_RING_FENCE()
+#endif
+
 static int16_t *sdl_buf = NULL;
 static SDL_AudioSpec sdl_spec;
-static volatile int sdl_inptr = 0;
-static volatile int sdl_outptr = 0;
-static volatile int sdl_full = 0;
+static unsigned int sdl_inpos = 0;
+static unsigned int sdl_outpos = 0;
 static int sdl_len = 0;
 
+/* Set while sdl_write() waits for the callback to make room.  */
+static unsigned int sdl_write_waiting = 0;
+static SDL_sem *sdl_sem = NULL;
+static Uint32 sdl_write_timeout = 0;
+
+/* Underruns are counted by the callback, overruns by sdl_write().  */
+static unsigned int sdl_underruns = 0;
+static unsigned int sdl_overruns = 0;
+static int sdl_starved = 0;
+
+static int sdl_ring_fill(unsigned int inpos, unsigned int outpos)
+{
+    int fill = (int)inpos - (int)outpos;
+
+    return fill < 0 ? fill + 2 * sdl_len : fill;
+}
+
+static unsigned int sdl_ring_advance(unsigned int pos, int amount)
+{
+    pos += (unsigned int)amount;
+
+    return pos >= (unsigned int)(2 * sdl_len) ? pos - (unsigned int)(2 * sdl_len) : pos;
+}
+
+static int sdl_ring_index(unsigned int pos)
+{
+    return pos < (unsigned int)sdl_len ? (int)pos : (int)pos - sdl_len;
+}
+
 static void sdl_callback(void *userdata, Uint8 *stream, int len)
 {
-    int amount, total;
+    unsigned int outpos = sdl_outpos;
+    int avail, amount, total, wanted;
+
+    avail = sdl_ring_fill(SDL_RING_LOAD(&sdl_inpos), outpos);
+    wanted = len / (int)sizeof(int16_t);
     total = 0;
 
 #ifdef ANDROID_COMPILE
-    if ((!sdl_full) && (sdl_inptr == sdl_outptr)) {
+    if (!avail) {
         if (userdata) {
             *(short *)userdata = 0;
         }
@@ -64,43 +112,70 @@ static void sdl_callback(void *userdata, Uint8 *stream, int len)
     }
 #endif
 
-    while (total < (len / (int)sizeof(int16_t))) {
-        amount = sdl_inptr - sdl_outptr;
-        if (amount <= 0) {
-            amount = sdl_len - sdl_outptr;
-        }
+    while (total < wanted && avail > 0) {
+        int idx = sdl_ring_index(outpos);
 
-        if (amount + total > (len / (int)sizeof(int16_t))) {
-            amount = len / (int)sizeof(int16_t) - total;
+        amount = sdl_len - idx;
+        if (amount > avail) {
+            amount = avail;
         }
-
-        sdl_full = 0;
-
-        if (!amount) {
-            memset(stream + total * (int)sizeof(int16_t), 0, (size_t)(len - total) * sizeof(int16_t));
-#ifdef ANDROID_COMPILE
-            if (userdata) {
-                *(short *)userdata = (short)(len / (int)sizeof(int16_t));
-            }
-#endif
-            return;
+        if (amount > wanted - total) {
+            amount = wanted - total;
         }
 
-        memcpy(stream + total * (int)sizeof(int16_t), sdl_buf + sdl_outptr, (size_t)amount * sizeof(int16_t));
+        memcpy(stream + total * (int)sizeof(int16_t), sdl_buf + idx, (size_t)amount * sizeof(int16_t));
         total += amount;
-        sdl_outptr += amount;
+        avail -= amount;
+        outpos = sdl_ring_advance(outpos, amount);
+    }
 
-        if (sdl_outptr == sdl_len) {
-            sdl_outptr = 0;
+    if (total < wanted) {
+        memset(stream + total * (int)sizeof(int16_t), 0, (size_t)(wanted - total) * sizeof(int16_t));
+        if (!sdl_starved) {
+            sdl_starved = 1;
+            SDL_RING_STORE(&sdl_underruns, sdl_underruns + 1);
         }
+    } else {
+        sdl_starved = 0;
     }
+
+    SDL_RING_STORE(&sdl_outpos, outpos);
+
+    /* Wake up a writer waiting for room.  */
+    SDL_RING_FENCE();
+    if (total && SDL_RING_LOAD(&sdl_write_waiting)) {
+        SDL_SemPost(sdl_sem);
+    }
+
 #ifdef ANDROID_COMPILE
     if (userdata) {
-        *(short *)userdata = (short)total;
+        *(short *)userdata = (short)(total < wanted ? wanted : total);
     }
 #endif
 }
 
+/* Wait until the callback has consumed some samples, or the timeout has
+   expired.  Returns 0 on timeout.  */
+static int sdl_wait_for_space(void)
+{
+    int ret = 1;
+
+    /* Drop wake-ups that were meant for an earlier wait.  */
+    while (SDL_SemTryWait(sdl_sem) == 0) {
+    }
+
+    SDL_RING_STORE(&sdl_write_waiting, 1);
+    SDL_RING_FENCE();
+
+    if (sdl_ring_fill(sdl_inpos, SDL_RING_LOAD(&sdl_outpos)) >= sdl_len) {
+        ret = (SDL_SemWaitTimeout(sdl_sem, sdl_write_timeout) == 0);
+    }
+
+    SDL_RING_STORE(&sdl_write_waiting, 0);
+
+    return ret;
+}
+
 static int sdl_init(const char *param, int *speed,
                     int *fragsize, int *fragnr, int *channels)
 {
@@ -140,14 +215,31 @@ static int sdl_init(const char *param, int *speed,
     nr = ((*fragnr) * (*fragsize)) / sdl_spec.samples;
 
     sdl_len = sdl_spec.samples * nr;
-    sdl_inptr = sdl_outptr = sdl_full = 0;
+    sdl_inpos = sdl_outpos = 0;
+    sdl_write_waiting = 0;
+    /* Count the xruns of this device only.  The ring starts out empty, so
+       the callbacks before the first write are not an underrun.  */
+    sdl_underruns = 0;
+    sdl_overruns = 0;
+    sdl_starved = 1;
     sdl_buf = lib_calloc((size_t)sdl_len, sizeof(int16_t));
+    sdl_sem = SDL_CreateSemaphore(0);
 
-    if (!sdl_buf) {
+    if (!sdl_buf || !sdl_sem) {
         SDL_CloseAudio();
+        lib_free(sdl_buf);
+        sdl_buf = NULL;
+        if (sdl_sem) {
+            SDL_DestroySemaphore(sdl_sem);
+            sdl_sem = NULL;
+        }
         return 1;
     }
 
+    /* Give up writing if the callback did not make room for the time it
+       takes to play the whole buffer.  */
+    sdl_write_timeout = (Uint32)(1000 * sdl_len / (sdl_spec.freq * sdl_spec.channels)) + 10;
+
     *speed = sdl_spec.freq;
     *fragsize = sdl_spec.samples;
     *fragnr = nr;
@@ -200,19 +292,16 @@ void loader_writebuffer()
     int total;
 
     for(;;) {
-        int old_sdl_outptr = sdl_outptr;
+        unsigned int old_sdl_outpos = SDL_RING_LOAD(&sdl_outpos);
 
-        total = sdl_inptr - sdl_outptr;
-        if (total <= 0) {
-            total = sdl_len - sdl_outptr + sdl_inptr;
-        }
+        total = sdl_ring_fill(SDL_RING_LOAD(&sdl_inpos), old_sdl_outpos);
         if (total > (sdl_spec.samples << 1)) {
             Android_AudioWriteBuffer();
         } else {
             break;
         }
 
-        if (sdl_outptr == old_sdl_outptr) {
+        if (SDL_RING_LOAD(&sdl_outpos) == old_sdl_outpos) {
             break;
         }
     };
@@ -221,7 +310,8 @@ void loader_writebuffer()
 
 static int sdl_write(int16_t *pbuf, size_t nr)
 {
-    int total, amount;
+    unsigned int inpos = sdl_inpos;
+    int total, amount, space;
     total = 0;
 
 #ifdef WORDS_BIGENDIAN
@@ -232,32 +322,35 @@ static int sdl_write(int16_t *pbuf, size_t nr)
 #endif
 
     while (total < (int)nr) {
-        amount = sdl_outptr - sdl_inptr;
+        int idx;
+
+        space = sdl_len - sdl_ring_fill(inpos, SDL_RING_LOAD(&sdl_outpos));
 
-        if (amount <= 0) {
-            amount = sdl_len - sdl_inptr;
+        if (space <= 0) {
+            if (!sdl_wait_for_space()) {
+                /* The callback is not draining the buffer; drop the rest. */
+                sdl_overruns++;
+                break;
+            }
+            continue;
         }
 
-        if (total + amount > (int)nr) {
-            amount = (int)nr - total;
+        idx = sdl_ring_index(inpos);
+        amount = sdl_len - idx;
+
+        if (amount > space) {
+            amount = space;
         }
 
-        if (amount <= 0) {
-            SDL_Delay(5);
-            continue;
+        if (total + amount > (int)nr) {
+            amount = (int)nr - total;
         }
 
-        memcpy(sdl_buf + sdl_inptr, pbuf + total, (size_t)amount * sizeof(int16_t));
-        sdl_inptr += amount;
+        memcpy(sdl_buf + idx, pbuf + total, (size_t)amount * sizeof(int16_t));
         total += amount;
+        inpos = sdl_ring_advance(inpos, amount);
 
-        if (sdl_inptr == sdl_len) {
-            sdl_inptr = 0;
-        }
-    }
-
-    if (sdl_inptr == sdl_outptr) {
-        sdl_full = 1;
+        SDL_RING_STORE(&sdl_inpos, inpos);
     }
 
     return 0;
@@ -265,19 +358,7 @@ static int sdl_write(int16_t *pbuf, size_t nr)
 
 static int sdl_bufferspace(void)
 {
-    int amount;
-
-    if (sdl_full) {
-        amount = sdl_len;
-    } else {
-        amount = sdl_inptr - sdl_outptr;
-    }
-
-    if (amount < 0) {
-        amount += sdl_len;
-    }
-
-    return sdl_len - amount;
+    return sdl_len - sdl_ring_fill(sdl_inpos, SDL_RING_LOAD(&sdl_outpos));
 }
 
 static void sdl_close(void)
@@ -285,13 +366,17 @@ static void sdl_close(void)
     SDL_CloseAudio();
     lib_free(sdl_buf);
     sdl_buf = NULL;
-    sdl_inptr = sdl_outptr = sdl_len = sdl_full = 0;
+    if (sdl_sem) {
+        SDL_DestroySemaphore(sdl_sem);
+        sdl_sem = NULL;
+    }
+    sdl_inpos = sdl_outpos = 0;
+    sdl_len = 0;
 }
 
 static int sdl_suspend(void)
 {
     SDL_PauseAudio(1);
-    sdl_full = 0;
     return 0;
 }
 
@@ -301,6 +386,13 @@ static int sdl_resume(void)
     return 0;
 }
 
+static int sdl_xruns(unsigned int *underruns, unsigned int *overruns)
+{
+    *underruns = SDL_RING_LOAD(&sdl_underruns);
+    *overruns = sdl_overruns;
+    return 0;
+}
+
 static sound_device_t sdl_device =
 {
     "sdl",
@@ -313,7 +405,8 @@ static sound_device_t sdl_device =
     sdl_suspend,
     sdl_resume,
     1,
-    2
+    2,
+    sdl_xruns
 };
 
 int sound_init_sdl_device(void)
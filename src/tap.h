@@ -38,6 +38,14 @@
 #define TAP_HDR_SYSTEM       13
 #define TAP_HDR_LEN          16
 
+/* Pulses from one entry of the pulse index to the next.  */
+#define TAP_INDEX_STEP       256
+
+/* Bytes taken by the pulse at the offset `pos' from the header.  The long
+   pulses of version 1 and 2 take 4 bytes.  */
+#define TAP_PULSE_LEN(tap, pos) \
+    (((tap)->version > 0 && (tap)->data[(tap)->offset + (pos)] == 0) ? 4 : 1)
+
 
 struct tape_init_s;
 struct tape_file_record_s;
@@ -52,6 +60,29 @@ typedef struct tap_s {
     /* Size of the image.  */
     int size;
 
+    /* Contents of the image, header included, loaded at open.  */
+    uint8_t *data;
+
+    /* Bytes allocated for the contents.  */
+    int data_alloc;
+
+    /* Position of the file detection in the contents.  */
+    int data_pos;
+
+    /* Offset after the header of every TAP_INDEX_STEP-th pulse, from the
+       first one up to the end of the last pulse.  Each half wave of
+       version 2 is a pulse of its own.  The pulses in between are found by
+       reading on from the entry before them.  */
+    uint32_t *index_offset;
+
+    /* Tape counter in machine-cycles/8 at the start of the same pulses.
+       Filled by the datasette.  */
+    uint32_t *index_counter;
+
+    /* Number of pulses, and of entries allocated in the arrays above.  */
+    int num_pulses;
+    int index_alloc;
+
     /* The TAP version byte.  */
     uint8_t version;
 
@@ -110,4 +141,9 @@ extern struct tape_file_record_s *tap_get_current_file_record(tap_t *tap);
 
 extern int tap_read(tap_t *tap, uint8_t *buf, size_t size);
 
+extern void tap_index_pulses(tap_t *tap);
+extern int tap_find_pulse(tap_t *tap, int position, uint32_t *offset);
+extern uint32_t tap_pulse_offset(tap_t *tap, int pulse);
+extern int tap_write_data(tap_t *tap, int position, const uint8_t *buf, int size);
+
 #endif
@@ -156,6 +156,20 @@ tap_t *tap_open(const char *name, unsigned int *read_only)
         return NULL;
     }
 
+    /* The whole image is kept in memory, so that the datasette and the file
+       detection never read from the file.  */
+    new->data_alloc = new->offset + new->size;
+    new->data = lib_malloc(new->data_alloc);
+
+    if (util_fpread(fd, new->data, new->data_alloc, 0) < 0) {
+        zfile_fclose(new->fd);
+        lib_free(new->data);
+        lib_free(new);
+        return NULL;
+    }
+
+    tap_index_pulses(new);
+
     new->file_name = lib_stralloc(name);
     new->tap_file_record = lib_calloc(1, sizeof(tape_file_record_t));
     new->current_file_number = -1;
@@ -182,6 +196,9 @@ int tap_close(tap_t *tap)
     }
 
     lib_free(tap->current_file_data);
+    lib_free(tap->data);
+    lib_free(tap->index_offset);
+    lib_free(tap->index_counter);
     lib_free(tap->file_name);
     lib_free(tap->tap_file_record);
     lib_free(tap);
@@ -222,73 +239,222 @@ int tap_create(const char *name)
 }
 
 
+/* ------------------------------------------------------------------------- */
+
+static void tap_index_alloc(tap_t *tap, int num)
+{
+    if (num <= tap->index_alloc) {
+        return;
+    }
+
+    if (tap->index_alloc == 0) {
+        tap->index_alloc = 64;
+    }
+    while (tap->index_alloc < num) {
+        tap->index_alloc *= 2;
+    }
+
+    tap->index_offset = lib_realloc(tap->index_offset,
+                                    tap->index_alloc * sizeof(uint32_t));
+    tap->index_counter = lib_realloc(tap->index_counter,
+                                     tap->index_alloc * sizeof(uint32_t));
+}
+
+/* Index the pulses after the last entry of the index that is still valid.
+   A long pulse cut short by the end of the image is left out, as the
+   datasette can't play it.  */
+void tap_index_pulses(tap_t *tap)
+{
+    uint32_t size = (uint32_t)tap->size;
+    uint32_t pos, len;
+    int pulse;
+
+    if (tap->index_alloc == 0) {
+        tap_index_alloc(tap, 1);
+        tap->index_offset[0] = 0;
+        tap->index_counter[0] = 0;
+    }
+
+    pulse = (tap->num_pulses / TAP_INDEX_STEP) * TAP_INDEX_STEP;
+    pos = tap->index_offset[pulse / TAP_INDEX_STEP];
+
+    while (pos < size) {
+        len = TAP_PULSE_LEN(tap, pos);
+        if (pos + len > size) {
+            break;
+        }
+        pos += len;
+        if (++pulse % TAP_INDEX_STEP == 0) {
+            tap_index_alloc(tap, pulse / TAP_INDEX_STEP + 1);
+            tap->index_offset[pulse / TAP_INDEX_STEP] = pos;
+        }
+    }
+
+    tap->num_pulses = pulse;
+}
+
+/* Number of the first pulse at or after the offset `position' from the
+   header, or the number of pulses if there is none.  Its offset is stored
+   in `offset'.  */
+int tap_find_pulse(tap_t *tap, int position, uint32_t *offset)
+{
+    int low = 0;
+    int high = tap->num_pulses / TAP_INDEX_STEP;
+    int mid, pulse;
+    uint32_t pos;
+
+    while (low < high) {
+        mid = (low + high + 1) / 2;
+        if (tap->index_offset[mid] <= (uint32_t)position) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    pulse = low * TAP_INDEX_STEP;
+    pos = tap->index_offset[low];
+    while (pulse < tap->num_pulses && pos < (uint32_t)position) {
+        pos += TAP_PULSE_LEN(tap, pos);
+        pulse++;
+    }
+
+    *offset = pos;
+    return pulse;
+}
+
+/* Offset from the header of the pulse `pulse', or of the end of the last
+   pulse.  */
+uint32_t tap_pulse_offset(tap_t *tap, int pulse)
+{
+    int i = (pulse / TAP_INDEX_STEP) * TAP_INDEX_STEP;
+    uint32_t pos = tap->index_offset[pulse / TAP_INDEX_STEP];
+
+    for (; i < pulse; i++) {
+        pos += TAP_PULSE_LEN(tap, pos);
+    }
+
+    return pos;
+}
+
+/* Write to the file and to the image in memory at the offset `position'
+   from the header.  The pulses from there on have to be indexed again with
+   tap_index_pulses() once tap->size is updated.  */
+int tap_write_data(tap_t *tap, int position, const uint8_t *buf, int size)
+{
+    int end = tap->offset + position + size;
+    int pulse;
+    uint32_t pos;
+
+    if (util_fpwrite(tap->fd, buf, size, tap->offset + position) < 0) {
+        return -1;
+    }
+
+    if (end > tap->data_alloc) {
+        while (tap->data_alloc < end) {
+            tap->data_alloc *= 2;
+        }
+        tap->data = lib_realloc(tap->data, tap->data_alloc);
+    }
+
+    /* The pulse written into is found before its first byte changes.  */
+    pulse = tap_find_pulse(tap, position, &pos);
+    if (pulse > 0 && pos > (uint32_t)position) {
+        pulse--;
+    }
+    tap->num_pulses = pulse;
+
+    memcpy(tap->data + tap->offset + position, buf, size);
+
+    return size;
+}
+
 /* ------------------------------------------------------------------------- */
 
 static int tap_find_pilot(tap_t *tap, int type);
 
-inline static int tap_get_pulse(tap_t *tap, int *pos_advance)
+/* The file detection reads the image in memory like a file: data_pos is
+   the position in the file, header included.  */
+#define tap_tell(tap)       ((long)(tap)->data_pos)
+#define tap_seek(tap, pos)  ((tap)->data_pos = (int)(pos))
+
+static size_t tap_read_data(tap_t *tap, uint8_t *buf, size_t size)
 {
-    uint8_t data;
-    uint32_t pulse_length = 0;
-    size_t res;
+    int left = tap->offset + tap->size - tap->data_pos;
 
-    *pos_advance = 0;
-    res = fread(&data, 1, 1, tap->fd);
+    if (left <= 0) {
+        return 0;
+    }
+    if (size > (size_t)left) {
+        size = (size_t)left;
+    }
+
+    memcpy(buf, tap->data + tap->data_pos, size);
+    tap->data_pos += (int)size;
+
+    return size;
+}
+
+/* Length of the (long) pulse at data_pos, -1 at the end of the image.  */
+inline static int tap_get_pulse_half(tap_t *tap, int *pos_advance)
+{
+    const uint8_t *data = tap->data + tap->data_pos;
+    int left = tap->offset + tap->size - tap->data_pos;
 
-    if (res == 0) {
+    if (left < 1) {
         return -1;
     }
 
-    *pos_advance += (int)res;
+    if (data[0] != 0) {
+        tap->data_pos++;
+        *pos_advance += 1;
+        return data[0];
+    }
 
-    if (data == 0) {
-        if (tap->version == 0) {
-            pulse_length = 256;
-        } else if ((tap->version == 1) || (tap->version == 2)) {
-            uint8_t size[3];
-            res = fread(size, 3, 1, tap->fd);
-            if (res == 0) {
-                return -1;
-            }
-            *pos_advance += 3;
-            pulse_length = ((size[2] << 16) | (size[1] << 8) | size[0]) >> 3;
-        }
-    } else {
-        pulse_length = data;
+    if (tap->version == 0) {
+        tap->data_pos++;
+        *pos_advance += 1;
+        return 256;
+    }
+
+    if (left < 4) {
+        return -1;
+    }
+
+    tap->data_pos += 4;
+    *pos_advance += 4;
+    return (int)(((data[3] << 16) | (data[2] << 8) | data[1]) >> 3);
+}
+
+inline static int tap_get_pulse(tap_t *tap, int *pos_advance)
+{
+    int pulse_length;
+
+    *pos_advance = 0;
+
+    pulse_length = tap_get_pulse_half(tap, pos_advance);
+    if (pulse_length < 0) {
+        return -1;
     }
 
     /*  Handle Halfwave format for C16 tapes */
     if (tap->version == 2) {
-        uint32_t pulse_length2;
-
-        res = fread(&data, 1, 1, tap->fd);
+        int pulse_length2 = tap_get_pulse_half(tap, pos_advance);
 
-        if (res == 0) {
+        if (pulse_length2 < 0) {
             return -1;
         }
-        *pos_advance += (int)res;
-        if (data == 0) {
-            uint8_t size[3];
-            res = fread(size, 3, 1, tap->fd);
-            if (res == 0) {
-                return -1;
-            }
-            *pos_advance += 3;
-            pulse_length2 = ((size[2] << 16) | (size[1] << 8) | size[0]) >> 3;
-        } else {
-            pulse_length2 = data;
-        }
 
         /*  This should do for the time being */
         pulse_length += pulse_length2;
     }
 
 #if TAP_DEBUG > 2
-    if (TAP_PULSE_SHORT(data)) {
+    if (TAP_PULSE_SHORT(pulse_length)) {
         log_debug("s");
-    } else if (TAP_PULSE_MIDDLE(data)) {
+    } else if (TAP_PULSE_MIDDLE(pulse_length)) {
         log_debug("m");
-    } else if (TAP_PULSE_LONG(data)) {
+    } else if (TAP_PULSE_LONG(pulse_length)) {
         log_debug("l");
     }
 #endif
@@ -382,7 +548,7 @@ static int tap_cbm_skip_pilot(tap_t *tap)
 
     errors = 0;
     counter = 0;
-    current_filepos = ftell(tap->fd);
+    current_filepos = tap_tell(tap);
     while (1) {
         /*  Save file position */
         fpos = current_filepos;
@@ -391,7 +557,7 @@ static int tap_cbm_skip_pilot(tap_t *tap)
         fpos2 = current_filepos;
         if (TAP_PULSE_LONG(data)) {
             /* found an L pulse, try to read a byte */
-            fseek(tap->fd, fpos, SEEK_SET);
+            tap_seek(tap, fpos);
             current_filepos = fpos;
             data = tap_cbm_read_byte(tap);
             if (data == -1) {
@@ -404,12 +570,12 @@ static int tap_cbm_skip_pilot(tap_t *tap)
                 }
 
                 /* Start over after the L pulse */
-                fseek(tap->fd, fpos2, SEEK_SET);
+                tap_seek(tap, fpos2);
                 current_filepos = fpos2;
                 counter = 0;
             } else {
                 /* success.  Go back to start of byte and return */
-                fseek(tap->fd, fpos, SEEK_SET);
+                tap_seek(tap, fpos);
                 current_filepos = fpos;
                 return 0;
             }
@@ -766,13 +932,13 @@ static int tap_cbm_skip_file(tap_t *tap)
         int ret;
 
         while (1) {
-            fpos = ftell(tap->fd);
+            fpos = tap_tell(tap);
 
             /* find next pilot */
             ret = tap_find_pilot(tap, PILOT_TYPE_CBM);
             if (ret < 0) {
                 /* no more pilot found => end of data */
-                fseek(tap->fd, fpos, SEEK_SET);
+                tap_seek(tap, fpos);
                 break;
             }
 
@@ -780,7 +946,7 @@ static int tap_cbm_skip_file(tap_t *tap)
             ret = tap_cbm_read_block(tap, buffer, 193);
             if (ret < 1 || buffer[0] != 2) {
                 /* next block is not a data continuation block => end of data */
-                fseek(tap->fd, fpos, SEEK_SET);
+                tap_seek(tap, fpos);
                 break;
             }
         }
@@ -847,7 +1013,7 @@ static int tap_tt_skip_pilot(tap_t *tap)
     int data;
 
 #if TAP_DEBUG > 1
-    log_debug("\nTAP_TT_SKIP_PILOT(0x%X", ftell(tap->fd));
+    log_debug("\nTAP_TT_SKIP_PILOT(0x%X", tap_tell(tap));
 #endif
 
     /* turbo-tape pilot is just repeats of value 0x02 */
@@ -860,12 +1026,12 @@ static int tap_tt_skip_pilot(tap_t *tap)
         if (data != 2) {
             /* value != 0x02, we found the end of the pilot.  Go back
                so byte can be read again */
-            fseek(tap->fd, -8, SEEK_CUR);
+            tap_seek(tap, tap_tell(tap) - 8);
         }
     } while (data == 2);
 
 #if TAP_DEBUG > 1
-    log_debug("-0x%X) ", ftell(tap->fd));
+    log_debug("-0x%X) ", tap_tell(tap));
 #endif
 
     return 0;
@@ -1103,7 +1269,7 @@ static int tap_find_pilot(tap_t *tap, int type)
        file */
     minCBM = (type == PILOT_TYPE_ANY) ? 1000 : PILOT_MIN_LENGTH_CBM;
 
-    startCBM = ftell(tap->fd);
+    startCBM = tap_tell(tap);
     startTT = startCBM;
     countCBM = 0;
     countTT = 0;
@@ -1114,8 +1280,8 @@ static int tap_find_pilot(tap_t *tap, int type)
 
     while ((countCBM < minCBM) && (countTT < PILOT_MIN_LENGTH_TT * 8)) {
 /*        count = fread(&data, 1, 256, tap->fd); */
-        int startpos = ftell(tap->fd);
-        int readlen = (int)fread(buffer, 1, 256, tap->fd);
+        int startpos = tap_tell(tap);
+        int readlen = (int)tap_read_data(tap, buffer, 256);
         uint32_t pulse_length = 0;
         int j = 0;
         int needed;
@@ -1136,7 +1302,7 @@ static int tap_find_pilot(tap_t *tap, int type)
                         /* There is not enough in the buffer
                            Read some more */
                         memcpy(buffer, buffer + i + 1, still_in_buffer);
-                        res = (int)fread(buffer + still_in_buffer, 1, needed, tap->fd);
+                        res = (int)tap_read_data(tap, buffer + still_in_buffer, needed);
                         i = readlen;
                         if (res == 0) {
                             continue;
@@ -1154,7 +1320,7 @@ static int tap_find_pilot(tap_t *tap, int type)
                 uint32_t pulse_length2;
                 /*  Read one more byte if run out of buffer */
                 if (i == readlen) {
-                    readlen = (int)fread(buffer, 1, 1, tap->fd);
+                    readlen = (int)tap_read_data(tap, buffer, 1);
                     if (readlen == 0) {
                         continue;
                     }
@@ -1170,7 +1336,7 @@ static int tap_find_pilot(tap_t *tap, int type)
                         /* There is not enough in the buffer
                            Read some more */
                         memcpy(buffer, buffer + i + 1, still_in_buffer);
-                        res = (int)fread(buffer + still_in_buffer, 1, needed, tap->fd);
+                        res = (int)tap_read_data(tap, buffer + still_in_buffer, needed);
                         i = readlen;
                         if (res == 0) {
                             continue;
@@ -1186,14 +1352,14 @@ static int tap_find_pilot(tap_t *tap, int type)
             j++;
         }
         count = j;
-        pos[j] = ftell(tap->fd);
+        pos[j] = tap_tell(tap);
 
 /*        for (i = 0, count = 0; i < 256; i++, count++) {
-            pos[i] = ftell(tap->fd);
+            pos[i] = tap_tell(tap);
             data[i] = tap_get_pulse(tap);
             if (data[i] < 0) break;
         }
-        pos[i] = ftell(tap->fd);*/
+        pos[i] = tap_tell(tap);*/
         if (count < 1) {
             return -1;
         }
@@ -1254,10 +1420,10 @@ static int tap_find_pilot(tap_t *tap, int type)
         /* startTT points to a '1' bit which we assume to be part of the
            value 00000010.  Skip over the 1 and following 0 so we start
            at the beginning of a 00000010 sequence */
-        fseek(tap->fd, startTT + 2, SEEK_SET);
+        tap_seek(tap, startTT + 2);
         return 1;
     } else {
-        fseek(tap->fd, startCBM, SEEK_SET);
+        tap_seek(tap, startCBM);
         return 0;
     }
 }
@@ -1277,21 +1443,21 @@ static int tap_find_header(tap_t *tap)
         }
 
         /* store current position in TAP file */
-        fpos = ftell(tap->fd);
+        fpos = tap_tell(tap);
 
         /* try to read a header */
         if (type == PILOT_TYPE_CBM) {
             res = tap_cbm_read_header(tap);
             if (res < 0) {
                 int pos_advance;
-                fseek(tap->fd, fpos, SEEK_SET);
+                tap_seek(tap, fpos);
                 while (TAP_PULSE_SHORT(tap_get_pulse(tap, &pos_advance))) {
                 }
             }
         } else if (type == PILOT_TYPE_TT) {
             res = tap_tt_read_header(tap);
             if (res < 0) {
-                fseek(tap->fd, fpos, SEEK_SET);
+                tap_seek(tap, fpos);
                 tap_tt_skip_pilot(tap);
             }
         } else {
@@ -1305,7 +1471,7 @@ static int tap_find_header(tap_t *tap)
             }
 
             /* success.  Rewind to start of header and return. */
-            fseek(tap->fd, fpos, SEEK_SET);
+            tap_seek(tap, fpos);
             tap->current_file_seek_position = fpos;
             return type;
         }
@@ -1323,7 +1489,7 @@ static int tap_read_file(tap_t *tap)
 #endif
 
     /* store current position in TAP file */
-    fpos = ftell(tap->fd);
+    fpos = tap_tell(tap);
 
     /* clear old file data */
     tap->current_file_size = 0;
@@ -1349,7 +1515,7 @@ static int tap_read_file(tap_t *tap)
     }
 
     /* go back to previous position in TAP file */
-    fseek(tap->fd, fpos, SEEK_SET);
+    tap_seek(tap, fpos);
 
 #if TAP_DEBUG > 0
     log_debug("\nTAP_READ_FILE(END%i)\n", ret);
@@ -1407,7 +1573,7 @@ int tap_seek_start(tap_t *tap)
 
     tap->current_file_number = -1;
     tap->current_file_seek_position = 0;
-    fseek(tap->fd, tap->offset, SEEK_SET);
+    tap_seek(tap, tap->offset);
     return 0;
 }
 
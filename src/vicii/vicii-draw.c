@@ -42,6 +42,17 @@
 #include "viciitypes.h"
 #include "viewport.h"
 
+/* The text and bitmap modes can be drawn 16 characters at a time with
+   NEON, or SSE2 on the host.  Without either, only the plain loops
+   below are used.  */
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VICII_DRAW_SIMD
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define VICII_DRAW_SIMD
+#endif
+
 
 #define GFX_MSK_LEFTBORDER_SIZE ((VICII_MAX_SPRITE_WIDTH - VICII_RASTER_X(0) \
                                   + vicii.screen_leftborderwidth ) / 8 + 1)
@@ -1411,40 +1422,597 @@ static void draw_idle_foreground(unsigned int start_char,
     }
 }
 
+#ifdef VICII_DRAW_SIMD
+
+/* Vectorized drawing of the text and bitmap modes.
+
+   The colours and data of 16 characters are loaded into vectors (the
+   data is gathered byte by byte where it comes from the character
+   generator or the bitmap).  Each byte is then spread over 8 lanes and
+   the pixels are picked from the colours with a per-lane bit test, so a
+   block of 16 characters takes 8 stores of 16 pixels.  Ranges shorter
+   than a block are drawn with the plain functions above; for longer ones
+   the last block is moved back to end at `xe', drawing a few characters
+   twice.
+
+   Only the operations below are ISA specific.  SIMD_TEST() must be given
+   a single bit per lane.  */
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+typedef uint8x16_t simd_t;
+
+#define SIMD_LOAD(p)            vld1q_u8(p)
+#define SIMD_STORE(p, v)        vst1q_u8((p), (v))
+#define SIMD_DUP(b)             vdupq_n_u8(b)
+#define SIMD_AND(a, b)          vandq_u8((a), (b))
+#define SIMD_OR(a, b)           vorrq_u8((a), (b))
+#define SIMD_SHR1(a)            vshrq_n_u8((a), 1)
+#define SIMD_SHR4(a)            vshrq_n_u8((a), 4)
+#define SIMD_TEST(a, b)         vtstq_u8((a), (b))
+#define SIMD_SELECT(m, a, b)    vbslq_u8((m), (a), (b))
+
+/* a0 a0 a1 a1 ... a7 a7 and a8 a8 ... a15 a15.  */
+inline static void simd_zip(simd_t a, simd_t *lo, simd_t *hi)
+{
+    uint8x16x2_t z = vzipq_u8(a, a);
+
+    *lo = z.val[0];
+    *hi = z.val[1];
+}
+
+#else
+
+typedef __m128i simd_t;
+
+#define SIMD_LOAD(p)            _mm_loadu_si128((const __m128i *)(p))
+#define SIMD_STORE(p, v)        _mm_storeu_si128((__m128i *)(p), (v))
+#define SIMD_DUP(b)             _mm_set1_epi8((char)(b))
+#define SIMD_AND(a, b)          _mm_and_si128((a), (b))
+#define SIMD_OR(a, b)           _mm_or_si128((a), (b))
+#define SIMD_SHR1(a)            _mm_and_si128(_mm_srli_epi16((a), 1), _mm_set1_epi8(0x7f))
+#define SIMD_SHR4(a)            _mm_and_si128(_mm_srli_epi16((a), 4), _mm_set1_epi8(0x0f))
+#define SIMD_TEST(a, b)         _mm_cmpeq_epi8(_mm_and_si128((a), (b)), (b))
+#define SIMD_SELECT(m, a, b)    _mm_or_si128(_mm_and_si128((m), (a)), _mm_andnot_si128((m), (b)))
+
+inline static void simd_zip(simd_t a, simd_t *lo, simd_t *hi)
+{
+    *lo = _mm_unpacklo_epi8(a, a);
+    *hi = _mm_unpackhi_epi8(a, a);
+}
+
+#endif
+
+/* Start of the next block of 16 characters in a range ending at `xe'.  */
+#define SIMD_NEXT_BLOCK(i, xe) \
+    ((i) + 31 <= (xe) || (i) + 15 == (xe) ? (i) + 16 : (xe) - 15)
+
+/* Bit of each pixel in the character data, for hires and multicolor.  */
+static const uint8_t simd_hr_bits[16] = {
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+    0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01
+};
+static const uint8_t simd_mc_hi_bits[16] = {
+    0x80, 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02,
+    0x80, 0x80, 0x20, 0x20, 0x08, 0x08, 0x02, 0x02
+};
+static const uint8_t simd_mc_lo_bits[16] = {
+    0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01,
+    0x40, 0x40, 0x10, 0x10, 0x04, 0x04, 0x01, 0x01
+};
+
+/* Spread each byte of `v' over 8 lanes: out[k] holds bytes 2k and
+   2k + 1.  */
+inline static void simd_expand(simd_t v, simd_t *out)
+{
+    simd_t a[2], b[4];
+    int k;
+
+    simd_zip(v, &a[0], &a[1]);
+    for (k = 0; k < 2; k++) {
+        simd_zip(a[k], &b[k * 2], &b[k * 2 + 1]);
+    }
+    for (k = 0; k < 4; k++) {
+        simd_zip(b[k], &out[k * 2], &out[k * 2 + 1]);
+    }
+}
+
+/* Same as mcmsktable[].  */
+inline static simd_t simd_mc_msk(simd_t d)
+{
+    simd_t m = SIMD_AND(d, SIMD_DUP(0xaa));
+
+    return SIMD_OR(m, SIMD_SHR1(m));
+}
+
+/* One of four colours for each lane, indexed by bits `b1' and `b0' of
+   `idx'.  */
+inline static simd_t simd_lookup4(simd_t idx, uint8_t b1, uint8_t b0,
+                                  simd_t c0, simd_t c1, simd_t c2, simd_t c3)
+{
+    simd_t bit0 = SIMD_TEST(idx, SIMD_DUP(b0));
+
+    return SIMD_SELECT(SIMD_TEST(idx, SIMD_DUP(b1)),
+                       SIMD_SELECT(bit0, c3, c2),
+                       SIMD_SELECT(bit0, c1, c0));
+}
+
+/* 16 hires characters: `fg' where the bit of `d' is set, else `bg'.
+   Unless `bg_varies', `bg' is the same for all of them and is not
+   spread.  */
+inline static void simd_draw_hires(uint8_t *p, simd_t d, simd_t fg, simd_t bg,
+                                   int bg_varies)
+{
+    simd_t dx[8], fx[8], bx[8];
+    simd_t bits = SIMD_LOAD(simd_hr_bits);
+    int k;
+
+    simd_expand(d, dx);
+    simd_expand(fg, fx);
+    if (bg_varies) {
+        simd_expand(bg, bx);
+    }
+
+    for (k = 0; k < 8; k++) {
+        SIMD_STORE(p + k * 16, SIMD_SELECT(SIMD_TEST(dx[k], bits), fx[k],
+                                           bg_varies ? bx[k] : bg));
+    }
+}
+
+/* 16 multicolor characters: each bit pair of `d' picks the background
+   `c0' or one of the colours `c1'...`c3' for two pixels.  */
+inline static void simd_draw_mc(uint8_t *p, simd_t d, simd_t c0, simd_t c1,
+                                simd_t c2, simd_t c3)
+{
+    simd_t dx[8], c1x[8], c2x[8], c3x[8];
+    simd_t hi_bits = SIMD_LOAD(simd_mc_hi_bits);
+    simd_t lo_bits = SIMD_LOAD(simd_mc_lo_bits);
+    int k;
+
+    simd_expand(d, dx);
+    simd_expand(c1, c1x);
+    simd_expand(c2, c2x);
+    simd_expand(c3, c3x);
+
+    for (k = 0; k < 8; k++) {
+        simd_t lo = SIMD_TEST(dx[k], lo_bits);
+
+        SIMD_STORE(p + k * 16,
+                   SIMD_SELECT(SIMD_TEST(dx[k], hi_bits),
+                               SIMD_SELECT(lo, c3x[k], c2x[k]),
+                               SIMD_SELECT(lo, c1x[k], c0)));
+    }
+}
+
+/* 16 characters of multicolor text.  Bit 3 of the colour selects between
+   multicolor and hires.  A hires character is drawn as a multicolor one
+   with both bits of each pair taken from the same pixel, and since its
+   colour is below 8 both use colour & 7.  */
+inline static void simd_draw_mc_text(uint8_t *p, uint8_t *msk, simd_t d,
+                                     simd_t c, simd_t bg, simd_t ext0,
+                                     simd_t ext1)
+{
+    simd_t dx[8], cx[8];
+    simd_t hr_bits = SIMD_LOAD(simd_hr_bits);
+    simd_t hi_bits = SIMD_LOAD(simd_mc_hi_bits);
+    simd_t lo_bits = SIMD_LOAD(simd_mc_lo_bits);
+    simd_t mc_flag = SIMD_DUP(0x08);
+    int k;
+
+    SIMD_STORE(msk, SIMD_SELECT(SIMD_TEST(c, mc_flag), simd_mc_msk(d), d));
+
+    simd_expand(d, dx);
+    simd_expand(c, cx);
+
+    for (k = 0; k < 8; k++) {
+        simd_t mc = SIMD_TEST(cx[k], mc_flag);
+        simd_t hi = SIMD_TEST(dx[k], SIMD_SELECT(mc, hi_bits, hr_bits));
+        simd_t lo = SIMD_TEST(dx[k], SIMD_SELECT(mc, lo_bits, hr_bits));
+
+        SIMD_STORE(p + k * 16,
+                   SIMD_SELECT(hi,
+                               SIMD_SELECT(lo, SIMD_AND(cx[k], SIMD_DUP(0x07)), ext1),
+                               SIMD_SELECT(lo, ext0, bg)));
+    }
+}
+
+/* Bitmap data of 16 characters from `i' on.  */
+inline static void simd_gather_bitmap(uint8_t *d, unsigned int i)
+{
+    unsigned int j, k;
+
+    for (j = ((vicii.memptr + i) << 3) + vicii.raster.ycounter, k = 0;
+         k < 16; k++, j += 8) {
+        if (j & 0x1000) {
+            d[k] = vicii.bitmap_high_ptr[j & 0xfff];
+        } else {
+            d[k] = vicii.bitmap_low_ptr[j & 0xfff];
+        }
+    }
+}
+
+static void _draw_std_text_simd(uint8_t *p, unsigned int xs, unsigned int xe,
+                                uint8_t *gfx_msk_ptr)
+{
+    uint8_t d[16];
+    uint8_t *char_ptr, *msk_ptr;
+    simd_t bg;
+    unsigned int i, k;
+
+    if (xe + 1 - xs < 16) {
+        _draw_std_text(p, xs, xe, gfx_msk_ptr);
+        return;
+    }
+
+    char_ptr = vicii.chargen_ptr + vicii.raster.ycounter;
+    msk_ptr = gfx_msk_ptr + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(vicii.raster.background_color);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        for (k = 0; k < 16; k++) {
+            d[k] = char_ptr[vicii.vbuf[i + k] * 8];
+        }
+        SIMD_STORE(msk_ptr + i, SIMD_LOAD(d));
+        simd_draw_hires(p + i * 8, SIMD_LOAD(d), SIMD_LOAD(vicii.cbuf + i), bg, 0);
+    }
+}
+
+static void _draw_std_text_cached_simd(uint8_t *p, unsigned int xs,
+                                       unsigned int xe, raster_cache_t *cache)
+{
+    uint8_t *msk_ptr;
+    simd_t bg;
+    unsigned int i;
+
+    if (xe + 1 - xs < 16) {
+        _draw_std_text_cached(p, xs, xe, cache);
+        return;
+    }
+
+    msk_ptr = cache->gfx_msk + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(cache->background_data[0]);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_t d = SIMD_LOAD(cache->foreground_data + i);
+
+        SIMD_STORE(msk_ptr + i, d);
+        simd_draw_hires(p + i * 8, d, SIMD_LOAD(cache->color_data_1 + i), bg, 0);
+    }
+}
+
+static void draw_std_text_simd(void)
+{
+    ALIGN_DRAW_FUNC(_draw_std_text_simd, 0, VICII_SCREEN_TEXTCOLS - 1,
+                    vicii.raster.gfx_msk);
+}
+
+static void draw_std_text_cached_simd(raster_cache_t *cache, unsigned int xs,
+                                      unsigned int xe)
+{
+    ALIGN_DRAW_FUNC(_draw_std_text_cached_simd, xs, xe, cache);
+}
+
+static void _draw_hires_bitmap_simd(uint8_t *p, unsigned int xs,
+                                    unsigned int xe, uint8_t *gfx_msk_ptr)
+{
+    uint8_t d[16];
+    uint8_t *msk_ptr;
+    unsigned int i;
+
+    if (xe + 1 - xs < 16) {
+        _draw_hires_bitmap(p, xs, xe, gfx_msk_ptr);
+        return;
+    }
+
+    msk_ptr = gfx_msk_ptr + GFX_MSK_LEFTBORDER_SIZE;
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_t v = SIMD_LOAD(vicii.vbuf + i);
+
+        simd_gather_bitmap(d, i);
+        SIMD_STORE(msk_ptr + i, SIMD_LOAD(d));
+        simd_draw_hires(p + i * 8, SIMD_LOAD(d), SIMD_SHR4(v),
+                        SIMD_AND(v, SIMD_DUP(0x0f)), 1);
+    }
+}
+
+static void _draw_hires_bitmap_cached_simd(uint8_t *p, unsigned int xs,
+                                           unsigned int xe,
+                                           raster_cache_t *cache)
+{
+    uint8_t *msk_ptr;
+    unsigned int i;
+
+    if (xe + 1 - xs < 16) {
+        _draw_hires_bitmap_cached(p, xs, xe, cache);
+        return;
+    }
+
+    msk_ptr = cache->gfx_msk + GFX_MSK_LEFTBORDER_SIZE;
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_t d = SIMD_LOAD(cache->foreground_data + i);
+        simd_t v = SIMD_LOAD(cache->background_data + i);
+
+        SIMD_STORE(msk_ptr + i, d);
+        simd_draw_hires(p + i * 8, d, SIMD_SHR4(v), SIMD_AND(v, SIMD_DUP(0x0f)), 1);
+    }
+}
+
+static void draw_hires_bitmap_simd(void)
+{
+    ALIGN_DRAW_FUNC(_draw_hires_bitmap_simd, 0, VICII_SCREEN_TEXTCOLS - 1,
+                    vicii.raster.gfx_msk);
+}
+
+static void draw_hires_bitmap_cached_simd(raster_cache_t *cache,
+                                          unsigned int xs, unsigned int xe)
+{
+    ALIGN_DRAW_FUNC(_draw_hires_bitmap_cached_simd, xs, xe, cache);
+}
+
+static void _draw_mc_text_simd(uint8_t *p, unsigned int xs, unsigned int xe,
+                               uint8_t *gfx_msk_ptr)
+{
+    uint8_t d[16];
+    uint8_t *char_ptr, *msk_ptr;
+    simd_t bg, ext0, ext1;
+    unsigned int i, k;
+
+    if (xe + 1 - xs < 16) {
+        _draw_mc_text(p, xs, xe, gfx_msk_ptr);
+        return;
+    }
+
+    char_ptr = vicii.chargen_ptr + vicii.raster.ycounter;
+    msk_ptr = gfx_msk_ptr + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(vicii.raster.background_color);
+    ext0 = SIMD_DUP(vicii.ext_background_color[0]);
+    ext1 = SIMD_DUP(vicii.ext_background_color[1]);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        for (k = 0; k < 16; k++) {
+            d[k] = char_ptr[vicii.vbuf[i + k] * 8];
+        }
+        simd_draw_mc_text(p + i * 8, msk_ptr + i, SIMD_LOAD(d),
+                          SIMD_LOAD(vicii.cbuf + i), bg, ext0, ext1);
+    }
+}
+
+static void _draw_mc_text_cached_simd(uint8_t *p, unsigned int xs,
+                                      unsigned int xe, raster_cache_t *cache)
+{
+    uint8_t *msk_ptr;
+    simd_t bg, ext0, ext1;
+    unsigned int i;
+
+    if (xe + 1 - xs < 16) {
+        _draw_mc_text_cached(p, xs, xe, cache);
+        return;
+    }
+
+    msk_ptr = cache->gfx_msk + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(cache->background_data[0]);
+    ext0 = SIMD_DUP(cache->color_data_1[0]);
+    ext1 = SIMD_DUP(cache->color_data_1[1]);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_draw_mc_text(p + i * 8, msk_ptr + i,
+                          SIMD_LOAD(cache->foreground_data + i),
+                          SIMD_LOAD(cache->color_data_3 + i), bg, ext0, ext1);
+    }
+}
+
+static void draw_mc_text_simd(void)
+{
+    ALIGN_DRAW_FUNC(_draw_mc_text_simd, 0, VICII_SCREEN_TEXTCOLS - 1,
+                    vicii.raster.gfx_msk);
+}
+
+static void draw_mc_text_cached_simd(raster_cache_t *cache, unsigned int xs,
+                                     unsigned int xe)
+{
+    ALIGN_DRAW_FUNC(_draw_mc_text_cached_simd, xs, xe, cache);
+}
+
+static void _draw_mc_bitmap_simd(uint8_t *p, unsigned int xs, unsigned int xe,
+                                 uint8_t *gfx_msk_ptr)
+{
+    uint8_t d[16];
+    uint8_t *msk_ptr;
+    simd_t bg;
+    unsigned int i;
+
+    if (xe + 1 - xs < 16) {
+        _draw_mc_bitmap(p, xs, xe, gfx_msk_ptr);
+        return;
+    }
+
+    msk_ptr = gfx_msk_ptr + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(vicii.raster.background_color);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_t v = SIMD_LOAD(vicii.vbuf + i);
+        simd_t dv;
+
+        simd_gather_bitmap(d, i);
+        dv = SIMD_LOAD(d);
+        SIMD_STORE(msk_ptr + i, simd_mc_msk(dv));
+        simd_draw_mc(p + i * 8, dv, bg, SIMD_SHR4(v),
+                     SIMD_AND(v, SIMD_DUP(0x0f)), SIMD_LOAD(vicii.cbuf + i));
+    }
+}
+
+static void _draw_mc_bitmap_cached_simd(uint8_t *p, unsigned int xs,
+                                        unsigned int xe, raster_cache_t *cache)
+{
+    uint8_t *msk_ptr;
+    simd_t bg;
+    unsigned int i;
+
+    if (xe + 1 - xs < 16) {
+        _draw_mc_bitmap_cached(p, xs, xe, cache);
+        return;
+    }
+
+    msk_ptr = cache->gfx_msk + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(cache->background_data[0]);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_t d = SIMD_LOAD(cache->foreground_data + i);
+        simd_t v = SIMD_LOAD(cache->color_data_1 + i);
+
+        SIMD_STORE(msk_ptr + i, simd_mc_msk(d));
+        simd_draw_mc(p + i * 8, d, bg, SIMD_SHR4(v),
+                     SIMD_AND(v, SIMD_DUP(0x0f)),
+                     SIMD_LOAD(cache->color_data_3 + i));
+    }
+}
+
+static void draw_mc_bitmap_simd(void)
+{
+    _draw_mc_bitmap_simd(GFX_PTR(), 0, VICII_SCREEN_TEXTCOLS - 1,
+                         vicii.raster.gfx_msk);
+}
+
+static void draw_mc_bitmap_cached_simd(raster_cache_t *cache, unsigned int xs,
+                                       unsigned int xe)
+{
+    _draw_mc_bitmap_cached_simd(GFX_PTR(), xs, xe, cache);
+}
+
+static void _draw_ext_text_simd(uint8_t *p, unsigned int xs, unsigned int xe,
+                                uint8_t *gfx_msk_ptr)
+{
+    uint8_t d[16];
+    uint8_t *char_ptr, *msk_ptr;
+    simd_t bg, ext0, ext1, ext2;
+    unsigned int i, k;
+
+    if (xe + 1 - xs < 16) {
+        _draw_ext_text(p, xs, xe, gfx_msk_ptr);
+        return;
+    }
+
+    char_ptr = vicii.chargen_ptr + vicii.raster.ycounter;
+    msk_ptr = gfx_msk_ptr + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(vicii.raster.background_color);
+    ext0 = SIMD_DUP(vicii.ext_background_color[0]);
+    ext1 = SIMD_DUP(vicii.ext_background_color[1]);
+    ext2 = SIMD_DUP(vicii.ext_background_color[2]);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_t v = SIMD_LOAD(vicii.vbuf + i);
+
+        for (k = 0; k < 16; k++) {
+            d[k] = char_ptr[(vicii.vbuf[i + k] & 0x3f) * 8];
+        }
+        SIMD_STORE(msk_ptr + i, SIMD_LOAD(d));
+        simd_draw_hires(p + i * 8, SIMD_LOAD(d), SIMD_LOAD(vicii.cbuf + i),
+                        simd_lookup4(v, 0x80, 0x40, bg, ext0, ext1, ext2), 1);
+    }
+}
+
+static void _draw_ext_text_cached_simd(uint8_t *p, unsigned int xs,
+                                       unsigned int xe, raster_cache_t *cache)
+{
+    uint8_t *msk_ptr;
+    simd_t bg, ext0, ext1, ext2;
+    unsigned int i;
+
+    if (xe + 1 - xs < 16) {
+        _draw_ext_text_cached(p, xs, xe, cache);
+        return;
+    }
+
+    msk_ptr = cache->gfx_msk + GFX_MSK_LEFTBORDER_SIZE;
+    bg = SIMD_DUP(cache->color_data_2[0]);
+    ext0 = SIMD_DUP(cache->color_data_2[1]);
+    ext1 = SIMD_DUP(cache->color_data_2[2]);
+    ext2 = SIMD_DUP(cache->color_data_2[3]);
+
+    for (i = xs; i + 15 <= xe; i = SIMD_NEXT_BLOCK(i, xe)) {
+        simd_t d = SIMD_LOAD(cache->foreground_data + i);
+
+        SIMD_STORE(msk_ptr + i, d);
+        simd_draw_hires(p + i * 8, d, SIMD_LOAD(cache->color_data_1 + i),
+                        simd_lookup4(SIMD_LOAD(cache->color_data_3 + i),
+                                     0x02, 0x01, bg, ext0, ext1, ext2), 1);
+    }
+}
+
+static void draw_ext_text_simd(void)
+{
+    ALIGN_DRAW_FUNC(_draw_ext_text_simd, 0, VICII_SCREEN_TEXTCOLS - 1,
+                    vicii.raster.gfx_msk);
+}
+
+static void draw_ext_text_cached_simd(raster_cache_t *cache, unsigned int xs,
+                                      unsigned int xe)
+{
+    ALIGN_DRAW_FUNC(_draw_ext_text_cached_simd, xs, xe, cache);
+}
+
+#define DRAW_STD_TEXT                   draw_std_text_simd
+#define DRAW_STD_TEXT_CACHED            draw_std_text_cached_simd
+#define DRAW_HIRES_BITMAP               draw_hires_bitmap_simd
+#define DRAW_HIRES_BITMAP_CACHED        draw_hires_bitmap_cached_simd
+#define DRAW_MC_TEXT                    draw_mc_text_simd
+#define DRAW_MC_TEXT_CACHED             draw_mc_text_cached_simd
+#define DRAW_MC_BITMAP                  draw_mc_bitmap_simd
+#define DRAW_MC_BITMAP_CACHED           draw_mc_bitmap_cached_simd
+#define DRAW_EXT_TEXT                   draw_ext_text_simd
+#define DRAW_EXT_TEXT_CACHED            draw_ext_text_cached_simd
+
+#else
+
+#define DRAW_STD_TEXT                   draw_std_text
+#define DRAW_STD_TEXT_CACHED            draw_std_text_cached
+#define DRAW_HIRES_BITMAP               draw_hires_bitmap
+#define DRAW_HIRES_BITMAP_CACHED        draw_hires_bitmap_cached
+#define DRAW_MC_TEXT                    draw_mc_text
+#define DRAW_MC_TEXT_CACHED             draw_mc_text_cached
+#define DRAW_MC_BITMAP                  draw_mc_bitmap
+#define DRAW_MC_BITMAP_CACHED           draw_mc_bitmap_cached
+#define DRAW_EXT_TEXT                   draw_ext_text
+#define DRAW_EXT_TEXT_CACHED            draw_ext_text_cached
+
+#endif /* VICII_DRAW_SIMD */
+
 static void setup_modes(void)
 {
     raster_modes_set(vicii.raster.modes, VICII_NORMAL_TEXT_MODE,
                      get_std_text,
-                     draw_std_text_cached,
-                     draw_std_text,
+                     DRAW_STD_TEXT_CACHED,
+                     DRAW_STD_TEXT,
                      draw_std_background,
                      draw_std_text_foreground);
 
     raster_modes_set(vicii.raster.modes, VICII_MULTICOLOR_TEXT_MODE,
                      get_mc_text,
-                     draw_mc_text_cached,
-                     draw_mc_text,
+                     DRAW_MC_TEXT_CACHED,
+                     DRAW_MC_TEXT,
                      draw_std_background,
                      draw_mc_text_foreground);
 
     raster_modes_set(vicii.raster.modes, VICII_HIRES_BITMAP_MODE,
                      get_hires_bitmap,
-                     draw_hires_bitmap_cached,
-                     draw_hires_bitmap,
+                     DRAW_HIRES_BITMAP_CACHED,
+                     DRAW_HIRES_BITMAP,
                      draw_std_background,
                      draw_hires_bitmap_foreground);
 
     raster_modes_set(vicii.raster.modes, VICII_MULTICOLOR_BITMAP_MODE,
                      get_mc_bitmap,
-                     draw_mc_bitmap_cached,
-                     draw_mc_bitmap,
+                     DRAW_MC_BITMAP_CACHED,
+                     DRAW_MC_BITMAP,
                      draw_std_background,
                      draw_mc_bitmap_foreground);
 
     raster_modes_set(vicii.raster.modes, VICII_EXTENDED_TEXT_MODE,
                      get_ext_text,
-                     draw_ext_text_cached,
-                     draw_ext_text,
+                     DRAW_EXT_TEXT_CACHED,
+                     DRAW_EXT_TEXT,
                      draw_std_background,
                      draw_ext_text_foreground);
 
@@ -1510,3 +2078,34 @@ void vicii_draw_init(void)
 
     setup_modes();
 }
+
+#ifdef PSV_BENCH
+#ifdef VICII_DRAW_SIMD
+static const vicii_draw_test_t draw_tests[] = {
+    { "std text", _draw_std_text, _draw_std_text_simd,
+      _draw_std_text_cached, _draw_std_text_cached_simd },
+    { "hires bitmap", _draw_hires_bitmap, _draw_hires_bitmap_simd,
+      _draw_hires_bitmap_cached, _draw_hires_bitmap_cached_simd },
+    { "mc text", _draw_mc_text, _draw_mc_text_simd,
+      _draw_mc_text_cached, _draw_mc_text_cached_simd },
+    { "mc bitmap", _draw_mc_bitmap, _draw_mc_bitmap_simd,
+      _draw_mc_bitmap_cached, _draw_mc_bitmap_cached_simd },
+    { "ext text", _draw_ext_text, _draw_ext_text_simd,
+      _draw_ext_text_cached, _draw_ext_text_cached_simd }
+};
+
+int vicii_draw_get_tests(const vicii_draw_test_t **tests)
+{
+    init_drawing_tables();
+    *tests = draw_tests;
+    return (int)(sizeof(draw_tests) / sizeof(draw_tests[0]));
+}
+#else
+int vicii_draw_get_tests(const vicii_draw_test_t **tests)
+{
+    init_drawing_tables();
+    *tests = NULL;
+    return 0;
+}
+#endif
+#endif
@@ -28,6 +28,31 @@
 #ifndef VICE_VICII_DRAW_H
 #define VICE_VICII_DRAW_H
 
+#include "types.h"
+
 extern void vicii_draw_init(void);
 
+#ifdef PSV_BENCH
+struct raster_cache_s;
+
+/* A text or bitmap mode drawn with the plain loops and with SIMD, for the
+   self test of the benchmark runner.  The functions draw characters `xs'
+   to `xe' of the current line to `p'.  */
+typedef struct vicii_draw_test_s {
+    const char *name;
+    void (*draw)(uint8_t *p, unsigned int xs, unsigned int xe,
+                 uint8_t *gfx_msk_ptr);
+    void (*draw_simd)(uint8_t *p, unsigned int xs, unsigned int xe,
+                      uint8_t *gfx_msk_ptr);
+    void (*draw_cached)(uint8_t *p, unsigned int xs, unsigned int xe,
+                        struct raster_cache_s *cache);
+    void (*draw_cached_simd)(uint8_t *p, unsigned int xs, unsigned int xe,
+                             struct raster_cache_s *cache);
+} vicii_draw_test_t;
+
+/* Initialize the drawing tables and return the modes that have a SIMD
+   version; none without SIMD.  */
+extern int vicii_draw_get_tests(const vicii_draw_test_t **tests);
+#endif
+
 #endif
@@ -378,161 +378,194 @@ const int vicii_sprites_crunch_table[64] =
 };
 
 
-/* Each byte in this array is a bit mask representing the sprites that
-   have a pixel turned on in that position.  This is used for sprite-sprite
-   collision checking.  */
-static uint8_t *sprline = NULL;
+/* The sprite pixels drawn so far on the current line, as bit planes: bit
+   `x' of plane `n' is set if sprite `n' has a pixel at position `x' of the
+   line, and plane SPRLINE_ANY is the OR of the others.  The pixels of a
+   sprite are composited, and its collisions found, with a few operations
+   on 64-bit words instead of one pixel at a time.
+
+   The first position of a word is its MSB, as in the sprite masks.
+   SPRLINE_GUARD positions on the left and some words on the right keep
+   the whole sprite inside the planes, even if it is partially outside the
+   line.  */
+#define SPRLINE_ANY     8
+#define SPRLINE_PLANES  9
+#define SPRLINE_GUARD   128
+
+static uint64_t *sprline = NULL;
+static unsigned int sprline_words = 0;
+
+#define SPRLINE_PLANE(n) (sprline + (n) * sprline_words)
 
 /* Sprite tables.  */
 static uint16_t sprite_doubling_table[256];
 static uint8_t mcsprtable[256];
 
+/* The 8 pixels of a mask byte, the MSB first, as 0xff bytes in memory
+   order.  */
+static uint64_t sprite_pixel_table[256];
+
 static void init_drawing_tables(void)
 {
-    unsigned int i;
+    unsigned int i, j;
     uint16_t w;
+    uint8_t pixels[8];
 
     for (w = i = 0; i <= 0xff; i++) {
         mcsprtable[i] = i | ((i & 0x55) << 1) | ((i & 0xaa) >> 1);
         sprite_doubling_table[i] = w;
         w++;
         w |= (w & 0x5555) << 1;
+
+        for (j = 0; j < 8; j++) {
+            pixels[j] = (i & (0x80 >> j)) ? 0xff : 0;
+        }
+        memcpy(&sprite_pixel_table[i], pixels, 8);
     }
 }
 
-/* Sprite drawing macros.  */
-#define SPRITE_PIXEL(do_draw, sprite_bit, imgptr, collmskptr, \
-                     pos, color, collmsk_return)              \
-    do {                                                      \
-        if ((do_draw) && (collmskptr)[(pos)] == 0) {          \
-            (imgptr)[(pos)] = (uint8_t)(color); }                \
-        (collmsk_return) |= (collmskptr)[(pos)];              \
-        (collmskptr)[(pos)] |= (sprite_bit);                  \
-    } while (0)
+/* The 64 positions of `plane' from `pos' on, `pos' in the MSB.  */
+inline static uint64_t sprline_get(const uint64_t *plane, int pos)
+{
+    unsigned int bit = (unsigned int)(pos + SPRLINE_GUARD);
+    unsigned int w = bit >> 6, s = bit & 63;
+
+    if (s == 0) {
+        return plane[w];
+    }
+    return (plane[w] << s) | (plane[w + 1] >> (64 - s));
+}
+
+inline static void sprline_set(uint64_t *plane, int pos, uint64_t msk)
+{
+    unsigned int bit = (unsigned int)(pos + SPRLINE_GUARD);
+    unsigned int w = bit >> 6, s = bit & 63;
+
+    plane[w] |= msk >> s;
+    if (s != 0) {
+        plane[w + 1] |= msk << (64 - s);
+    }
+}
+
+/* Draw `size' pixels of sprite `n' at `ptr', position `pos' of the line.
+   `pix' has the pixels of each of the `num' colours, the first pixel in bit
+   `size' - 1, and the pixels in `gfxmsk' are behind the foreground.  A pixel
+   is drawn only if no sprite has been drawn there yet.  Return the sprites
+   that are already there, `n' included.  */
+static uint8_t sprite_draw_pixels(uint8_t *ptr, int pos, int n, int size,
+                                  uint32_t gfxmsk, const uint32_t *pix,
+                                  const uint32_t *color, int num)
+{
+    uint64_t on = 0, drawn, draw;
+    uint64_t planes[3], colors[3];
+    uint8_t cmsk = 0;
+    int i, p, shift;
+
+    if (size <= 0) {
+        return 0;
+    }
+    shift = 64 - size;
+
+    for (i = 0; i < num; i++) {
+        on |= (uint64_t)pix[i] << shift;
+    }
+    if (on == 0) {
+        return 0;
+    }
+
+    /* Collisions with the sprites drawn so far.  */
+    drawn = sprline_get(SPRLINE_PLANE(SPRLINE_ANY), pos);
+    if (drawn & on) {
+        for (i = 0; i < 8; i++) {
+            if (sprline_get(SPRLINE_PLANE(i), pos) & on) {
+                cmsk |= 1 << i;
+            }
+        }
+    }
+    sprline_set(SPRLINE_PLANE(SPRLINE_ANY), pos, on);
+    sprline_set(SPRLINE_PLANE(n), pos, on);
+
+    draw = on & ~drawn & ~((uint64_t)gfxmsk << shift);
+    if (draw == 0) {
+        return cmsk;
+    }
+
+    for (i = 0; i < num; i++) {
+        planes[i] = ((uint64_t)pix[i] << shift) & draw;
+        colors[i] = (uint8_t)color[i] * 0x0101010101010101ULL;
+    }
+
+    /* 8 pixels at a time, then the rest one by one.  */
+    for (p = 0; p + 8 <= size; p += 8) {
+        uint64_t m = sprite_pixel_table[(draw >> (56 - p)) & 0xff];
+        uint64_t c = 0, d;
+
+        if (m == 0) {
+            continue;
+        }
+        for (i = 0; i < num; i++) {
+            c |= colors[i] & sprite_pixel_table[(planes[i] >> (56 - p)) & 0xff];
+        }
+        memcpy(&d, ptr + p, 8);
+        d = (d & ~m) | c;
+        memcpy(ptr + p, &d, 8);
+    }
+    for (; p < size; p++) {
+        for (i = 0; i < num; i++) {
+            if ((planes[i] >> (63 - p)) & 1) {
+                ptr[p] = (uint8_t)color[i];
+            }
+        }
+    }
+
+    return cmsk;
+}
 
 /* Hires sprites */
-#define _SPRITE_MASK(msk, gfxmsk, size, sprite_bit, imgptr,      \
-                     collmskptr, color, collmsk_return, DRAW)    \
-    do {                                                         \
-        uint32_t __m;                                               \
-        int __p;                                                 \
-                                                                 \
-        for (__m = 1 << ((size) - 1), __p = 0;                   \
-             __p < (size);                                       \
-             __p++, __m >>= 1) {                                 \
-            if ((msk) & __m) {                                   \
-                if ((gfxmsk) & __m) {                            \
-                    DRAW(0, sprite_bit, imgptr, collmskptr, __p, \
-                         color, collmsk_return);                 \
-                } else {                                         \
-                    DRAW(1, sprite_bit, imgptr, collmskptr, __p, \
-                         color, collmsk_return); }               \
-            }                                                    \
-        }                                                        \
-    } while (0)
+inline static uint8_t sprite_mask(uint32_t msk, uint32_t gfxmsk, int size,
+                                  int n, uint8_t *ptr, int pos, uint32_t color)
+{
+    return sprite_draw_pixels(ptr, pos, n, size, gfxmsk, &msk, &color, 1);
+}
 
-#define SPRITE_MASK(msk, gfxmsk, size, sprite_bit, imgptr,          \
-                    collmskptr, color, collmsk_return)              \
-    _SPRITE_MASK(msk, gfxmsk, size, sprite_bit, imgptr, collmskptr, \
-                 color, collmsk_return, SPRITE_PIXEL)
-
-/* Multicolor sprites */
-#define _MCSPRITE_MASK(mcmsk, gfxmsk, trmsk, size, sprite_bit, imgptr,   \
-                       collmskptr, pixel_table, collmsk_return, DRAW)    \
-    do {                                                                 \
-        uint32_t __m;                                                       \
-        int __p;                                                         \
-                                                                         \
-        for (__m = 1 << ((size) - 1), __p = 0;                           \
-             __p < (size);                                               \
-             __p += 2, __m >>= 2, (mcmsk) <<= 2, (trmsk) <<= 2) {        \
-            uint8_t __c, __t;                                               \
-                                                                         \
-            __c = (uint8_t)(((mcmsk) >> 22) & 0x3);                         \
-            __t = (uint8_t)(((trmsk) >> 22) & 0x3);                         \
-                                                                         \
-            if (__c) {                                                   \
-                if (__t & 2) {                                           \
-                    if ((gfxmsk) & __m) {                                \
-                        DRAW(0, sprite_bit, imgptr, collmskptr, __p,     \
-                             pixel_table[__c], collmsk_return);          \
-                    } else {                                             \
-                        DRAW(1, sprite_bit, imgptr, collmskptr, __p,     \
-                             pixel_table[__c], collmsk_return);          \
-                    }                                                    \
-                }                                                        \
-                                                                         \
-                if (__t & 1) {                                           \
-                    if ((gfxmsk) & (__m >> 1)) {                         \
-                        DRAW(0, sprite_bit, imgptr, collmskptr, __p + 1, \
-                             pixel_table[__c], collmsk_return);          \
-                    } else {                                             \
-                        DRAW(1, sprite_bit, imgptr, collmskptr, __p + 1, \
-                             pixel_table[__c], collmsk_return);          \
-                    }                                                    \
-                }                                                        \
-            }                                                            \
-        }                                                                \
-    } while (0)
+/* Multicolor sprites.  Each bit pair of `mcmsk', from bits 23-22 on, is
+   the colour of two pixels, or of four if `expanded'.  */
+inline static uint8_t mcsprite_mask(uint32_t mcmsk, uint32_t gfxmsk,
+                                    uint32_t trmsk, int size, int expanded,
+                                    int n, uint8_t *ptr, int pos,
+                                    const uint32_t *pixel_table)
+{
+    uint32_t hi = (mcmsk >> 1) & 0x555555, lo = mcmsk & 0x555555;
+    uint32_t pix[3];
+    int i;
 
+    pix[0] = lo & ~hi;
+    pix[1] = hi & ~lo;
+    pix[2] = hi & lo;
 
-#define MCSPRITE_MASK(mcmsk, gfxmsk, trmsk, size, sprite_bit, imgptr, \
-                      collmskptr, pixel_table, collmsk_return)        \
-    _MCSPRITE_MASK(mcmsk, gfxmsk, trmsk, size, sprite_bit, imgptr,    \
-                   collmskptr, pixel_table, collmsk_return,           \
-                   SPRITE_PIXEL)
-
-
-#define _MCSPRITE_DOUBLE_MASK(mcmsk, gfxmsk, trmsk, size, sprite_bit, \
-                              imgptr, collmskptr, pixel_table,        \
-                              collmsk_return, DRAW)                   \
-    do {                                                              \
-        uint32_t __m;                                                    \
-        int __p, __i;                                                 \
-                                                                      \
-        for (__m = 1U << ((size) - 1), __p = 0; __p < (size);         \
-             __p += 4, (mcmsk) <<= 2, (trmsk) <<= 4) {                \
-            uint8_t __c;                                                 \
-            uint8_t __t;                                                 \
-                                                                      \
-            __c = (uint8_t)(((mcmsk) >> 22) & 0x3);                      \
-            __t = (uint8_t)(((trmsk) >> (size - 4)) & 0xf);              \
-                                                                      \
-            for (__i = 0; __i < 4; __i++, __m >>= 1, __t <<= 1) {     \
-                if (__c && (__t & 0x8)) {                             \
-                    if ((gfxmsk) & __m) {                             \
-                        DRAW(0, sprite_bit, imgptr, collmskptr,       \
-                             __p + __i, pixel_table[__c],             \
-                             collmsk_return);                         \
-                    } else {                                          \
-                        DRAW(1, sprite_bit, imgptr, collmskptr,       \
-                             __p + __i, pixel_table[__c],             \
-                             collmsk_return);                         \
-                    }                                                 \
-                }                                                     \
-            }                                                         \
-        }                                                             \
-    } while (0)
+    for (i = 0; i < 3; i++) {
+        pix[i] |= pix[i] << 1;
+        if (expanded) {
+            pix[i] = (pix[i] & 0xffffff) >> (24 - size / 2);
+            pix[i] = (sprite_doubling_table[pix[i] >> 8] << 16)
+                     | sprite_doubling_table[pix[i] & 0xff];
+        }
+        pix[i] &= trmsk;
+    }
 
-#define MCSPRITE_DOUBLE_MASK(mcmsk, gfxmsk, trmsk, size, sprite_bit,        \
-                             imgptr, collmskptr, pixel_table,               \
-                             collmsk_return)                                \
-    _MCSPRITE_DOUBLE_MASK(mcmsk, gfxmsk, trmsk, size, sprite_bit, imgptr,   \
-                          collmskptr, pixel_table, collmsk_return,          \
-                          SPRITE_PIXEL)
+    return sprite_draw_pixels(ptr, pos, n, size, gfxmsk, pix, pixel_table + 1, 3);
+}
 
 
 #define TRIM_MSK(msk, size)                                                 \
     do {                                                                    \
-        int trm_msk_i;                                                              \
+        int trm_msk_shift = (size) - sprite_xe - 1;                         \
         int display_width = (MIN(sprite_xe + 1, size) - MAX(0, sprite_xs)); \
         msk = 0;                                                            \
-        if (display_width > 0) {                                            \
-            for (trm_msk_i = 0; trm_msk_i < display_width; trm_msk_i++) {                           \
-                msk = (msk << 1) | 1;                                       \
-            }                                                               \
-            for (trm_msk_i = 0; trm_msk_i < size - sprite_xe - 1; trm_msk_i++) {                    \
-                msk <<= 1;                                                  \
+        if (display_width > 0 && trm_msk_shift < 32) {                      \
+            msk = display_width < 32 ? (1U << display_width) - 1 : ~0U;    \
+            if (trm_msk_shift > 0) {                                        \
+                msk <<= trm_msk_shift;                                      \
             }                                                               \
         }                                                                   \
     } while (0)
@@ -540,7 +573,7 @@ static void init_drawing_tables(void)
 
 inline static void draw_hires_sprite_expanded(uint8_t *data_ptr, int n,
                                               uint8_t *msk_ptr, uint8_t *ptr,
-                                              int lshift, uint8_t *sptr,
+                                              int lshift, int spos,
                                               raster_sprite_status_t *sprite_status,
                                               int sprite_xs, int sprite_xe)
 {
@@ -599,11 +632,11 @@ inline static void draw_hires_sprite_expanded(uint8_t *data_ptr, int n,
         sprite_status->sprite_background_collisions |= sbit;
     }
     if (sprite_status->sprites[n].in_background) {
-        SPRITE_MASK(sprmsk, collmsk, size1, sbit, ptr, sptr,
-                    sprite_status->sprites[n].color, cmsk);
+        cmsk |= sprite_mask(sprmsk, collmsk, size1, n, ptr, spos,
+                            sprite_status->sprites[n].color);
     } else {
-        SPRITE_MASK(sprmsk, 0, size1, sbit, ptr, sptr,
-                    sprite_status->sprites[n].color, cmsk);
+        cmsk |= sprite_mask(sprmsk, 0, size1, n, ptr, spos,
+                            sprite_status->sprites[n].color);
     }
 
     size1 = size - size1;
@@ -642,11 +675,11 @@ inline static void draw_hires_sprite_expanded(uint8_t *data_ptr, int n,
         sprite_status->sprite_background_collisions |= sbit;
     }
     if (sprite_status->sprites[n].in_background) {
-        SPRITE_MASK(sprmsk, collmsk, size1, sbit, ptr + 32, sptr + 32,
-                    sprite_status->sprites[n].color, cmsk);
+        cmsk |= sprite_mask(sprmsk, collmsk, size1, n, ptr + 32, spos + 32,
+                            sprite_status->sprites[n].color);
     } else {
-        SPRITE_MASK(sprmsk, 0, size1, sbit, ptr + 32, sptr + 32,
-                    sprite_status->sprites[n].color, cmsk);
+        cmsk |= sprite_mask(sprmsk, 0, size1, n, ptr + 32, spos + 32,
+                            sprite_status->sprites[n].color);
     }
     if (cmsk) {
         sprite_status->sprite_sprite_collisions
@@ -656,7 +689,7 @@ inline static void draw_hires_sprite_expanded(uint8_t *data_ptr, int n,
 
 inline static void draw_hires_sprite_normal(uint8_t *data_ptr, int n,
                                             uint8_t *msk_ptr, uint8_t *ptr,
-                                            int lshift, uint8_t *sptr,
+                                            int lshift, int spos,
                                             raster_sprite_status_t *sprite_status,
                                             int sprite_xs, int sprite_xe)
 {
@@ -707,11 +740,11 @@ inline static void draw_hires_sprite_normal(uint8_t *data_ptr, int n,
         sprite_status->sprite_background_collisions |= sbit;
     }
     if (sprite_status->sprites[n].in_background) {
-        SPRITE_MASK(sprmsk, collmsk, size, sbit, ptr, sptr,
-                    sprite_status->sprites[n].color, cmsk);
+        cmsk |= sprite_mask(sprmsk, collmsk, size, n, ptr, spos,
+                            sprite_status->sprites[n].color);
     } else {
-        SPRITE_MASK(sprmsk, 0, size, sbit, ptr, sptr,
-                    sprite_status->sprites[n].color, cmsk);
+        cmsk |= sprite_mask(sprmsk, 0, size, n, ptr, spos,
+                            sprite_status->sprites[n].color);
     }
     if (cmsk) {
         sprite_status->sprite_sprite_collisions |= cmsk | sbit;
@@ -723,22 +756,22 @@ inline static void draw_hires_sprite_normal(uint8_t *data_ptr, int n,
 /* Draw one hires sprite.  */
 inline static void draw_hires_sprite(uint8_t *gfx_msk_ptr, uint8_t *data_ptr, int n,
                                      uint8_t *msk_ptr, uint8_t *ptr,
-                                     int lshift, uint8_t *sptr,
+                                     int lshift, int spos,
                                      raster_sprite_status_t *sprite_status,
                                      int sprite_xs, int sprite_xe)
 {
     if (sprite_status->sprites[n].x_expanded) {
-        draw_hires_sprite_expanded(data_ptr, n, msk_ptr, ptr, lshift, sptr,
+        draw_hires_sprite_expanded(data_ptr, n, msk_ptr, ptr, lshift, spos,
                                    sprite_status, sprite_xs, sprite_xe);
     } else {
-        draw_hires_sprite_normal(data_ptr, n, msk_ptr, ptr, lshift, sptr,
+        draw_hires_sprite_normal(data_ptr, n, msk_ptr, ptr, lshift, spos,
                                  sprite_status, sprite_xs, sprite_xe);
     }
 }
 
 inline static void draw_mc_sprite_expanded(uint8_t *data_ptr, int n, uint32_t *c,
                                            uint8_t *msk_ptr, uint8_t *ptr,
-                                           int lshift, uint8_t *sptr,
+                                           int lshift, int spos,
                                            raster_sprite_status_t *sprite_status,
                                            int sprite_xs, int sprite_xe)
 {
@@ -773,7 +806,7 @@ inline static void draw_mc_sprite_expanded(uint8_t *data_ptr, int n, uint32_t *c
     /* Fixes for the MC bug */
     if (delayed_shift) {
         ptr += 2;
-        sptr += 2;
+        spos += 2;
         trim_size += 2;
         mcsprmsk <<= 1;
         collmsk = (collmsk << 2 ) | (((msk_ptr[5] << 8) | msk_ptr[6]) >> (14 - lshift));
@@ -815,11 +848,13 @@ inline static void draw_mc_sprite_expanded(uint8_t *data_ptr, int n, uint32_t *c
     }
 
     if (sprite_status->sprites[n].in_background) {
-        MCSPRITE_DOUBLE_MASK(mcsprmsk, collmsk, trimmsk, 32, sbit, ptr, sptr, c, cmsk);
+        cmsk |= mcsprite_mask(mcsprmsk, collmsk, trimmsk, 32, 1,
+                              n, ptr, spos, c);
     } else {
-        MCSPRITE_DOUBLE_MASK(mcsprmsk, 0, trimmsk, 32,
-                             sbit, ptr, sptr, c, cmsk);
+        cmsk |= mcsprite_mask(mcsprmsk, 0, trimmsk, 32, 1,
+                              n, ptr, spos, c);
     }
+    mcsprmsk <<= 16;
 
     sprmsk = sprite_doubling_table[mcsprtable[data_ptr[2]]];
     collmsk = ((((msk_ptr[5] << 8) | msk_ptr[6]) << lshift) | (msk_ptr[7] >> (8 - lshift)));
@@ -845,11 +880,11 @@ inline static void draw_mc_sprite_expanded(uint8_t *data_ptr, int n, uint32_t *c
     }
 
     if (sprite_status->sprites[n].in_background) {
-        MCSPRITE_DOUBLE_MASK(mcsprmsk, collmsk, trimmsk, 16,
-                             sbit, ptr + 32, sptr + 32, c, cmsk);
+        cmsk |= mcsprite_mask(mcsprmsk, collmsk, trimmsk, 16, 1,
+                              n, ptr + 32, spos + 32, c);
     } else {
-        MCSPRITE_DOUBLE_MASK(mcsprmsk, 0, trimmsk, 16, sbit,
-                             ptr + 32, sptr + 32, c, cmsk);
+        cmsk |= mcsprite_mask(mcsprmsk, 0, trimmsk, 16, 1,
+                              n, ptr + 32, spos + 32, c);
     }
 
     if (must_repeat_pixels) {
@@ -878,11 +913,11 @@ inline static void draw_mc_sprite_expanded(uint8_t *data_ptr, int n, uint32_t *c
 
         special_sprmsk &= trimmsk;
 
-        SPRITE_MASK(special_sprmsk, 0,
-                    7 - repeat_offset, sbit,
-                    ptr + size + repeat_offset,
-                    sptr + size + repeat_offset,
-                    repeat_color, cmsk);
+        cmsk |= sprite_mask(special_sprmsk, 0,
+                            7 - repeat_offset, n,
+                            ptr + size + repeat_offset,
+                            spos + size + repeat_offset,
+                            repeat_color);
 
         /* this may cause a 'self-collision'; delete it */
         if (cmsk == sbit) {
@@ -897,7 +932,7 @@ inline static void draw_mc_sprite_expanded(uint8_t *data_ptr, int n, uint32_t *c
 
 inline static void draw_mc_sprite_normal(uint8_t *data_ptr, int n, uint32_t *c,
                                          uint8_t *msk_ptr, uint8_t *ptr,
-                                         int lshift, uint8_t *sptr,
+                                         int lshift, int spos,
                                          raster_sprite_status_t *sprite_status,
                                          int sprite_xs, int sprite_xe)
 {
@@ -930,7 +965,7 @@ inline static void draw_mc_sprite_normal(uint8_t *data_ptr, int n, uint32_t *c,
     /* Fixes for the MC bug */
     if (delayed_shift) {
         ptr++;
-        sptr++;
+        spos++;
         trim_size++;
         mcsprmsk <<= 1;
         collmsk = (collmsk << 1 ) | (((msk_ptr[4] << 8) | msk_ptr[6]) >> (15 - lshift));
@@ -965,9 +1000,11 @@ inline static void draw_mc_sprite_normal(uint8_t *data_ptr, int n, uint32_t *c,
     }
 
     if (sprite_status->sprites[n].in_background) {
-        MCSPRITE_MASK(mcsprmsk, collmsk, trimmsk, 24, sbit, ptr, sptr, c, cmsk);
+        cmsk |= mcsprite_mask(mcsprmsk, collmsk, trimmsk, 24, 0,
+                              n, ptr, spos, c);
     } else {
-        MCSPRITE_MASK(mcsprmsk, 0, trimmsk, 24, sbit, ptr, sptr, c, cmsk);
+        cmsk |= mcsprite_mask(mcsprmsk, 0, trimmsk, 24, 0,
+                              n, ptr, spos, c);
     }
 
     if (must_repeat_pixels) {
@@ -995,9 +1032,9 @@ inline static void draw_mc_sprite_normal(uint8_t *data_ptr, int n, uint32_t *c,
 
         special_sprmsk &= trimmsk;
 
-        SPRITE_MASK(special_sprmsk, 0, 7 - size_is_odd, sbit,
-                    ptr + size + size_is_odd, sptr + size + size_is_odd,
-                    repeat_color, cmsk);
+        cmsk |= sprite_mask(special_sprmsk, 0, 7 - size_is_odd, n,
+                            ptr + size + size_is_odd, spos + size + size_is_odd,
+                            repeat_color);
     }
 
     if (cmsk) {
@@ -1009,7 +1046,7 @@ inline static void draw_mc_sprite_normal(uint8_t *data_ptr, int n, uint32_t *c,
 /* Draw one multicolor sprite.  */
 inline static void draw_mc_sprite(uint8_t *gfx_msk_ptr, uint8_t *data_ptr, int n,
                                   uint8_t *msk_ptr, uint8_t *ptr, int lshift,
-                                  uint8_t *sptr,
+                                  int spos,
                                   raster_sprite_status_t *sprite_status,
                                   int sprite_xs, int sprite_xe)
 {
@@ -1020,10 +1057,10 @@ inline static void draw_mc_sprite(uint8_t *gfx_msk_ptr, uint8_t *data_ptr, int n
     c[3] = sprite_status->mc_sprite_color_2;
 
     if (sprite_status->sprites[n].x_expanded) {
-        draw_mc_sprite_expanded(data_ptr, n, c, msk_ptr, ptr, lshift, sptr,
+        draw_mc_sprite_expanded(data_ptr, n, c, msk_ptr, ptr, lshift, spos,
                                 sprite_status, sprite_xs, sprite_xe);
     } else {
-        draw_mc_sprite_normal(data_ptr, n, c, msk_ptr, ptr, lshift, sptr,
+        draw_mc_sprite_normal(data_ptr, n, c, msk_ptr, ptr, lshift, spos,
                               sprite_status, sprite_xs, sprite_xe);
     }
 }
@@ -1094,7 +1131,8 @@ static void draw_sprite_partial(uint8_t *line_ptr, uint8_t *gfx_msk_ptr,
     }
 
     if (data_ptr != NULL) {
-        uint8_t *msk_ptr, *ptr, *sptr;
+        uint8_t *msk_ptr, *ptr;
+        int spos;
         int lshift;
 
         msk_ptr = gfx_msk_ptr
@@ -1102,15 +1140,15 @@ static void draw_sprite_partial(uint8_t *line_ptr, uint8_t *gfx_msk_ptr,
                      - VICII_RASTER_X(0) - vicii.raster.sprite_xsmooth) / 8;
         ptr = line_ptr + sprite_offset;
         lshift = (sprite_offset - vicii.raster.sprite_xsmooth) & 0x7;
-        sptr = sprline - VICII_RASTER_X(0) + sprite_offset;
+        spos = sprite_offset - VICII_RASTER_X(0);
 
         if (sprite_status->sprites[n].multicolor) {
             draw_mc_sprite(gfx_msk_ptr, data_ptr, n, msk_ptr, ptr,
-                           lshift, sptr, sprite_status,
+                           lshift, spos, sprite_status,
                            sprite_xs, sprite_xe);
         } else {
             draw_hires_sprite(gfx_msk_ptr, data_ptr, n, msk_ptr, ptr,
-                              lshift, sptr, sprite_status,
+                              lshift, spos, sprite_status,
                               sprite_xs, sprite_xe);
         }
     }
@@ -1328,12 +1366,13 @@ void vicii_sprites_reset_xshift(void)
 
 void vicii_sprites_reset_sprline(void)
 {
-    memset(sprline, 0, vicii.sprite_wrap_x);
+    memset(sprline, 0, SPRLINE_PLANES * sprline_words * sizeof(uint64_t));
 }
 
 void vicii_sprites_init_sprline(void)
 {
-    sprline = lib_realloc(sprline, vicii.sprite_wrap_x);
+    sprline_words = (SPRLINE_GUARD + vicii.sprite_wrap_x + 128) / 64 + 1;
+    sprline = lib_realloc(sprline, SPRLINE_PLANES * sprline_words * sizeof(uint64_t));
 }
 
 void vicii_sprites_shutdown(void)
@@ -1345,3 +1384,35 @@ int vicii_sprite_offset(void)
 {
     return vicii.screen_leftborderwidth - 24;
 }
+
+#ifdef PSV_BENCH
+void vicii_sprites_test_init(void)
+{
+    init_drawing_tables();
+    vicii_sprites_init_sprline();
+    vicii_sprites_reset_sprline();
+}
+
+uint8_t vicii_sprites_test_mask(uint32_t msk, uint32_t gfxmsk, int size,
+                                int n, uint8_t *ptr, int pos, uint32_t color)
+{
+    return sprite_mask(msk, gfxmsk, size, n, ptr, pos, color);
+}
+
+uint8_t vicii_sprites_test_mcmask(uint32_t mcmsk, uint32_t gfxmsk,
+                                  uint32_t trmsk, int size, int expanded,
+                                  int n, uint8_t *ptr, int pos,
+                                  const uint32_t *pixel_table)
+{
+    return mcsprite_mask(mcmsk, gfxmsk, trmsk, size, expanded, n, ptr, pos,
+                         pixel_table);
+}
+
+uint32_t vicii_sprites_test_trim(int size, int sprite_xs, int sprite_xe)
+{
+    uint32_t msk;
+
+    TRIM_MSK(msk, size);
+    return msk;
+}
+#endif
@@ -49,4 +49,20 @@ extern void vicii_sprites_init_sprline(void);
 extern void vicii_sprites_reset_xshift(void);
 extern int vicii_sprite_offset(void);
 
+#ifdef PSV_BENCH
+/* The sprite pixel functions, for the self test of the benchmark runner.
+   vicii_sprites_test_init() sets up the tables and the line of sprite
+   pixels for the current `vicii.sprite_wrap_x'; clear the line with
+   vicii_sprites_reset_sprline() and free it with vicii_sprites_shutdown().  */
+extern void vicii_sprites_test_init(void);
+extern uint8_t vicii_sprites_test_mask(uint32_t msk, uint32_t gfxmsk, int size,
+                                       int n, uint8_t *ptr, int pos,
+                                       uint32_t color);
+extern uint8_t vicii_sprites_test_mcmask(uint32_t mcmsk, uint32_t gfxmsk,
+                                         uint32_t trmsk, int size,
+                                         int expanded, int n, uint8_t *ptr,
+                                         int pos, const uint32_t *pixel_table);
+extern uint32_t vicii_sprites_test_trim(int size, int sprite_xs, int sprite_xe);
+#endif
+
 #endif
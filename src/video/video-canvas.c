@@ -106,10 +106,11 @@ void video_canvas_render(video_canvas_t *canvas, uint8_t *trg, int width,
     if (!canvas->videoconfig->color_tables.updated) { /* update colors as necessary */
         video_color_update_palette(canvas);
     }
-    video_render_main(canvas->videoconfig, canvas->draw_buffer->draw_buffer,
-                      trg, width, height, xs, ys, xt, yt,
-                      canvas->draw_buffer->draw_buffer_width, pitcht, depth,
-                      viewport);
+    video_render_threads_main(canvas->videoconfig,
+                              canvas->draw_buffer->draw_buffer,
+                              trg, width, height, xs, ys, xt, yt,
+                              canvas->draw_buffer->draw_buffer_width, pitcht,
+                              depth, viewport);
 }
 
 void video_canvas_refresh_all(video_canvas_t *canvas)
@@ -0,0 +1,339 @@
+/*
+ * video-render-threads.c - Render the image in bands on worker threads.
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+/* The renderers convert the draw buffer one line after the other on the
+   calling thread.  video_render_threads_main() splits the area in
+   horizontal bands and renders them in parallel: the calling thread renders
+   the first band, and each worker thread one of the others.
+
+   The filters carry state from one line to the next in the line buffers of
+   the colour tables: the PAL delay line, and the RGB of the previous line
+   for the scanlines.  Each worker renders with its own copy of the render
+   config, which has the same tables but its own line buffers.  The
+   renderers fill these buffers from the source lines above the area, so a
+   band comes out exactly as when the whole area is rendered in one go.
+
+   A band must start on a source line, and the scanline after the last line
+   of a band is drawn by that band.  Only the render modes that are known
+   to work this way are split (see video_render_band_scale()); the others
+   are rendered on the calling thread as before.  */
+
+#include "vice.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "lib.h"
+#include "log.h"
+#include "types.h"
+#include "video-render.h"
+#include "video-sound.h"
+#include "video.h"
+
+#ifdef USE_RENDER_THREADS
+
+#include <pthread.h>
+
+/* Source lines a band has at least.  */
+#define VIDEO_RENDER_BAND_MIN       16
+
+/* The part of the config that is copied for each band: all but the line
+   buffers at the end of the colour tables, and the fullscreen settings
+   after them, which the renderers don't use.  */
+#define VIDEO_RENDER_CONFIG_SHARED  (offsetof(video_render_config_t, color_tables) \
+                                     + offsetof(video_render_color_tables_t, line_yuv_0))
+
+typedef struct render_band_s {
+    video_render_config_t *config;
+    uint8_t *src;
+    uint8_t *trg;
+    int width;
+    int height;
+    int xs;
+    int ys;
+    int xt;
+    int yt;
+    int pitchs;
+    int pitcht;
+    int depth;
+    viewport_t *viewport;
+} render_band_t;
+
+typedef struct render_worker_s {
+    pthread_t thread_id;
+    video_render_config_t *config;  /* private copy of the band's config */
+    render_band_t band;
+    unsigned int seq;               /* last job seen */
+} render_worker_t;
+
+static render_worker_t workers[VIDEO_RENDER_THREADS_MAX];
+static int num_workers = 0;
+
+static pthread_mutex_t render_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static unsigned int job_seq = 0;
+static int job_bands = 0;       /* workers used by the current job */
+static int jobs_pending = 0;    /* workers still rendering */
+static int render_quit = 0;
+
+static log_t render_threads_log = LOG_DEFAULT;
+
+/* ------------------------------------------------------------------------- */
+
+/* Target lines per source line of the render modes that can be split, or 0
+   if the mode is rendered in one go.  */
+static int video_render_band_scale(int rendermode)
+{
+    switch (rendermode) {
+        case VIDEO_RENDER_PAL_1X1:
+        case VIDEO_RENDER_RGB_1X1:
+        case VIDEO_RENDER_CRT_1X1:
+            return 1;
+        case VIDEO_RENDER_PAL_2X2:
+        case VIDEO_RENDER_RGB_1X2:
+        case VIDEO_RENDER_RGB_2X2:
+        case VIDEO_RENDER_CRT_1X2:
+        case VIDEO_RENDER_CRT_2X2:
+            return 2;
+    }
+    return 0;
+}
+
+static void *render_thread(void *arg)
+{
+    render_worker_t *worker = (render_worker_t *)arg;
+    render_band_t *band = &worker->band;
+    int index = (int)(worker - workers);
+
+    pthread_mutex_lock(&render_mutex);
+
+    for (;;) {
+        while (worker->seq == job_seq && !render_quit) {
+            pthread_cond_wait(&start_cond, &render_mutex);
+        }
+        if (render_quit) {
+            break;
+        }
+        worker->seq = job_seq;
+        if (index >= job_bands) {
+            continue;
+        }
+        pthread_mutex_unlock(&render_mutex);
+
+        memcpy(worker->config, band->config, VIDEO_RENDER_CONFIG_SHARED);
+        video_render_area(worker->config, band->src, band->trg,
+                          band->width, band->height,
+                          band->xs, band->ys, band->xt, band->yt,
+                          band->pitchs, band->pitcht, band->depth,
+                          band->viewport);
+
+        pthread_mutex_lock(&render_mutex);
+        if (--jobs_pending == 0) {
+            pthread_cond_signal(&done_cond);
+        }
+    }
+
+    pthread_mutex_unlock(&render_mutex);
+
+    return NULL;
+}
+
+static void render_threads_start(int num)
+{
+    int i;
+
+    if (render_threads_log == LOG_DEFAULT) {
+        render_threads_log = log_open("RenderThreads");
+    }
+
+    render_quit = 0;
+
+    for (i = 0; i < num; i++) {
+        workers[i].config = lib_malloc(sizeof(video_render_config_t));
+        workers[i].seq = job_seq;
+        if (pthread_create(&workers[i].thread_id, NULL, render_thread, &workers[i]) != 0) {
+            log_error(render_threads_log, "Cannot create render thread.");
+            lib_free(workers[i].config);
+            break;
+        }
+    }
+    num_workers = i;
+
+    log_message(render_threads_log, "%d render threads started.", num_workers);
+}
+
+static void render_threads_stop(void)
+{
+    int i;
+
+    if (num_workers == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&render_mutex);
+    render_quit = 1;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&render_mutex);
+
+    for (i = 0; i < num_workers; i++) {
+        pthread_join(workers[i].thread_id, NULL);
+        lib_free(workers[i].config);
+        workers[i].config = NULL;
+    }
+    num_workers = 0;
+    render_quit = 0;
+
+    log_message(render_threads_log, "Render threads stopped.");
+}
+
+/* ------------------------------------------------------------------------- */
+
+void video_render_threads_main(video_render_config_t *config, uint8_t *src,
+                               uint8_t *trg, int width, int height,
+                               int xs, int ys, int xt, int yt,
+                               int pitchs, int pitcht, int depth,
+                               viewport_t *viewport)
+{
+    render_band_t *band;
+    int start[VIDEO_RENDER_THREADS_MAX + 1];
+    int scale, bands, lines, i;
+
+    scale = video_render_band_scale(config->rendermode);
+    bands = num_workers + 1;
+
+    if (scale > 0 && bands > height / scale / VIDEO_RENDER_BAND_MIN) {
+        bands = height / scale / VIDEO_RENDER_BAND_MIN;
+    }
+
+    if (scale == 0 || bands < 2 || width <= 0) {
+        video_render_main(config, src, trg, width, height, xs, ys, xt, yt,
+                          pitchs, pitcht, depth, viewport);
+        return;
+    }
+
+    video_sound_update(config, src, width, height, xs, ys, pitchs, viewport);
+
+    /* First source line of each band; the last one also gets the rest.  The
+       scanline renderers draw the line after the last line of the viewport
+       differently when they start on it, so no band starts there.  */
+    lines = height / scale / bands;
+    for (i = 0; i < bands; i++) {
+        start[i] = ys + i * lines;
+        if (i > 0 && start[i] == (int)viewport->last_line + 1) {
+            start[i]++;
+        }
+    }
+
+    pthread_mutex_lock(&render_mutex);
+    for (i = 1; i < bands; i++) {
+        band = &workers[i - 1].band;
+        band->config = config;
+        band->src = src;
+        band->trg = trg;
+        band->width = width;
+        band->height = (i < bands - 1) ? (start[i + 1] - start[i]) * scale
+                                       : height - (start[i] - ys) * scale;
+        band->xs = xs;
+        band->ys = start[i];
+        band->xt = xt;
+        band->yt = yt + (start[i] - ys) * scale;
+        band->pitchs = pitchs;
+        band->pitcht = pitcht;
+        band->depth = depth;
+        band->viewport = viewport;
+    }
+    job_bands = bands - 1;
+    jobs_pending = bands - 1;
+    job_seq++;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&render_mutex);
+
+    video_render_area(config, src, trg, width, (start[1] - ys) * scale,
+                      xs, ys, xt, yt, pitchs, pitcht, depth, viewport);
+
+    pthread_mutex_lock(&render_mutex);
+    while (jobs_pending > 0) {
+        pthread_cond_wait(&done_cond, &render_mutex);
+    }
+    pthread_mutex_unlock(&render_mutex);
+}
+
+void video_render_threads_set(int num)
+{
+    if (num < 0) {
+        num = 0;
+    }
+    if (num > VIDEO_RENDER_THREADS_MAX) {
+        num = VIDEO_RENDER_THREADS_MAX;
+    }
+    if (num == num_workers) {
+        return;
+    }
+
+    render_threads_stop();
+    if (num > 0) {
+        render_threads_start(num);
+    }
+}
+
+void video_render_threads_shutdown(void)
+{
+    render_threads_stop();
+}
+
+#ifdef PSV_BENCH
+int video_render_threads_test_scale(int rendermode)
+{
+    return video_render_band_scale(rendermode);
+}
+#endif
+
+#else /* !USE_RENDER_THREADS */
+
+void video_render_threads_main(video_render_config_t *config, uint8_t *src,
+                               uint8_t *trg, int width, int height,
+                               int xs, int ys, int xt, int yt,
+                               int pitchs, int pitcht, int depth,
+                               viewport_t *viewport)
+{
+    video_render_main(config, src, trg, width, height, xs, ys, xt, yt,
+                      pitchs, pitcht, depth, viewport);
+}
+
+void video_render_threads_set(int num)
+{
+}
+
+void video_render_threads_shutdown(void)
+{
+}
+
+#ifdef PSV_BENCH
+int video_render_threads_test_scale(int rendermode)
+{
+    return 0;
+}
+#endif
+
+#endif
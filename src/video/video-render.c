@@ -102,9 +102,6 @@ void video_render_main(video_render_config_t *config, uint8_t *src, uint8_t *trg
                        int width, int height, int xs, int ys, int xt, int yt,
                        int pitchs, int pitcht, int depth, viewport_t *viewport)
 {
-    const video_render_color_tables_t *colortab;
-    int rendermode;
-
 #if 0
     log_debug("w:%i h:%i xs:%i ys:%i xt:%i yt:%i ps:%i pt:%i d%i",
               width, height, xs, ys, xt, yt, pitchs, pitcht, depth);
@@ -116,6 +113,18 @@ void video_render_main(video_render_config_t *config, uint8_t *src, uint8_t *trg
 
     video_sound_update(config, src, width, height, xs, ys, pitchs, viewport);
 
+    video_render_area(config, src, trg, width, height, xs, ys, xt, yt,
+                      pitchs, pitcht, depth, viewport);
+}
+
+/* Same as video_render_main(), without the video sound update.  */
+void video_render_area(video_render_config_t *config, uint8_t *src, uint8_t *trg,
+                       int width, int height, int xs, int ys, int xt, int yt,
+                       int pitchs, int pitcht, int depth, viewport_t *viewport)
+{
+    const video_render_color_tables_t *colortab;
+    int rendermode;
+
     rendermode = config->rendermode;
     colortab = &config->color_tables;
 
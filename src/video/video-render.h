@@ -39,8 +39,35 @@ extern void video_render_main(struct video_render_config_s *config, uint8_t *src
                               int xs, int ys, int xt, int yt,
                               int pitchs, int pitcht, int depth,
                               viewport_t *viewport);
+extern void video_render_area(struct video_render_config_s *config, uint8_t *src,
+                              uint8_t *trg, int width, int height,
+                              int xs, int ys, int xt, int yt,
+                              int pitchs, int pitcht, int depth,
+                              viewport_t *viewport);
 extern void video_render_update_palette(struct video_canvas_s *canvas);
 
+/* Same as video_render_main(), but the area is rendered in bands on the
+   render threads, if there are any and the render mode allows.  */
+extern void video_render_threads_main(struct video_render_config_s *config,
+                                      uint8_t *src, uint8_t *trg,
+                                      int width, int height,
+                                      int xs, int ys, int xt, int yt,
+                                      int pitchs, int pitcht, int depth,
+                                      viewport_t *viewport);
+/* Number of worker threads besides the calling one, at most
+   VIDEO_RENDER_THREADS_MAX; the value of the "RenderThreads" resource.  Must
+   be called by the thread that renders.  */
+#define VIDEO_RENDER_THREADS_MAX    3
+extern void video_render_threads_set(int num);
+extern void video_render_threads_shutdown(void);
+
+#ifdef PSV_BENCH
+/* Target lines per source line of a render mode that is rendered in bands,
+   for the self test of the benchmark runner; 0 if it is rendered in one go,
+   or if there are no render threads.  */
+extern int video_render_threads_test_scale(int rendermode);
+#endif
+
 extern void video_render_1x2func_set(void (*func)(struct video_render_config_s *,
                                                   const uint8_t *, uint8_t *,
                                                   unsigned int, const unsigned int,
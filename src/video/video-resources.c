@@ -45,6 +45,7 @@
 #include "machine.h"
 #include "resources.h"
 #include "video-color.h"
+#include "video-render.h"
 #include "video.h"
 #include "viewport.h"
 #include "util.h"
@@ -70,6 +71,27 @@ static resource_int_t resources_hwscale_possible[] =
 };
 #endif
 
+static int render_threads;
+
+static int set_render_threads(int val, void *param)
+{
+    if (val < 0 || val > VIDEO_RENDER_THREADS_MAX) {
+        return -1;
+    }
+
+    render_threads = val;
+    video_render_threads_set(val);
+
+    return 0;
+}
+
+static resource_int_t resources_render_threads[] =
+{
+    { "RenderThreads", 0, RES_EVENT_NO, NULL,
+      &render_threads, set_render_threads, NULL },
+    RESOURCE_INT_LIST_END
+};
+
 int video_resources_init(void)
 {
 #ifdef HAVE_HWSCALE
@@ -80,11 +102,18 @@ int video_resources_init(void)
     }
 #endif
 
+    if (machine_class != VICE_MACHINE_VSID) {
+        if (resources_register_int(resources_render_threads) < 0) {
+            return -1;
+        }
+    }
+
     return video_arch_resources_init();
 }
 
 void video_resources_shutdown(void)
 {
+    video_render_threads_shutdown();
     video_arch_resources_shutdown();
 }
 
@@ -54,6 +54,7 @@ int vsync_frame_counter;
 #include "clkguard.h"
 #include "cmdline.h"
 #include "debug.h"
+#include "frameprof.h"
 #include "log.h"
 #include "maincpu.h"
 #include "machine.h"
@@ -62,6 +63,8 @@ int vsync_frame_counter;
 #endif
 #include "network.h"
 #include "resources.h"
+#include "rewind.h"
+#include "runahead.h"
 #include "sound.h"
 #include "types.h"
 #include "vsync.h"
@@ -80,6 +83,10 @@ static int refresh_rate;
 /* "Warp mode".  If nonzero, attempt to run as fast as possible. */
 static int warp_mode_enabled;
 
+/* Frame pacing mode.  With VSYNC_PACING_AUDIO the fill level of the sound
+   device buffer paces the emulation instead of the host timer. */
+static int pacing_mode;
+
 
 static int set_relative_speed(int val, void *param)
 {
@@ -111,6 +118,22 @@ static int set_warp_mode(int val, void *param)
     return 0;
 }
 
+static int set_pacing_mode(int val, void *param)
+{
+    switch (val) {
+        case VSYNC_PACING_TIMER:
+        case VSYNC_PACING_AUDIO:
+            break;
+        default:
+            return -1;
+    }
+
+    pacing_mode = val;
+    vsync_sync_reset();
+
+    return 0;
+}
+
 
 /* Vsync-related resources. */
 static const resource_int_t resources_int[] = {
@@ -121,6 +144,8 @@ static const resource_int_t resources_int[] = {
     { "WarpMode", 0, RES_EVENT_STRICT, (resource_value_t)0,
       /* FIXME: maybe RES_EVENT_NO */
       &warp_mode_enabled, set_warp_mode, NULL },
+    { "VsyncPacing", VSYNC_PACING_TIMER, RES_EVENT_NO, NULL,
+      &pacing_mode, set_pacing_mode, NULL },
     RESOURCE_INT_LIST_END
 };
 
@@ -161,6 +186,9 @@ static const cmdline_option_t cmdline_options[] =
     { "+warp", SET_RESOURCE, CMDLINE_ATTRIB_NONE,
       NULL, NULL, "WarpMode", (resource_value_t)0,
       NULL, "Disable warp mode" },
+    { "-vsyncpacing", SET_RESOURCE, CMDLINE_ATTRIB_NEED_ARGS,
+      NULL, NULL, "VsyncPacing", NULL,
+      "<mode>", "Frame pacing mode (0: host timer, 1: sound buffer fill level)" },
     CMDLINE_LIST_END
 };
 
@@ -316,9 +344,23 @@ void vsync_sync_reset(void)
     sync_reset = 1;
 }
 
-/* This is called at the end of each screen frame. It flushes the
-   audio buffer and keeps control of the emulation speed. */
+/* This is called at the end of each screen frame. */
 int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
+{
+    int skip_next_frame;
+
+    /* The frames emulated ahead are not synchronized; run-ahead calls
+       vsync_sync_frame() itself once it is back at the real frame.  */
+    if (runahead_end_frame(been_skipped, &skip_next_frame)) {
+        return skip_next_frame;
+    }
+
+    return vsync_sync_frame(been_skipped);
+}
+
+/* This is called once for every displayed frame. It flushes the audio
+   buffer and keeps control of the emulation speed. */
+int vsync_sync_frame(int been_skipped)
 {
     static unsigned long next_frame_start = 0;
     unsigned long network_hook_time = 0;
@@ -341,6 +383,7 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
     static signed long avg_sdelay, prev_sdelay;
 
     double sound_delay;
+    double sound_queued, sound_bufsize = 0;
     int skip_next_frame;
 
     signed long delay;
@@ -408,7 +451,9 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
     }
 
     /* Flush sound buffer, get delay in seconds. */
+    FRAMEPROF_ENTER(FRAMEPROF_SOUND);
     sound_delay = sound_flush();
+    FRAMEPROF_LEAVE();
 
     /* Get current time, directly after getting the sound delay. */
     now = vsyncarch_gettime();
@@ -440,59 +485,103 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
     }
 
 
-    /* This is the time between the start of the next frame and now. */
-    delay = (signed long)(now - next_frame_start);
-    /*
-     * We sleep until the start of the next frame, if:
-     *  - warp_mode is disabled
-     *  - a limiting speed is given
-     *  - we have not reached next_frame_start yet
-     *
-     * We could optimize by sleeping only if a frame is to be output.
-     */
-    /*log_debug("vsync_do_vsync: sound_delay=%f  frame_ticks=%d  delay=%d", sound_delay, frame_ticks, delay);*/
-    if (!warp_mode_enabled && timer_speed && (skipped_redraw == 0) && (delay < 0)) {
-        /* FIXME: this is likely implemented as a regular sleep(), which means
-           it will wait *at least* the given time (but may just as well wait
-           much longer. its doomed to break on those archs - we should instead
-           "lean against" the sound output, and let the sound hardware be the
-           timing reference */
-        vsyncarch_sleep(-delay);
+    /* Get the sound buffer fill level if the sound output paces us. */
+    sound_queued = -1;
+    if (pacing_mode == VSYNC_PACING_AUDIO && !warp_mode_enabled && timer_speed) {
+        sound_queued = sound_get_queued_time(&sound_bufsize);
     }
-    /*
-     * Check whether we should skip the next frame or not.
-     * Allow delay of up to one frame before skipping frames.
-     * Frames are skipped:
-     *  - only if maximum skipped frames are not reached
-     *  - if warp_mode enabled
-     *  - if speed is not limited or we are too slow and
-     *    refresh rate is automatic or fixed and needs correction
-     *
-     * Remark: The time_deviation should be the equivalent of two
-     *         frames and must be scaled to make sure, that we
-     *         don't start skipping frames before the CPU reaches 100%.
-     *         If we are becoming faster a small deviation because of
-     *         threading results in a frame rate correction suddenly.
-     */
 
-    /* this doesnt really work correctly, and it shouldnt be neceassary either */
-    frame_ticks_remainder = frame_ticks % 100;
-    frame_ticks_integer = frame_ticks / 100;
-    compval = (frame_ticks_integer * 3 * timer_speed)
-              + ((frame_ticks_remainder * 3 * timer_speed) / 100);
-
-    if ((skipped_redraw < MAX_SKIPPED_FRAMES)
-        && (warp_mode_enabled
-            || (skipped_redraw < (refresh_rate - 1))
-            || ((!timer_speed || delay > compval) && !refresh_rate))
-        ) {
-        /* printf("skipped redraw:%d timer_speed:%3d refresh_rate:%2d delay:%6lx compval:%6lx frame_ticks:%lx\n",
-               skipped_redraw,timer_speed,refresh_rate,delay,compval,frame_ticks); */
-        skip_next_frame = 1;
-        skipped_redraw++;
+    if (sound_queued >= 0) {
+        /* Length of a frame at the current speed, in seconds. */
+        double frame_time = (double)frame_ticks_orig / vsyncarch_freq;
+
+        /*
+         * Lean against the sound output: sleep only for the time the sound
+         * device needs to play back what it holds in excess of half its
+         * buffer.  Oversleeping just eats into the remaining half, so it
+         * no longer accumulates into stutter.
+         */
+        if (skipped_redraw == 0 && sound_queued > sound_bufsize / 2) {
+            FRAMEPROF_ENTER(FRAMEPROF_SLEEP);
+            vsyncarch_sleep((unsigned long)((sound_queued - sound_bufsize / 2)
+                                            * vsyncarch_freq));
+            FRAMEPROF_LEAVE();
+        }
+
+        /*
+         * Skip the next frame if the sound buffer holds less than a frame
+         * of sound, i.e. if we are about to underrun.
+         */
+        if ((skipped_redraw < MAX_SKIPPED_FRAMES)
+            && ((skipped_redraw < (refresh_rate - 1))
+                || (sound_queued < frame_time && !refresh_rate))) {
+            skip_next_frame = 1;
+            skipped_redraw++;
+        } else {
+            skip_next_frame = 0;
+            skipped_redraw = 0;
+        }
+
+        /* The timer based code takes over from here if sound stops. */
+        next_frame_start = now;
+        delay = 0;
     } else {
-        skip_next_frame = 0;
-        skipped_redraw = 0;
+        /* This is the time between the start of the next frame and now. */
+        delay = (signed long)(now - next_frame_start);
+        /*
+         * We sleep until the start of the next frame, if:
+         *  - warp_mode is disabled
+         *  - a limiting speed is given
+         *  - we have not reached next_frame_start yet
+         *
+         * We could optimize by sleeping only if a frame is to be output.
+         */
+        /*log_debug("vsync_do_vsync: sound_delay=%f  frame_ticks=%d  delay=%d", sound_delay, frame_ticks, delay);*/
+        if (!warp_mode_enabled && timer_speed && (skipped_redraw == 0) && (delay < 0)) {
+            /* FIXME: this is likely implemented as a regular sleep(), which means
+               it will wait *at least* the given time (but may just as well wait
+               much longer. its doomed to break on those archs - we should instead
+               "lean against" the sound output, and let the sound hardware be the
+               timing reference */
+            FRAMEPROF_ENTER(FRAMEPROF_SLEEP);
+            vsyncarch_sleep(-delay);
+            FRAMEPROF_LEAVE();
+        }
+        /*
+         * Check whether we should skip the next frame or not.
+         * Allow delay of up to one frame before skipping frames.
+         * Frames are skipped:
+         *  - only if maximum skipped frames are not reached
+         *  - if warp_mode enabled
+         *  - if speed is not limited or we are too slow and
+         *    refresh rate is automatic or fixed and needs correction
+         *
+         * Remark: The time_deviation should be the equivalent of two
+         *         frames and must be scaled to make sure, that we
+         *         don't start skipping frames before the CPU reaches 100%.
+         *         If we are becoming faster a small deviation because of
+         *         threading results in a frame rate correction suddenly.
+         */
+
+        /* this doesnt really work correctly, and it shouldnt be neceassary either */
+        frame_ticks_remainder = frame_ticks % 100;
+        frame_ticks_integer = frame_ticks / 100;
+        compval = (frame_ticks_integer * 3 * timer_speed)
+                  + ((frame_ticks_remainder * 3 * timer_speed) / 100);
+
+        if ((skipped_redraw < MAX_SKIPPED_FRAMES)
+            && (warp_mode_enabled
+                || (skipped_redraw < (refresh_rate - 1))
+                || ((!timer_speed || delay > compval) && !refresh_rate))
+            ) {
+            /* printf("skipped redraw:%d timer_speed:%3d refresh_rate:%2d delay:%6lx compval:%6lx frame_ticks:%lx\n",
+                   skipped_redraw,timer_speed,refresh_rate,delay,compval,frame_ticks); */
+            skip_next_frame = 1;
+            skipped_redraw++;
+        } else {
+            skip_next_frame = 0;
+            skipped_redraw = 0;
+        }
     }
 
     /*
@@ -549,6 +638,10 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
 
     vsyncarch_postsync();
 
+    rewind_end_frame();
+
+    frameprof_end_frame();
+
 #ifdef VSYNC_DEBUG
     log_debug("vsync: start:%lu  delay:%ld  sound-delay:%lf  end:%lu  next-frame:%lu  frame-ticks:%lu", 
                 now, delay, sound_delay * 1000000, vsyncarch_gettime(), next_frame_start, frame_ticks);
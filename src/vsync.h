@@ -33,6 +33,10 @@
 #define VSYNC_DEBUG
 #endif
 
+/* Frame pacing modes.  */
+#define VSYNC_PACING_TIMER  0
+#define VSYNC_PACING_AUDIO  1
+
 struct video_canvas_s;
 
 extern int vsync_frame_counter;
@@ -45,6 +49,7 @@ extern void vsync_init(void (*hook)(void));
 extern void vsync_set_machine_parameter(double refresh_rate, long cycles);
 extern double vsync_get_refresh_frequency(void);
 extern int vsync_do_vsync(struct video_canvas_s *c, int been_skipped);
+extern int vsync_sync_frame(int been_skipped);
 extern int vsync_disable_timer(void);
 
 #endif
@@ -30,6 +30,11 @@
 
 /* This code might be improved a lot...  */
 
+/* For fopencookie().  */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
+
 #include "vice.h"
 
 #include <ctype.h>
@@ -54,6 +59,7 @@
 #include "ioutil.h"
 #include "lib.h"
 #include "log.h"
+#include "types.h"
 #include "util.h"
 #include "zfile.h"
 #include "zipcode.h"
@@ -76,9 +82,32 @@ enum compression_type {
     COMPR_ARCHIVE,
     COMPR_ZIPCODE,
     COMPR_LYNX,
-    COMPR_TZX
+    COMPR_TZX,
+    COMPR_MEMORY
 };
 
+/* This defines a linked list of the files that are kept in memory, see
+   zfile_memory_add().  */
+struct zfile_memory_s {
+    char *name;                  /* Complete path of the file.  */
+    uint8_t *data;
+    size_t size;
+    size_t alloc;                /* Bytes allocated for `data'.  */
+    int dirty;                   /* Written to since it was last written back.  */
+    int open_count;              /* Number of streams open on `data'.  */
+    int removed;                 /* Free `data' once the last one is closed.  */
+    struct zfile_memory_s *next;
+};
+typedef struct zfile_memory_s zfile_memory_t;
+
+/* Position of a stream on a file in memory.  */
+struct zfile_memory_stream_s {
+    zfile_memory_t *memory;
+    size_t pos;
+    int append;                  /* Every write goes to the end.  */
+};
+typedef struct zfile_memory_stream_s zfile_memory_stream_t;
+
 /* This defines a linked list of all the compressed files that have been
    opened.  */
 struct zfile_s {
@@ -91,11 +120,14 @@ struct zfile_s {
     struct zfile_s *prev, *next; /* Link to the previous and next nodes.  */
     zfile_action_t action;       /* action on close */
     char *request_string;        /* ui string for action=ZFILE_REQUEST */
+    zfile_memory_t *memory;      /* File in memory, for COMPR_MEMORY.  */
 };
 typedef struct zfile_s zfile_t;
 
 static zfile_t *zfile_list = NULL;
 
+static zfile_memory_t *zfile_memory_list = NULL;
+
 static log_t zlog = LOG_ERR;
 
 /* ------------------------------------------------------------------------- */
@@ -175,6 +207,7 @@ static void zfile_list_add(const char *tmp_name,
     new_zfile->type = type;
     new_zfile->action = ZFILE_KEEP;
     new_zfile->request_string = NULL;
+    new_zfile->memory = NULL;
     new_zfile->next = zfile_list;
     new_zfile->prev = NULL;
     if (zfile_list != NULL) {
@@ -186,6 +219,248 @@ static void zfile_list_add(const char *tmp_name,
 void zfile_shutdown(void)
 {
     zfile_list_destroy();
+
+    while (zfile_memory_list != NULL) {
+        zfile_memory_t *next = zfile_memory_list->next;
+
+        lib_free(zfile_memory_list->name);
+        lib_free(zfile_memory_list->data);
+        lib_free(zfile_memory_list);
+        zfile_memory_list = next;
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+
+/* Files in memory.  */
+
+static zfile_memory_t *zfile_memory_find(const char *name)
+{
+    char *fullname = NULL;
+    zfile_memory_t *p;
+
+    if (zfile_memory_list == NULL) {
+        return NULL;
+    }
+
+    archdep_expand_path(&fullname, name);
+
+    for (p = zfile_memory_list; p != NULL; p = p->next) {
+        if (!strcmp(p->name, fullname)) {
+            break;
+        }
+    }
+
+    lib_free(fullname);
+    return p;
+}
+
+/* Take `p' off the list.  The data is freed now, or when the last stream on
+   it is closed.  */
+static void zfile_memory_unlink(zfile_memory_t *p)
+{
+    zfile_memory_t **pp;
+
+    for (pp = &zfile_memory_list; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == p) {
+            *pp = p->next;
+            break;
+        }
+    }
+
+    if (p->open_count > 0) {
+        p->removed = 1;
+        return;
+    }
+
+    lib_free(p->name);
+    lib_free(p->data);
+    lib_free(p);
+}
+
+#ifdef HAVE_FOPENCOOKIE
+/* Offset type of the fopencookie() seek function.  */
+#if defined(__NEWLIB__) && !defined(__LARGE64_FILES)
+typedef off_t zfile_cookie_off_t;
+#elif defined(__NEWLIB__)
+typedef _off64_t zfile_cookie_off_t;
+#else
+typedef off64_t zfile_cookie_off_t;
+#endif
+
+static ssize_t zfile_memory_read(void *cookie, char *buf, size_t size)
+{
+    zfile_memory_stream_t *ms = cookie;
+    zfile_memory_t *p = ms->memory;
+
+    if (ms->pos >= p->size) {
+        return 0;
+    }
+    if (size > p->size - ms->pos) {
+        size = p->size - ms->pos;
+    }
+
+    memcpy(buf, p->data + ms->pos, size);
+    ms->pos += size;
+    return (ssize_t)size;
+}
+
+/* Writes past the end make the file grow, as with a real one.  */
+static ssize_t zfile_memory_write(void *cookie, const char *buf, size_t size)
+{
+    zfile_memory_stream_t *ms = cookie;
+    zfile_memory_t *p = ms->memory;
+    size_t end;
+
+    if (ms->append) {
+        ms->pos = p->size;
+    }
+    end = ms->pos + size;
+
+    if (end > p->alloc) {
+        while (p->alloc < end) {
+            p->alloc *= 2;
+        }
+        p->data = lib_realloc(p->data, p->alloc);
+    }
+    if (ms->pos > p->size) {
+        memset(p->data + p->size, 0, ms->pos - p->size);
+    }
+
+    memcpy(p->data + ms->pos, buf, size);
+    ms->pos = end;
+    if (p->size < end) {
+        p->size = end;
+    }
+    p->dirty = 1;
+    return (ssize_t)size;
+}
+
+static int zfile_memory_seek(void *cookie, zfile_cookie_off_t *offset, int whence)
+{
+    zfile_memory_stream_t *ms = cookie;
+    zfile_cookie_off_t pos;
+
+    switch (whence) {
+        case SEEK_SET:
+            pos = *offset;
+            break;
+        case SEEK_CUR:
+            pos = (zfile_cookie_off_t)ms->pos + *offset;
+            break;
+        case SEEK_END:
+            pos = (zfile_cookie_off_t)ms->memory->size + *offset;
+            break;
+        default:
+            return -1;
+    }
+    if (pos < 0) {
+        return -1;
+    }
+
+    ms->pos = (size_t)pos;
+    *offset = pos;
+    return 0;
+}
+
+static int zfile_memory_close(void *cookie)
+{
+    lib_free(cookie);
+    return 0;
+}
+#endif
+
+static FILE *zfile_memory_open(zfile_memory_t *p, const char *mode)
+{
+#ifdef HAVE_FOPENCOOKIE
+    static const cookie_io_functions_t io = {
+        zfile_memory_read, zfile_memory_write, zfile_memory_seek, zfile_memory_close
+    };
+    zfile_memory_stream_t *ms;
+    FILE *stream;
+
+    ms = lib_malloc(sizeof(zfile_memory_stream_t));
+    ms->memory = p;
+    ms->pos = 0;
+    ms->append = (strchr(mode, 'a') != NULL);
+
+    stream = fopencookie(ms, mode, io);
+    if (stream == NULL) {
+        lib_free(ms);
+    }
+    return stream;
+#else
+    return NULL;
+#endif
+}
+
+/* Write a file in memory that has been changed back to `name'.  */
+static int zfile_memory_write_back(zfile_memory_t *p, const char *name)
+{
+    FILE *fd;
+    size_t written;
+
+    fd = fopen(name, MODE_WRITE);
+    if (fd == NULL) {
+        log_error(zlog, "Cannot write back `%s'.", name);
+        return -1;
+    }
+
+    written = fwrite(p->data, 1, p->size, fd);
+
+    if (fclose(fd) != 0 || written != p->size) {
+        log_error(zlog, "Cannot write back `%s'.", name);
+        return -1;
+    }
+
+    p->dirty = 0;
+    return 0;
+}
+
+/* Make `name' refer to the `size' bytes at `data', which must have been
+   allocated with lib_malloc() and belong to zfile from now on.  Opening
+   `name' then reads the data in memory instead of the file.  Writes go to
+   memory too, and may make it grow; a file that has been written to is
+   written to `name' when it is closed.  This way an image unpacked in
+   memory can be attached without going through the file system.  Return -1 if memory streams are not
+   supported; `data' is not taken over then.  */
+int zfile_memory_add(const char *name, uint8_t *data, size_t size)
+{
+#ifdef HAVE_FOPENCOOKIE
+    zfile_memory_t *p;
+
+    if (name == NULL || name[0] == 0 || data == NULL || size == 0) {
+        return -1;
+    }
+
+    /* Images still attached keep the old data until they are closed.  */
+    zfile_memory_remove(name);
+
+    p = lib_malloc(sizeof(zfile_memory_t));
+    archdep_expand_path(&p->name, name);
+    p->data = data;
+    p->size = size;
+    p->alloc = size;
+    p->dirty = 0;
+    p->open_count = 0;
+    p->removed = 0;
+    p->next = zfile_memory_list;
+    zfile_memory_list = p;
+
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* Forget the data in memory of `name', if any.  */
+void zfile_memory_remove(const char *name)
+{
+    zfile_memory_t *p = zfile_memory_find(name);
+
+    if (p != NULL) {
+        zfile_memory_unlink(p);
+    }
 }
 
 /* ------------------------------------------------------------------------ */
@@ -1019,6 +1294,7 @@ FILE *zfile_fopen(const char *name, const char *mode)
     FILE *stream;
     enum compression_type type;
     int write_mode = 0;
+    zfile_memory_t *memory;
 
     if (!zinit_done) {
         zinit();
@@ -1033,6 +1309,23 @@ FILE *zfile_fopen(const char *name, const char *mode)
         write_mode = 1;
     }
 
+    memory = zfile_memory_find(name);
+    if (memory != NULL) {
+        /* Writing a new file replaces the one in memory.  */
+        if (strchr(mode, 'w') != NULL) {
+            zfile_memory_unlink(memory);
+        } else {
+            stream = zfile_memory_open(memory, mode);
+            if (stream == NULL) {
+                return NULL;
+            }
+            zfile_list_add(NULL, name, COMPR_MEMORY, write_mode, stream, NULL);
+            zfile_list->memory = memory;
+            memory->open_count++;
+            return stream;
+        }
+    }
+
     /* Check for write permissions.  */
     if (write_mode && ioutil_access(name, IOUTIL_ACCESS_W_OK) < 0) {
         return NULL;
@@ -1097,6 +1390,20 @@ static int handle_close(zfile_t *ptr)
             ptr->tmp_name ? ptr->tmp_name : "(null)",
             ptr->orig_name, ptr->write_mode));
 
+    if (ptr->memory) {
+        zfile_memory_t *memory = ptr->memory;
+
+        if (memory->dirty) {
+            zfile_memory_write_back(memory, ptr->orig_name);
+        }
+
+        if (--memory->open_count == 0 && memory->removed) {
+            lib_free(memory->name);
+            lib_free(memory->data);
+            lib_free(memory);
+        }
+    }
+
     if (ptr->tmp_name) {
         /* Recompress into the original file.  */
         if (ptr->orig_name
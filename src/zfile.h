@@ -30,6 +30,8 @@
 
 #include <stdio.h>
 
+#include "types.h"
+
 /* actions to be done when a zfile is closed */
 typedef enum {
     ZFILE_KEEP,         /* Nothing, keep original file (default).  */
@@ -40,6 +42,9 @@ typedef enum {
 extern FILE *zfile_fopen(const char *name, const char *mode);
 extern int zfile_fclose(FILE *stream);
 
+extern int zfile_memory_add(const char *name, uint8_t *data, size_t size);
+extern void zfile_memory_remove(const char *name);
+
 extern void zfile_shutdown(void);
 
 extern int zfile_close_action(const char *filename, zfile_action_t action,